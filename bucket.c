@@ -0,0 +1,78 @@
+#include "yar.h"
+
+// add the tokens that have accrued since they were last added
+static void
+bucketFill(bucket_t *this)
+{
+  struct timespec now;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  this->tokens += tsDiff(&now, &(this->last)) * this->rate;
+  if (this->tokens > this->burst) this->tokens = this->burst;
+  this->last = now;
+}
+
+extern void
+bucketInit(bucket_t *this, double rate, int burst, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(bucket_t));
+  this->rate   = (rate > 0.0) ? rate : 0.0;
+  this->burst  = (burst > 0) ? burst : 1;
+  this->tokens = this->burst;
+  if (clock_gettime(CLOCK_SOURCE, &(this->last)) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+}
+
+// change the rate and burst: tokens accrued at the old rate are kept (up to
+// the new burst)
+extern void
+bucketSet(bucket_t *this, double rate, int burst)
+{
+  if (this->rate > 0.0) bucketFill(this);
+  else this->tokens = burst;
+  this->rate  = (rate > 0.0) ? rate : 0.0;
+  this->burst = (burst > 0) ? burst : 1;
+  if (clock_gettime(CLOCK_SOURCE, &(this->last)) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  if (this->tokens > this->burst) this->tokens = this->burst;
+}
+
+// number of bytes (at most max) that may be sent now.  The caller uses
+// bucketUse to account for the bytes it actually sends
+extern int
+bucketAvail(bucket_t *this, int max)
+{
+  if (this->rate <= 0.0) return max;
+  bucketFill(this);
+  if (this->tokens < 1.0) {
+    this->waits++;
+    return 0;
+  }
+  return (this->tokens < max) ? (int)this->tokens : max;
+}
+
+// seconds until n bytes (at most burst) may be sent
+extern double
+bucketWait(bucket_t *this, int n)
+{
+  if (this->rate <= 0.0) return 0.0;
+  if (n > this->burst) n = this->burst;
+  bucketFill(this);
+  if (this->tokens >= n) return 0.0;
+  return (n - this->tokens) / this->rate;
+}
+
+extern void
+bucketDump(bucket_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sbucket: this=%p rate=%f burst=%d tokens=%f bytes=%lu "
+	  "waits=%lu last=%ld:%ld\n", prefix, this, this->rate, this->burst,
+	  this->tokens, this->bytes, this->waits, this->last.tv_sec,
+	  this->last.tv_nsec);
+}
@@ -0,0 +1,37 @@
+#ifndef __YAR_BUCKET_H__
+#define __YAR_BUCKET_H__
+
+// Token Bucket Object
+//   Limits a byte stream to rate bytes/sec on average while letting up to
+//   burst bytes go at once.  Tokens accrue at rate up to burst and each
+//   byte sent uses one.  Bytes may be sent without checking (eg. to a
+//   command that is paced for both its client and the broadcast tty) in
+//   which case the bucket goes into debt that is repaid before more bytes
+//   are allowed.  A rate of 0 is unlimited.  A delay of d seconds between
+//   bytes is the special case rate=1/d, burst=1.
+typedef struct {
+  struct timespec last;    // when tokens were last added
+  double          rate;    // bytes/sec (0 unlimited)
+  double          tokens;  // bytes that may be sent now (< 0 in debt)
+  uint64_t        bytes;   // total bytes sent
+  uint64_t        waits;   // number of times the bucket was empty
+  int             burst;   // depth of the bucket (bytes)
+} bucket_t;
+
+extern void   bucketInit(bucket_t *this, double rate, int burst, bool iszeroed);
+extern void   bucketSet(bucket_t *this, double rate, int burst);
+extern int    bucketAvail(bucket_t *this, int max);
+extern double bucketWait(bucket_t *this, int n);
+extern void   bucketDump(bucket_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool bucketIsOn(bucket_t *this)
+{
+  return (this->rate > 0.0);
+}
+
+__attribute__((unused)) static inline void bucketUse(bucket_t *this, int n)
+{
+  this->bytes += n;
+  if (this->rate > 0.0) this->tokens -= n;
+}
+#endif
@@ -38,9 +38,201 @@ int fcntl(int fd, int cmd, ... /* arg */ );
 #define cmdbufDataEnd(n)   ( cmdbufWrapped(n) ? cmdbufNtoI(n)-1 : n-1 )
 
 // MISC
+// locate the line that ends at buffer index end.  The line is returned as
+// one or two segments (the buffer is circular) and the number of segments
+// is returned.
+static int
+cmdbufLineSegs(cmd_t *this, int end, char *seg[2], int seglen[2])
+{
+  int segs = 0;
+  if (this->bufof==0) {
+    // Handle no over flow cases -> buffer holds a complete line 
+    int start = cmdbufNtoI(this->bufstart);
+    if (start <= end) {
+      // Line does not wrap the buffer (end is >= start)
+      seg[segs] = (char *)&(this->buf[start]);
+      seglen[segs++] = (end - start) + 1;
+    } else {
+      // Line wraps across end of buffer (no overflow and start > end) 
+      // Requires two segments: 
+      //   1. beginning of the line is from start to buffer end
+      seg[segs] = (char *)&(this->buf[start]);
+      seglen[segs++] = cmdbufSize - start;
+      ASSERT(seglen[0]>=1);
+      //   2. end of the line is from buffer start to end
+      seg[segs] = (char *)&(this->buf[0]);
+      seglen[segs++] = end + 1;
+    }
+  } else {
+    // handle overflow cases
+    //  start is irrelevant last bufsize bytes written are from
+    //  end+1 to bufend and 0 to end
+    if ( (end+1) < cmdbufSize ) {
+      seg[segs] = (char *)&(this->buf[end+1]);
+      seglen[segs++] = cmdbufSize - (end+1);
+    }
+    // given wrap data is from 0  to end
+    seg[segs] = (char *)&(this->buf[0]);
+    seglen[segs++] = end + 1;
+  }
+  return segs;
+}
+
+// process a byte of output of the command: it is written to the client
+// tty and the broadcast tty and fed to everything watching the output.
+// Returns the number of bytes written
+extern int
+cmdOutputChar(cmd_t *this, char c, int epollfd)
+{
+  int n;
+
+  // answer to a watchdog probe (see watchdog.h)
+  if (this->wdog.waiting) watchdogChar(&GBLS.watchdog, this, c);
+
+  // the output of a child yar is frames about its nodes (see relay.h)
+  if (this->rly.on) return relayChar(&GBLS.relay, this, c, epollfd);
+
+  if (c == '\n') this->st.lines++;
+
+  // if ready string has been specified then this command is not
+  // considered ready to be written to until we recieve the ready string
+  // from it so ignore data and do not read from client ttys
+  if (!cmdIsReady(this)) {
+    // a newly ready command can take queued work
+    if (readyChar(&GBLS.ready, this, c)) workqDispatch(&GBLS.workq, epollfd);
+  }
+
+  // work queue completion marker: the command has finished a work item
+  if (kmpIsSet(&GBLS.workq.marker) && this->wq.inflight) {
+    this->wq.markercnt = kmpStep(&GBLS.workq.marker, this->wq.markercnt, c);
+    if (kmpMatched(&GBLS.workq.marker, this->wq.markercnt)) {
+      this->wq.markercnt = 0;
+      workqComplete(&GBLS.workq, this, epollfd);
+    }
+  }
+
+  // gather marker: the command has reached the barrier
+  if (gatherIsWaiting(&GBLS.gather) && this->gthr.target &&
+      !this->gthr.arrived) {
+    this->gthr.markercnt = kmpStep(&GBLS.gather.marker,
+				   this->gthr.markercnt, c);
+    if (kmpMatched(&GBLS.gather.marker, this->gthr.markercnt)) {
+      this->gthr.markercnt = 0;
+      gatherArrive(&GBLS.gather, this);
+    }
+  }
+
+  // wave success marker: the command has completed the rolled out line
+  if (waveIsWaiting(&GBLS.wave) && kmpIsSet(&GBLS.wave.marker) &&
+      this->wv.inwave && !this->wv.done) {
+    this->wv.markercnt = kmpStep(&GBLS.wave.marker, this->wv.markercnt, c);
+    if (kmpMatched(&GBLS.wave.marker, this->wv.markercnt)) {
+      waveArrive(&GBLS.wave, this, epollfd);
+    }
+  }
+
+  if (watchIsOn(&GBLS.watch)) watchChar(&GBLS.watch, this, c);
+
+  if (this->pace.on) paceEcho(this, c);
+
+  if (this->bufn == this->bufstart && mergeIsOn(&GBLS.merge)) {
+    // first byte of a line: its read time orders the line when merging
+    if (clock_gettime(CLOCK_SOURCE, &(this->mrg.linets)) == -1) {
+      perror("clock_gettime");
+      NYI;
+    }
+  }
+  int i        = cmdbufNtoI(this->bufn); // account for circular buffer
+  this->buf[i] = c;                      // store character in buffer
+  assert(this->bufn+1 > this->bufn);     // yikes we rolled over
+  this->bufn++;                          // inc n -- bytes since last flush
+
+  int written;                           
+  written = ttyWriteChar(&(this->clttty), c, NULL); // write data to clt tty
+  if (written != 1) NYI;
+  n = written;
+  if (GBLS.bcstflg) {
+    if (!GBLS.linebufferbcst) { 
+      if (!this->lmt.on || limitPassChar(&GBLS.limit, this, epollfd)) {
+	// write data to bcst tty (or queue it if the tty is full)
+	n += fairqWrite(&GBLS.fairq, this, &c, 1, epollfd);
+      }
+    } else {
+      if (cmdbufNtoI(this->bufn) == cmdbufNtoI(this->bufstart)) {
+	this->bufof++; // buffer just wrapped
+	EPRINT(stderr, "cmd:%s line overflowed output buffer: start:%zu m:%zu"
+	       " of:%d\n", this->name, this->bufstart,
+	       this->bufn, this->bufof);
+      }
+      if (c=='\n') {
+	char *seg[2];
+	int   seglen[2];
+	int   segs = cmdbufLineSegs(this, i, seg, seglen);
+	char line[CMD_BUFSIZE];
+	int  len = 0;
+	if (reduceIsOn(&GBLS.reduce) || coalesceIsOn(&GBLS.coalesce) ||
+	    mergeIsOn(&GBLS.merge)) {
+	  for (int s=0; s<segs; s++) {
+	    memcpy(&line[len], seg[s], seglen[s]);
+	    len += seglen[s];
+	  }
+	}
+	if (this->lmt.on &&
+	    !limitPass(&GBLS.limit, this,
+		       seglen[0] + ((segs > 1) ? seglen[1] : 0), epollfd)) {
+	  // the line is over the command's output limit: it is counted
+	  // and summarized rather than written
+	} else if (reduceIsOn(&GBLS.reduce) &&
+	    reduceLine(&GBLS.reduce, this, line, len, epollfd)) {
+	  // the line's value was folded into the reduction summary
+	} else if (coalesceIsOn(&GBLS.coalesce)) {
+	  // the line is held and summarized with identical lines from the
+	  // other commands rather than being written now
+	  coalesceLine(&GBLS.coalesce, this, line, len, epollfd);
+	} else if (mergeIsOn(&GBLS.merge)) {
+	  // the line is held and written in timestamp order
+	  mergeLine(&GBLS.merge, this, line, len, epollfd);
+	} else {
+	  // Write cmd prefix to tty if enabled, the prefix and line are
+	  // queued together if the tty is full
+	  char *bufs[3];
+	  int   lens[3], nbufs = 0;
+	  if (GBLS.prefixbcst && this->bcstprefix &&
+	      this->bcstprefixlen > 0) {
+	    bufs[nbufs]   = this->bcstprefix;
+	    lens[nbufs++] = this->bcstprefixlen;
+	    // we don't include prefix in count of data written to the tty
+	    n -= this->bcstprefixlen;
+	  }
+	  for (int s=0; s<segs; s++) {
+	    bufs[nbufs]   = seg[s];
+	    lens[nbufs++] = seglen[s];
+	  }
+	  n += fairqWritev(&GBLS.fairq, this, bufs, lens, nbufs, epollfd);
+	}
+	this->bufof    = 0;           // reset overflow count
+	this->bufstart = this->bufn;  // record start location of next line
+      }
+    }
+  }
+  if (relayIsUplink(&GBLS.relay)) {
+    // a child yar sends each line of output up to its parent
+    if (cmdbufNtoI(this->bufn) == cmdbufNtoI(this->bufstart)) this->bufof++;
+    if (c=='\n') {
+      char *seg[2];
+      int   seglen[2];
+      int   segs = cmdbufLineSegs(this, i, seg, seglen);
+      relayOutput(&GBLS.relay, this, seg, seglen, segs);
+      this->bufof    = 0;
+      this->bufstart = this->bufn;
+    }
+  }
+  return n;
+}
+
 // NYI: FYI: logging not yet implemented
 static int
-cmdttyProcessOutput(cmd_t *this, uint32_t evnts)
+cmdttyProcessOutput(cmd_t *this, uint32_t evnts, int epollfd)
 {
   char c;
   tty_t *tty = &(this->cmdtty);
@@ -67,127 +259,13 @@ cmdttyProcessOutput(cmd_t *this, uint32_t evnts)
 	      n);
       
     }
-    // if ready string has been specified then this command is not
-    // considered ready to be written to until we recieve the ready string
-    // from it so ignore data and do not read from client ttys
-    if (GBLS.readystrlen && this->readycnt < GBLS.readystrlen) {
-      if (GBLS.readystr[this->readycnt]==c) {
-	// we have a matching character
-	VLPRINT(3, "READY: String match %c cnt=%d\n", c, this->readycnt);
-	this->readycnt++;
-	assert(this->readycnt <= GBLS.readystrlen);
-	if (this->readycnt == GBLS.readystrlen) {
-	  GBLS.cmdsreadycnt++;
-	  assert(GBLS.cmdsreadycnt <= HASH_COUNT(GBLS.cmds));
-	  VPRINT("%p(%s): READY: got ready string: %s\n", this,
-		 this->name, GBLS.readystr);
-	}
-#if 0
-	// if a ready string was specified we don't send it to the client
-	// or broadcast ttys
-	return n;
-#endif
-      } else {
-	// we have a ready string but current charcter did not id not match
-	// next expected character so reset ready cnt (eg start matching again
-	// from the beginning
-	VLPRINT(3, "READY: String match failed expecting %c got %c cnt=%d\n",
-		c, GBLS.readystr[this->readycnt],this->readycnt);
-	this->readycnt=0;
-      }
-    }
-      
-    int i        = cmdbufNtoI(this->bufn); // account for circular buffer
-    this->buf[i] = c;                      // store character in buffer
-    assert(this->bufn+1 > this->bufn);     // yikes we rolled over
-    this->bufn++;                          // inc n -- bytes since last flush
-
-    int written;                           
-    written = ttyWriteChar(&(this->clttty), c, NULL); // write data to clt tty
-    if (written != 1) NYI;
-    n = written;
-    if (GBLS.bcstflg) {
-      if (!GBLS.linebufferbcst) { 
-	written = ttyWriteChar(&GBLS.bcsttty, c, NULL); //write data to bcst tty
-	if (written != 1) NYI;
-	n += written;
-      } else {
-	if (cmdbufNtoI(this->bufn) == cmdbufNtoI(this->bufstart)) {
-	  this->bufof++; // buffer just wrapped
-	  EPRINT(stderr, "cmd:%s line overflowed output buffer: start:%zu m:%zu"
-		 " of:%d\n", this->name, this->bufstart,
-		 this->bufn, this->bufof);
-	}
-	if (c=='\n') {
-	  // Write cmd prefix to tty if enabled
-	  if (GBLS.prefixbcst && this->bcstprefix && this->bcstprefixlen > 0) {
-	    written = ttyWriteBuf(&GBLS.bcsttty, this->bcstprefix,
-				  this->bcstprefixlen,
-				  NULL);
-	    assert(written == this->bcstprefixlen);
-	    // we don't include prefix in count of data written to the tty
-	  }
-	  int len;
-	  int end = i;          // end of line is last location we put data
-	  if (this->bufof==0) {
-	    // Handle no over flow cases -> buffer holds a complete line 
-	    int start = cmdbufNtoI(this->bufstart);
-	    if (start <= end) {
-	      // Line does not wrap the buffer (end is >= start)
-	      len = (end - start) + 1;
-	      written = ttyWriteBuf(&GBLS.bcsttty,
-				    (char *)&(this->buf[start]),
-				    len,           
-				    NULL);
-	      assert(written == len);
-	      n += written;
-	    } else {
-	      // Line wraps across end of buffer (no overflow and start > end) 
-	      // Requires two writes: 
-	      //   1. beginning of the line is from start to buffer end
-	      len = cmdbufSize - start;
-	      ASSERT(len>=1);
-	      written= ttyWriteBuf(&GBLS.bcsttty,
-				   (char *)&(this->buf[start]),
-				   len,
-				   NULL);
-	      assert(written == len);
-	      n += written;
-	      //   2. end of the line is from buffer start to end
-	      len = end + 1;
-	      written = ttyWriteBuf(&GBLS.bcsttty,
-				    (char *)&(this->buf[0]),
-				    len,
-				    NULL);
-	      assert(written == len);
-	      n += written;
-	    }
-	  } else {
-	    // handle overflow cases
-	    //  start is irrelevant last bufsize bytes written are from
-	    //  end+1 to bufend and 0 to end
-	    if ( (end+1) < cmdbufSize ) {
-	      len = cmdbufSize - (end+1);
-	      written = ttyWriteBuf(&(GBLS.bcsttty),
-				    (char *)&(this->buf[end+1]),
-				    len,
-				    NULL);
-	      assert(len == written);
-	      n += written;
-	    }
-	  // given wrap data is from 0  to end
-	    len = end+1;
-	    written = ttyWriteBuf(&(GBLS.bcsttty),
-				  (char *)&(this->buf[0]),
-				  len,
-				  NULL);
-	    assert(written == len);
-	    n += written;
-	    this->bufof = 0;            // reset overflow count
-	  }
-	  this->bufstart = this->bufn;  // record start location of next line
-	}
-      }
+    // while a probe is outstanding output is held a line at a time so the
+    // probe can be stripped from it (see ping.h)
+    if (this->ping.waiting) {
+      n = pingChar(&GBLS.ping, this, c, epollfd);
+    } else {
+      if (GBLS.ping.every > 0.0) pingOutput(&GBLS.ping, this, c);
+      n = cmdOutputChar(this, c, epollfd);
     }
     if (evnts && verbose(2)) {
       fprintf(stderr, "cmdttyEvent: <--- CMDTTY: END: EIN: tty(%p):%s(%s) fd:%d"
@@ -205,11 +283,60 @@ cmdttyProcessOutput(cmd_t *this, uint32_t evnts)
   return n;
 }
 
+// write a complete line to the broadcast tty (with prefix if enabled).  It
+// is queued if the tty is full (see fairq.h)
+extern int
+cmdBcstWriteLine(cmd_t *this, char *line, int len)
+{
+  char *bufs[2];
+  int   lens[2], nbufs = 0;
+  if (GBLS.prefixbcst && this->bcstprefix && this->bcstprefixlen > 0) {
+    bufs[nbufs]   = this->bcstprefix;
+    lens[nbufs++] = this->bcstprefixlen;
+  }
+  bufs[nbufs]   = line;
+  lens[nbufs++] = len;
+  fairqWritev(&GBLS.fairq, this, bufs, lens, nbufs, -1);
+  return len;
+}
+
+// write a buffer of input to the command with a single write.  The tty
+// filling up is not fatal: returns the number of bytes written, less than
+// len if the tty is full.  Nothing is written while the command has input
+// pending (see inq.h) so that it is not overtaken
+extern int
+cmdWriteBuf(cmd_t *this, char *buf, int len)
+{
+  if (len == 0 || inqIsWaiting(&(this->inq))) return 0;
+  int n = cmdttyWrite(this, buf, len);
+  if (n <= 0) return 0;
+  cmdSent(this, buf, n);
+  return n;
+}
+
+// write to the command's tty: a child yar gets the data framed (see relay.h)
+extern int
+cmdttyWrite(cmd_t *this, char *buf, int len)
+{
+  if (this->rly.on) return relayWrite(&GBLS.relay, this, NULL, buf, len);
+  return ttyWriteBuf(&(this->cmdtty), buf, len, &(this->lastwrite));
+}
+
+// pacing book keeping for n bytes of buf written to the command
+extern void
+cmdSent(cmd_t *this, char *buf, int n)
+{
+  bucketUse(&(this->pace.bkt), n);
+  if (this->pace.on) {
+    for (int i=0; i<n; i++) paceSent(this, buf[i]);
+  }
+}
+
 extern void
-cmdttyDrain(cmd_t *this)
+cmdttyDrain(cmd_t *this, int epollfd)
 {
   // drain any remaining data???
-  while (cmdttyProcessOutput(this,0)>0);
+  while (cmdttyProcessOutput(this,0,epollfd)>0);
 }
   
 // EVENT HANDLERS
@@ -233,6 +360,7 @@ cmdPidEvent(void *obj, uint32_t evnts, int epollfd)
       assert(0);
     }
     this->exitstatus = info.si_status;
+    statsCmdExit(&GBLS.stats, this);
     if (verbose(1)) {
       cmdDump(this, stderr, "*** Command Died:\n  ");
     }
@@ -247,11 +375,10 @@ cmdPidEvent(void *obj, uint32_t evnts, int epollfd)
     // reset fields
     this->pidfd = -1;
     this->pid   = -1;
-    if (cmdIsReady(this)) { 
-      this->readycnt = 0;
-      decCmdsReadyCnt();
-      assert(GBLS.cmdsreadycnt>=0);
-    }
+    readyStop(&GBLS.ready, this);
+    inqStop(&GBLS.inq, this);
+    // give any work items the command had in flight to other commands
+    workqRequeueCmd(&GBLS.workq, this, epollfd);
     
     // cleanup on exit logic (takes precedence)
     if (this->deleteonexit) {
@@ -259,15 +386,11 @@ cmdPidEvent(void *obj, uint32_t evnts, int epollfd)
 	     this->name, this->pid,  this->exitstatus); 
       cmd_t *cmd=NULL;
       HASH_FIND_STR(GBLS.cmds, this->name, cmd);
-      cmdCleanup(this);
       if (cmd != NULL) {
 	ASSERT(this==cmd);
-	HASH_DEL(GBLS.cmds, cmd);
-	free(cmd);
-	if (HASH_COUNT(GBLS.cmds) == 0 && GBLS.exitonidle) {
-	  cleanup();
-	  exit(EXIT_SUCCESS);
-	}
+	GBLSDelCmd(cmd);
+      } else {
+	cmdCleanup(this);
       }
       goto done;
     } 
@@ -278,10 +401,16 @@ cmdPidEvent(void *obj, uint32_t evnts, int epollfd)
     if (GBLS.restart && this->restart) {
       if (this->exitstatus == 0) startdelay=GBLS.restartcmddelay;
       else startdelay=GBLS.errrestartcmddelay;
-      assert(cmdStart(this, true, epollfd, startdelay));
+      journalRestart(&GBLS.journal, this);
+      // a standby instance takes over immediately if there is one
+      if (!standbySwap(&GBLS.standby, this, startdelay, epollfd)) {
+	assert(cmdStart(this, true, epollfd, startdelay));
+      }
       this->restartcnt++;
       VPRINT("%s: restarted pid:%d restartcnt:%d\n",
 	     this->name, this->pid, this->restartcnt);
+    } else {
+      standbyStop(&GBLS.standby, this);
     }
     
     evnts = evnts & ~EPOLLIN;
@@ -321,7 +450,20 @@ cmdCmdttyEvent(void *obj, uint32_t evnts, int epollfd)
 	    " cmd:%s(%p)\n", tty, tty->link, tty->path, fd, evnts,
 	  this->name, this);
   if (evnts & EPOLLIN) {
-    cmdttyProcessOutput(this, evnts);  // data on this fd is output from command
+    // data on this fd is output from command: process it until there is no
+    // more or the budget for this dispatch is used up in which case the
+    // rest is processed after the other ready handlers have had a turn
+    while (cmdttyProcessOutput(this, evnts, epollfd) > 0) {
+      if (!loopBudgetUse(1)) {
+	loopDefer(&(tty->dfded));
+	break;
+      }
+    }
+    // a prompt is not newline terminated: the ready regex is tried against
+    // the line so far once per read rather than on every byte
+    if (!cmdIsReady(this) && readyPartial(&GBLS.ready, this)) {
+      workqDispatch(&GBLS.workq, epollfd);
+    }
     evnts = evnts & ~EPOLLIN;
     if (evnts==0) goto done;
   }
@@ -332,7 +474,7 @@ cmdCmdttyEvent(void *obj, uint32_t evnts, int epollfd)
     fprintf(stderr, "**************************************************\n");
     fprintf(stderr, "********** FUCKING SHIT!!!!!!!!!!!!!!!************\n");
     fprintf(stderr, "**************************************************\n");
-    cmdttyDrain(this);
+    cmdttyDrain(this, epollfd);
     {
       if (epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, NULL) == -1) {
 	perror("epoll_ctl: EPOLL_CTL_DEL fd");
@@ -376,31 +518,30 @@ cmdCltttyEvent(void *obj, uint32_t evnts, int epollfd)
 	  " cmd:%s(%p)\n", tty, tty->link, tty->path, fd, evnts,
 	  this->name, this);
   if (evnts & EPOLLIN) {
-    char c;
-    if (!cmdIsReady(this)) {
+    char buf[PACE_CHUNK];
+    if (!cmdIsReady(this) && !readyCatchUp(&GBLS.ready, this)) {
       VLPRINT(2, "skipping data from client tty %p:%s(%s) as cmd %p (%s) not ready"
-	     "(readycnt=%d)\n", tty, tty->link, tty->path, this, this->name,
-	     this->readycnt);
+	     "(ready=%d)\n", tty, tty->link, tty->path, this, this->name,
+	     this->rdy.ready);
       goto done;
     }
-    int n = ttyReadChar(tty, &c, &(this->lastwrite), this->delay);
+    // read as much as the command's pacing allows and stop reading until
+    // the bucket refills if it allows nothing
+    int n = bucketAvail(&(this->pace.bkt), sizeof(buf));
+    if (n == 0) {
+      paceThrottle(&GBLS.pace, this, epollfd);
+      goto done;
+    }
+    n = ttyReadBuf(tty, buf, n);
     if (n) {
       if (verbose(2)) {
-	  asciistr_t charstr;
-	  ascii_char2str((int)c, charstr);
 	  VPRINT("---> CLTTTY: START: EIN: tty(%p):%s(%s) fd:%d"
 		 " evnts:0x%08x cmd:%p(%s)\n"
-		 "ttyReadChar:    %p:%s(%s) fd:%d c:%02x(%s) %s n:%d\n",
+		 "ttyReadBuf:    %p:%s(%s) fd:%d n:%d\n",
 		 tty, tty->link, tty->path, fd, evnts, this,
-		 this->name, tty, tty->link, tty->path, fd, c, charstr,
-		 (ascii_isprintable(c)) ? "" : "^^^^ NOT PRINTABLE ^^^^",
-		 n);
+		 this->name, tty, tty->link, tty->path, fd, n);
 	}
-      n=cmdWriteChar(this,c);
-      if ( n != 1 ) {
-	EPRINT(stderr, "  write returned: n=%d\n", n);
-	NYI;
-      }
+      inqWrite(&GBLS.inq, this, buf, n, epollfd);
       // allow the command to be stopped if this read has caused it to go 
       // idle.  cmdStop internally has the logic to check and take care of
       // this case
@@ -488,14 +629,15 @@ cmdDump(cmd_t *this, FILE *f, char *prefix)
   ascii_char2str(i, charstr);
   
   fprintf(f, "%scmd: this=%p pid=%ld pidfd=%d name=%s exitstatus=%d\n"
-	  "    restart=%d restartcnt=%d deleteonexit=%d readycnt=%d\n"
+	  "    restart=%d restartcnt=%d deleteonexit=%d ready=%d ttr=%f\n"
 	  "    stopstr=\"%s\"\n"
 	  "    cmdstr=\"%s\"\n    cmdline=\"%s\"\n    bcstprefix=\"%s\"(len=%d)"
 	  " delay=%f log=%s bufn=%lu bufstart=%lu bufof=%d "
 	  "lastwrite=%ld:%ld lastchar:buf[%d]=%02x(%s)\n"
 	  , prefix, this,
 	  (long)this->pid, this->pidfd, this->name, this->exitstatus,
-	  this->restart, this->restartcnt, this->deleteonexit, this->readycnt,
+	  this->restart, this->restartcnt, this->deleteonexit, this->rdy.ready,
+	  this->rdy.ttr,
 	  this->stopstr,
 	  this->cmdstr, this->cmdline, this->bcstprefix, this->bcstprefixlen,
 	  this->delay, this->log, this->bufn, this->bufstart, this->bufof,
@@ -522,7 +664,7 @@ cmdDump(cmd_t *this, FILE *f, char *prefix)
 // on cleanup
 extern bool
 cmdInit(cmd_t *this, char *cmdstr, char *name, char *cmdline, double delay,
-	char *ttylink, char *log, bool iszeroed)
+	int burst, char *ttylink, char *log, bool iszeroed)
 {
   // name, cmdline, and log are supposed to be offsets within
   // cmdstr ---> freeing cmdstr is the right way to release the resource
@@ -536,8 +678,10 @@ cmdInit(cmd_t *this, char *cmdstr, char *name, char *cmdline, double delay,
   this->bcstprefixlen     = strlen(name)+2;   // +2 for ": " do no include null
   this->bcstprefix        = malloc(this->bcstprefixlen+1); // +1 for null 
   snprintf(this->bcstprefix, this->bcstprefixlen+1, "%s" ": ", this->name);
+  this->namehash          = hashBytes(name, strlen(name));
   this->cmdline           = cmdline;
   this->delay             = delay;
+  this->burst             = burst;
   this->log               = log;
   this->bufn              = 0;
   this->bufstart          = 0;
@@ -550,8 +694,10 @@ cmdInit(cmd_t *this, char *cmdstr, char *name, char *cmdline, double delay,
   this->deleteonexit      = GBLS.cmddelonexit; 
   this->lastwrite.tv_sec  = 0;
   this->lastwrite.tv_nsec = 0;
-  this->readycnt          = 0;
+  this->rdy.ready         = false;
+  this->mrg.heapidx       = -1;
   this->pidfded           = (evntdesc_t){ NULL, NULL };
+  this->rly.on            = (cmdline[0] == RELAY_CMDCHAR);
   ttyInit(&(this->cmdtty), NULL, NULL, NULL, NULL, NULL, true);
   if (ttylink) {
     char tmp1[PATH_MAX];
@@ -565,7 +711,13 @@ cmdInit(cmd_t *this, char *cmdstr, char *name, char *cmdline, double delay,
   } else {
     char tmp1[PATH_MAX];
     char tmp2[PATH_MAX];
-    ttylink = cwdPrefix(name);
+    if (relayIsUplink(&GBLS.relay)) {
+      // a child yar's links are named by its path so they are unique
+      snprintf(tmp1, sizeof(tmp1), "%s.%s", GBLS.relay.path, name);
+      ttylink = cwdPrefix(tmp1);
+    } else {
+      ttylink = cwdPrefix(name);
+    }
     snprintf(tmp1, sizeof(tmp1), "%s.mon", ttylink);
     snprintf(tmp2, sizeof(tmp2), "%s.fs", ttylink);
     ttyInit(&(this->clttty), ttylink,
@@ -577,19 +729,12 @@ cmdInit(cmd_t *this, char *cmdstr, char *name, char *cmdline, double delay,
   return true;
 }
 
-// NOTE caller has to register this new process with epoll loop!
-// FIXME: JA: add cmdRegisterPidFd
-extern bool
-cmdStart(cmd_t *this, bool raw, int epollfd, double startdelay)
+// fork and exec the command line (or child yar) connected to tty.  Returns
+// the pid of the new process and sets *pidfd to a pidfd for it
+extern pid_t
+cmdSpawn(cmd_t *this, tty_t *tty, bool raw, double startdelay, int *pidfd)
 {
   pid_t cpid;
-  // we expect the cmdtty to be created with both the dom and sub sides
-  // open in the yar process
-  ASSERT(this &&
-	 this->cmdtty.dfd != -1 && this->cmdtty.sfd != -1);
-
-  if (cmdIsRunning(this)) return false;
-  
   // NOTE: the sub-tty has been created and is being
   //       watched via inotify for opens.  When fork/exec'd command process
   //       opens the slave we will get and event and bump the open count
@@ -612,7 +757,7 @@ cmdStart(cmd_t *this, bool raw, int epollfd, double startdelay)
 
     // we do a new open on the sub-tty to count it as an open of the tty
     // by the child
-    int subfd = open(this->cmdtty.path, O_RDWR);   
+    int subfd = open(tty->path, O_RDWR);   
     if (subfd == -1) {
       perror("open of sub-tty in child");
       assert(subfd != -1);
@@ -644,22 +789,78 @@ cmdStart(cmd_t *this, bool raw, int epollfd, double startdelay)
     // See system manpage for how this was modelled
     // execute the shell command line as if it were passed via -c eg.
     // $ $SHELL -c '((i=0)); while :; do echo $i:hello; sleep 2; ((i++)); done'
+    // a relay command runs a child yar (see relay.h)
+    char *cmdline = (this->rly.on) ? relayCmdline(&GBLS.relay, this) :
+      this->cmdline;
     execlp(shell,           // executable 
 	   shell,           // argv[0]    
 	   "-c",            // argv[1]
-	   this->cmdline,   // argv[2]
+	   cmdline,         // argv[2]
 	   (char *) NULL);  // argv[3] terminating null
     perror("execlp");
     NYI;
-  } else {
-      // PARENT: finish setup the command object for the newly created child
-    this->pidfd        = pidfd_open(cpid, PIDFD_NONBLOCK);
-    fcntl(this->pidfd, F_SETFD, FD_CLOEXEC);
-    this->pid          = cpid;
-    this->pidfded      = (evntdesc_t){ .hdlr = cmdPidEvent, .obj = this };
-    this->readycnt     = 0;   
-    cmdRegisterProcessEvents(this, epollfd);
-    return true;
+  }
+  // PARENT
+  *pidfd = pidfd_open(cpid, PIDFD_NONBLOCK);
+  fcntl(*pidfd, F_SETFD, FD_CLOEXEC);
+  return cpid;
+}
+
+// NOTE caller has to register this new process with epoll loop!
+// FIXME: JA: add cmdRegisterPidFd
+extern bool
+cmdStart(cmd_t *this, bool raw, int epollfd, double startdelay)
+{
+  // we expect the cmdtty to be created with both the dom and sub sides
+  // open in the yar process
+  ASSERT(this &&
+	 this->cmdtty.dfd != -1 && this->cmdtty.sfd != -1);
+
+  if (cmdIsRunning(this)) return false;
+  
+  // finish setup the command object for the newly created child
+  this->pid          = cmdSpawn(this, &(this->cmdtty), raw, startdelay,
+				&(this->pidfd));
+  this->pidfded      = (evntdesc_t){ .hdlr = cmdPidEvent, .obj = this };
+  readyStart(&GBLS.ready, this);
+  watchdogStart(&GBLS.watchdog, this, startdelay);
+  statsCmdStart(&GBLS.stats, this);
+  cmdRegisterProcessEvents(this, epollfd);
+  // without a ready string a command can take queued work immediately
+  if (cmdIsReady(this)) workqDispatch(&GBLS.workq, epollfd);
+  // keep the command's standby instances running alongside it
+  standbyStart(&GBLS.standby, this, epollfd);
+  return true;
+}
+
+// the command's process has exited and a process started on tty (by
+// cmdSpawn, see standby.h) takes its place: the command's tty is released
+// and tty, with the process, becomes the command's.  ready is true if the
+// process has already matched the command's ready spec
+extern void
+cmdAdopt(cmd_t *this, tty_t *tty, pid_t pid, int pidfd, bool ready,
+	 int epollfd)
+{
+  ASSERT(!cmdIsRunning(this) && epollfd != -1);
+  cmdttyDrain(this, epollfd);   // last of the exited process's output
+  loopUndefer(&(this->cmdtty.dfded));
+  ttyCleanup(&(this->cmdtty));
+  this->cmdtty           = *tty;
+  this->cmdtty.dfded     = (evntdesc_t){ .hdlr = cmdCmdttyEvent, .obj = this };
+  this->cmdtty.ifded.obj = &(this->cmdtty);
+  assert(ttyRegisterEvents(&(this->cmdtty), epollfd));
+
+  this->pid     = pid;
+  this->pidfd   = pidfd;
+  this->pidfded = (evntdesc_t){ .hdlr = cmdPidEvent, .obj = this };
+  readyStart(&GBLS.ready, this);
+  if (ready && !cmdIsReady(this)) readyMark(&GBLS.ready, this);
+  statsCmdStart(&GBLS.stats, this);
+  cmdRegisterProcessEvents(this, epollfd);
+  if (cmdIsReady(this)) {
+    // the process set up its tty long ago: it can catch up immediately
+    journalReplay(&GBLS.journal, this);
+    workqDispatch(&GBLS.workq, epollfd);
   }
 }
 
@@ -676,6 +877,10 @@ cmdStop(cmd_t *this, int epollfd, bool force)
     if (!ttyIdle(&(this->clttty)) || !ttyIdle(&(GBLS.bcsttty))) {
       return false;
     }
+    // a child yar's commands are in use for as long as it has a parent
+    if (relayIsUplink(&GBLS.relay)) return false;
+    // an idle command can linger before it is stopped (see linger.h)
+    if (lingerHold(&GBLS.linger, this, epollfd)) return false;
   }
 
   // send stop string if there is one
@@ -706,11 +911,8 @@ cmdStop(cmd_t *this, int epollfd, bool force)
     }
   }
 
-  if (cmdIsReady(this)) {
-    this->readycnt=0;
-    decCmdsReadyCnt();
-    assert(GBLS.cmdsreadycnt>=0);
-  }
+  readyStop(&GBLS.ready, this);
+  inqStop(&GBLS.inq, this);
   
   // remove cmd pidfd from epoll as we know we are stopping it
   if (epollfd != -1) {
@@ -722,45 +924,56 @@ cmdStop(cmd_t *this, int epollfd, bool force)
   }
  
   // kill the cmd process
-  {
-    siginfo_t info;
-    int es;
-    struct pollfd pollfd;
-    int ready;
-    assert(kill(this->pid, SIGTERM)==0);
-  retry:
-    pollfd.fd = this->pidfd;
-    pollfd.events = POLLIN;
-    ready = poll(&pollfd, 1, 100); // give it 100 millseconds to exit cleanly
-    if (ready<0) {
-      if (errno==EINTR) goto retry; else {
-	perror("poll"); assert(0);
-      }
-    }
-    if (ready == 0) {
-      // timed out ... moving on to SIGKILL
-      EPRINT(stderr, "%s did not die with SIGTERM moving on to SIGKILL!", this->name);
-      cmdDump(this, stderr, "\n  ");
-      assert(kill(this->pid, SIGKILL)==0);
-      goto retry;
-    }
-    
-    es = waitid(P_PIDFD, this->pidfd,  &info, WEXITED);
-    if (es<0) {
-      perror("waitpid after SIGTERM");
-      assert(0);
-    }
-    this->exitstatus = info.si_status;
-    VLPRINT(1, "  exit status=%d\n", this->exitstatus);
-    close(this->pidfd);
-  }
+  this->exitstatus = cmdReap(this, this->pid, this->pidfd);
+  VLPRINT(1, "  exit status=%d\n", this->exitstatus);
+  statsCmdStop(&GBLS.stats, this);
+  close(this->pidfd);
   // reset fields
   this->pidfd = -1;
   this->pid   = -1;
-  
+
+  // give any work items the command had in flight to other commands
+  workqRequeueCmd(&GBLS.workq, this, epollfd);
+  standbyStop(&GBLS.standby, this);
   return true;
 }
 
+// terminate a process of the command (SIGTERM and then, if it has not
+// exited within 100 milliseconds, SIGKILL) and reap it.  Returns its exit
+// status
+extern int
+cmdReap(cmd_t *this, pid_t pid, int pidfd)
+{
+  siginfo_t info;
+  int es;
+  struct pollfd pollfd;
+  int ready;
+  assert(kill(pid, SIGTERM)==0);
+ retry:
+  pollfd.fd = pidfd;
+  pollfd.events = POLLIN;
+  ready = poll(&pollfd, 1, 100); // give it 100 millseconds to exit cleanly
+  if (ready<0) {
+    if (errno==EINTR) goto retry; else {
+      perror("poll"); assert(0);
+    }
+  }
+  if (ready == 0) {
+    // timed out ... moving on to SIGKILL
+    EPRINT(stderr, "%s did not die with SIGTERM moving on to SIGKILL!", this->name);
+    cmdDump(this, stderr, "\n  ");
+    assert(kill(pid, SIGKILL)==0);
+    goto retry;
+  }
+  
+  es = waitid(P_PIDFD, pidfd,  &info, WEXITED);
+  if (es<0) {
+    perror("waitpid after SIGTERM");
+    assert(0);
+  }
+  return info.si_status;
+}
+
 extern bool
 cmdCreate(cmd_t *this)
 {
@@ -838,6 +1051,7 @@ cmdCleanup(cmd_t *this)
   cmdStop(this, -1, true);
   VLPRINT(2, "  exit status=%d\n", this->exitstatus);
 
+  loopUndefer(&(this->cmdtty.dfded));
   ttyCleanup(&(this->cmdtty));
   ttyCleanup(&(this->clttty));
 
@@ -863,6 +1077,7 @@ cmdCleanup(cmd_t *this)
   this->restart       = false;
   this->deleteonexit  = false;
   this->delay         = 0.0;
+  this->burst         = 0;
   this->lastwrite.tv_nsec = 0;
   this->lastwrite.tv_sec = 0;
   this->pidfded           = (evntdesc_t){ NULL, NULL };
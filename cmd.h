@@ -4,7 +4,7 @@
 #define CMD_BUFSIZE 4096
 
 // CMD Object
-typedef struct  {
+typedef struct cmd {
   uint8_t buf[CMD_BUFSIZE];   // buffer of data read from command
   UT_hash_handle hh;          // hashtable handle
   tty_t   cmdtty;             // command tty used to internally communicate
@@ -12,6 +12,24 @@ typedef struct  {
   tty_t   clttty;             // client tty  used to communicate with external
                               // clients
   evntdesc_t pidfded;         // pidfd event descriptor  
+  cmdwq_t    wq;              // work queue state (scatter queue mode)
+  cmdscatter_t sctr;          // scatter queue state
+  cmdgather_t gthr;           // gather (barrier) state
+  cmdmerge_t  mrg;            // timestamp ordered merge state
+  cmdwatch_t  wtch;           // pattern watcher state
+  cmdready_t  rdy;            // ready state
+  cmdinq_t    inq;            // pending input state
+  cmdjournal_t jrnl;          // journal replay state
+  cmdwave_t   wv;             // staged delivery state
+  cmdpace_t   pace;           // adaptive pacing state
+  cmdlimit_t  lmt;            // broadcast output limit state
+  cmdfairq_t  fq;             // broadcast output queue state
+  cmdrelay_t  rly;            // relay (child yar) state
+  cmdstandby_t sby;           // standby instances state
+  cmdlinger_t lngr;           // idle linger state
+  cmdwatchdog_t wdog;         // liveness check state
+  cmdping_t   ping;           // round trip time probe state
+  cmdstats_t  st;             // counters (see /stats)
   struct timespec lastwrite;  // timestamp of last write
   char   *cmdstr;              // pointer if space allocated for cmd str  
   char   *name;               // user defined name (link is by default name)
@@ -20,7 +38,9 @@ typedef struct  {
   char   *log;                // path to log (copy of all data written and read)
   char   *stopstr;            // string to send when stopping takes precedence 
                               // over GBLS.stopstr
-  double  delay;              // time between writes
+  double  delay;              // time between writes (1/rate)
+  int     burst;              // bytes that may be written at once
+  uint64_t namehash;          // hash of name (used for scatter routing)
   pid_t   pid;                // process id of running command
   size_t  bufn;               // number of bytes buffered [0..SIZE_MAX]
   size_t  bufstart;           // start since last flush of buffer [0..SIZE_MAX]
@@ -28,8 +48,6 @@ typedef struct  {
   int     bcstprefixlen;      // length of prefix without null;
   int     pidfd;              // pid fd to monitor for termination
   int     exitstatus;         // exit status if command terminates
-  int     readycnt;           // count of ready string characters that have
-                              // matched the GBLS.readystr
   int     restartcnt;         // count of restarts
   bool    restart;            // restart this command if it exits
   bool    deleteonexit;       // delete this command if it exits 
@@ -37,14 +55,25 @@ typedef struct  {
 
 extern void cmdDump(cmd_t *this, FILE *f, char *prefix);
 extern bool cmdInit(cmd_t *this, char *cmdstr, char *name, char *cmdline,
-		    double delay, char *ttylink, char *log, bool iszeroed);
+		    double delay, int burst, char *ttylink, char *log,
+		    bool iszeroed);
 extern bool cmdCreate(cmd_t *this);
 extern bool cmdStart(cmd_t *this, bool raw, int epollfd, double startdelay);
 extern bool cmdStop(cmd_t *this, int epollfd, bool force);
+extern pid_t cmdSpawn(cmd_t *this, tty_t *tty, bool raw, double startdelay,
+		      int *pidfd);
+extern int  cmdReap(cmd_t *this, pid_t pid, int pidfd);
+extern void cmdAdopt(cmd_t *this, tty_t *tty, pid_t pid, int pidfd,
+		     bool ready, int epollfd);
 extern bool cmdRegisterttyEvents(cmd_t *this, int epollfd);
 extern bool cmdRegisterProcessEvents(cmd_t *this, int epollfd);
 extern bool cmdCleanup(cmd_t *this);
-extern void cmdttyDrain(cmd_t *this);
+extern void cmdttyDrain(cmd_t *this, int epollfd);
+extern int  cmdBcstWriteLine(cmd_t *this, char *line, int len);
+extern int  cmdttyWrite(cmd_t *this, char *buf, int len);
+extern int  cmdWriteBuf(cmd_t *this, char *buf, int len);
+extern int  cmdOutputChar(cmd_t *this, char c, int epollfd);
+extern void cmdSent(cmd_t *this, char *buf, int n);
 
 __attribute__((unused)) static inline bool cmdIsRunning(cmd_t *this)
 {
@@ -53,6 +82,11 @@ __attribute__((unused)) static inline bool cmdIsRunning(cmd_t *this)
 
 __attribute__((unused)) static inline int cmdWriteChar(cmd_t *this, char c)
 {
-  return ttyWriteChar(&(this->cmdtty), c, &(this->lastwrite));
+  int n = cmdttyWrite(this, &c, 1);
+  if (n == 1) {
+    bucketUse(&(this->pace.bkt), 1);
+    if (this->pace.on) paceSent(this, c);
+  }
+  return n;
 }
 #endif
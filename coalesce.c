@@ -0,0 +1,229 @@
+#include "yar.h"
+
+// normalize line into dst (which must be at least len bytes) returning the
+// normalized length.  The trailing newline (and return) are dropped.
+static int
+coalesceNormalize(coalesce_t *this, char *line, int len, char *dst)
+{
+  int i = 0, n = 0;
+
+  while (len && (line[len-1] == '\n' || line[len-1] == '\r')) len--;
+  if (this->norm & COALESCE_NORM_PREFIX) {
+    for (int j=0; j+1<len; j++) {
+      if (line[j] == ':' && line[j+1] == ' ') {
+	i = j+2;
+	break;
+      }
+    }
+  }
+  for (; i<len; i++) {
+    if ((this->norm & COALESCE_NORM_DIGITS) &&
+	line[i] >= '0' && line[i] <= '9') {
+      while (i+1<len && line[i+1] >= '0' && line[i+1] <= '9') i++;
+      dst[n++] = '#';
+    } else {
+      dst[n++] = line[i];
+    }
+  }
+  return n;
+}
+
+static evnthdlrrc_t
+coalesceTimeout(void *obj, uint32_t evnts, int epollfd)
+{
+  coalesceFlush(obj);
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+coalesceInit(coalesce_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(coalesce_t));
+  this->ents  = NULL;
+  this->pairs = NULL;
+  this->nents   = 0;
+  this->epollfd = -1;
+  this->on      = false;
+  return tmrInit(&(this->tmr), coalesceTimeout, this, iszeroed);
+}
+
+// spec is "off" or <timeout>[:<flags>] where flags is any of 'd' (digits)
+// and 'p' (prefix) normalization
+extern bool
+coalesceSet(coalesce_t *this, char *spec, FILE *f)
+{
+  char  *end;
+  double timeout;
+  int    norm = 0;
+
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing coalesce spec\n");
+    return false;
+  }
+  if (strcmp(spec, "off") == 0) {
+    coalesceFlush(this);
+    this->on = false;
+    return true;
+  }
+  errno = 0;
+  timeout = strtod(spec, &end);
+  if (errno != 0 || end == spec || timeout < 0.0 ||
+      (*end != '\0' && *end != ':')) {
+    EPRINT(f, "bad coalesce timeout: %s\n", spec);
+    return false;
+  }
+  if (*end == ':') {
+    for (end++; *end; end++) {
+      switch (*end) {
+      case 'd': norm |= COALESCE_NORM_DIGITS; break;
+      case 'p': norm |= COALESCE_NORM_PREFIX; break;
+      default:
+	EPRINT(f, "bad coalesce normalization flag: %c\n", *end);
+	return false;
+      }
+    }
+  }
+  // lines of the current round were compared under the old settings
+  coalesceFlush(this);
+  this->timeout = timeout;
+  this->norm    = norm;
+  this->on      = true;
+  return true;
+}
+
+// absorb a complete line output by cmd
+extern void
+coalesceLine(coalesce_t *this, cmd_t *cmd, char *line, int len, int epollfd)
+{
+  char        norm[CMD_BUFSIZE];
+  int         n   = coalesceNormalize(this, line, len, norm);
+  uint64_t    key = hashBytes(norm, n);
+  coalent_t  *ent;
+  coalpair_t *pair, find;
+
+  this->epollfd = epollfd;
+  if (this->ents == NULL && this->timeout > 0.0) {
+    // first line of a round starts the round's clock
+    tmrArm(&(this->tmr), epollfd, this->timeout, 0.0);
+  }
+  this->linesin++;
+  HASH_FIND(hh, this->ents, &key, sizeof(key), ent);
+  // a different line with the same hash is stored under the next free key
+  while (ent && (ent->len != n || memcmp(ent->line, norm, n) != 0)) {
+    key++;
+    HASH_FIND(hh, this->ents, &key, sizeof(key), ent);
+  }
+  if (ent == NULL) {
+    if (this->nents == COALESCE_MAXENTRIES) {
+      VPRINT("%d distinct lines flushing early\n", this->nents);
+      coalesceFlush(this);
+      if (this->timeout > 0.0) tmrArm(&(this->tmr), epollfd, this->timeout, 0.0);
+    }
+    ent = malloc(sizeof(coalent_t) + n);
+    assert(ent);
+    ent->key  = key;
+    ent->cmds = 0;
+    ent->len  = n;
+    memcpy(ent->line, norm, n);
+    HASH_ADD(hh, this->ents, key, sizeof(ent->key), ent);
+    this->nents++;
+  }
+  // count each command once per distinct line
+  bzero(&(find.key), sizeof(find.key));
+  find.key.ent = ent;
+  find.key.cmd = cmd;
+  HASH_FIND(hh, this->pairs, &(find.key), sizeof(find.key), pair);
+  if (pair == NULL) {
+    pair = malloc(sizeof(coalpair_t));
+    assert(pair);
+    pair->key = find.key;
+    HASH_ADD(hh, this->pairs, key, sizeof(pair->key), pair);
+    ent->cmds++;
+  }
+  if (this->barrier) coalesceFlush(this);
+}
+
+static void
+coalesceFree(coalesce_t *this)
+{
+  coalent_t  *ent, *etmp;
+  coalpair_t *pair, *ptmp;
+
+  HASH_ITER(hh, this->ents, ent, etmp) {
+    HASH_DEL(this->ents, ent);
+    free(ent);
+  }
+  HASH_ITER(hh, this->pairs, pair, ptmp) {
+    HASH_DEL(this->pairs, pair);
+    free(pair);
+  }
+  this->nents = 0;
+}
+
+// end the round: write the summaries to the broadcast tty
+extern void
+coalesceFlush(coalesce_t *this)
+{
+  coalent_t *ent, *tmp;
+  char       hdr[32];
+  char      *bufs[3];
+  int        lens[3];
+
+  tmrDisarm(&(this->tmr));
+  this->barrier = false;
+  if (this->ents == NULL) return;
+  if (GBLS.bcstflg) {
+    HASH_ITER(hh, this->ents, ent, tmp) {
+      lens[0] = snprintf(hdr, sizeof(hdr), "%d command%s: ", ent->cmds,
+			 (ent->cmds == 1) ? "" : "s");
+      bufs[0] = hdr;
+      bufs[1] = ent->line;
+      lens[1] = ent->len;
+      bufs[2] = "\n";
+      lens[2] = 1;
+      fairqWritev(&GBLS.fairq, NULL, bufs, lens, 3, this->epollfd);
+      this->linesout++;
+    }
+  }
+  coalesceFree(this);
+  this->rounds++;
+}
+
+// a gather (barrier) completed.  If it completed as a command output the
+// marker (now is false) then the line holding the marker is still being
+// read so the flush happens once that line has been absorbed.
+extern void
+coalesceBarrier(coalesce_t *this, bool now)
+{
+  if (!this->on) return;
+  if (now) coalesceFlush(this);
+  else this->barrier = true;
+}
+
+extern void
+coalesceReport(coalesce_t *this, FILE *f)
+{
+  fprintf(f, "coalesce: %s timeout:%f normalize:%s%s pending:%d rounds:%lu "
+	  "in:%lu out:%lu\n", (this->on) ? "on" : "off", this->timeout,
+	  (this->norm & COALESCE_NORM_DIGITS) ? "d" : "",
+	  (this->norm & COALESCE_NORM_PREFIX) ? "p" : "",
+	  this->nents, this->rounds, this->linesin, this->linesout);
+}
+
+extern void
+coalesceCleanup(coalesce_t *this)
+{
+  coalesceFree(this);
+  tmrCleanup(&(this->tmr));
+  this->on = false;
+}
+
+extern void
+coalesceDump(coalesce_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%scoalesce: this=%p on=%d timeout=%f norm=0x%x nents=%d "
+	  "rounds=%lu linesin=%lu linesout=%lu\n", prefix, this, this->on,
+	  this->timeout, this->norm, this->nents, this->rounds, this->linesin,
+	  this->linesout);
+  tmrDump(&(this->tmr), f, prefix);
+}
@@ -0,0 +1,71 @@
+#ifndef __YAR_COALESCE_H__
+#define __YAR_COALESCE_H__
+
+struct cmd;
+
+#define COALESCE_MAXENTRIES 4096   // flush early if a round has more
+                                   // distinct lines than this
+
+// normalization flags: applied to a line before it is compared
+#define COALESCE_NORM_DIGITS 0x1   // runs of digits compare equal ('#')
+#define COALESCE_NORM_PREFIX 0x2   // ignore everything up to the first ': '
+
+// a distinct (normalized) line seen this round
+typedef struct {
+  UT_hash_handle hh;
+  uint64_t       key;     // hash of the normalized line (the next free
+                          // value if another line has the same hash)
+  int            cmds;    // number of distinct commands that output it
+  int            len;
+  char           line[];  // normalized line (without newline)
+} coalent_t;
+
+// a (line, command) pair seen this round: used to count commands not lines
+typedef struct {
+  UT_hash_handle hh;
+  struct {
+    coalent_t   *ent;
+    struct cmd  *cmd;
+  }              key;
+} coalpair_t;
+
+// Coalesce Object
+//   dshbak style deduplication of command output written to the broadcast
+//   tty.  Rather than writing each complete line as it arrives, identical
+//   (optionally normalized) lines from all commands are counted and at the
+//   end of a round a single "N commands: <line>" summary is written for each
+//   distinct line, in the order the lines were first seen.  A round ends
+//   when a gather completes, timeout seconds after its first line or via
+//   the monitor.  Summaries are queued like command output if the
+//   broadcast tty is full (see fairq.h).  Requires line buffered broadcast
+//   output (-l).
+typedef struct {
+  tmr_t       tmr;          // round timeout
+  coalent_t  *ents;         // distinct lines of this round (insertion order)
+  coalpair_t *pairs;        // (line, command) pairs of this round
+  uint64_t    rounds;       // number of rounds flushed
+  uint64_t    linesin;      // total lines absorbed
+  uint64_t    linesout;     // total summary lines written
+  double      timeout;      // seconds a round stays open (0 no timeout)
+  int         norm;         // COALESCE_NORM_* flags
+  int         nents;
+  int         epollfd;      // for flushes outside of our events
+  bool        on;
+  bool        barrier;      // flush once the current line is absorbed
+} coalesce_t;
+
+extern bool coalesceInit(coalesce_t *this, bool iszeroed);
+extern bool coalesceSet(coalesce_t *this, char *spec, FILE *f);
+extern void coalesceLine(coalesce_t *this, struct cmd *cmd, char *line,
+			 int len, int epollfd);
+extern void coalesceFlush(coalesce_t *this);
+extern void coalesceBarrier(coalesce_t *this, bool now);
+extern void coalesceReport(coalesce_t *this, FILE *f);
+extern void coalesceCleanup(coalesce_t *this);
+extern void coalesceDump(coalesce_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool coalesceIsOn(coalesce_t *this)
+{
+  return this->on;
+}
+#endif
@@ -1,14 +1,40 @@
 #ifndef __EVENT_H__
 #define __EVENT_H__
 
+#define EVNT_BUDGET_BYTES 4096    // bytes a handler may process per dispatch
+#define EVNT_BUDGET_SECS  0.002   // time a handler may take per dispatch
+#define EVNT_BATCHES      11      // epoll batch size buckets: <=1,<=2,...<=1024
+
 typedef enum {
   EVNT_HDLR_SUCCESS=0,
   EVNT_HDLR_FAILED=-1,
   EVNT_HDLR_EXIT_LOOP=1 } evnthdlrrc_t;
 typedef  evnthdlrrc_t (* evnthdlr_t)(void *, uint32_t, int);
-typedef struct {
+typedef struct evntdesc {
   evnthdlr_t  hdlr;
   void       *obj;
+  struct evntdesc *next;    // next on the deferred list
+  bool        deferred;     // on the deferred list
 } evntdesc_t;
 
+// Event loop state
+//   Each handler dispatched by theLoop gets a budget of bytes and time.
+//   A handler with more work than its budget allows defers the rest
+//   (loopDefer): deferred handlers are called again on the next iteration
+//   of theLoop, after the handlers of newly ready events, rather than
+//   waiting on epoll.  So one busy command cannot delay the monitor, the
+//   file system or other commands by more than a budget.
+typedef struct {
+  evntdesc_t     *head;       // deferred handlers
+  evntdesc_t     *tail;
+  struct timespec deadline;   // end of the current dispatch's time budget
+  uint64_t        waits;      // epoll_waits that returned events (or none)
+  uint64_t        events;     // events returned by them
+  uint64_t        batches[EVNT_BATCHES]; // waits by events returned
+  uint64_t        dispatches;
+  uint64_t        deferrals;
+  int             bytes;      // bytes left in the current dispatch's budget
+  int             uses;       // budget uses since the time was checked
+} evntloop_t;
+
 #endif
@@ -0,0 +1,368 @@
+#include "yar.h"
+#include <fcntl.h>
+
+static void
+fairqActivate(fairq_t *this, cmd_t *cmd)
+{
+  cmdfairq_t *fq = &(cmd->fq);
+  if (fq->active) return;
+  fq->active = true;
+  fq->next   = NULL;
+  if (this->tail) this->tail->fq.next = cmd; else this->head = cmd;
+  this->tail = cmd;
+}
+
+static void
+fairqDeactivate(fairq_t *this, cmd_t *cmd)
+{
+  cmdfairq_t *fq = &(cmd->fq);
+  cmd_t *prev = NULL, *c;
+
+  if (!fq->active) return;
+  for (c = this->head; c && c != cmd; c = c->fq.next) prev = c;
+  ASSERT(c == cmd);
+  if (prev) prev->fq.next = fq->next; else this->head = fq->next;
+  if (this->tail == cmd) this->tail = prev;
+  fq->next    = NULL;
+  fq->active  = false;
+  fq->visited = false;
+  fq->deficit = 0;
+}
+
+// move the head of the active list to the tail (its round is over)
+static void
+fairqRotate(fairq_t *this)
+{
+  cmd_t *cmd = this->head;
+  cmd->fq.visited = false;
+  if (this->tail == cmd) return;
+  this->head       = cmd->fq.next;
+  cmd->fq.next     = NULL;
+  this->tail->fq.next = cmd;
+  this->tail       = cmd;
+}
+
+// the queue of cmd or, if cmd is NULL, of yar's own output
+static cmdfairq_t *
+fairqQueue(fairq_t *this, cmd_t *cmd)
+{
+  return (cmd) ? &(cmd->fq) : &(this->own);
+}
+
+// write to the broadcast tty on behalf of fq's owner.  Returns the bytes
+// written (0 if the tty is full)
+static int
+fairqWriteTty(fairq_t *this, cmdfairq_t *fq, char *buf, int len)
+{
+  int n = ttyWriteBuf(&GBLS.bcsttty, buf, len, NULL);
+  if (n <= 0) return 0;
+  if (GBLS.linebufferbcst) this->midline = (buf[n-1] != '\n') ? fq : NULL;
+  return n;
+}
+
+static evnthdlrrc_t
+fairqEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  fairq_t *this = obj;
+  VLPRINT(3, "START: fairq:%p fd:%d evnts:0x%08x\n", this, this->wfd, evnts);
+  if (evnts & EPOLLOUT) fairqDrain(this);
+  return EVNT_HDLR_SUCCESS;
+}
+
+// wait for the broadcast tty to become writable
+static void
+fairqWait(fairq_t *this)
+{
+  struct epoll_event ev;
+
+  if (this->waiting) return;
+  this->blocks++;
+  ASSERT(this->epollfd != -1);
+  ev.events   = EPOLLOUT;
+  ev.data.ptr = &(this->ed);
+  if (this->wfd == -1) {
+    this->wfd = dup(GBLS.bcsttty.dfd);
+    if (this->wfd == -1) {
+      perror("dup: bcsttty dfd");
+      NYI;
+    }
+    assert(fcntl(this->wfd, F_SETFD, FD_CLOEXEC)!=-1);
+    this->ed = (evntdesc_t){ .hdlr = fairqEvent, .obj = this };
+    if (epoll_ctl(this->epollfd, EPOLL_CTL_ADD, this->wfd, &ev) == -1) {
+      perror("epoll_ctl: EPOLL_CTL_ADD fairq->wfd");
+      NYI;
+    }
+  } else if (epoll_ctl(this->epollfd, EPOLL_CTL_MOD, this->wfd, &ev) == -1) {
+    perror("epoll_ctl: EPOLL_CTL_MOD fairq->wfd");
+    NYI;
+  }
+  this->waiting = true;
+  VLPRINT(2, "broadcast tty full: %d bytes queued\n", this->depth);
+}
+
+static void
+fairqUnwait(fairq_t *this)
+{
+  struct epoll_event ev = { .events = 0, .data.ptr = &(this->ed) };
+
+  if (!this->waiting) return;
+  if (epoll_ctl(this->epollfd, EPOLL_CTL_MOD, this->wfd, &ev) == -1) {
+    perror("epoll_ctl: EPOLL_CTL_MOD fairq->wfd");
+    NYI;
+  }
+  this->waiting = false;
+}
+
+// append to fq (the caller has checked there is space)
+static void
+fairqEnqueue(fairq_t *this, cmdfairq_t *fq, char *buf, int len)
+{
+  int end, n;
+
+  if (fq->ring == NULL) {
+    fq->ring = malloc(FAIRQ_QUEUELEN);
+    assert(fq->ring);
+  }
+  while (len) {
+    end = (fq->start + fq->len) % FAIRQ_QUEUELEN;
+    n   = FAIRQ_QUEUELEN - end;
+    if (n > len) n = len;
+    memcpy(&(fq->ring[end]), buf, n);
+    fq->len     += n;
+    fq->queued  += n;
+    this->queued += n;
+    this->depth  += n;
+    buf += n;
+    len -= n;
+  }
+}
+
+// send n bytes from the front of fq.  Returns the bytes sent
+static int
+fairqSend(fairq_t *this, cmdfairq_t *fq, int n)
+{
+  int sent = 0, chunk, w;
+
+  while (sent < n) {
+    chunk = FAIRQ_QUEUELEN - fq->start;
+    if (chunk > n - sent) chunk = n - sent;
+    w = fairqWriteTty(this, fq, &(fq->ring[fq->start]), chunk);
+    fq->start    = (fq->start + w) % FAIRQ_QUEUELEN;
+    fq->len     -= w;
+    this->depth -= w;
+    sent        += w;
+    if (w < chunk) break;
+  }
+  return sent;
+}
+
+// bytes at the front of fq that can be sent: at most max and,
+// when line buffering, only whole lines
+static int
+fairqSendable(cmdfairq_t *fq, int max)
+{
+  int n = (fq->len < max) ? fq->len : max;
+  if (!GBLS.linebufferbcst) return n;
+  while (n > 0 && fq->ring[(fq->start + n - 1) % FAIRQ_QUEUELEN] != '\n') n--;
+  return n;
+}
+
+extern void
+fairqInit(fairq_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(fairq_t));
+  this->head    = this->tail = NULL;
+  this->midline = NULL;
+  this->wfd     = -1;
+  this->epollfd = -1;
+  this->waiting = false;
+}
+
+// fq cannot take n more bytes of cmd's output: they are dropped
+static void
+fairqDrop(fairq_t *this, cmd_t *cmd, cmdfairq_t *fq, int n)
+{
+  VLPRINT(2, "%s: broadcast queue full dropping %d bytes\n",
+	  (cmd) ? cmd->name : "yar", n);
+  fq->drops   += n;
+  this->drops += n;
+}
+
+// write output of cmd, or of yar if cmd is NULL, (nbufs buffers that form
+// one unit, eg. prefix and line) to the broadcast tty or, if it is full or
+// others are waiting, to cmd's queue.  A unit that does not fit in the
+// queue is dropped.  Returns the number of bytes consumed
+extern int
+fairqWrite(fairq_t *this, cmd_t *cmd, char *buf, int len, int epollfd)
+{
+  return fairqWritev(this, cmd, &buf, &len, 1, epollfd);
+}
+
+extern int
+fairqWritev(fairq_t *this, cmd_t *cmd, char **bufs, int *lens, int nbufs,
+	    int epollfd)
+{
+  cmdfairq_t *fq = fairqQueue(this, cmd);
+  int i, w = 0, total = 0, done = 0;
+
+  if (epollfd != -1) this->epollfd = epollfd;
+  for (i=0; i<nbufs; i++) total += lens[i];
+
+  if (this->head == NULL && this->own.len == 0) {
+    // nothing is waiting: write directly queueing whatever does not fit
+    for (i=0; i<nbufs; i++) {
+      w     = fairqWriteTty(this, fq, bufs[i], lens[i]);
+      done += w;
+      if (w < lens[i]) break;
+    }
+    if (i == nbufs) return total;
+    if (total - done > FAIRQ_QUEUELEN - fq->len) {
+      // the unit is cut short: nothing is left to finish the line with
+      fairqDrop(this, cmd, fq, total - done);
+      this->midline = NULL;
+      return total;
+    }
+    fairqEnqueue(this, fq, bufs[i] + w, lens[i] - w);
+    for (i++; i<nbufs; i++) fairqEnqueue(this, fq, bufs[i], lens[i]);
+    if (cmd) fairqActivate(this, cmd);
+    fairqWait(this);
+    return total;
+  }
+  if (total > FAIRQ_QUEUELEN - fq->len) {
+    fairqDrop(this, cmd, fq, total);
+    return total;
+  }
+  for (i=0; i<nbufs; i++) fairqEnqueue(this, fq, bufs[i], lens[i]);
+  if (cmd) fairqActivate(this, cmd);
+  return total;
+}
+
+// the broadcast tty is writable: send yar's own queued output and then
+// that of the commands by deficit round robin
+extern void
+fairqDrain(fairq_t *this)
+{
+  cmdfairq_t *fq;
+  int         n, w;
+
+  while (this->head || this->own.len) {
+    if (this->midline) {
+      // a partly written line is finished first whatever the deficit
+      fq = this->midline;
+      for (n=1; n<fq->len; n++) {
+	if (fq->ring[(fq->start + n - 1) % FAIRQ_QUEUELEN] == '\n') break;
+      }
+      if (fq->len == 0) n = 0;
+    } else if (this->own.len) {
+      fq = &(this->own);
+      n  = fq->len;
+    } else {
+      fq = &(this->head->fq);
+      if (!fq->visited) {
+	fq->deficit += FAIRQ_QUANTUM * fq->weight;
+	fq->visited  = true;
+      }
+      n = fairqSendable(fq, fq->deficit);
+    }
+    if (n > 0) {
+      w = fairqSend(this, fq, n);
+      fq->deficit -= w;
+      if (w < n) {
+	fairqWait(this);
+	return;
+      }
+    }
+    if (fq->len == 0) {
+      if (fq->cmd) fairqDeactivate(this, fq->cmd);
+      if (this->midline == fq) this->midline = NULL;
+    } else if (fq->cmd && fq->cmd == this->head && fq != this->midline) {
+      fairqRotate(this);
+    }
+  }
+  fairqUnwait(this);
+}
+
+// spec is a weight from 1 to FAIRQ_MAXWEIGHT.  Applies to cmd or, if cmd
+// is NULL, to all commands
+extern bool
+fairqSetWeight(fairq_t *this, cmd_t *cmd, char *spec, FILE *f)
+{
+  cmd_t *c, *tmp;
+  char  *end;
+  long   weight;
+
+  errno  = 0;
+  weight = strtol(spec, &end, 10);
+  if (errno != 0 || end == spec || *end != '\0' || weight < 1 ||
+      weight > FAIRQ_MAXWEIGHT) {
+    EPRINT(f, "bad weight (1-%d): %s\n", FAIRQ_MAXWEIGHT, spec);
+    return false;
+  }
+  if (cmd) {
+    cmd->fq.weight = weight;
+  } else {
+    HASH_ITER(hh, GBLS.cmds, c, tmp) c->fq.weight = weight;
+  }
+  return true;
+}
+
+extern void
+fairqAddCmd(fairq_t *this, cmd_t *cmd)
+{
+  cmd->fq.cmd    = cmd;
+  cmd->fq.weight = 1;
+}
+
+// must be called before cmd is removed from GBLS.cmds and freed.  Its
+// queued output is discarded
+extern void
+fairqForgetCmd(fairq_t *this, cmd_t *cmd)
+{
+  cmdfairq_t *fq = &(cmd->fq);
+
+  fairqDeactivate(this, cmd);
+  if (this->midline == fq) this->midline = NULL;
+  this->depth -= fq->len;
+  fq->len = 0;
+  if (fq->ring) free(fq->ring);
+  fq->ring = NULL;
+}
+
+// human readable report of the fair queueing of command output
+extern void
+fairqReport(fairq_t *this, FILE *f)
+{
+  cmd_t *cmd, *tmp;
+  fprintf(f, "fair: %s depth:%d blocks:%lu queued:%lu drops:%lu\n",
+	  (this->waiting) ? "waiting" : "idle", this->depth, this->blocks,
+	  this->queued, this->drops);
+  if (this->own.queued) {
+    fprintf(f, "  (yar) queued:%d total:%lu drops:%lu\n", this->own.len,
+	    this->own.queued, this->own.drops);
+  }
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    cmdfairq_t *fq = &(cmd->fq);
+    fprintf(f, "  %s weight:%d queued:%d total:%lu drops:%lu\n", cmd->name,
+	    fq->weight, fq->len, fq->queued, fq->drops);
+  }
+}
+
+extern void
+fairqCleanup(fairq_t *this)
+{
+  if (this->wfd != -1 && close(this->wfd) != 0) perror("close fairq->wfd");
+  this->wfd = -1;
+  if (this->own.ring) free(this->own.ring);
+  this->own.ring = NULL;
+  this->own.len  = 0;
+}
+
+extern void
+fairqDump(fairq_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sfairq: this=%p head=%p tail=%p midline=%p wfd=%d depth=%d "
+	  "blocks=%lu queued=%lu drops=%lu waiting=%d ownlen=%d\n", prefix, this,
+	  this->head, this->tail, this->midline, this->wfd, this->depth,
+	  this->blocks, this->queued, this->drops, this->waiting,
+	  this->own.len);
+}
@@ -0,0 +1,65 @@
+#ifndef __YAR_FAIRQ_H__
+#define __YAR_FAIRQ_H__
+
+struct cmd;
+
+#define FAIRQ_QUEUELEN (64 * 1024)  // bytes queued per command
+#define FAIRQ_QUANTUM  512          // bytes per round for a weight of 1
+#define FAIRQ_MAXWEIGHT 1000
+
+// per command fair queue state (embedded in each cmd_t)
+typedef struct {
+  struct cmd *cmd;           // owner (NULL for yar's own output)
+  struct cmd *next;          // next command in the active list
+  char       *ring;          // queued output (allocated when first needed)
+  uint64_t    queued;        // bytes that had to be queued
+  uint64_t    drops;         // bytes dropped as the queue was full
+  int         start;         // offset of the oldest queued byte
+  int         len;           // bytes queued
+  int         deficit;       // bytes that may be sent this round
+  int         weight;        // share of the broadcast tty (default 1)
+  bool        active;        // on the active list
+  bool        visited;       // has had its quantum this round
+} cmdfairq_t;
+
+// Fair Queue Object
+//   Shares the broadcast tty between the commands' output when its reader
+//   cannot keep up.  While writes to the broadcast tty succeed command
+//   output is written directly.  Once a write would block, output is
+//   queued per command and drained as the tty becomes writable by deficit
+//   round robin: each round an active command may send up to its weight
+//   times FAIRQ_QUANTUM bytes, whole lines when line buffering.  A chatty
+//   command thus only gets its share and a quiet command's lines wait for
+//   at most one round.  Output of yar itself (eg. coalesced summaries) is
+//   written with a NULL cmd and has a queue of its own that is drained
+//   ahead of the commands' queues.  Writability is watched via a duplicate
+//   of the broadcast tty's fd so that it does not disturb its input events.
+typedef struct {
+  struct cmd *head;          // active list: commands with queued output
+  struct cmd *tail;
+  cmdfairq_t *midline;       // queue whose line has been partly written
+  cmdfairq_t  own;           // yar's own output
+  evntdesc_t  ed;            // event descriptor for the duplicate fd
+  uint64_t    blocks;        // times the broadcast tty became full
+  uint64_t    queued;        // bytes that had to be queued
+  uint64_t    drops;         // bytes dropped as a queue was full
+  int         wfd;           // duplicate of the broadcast tty dom fd
+  int         epollfd;
+  int         depth;         // bytes queued for all commands
+  bool        waiting;       // waiting for the broadcast tty to be writable
+} fairq_t;
+
+extern void fairqInit(fairq_t *this, bool iszeroed);
+extern int  fairqWrite(fairq_t *this, struct cmd *cmd, char *buf, int len,
+		       int epollfd);
+extern int  fairqWritev(fairq_t *this, struct cmd *cmd, char **bufs,
+			int *lens, int nbufs, int epollfd);
+extern void fairqDrain(fairq_t *this);
+extern bool fairqSetWeight(fairq_t *this, struct cmd *cmd, char *spec,
+			   FILE *f);
+extern void fairqAddCmd(fairq_t *this, struct cmd *cmd);
+extern void fairqForgetCmd(fairq_t *this, struct cmd *cmd);
+extern void fairqReport(fairq_t *this, FILE *f);
+extern void fairqCleanup(fairq_t *this);
+extern void fairqDump(fairq_t *this, FILE *f, char *prefix);
+#endif
@@ -0,0 +1,224 @@
+#include "yar.h"
+
+// midline is true if the gather completed as a command output the marker
+// (the rest of its line is yet to be read)
+static void
+gatherFinish(gather_t *this, gatherstate_t state, bool midline)
+{
+  if (clock_gettime(CLOCK_SOURCE, &(this->end)) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  tmrDisarm(&(this->tmr));
+  this->state = state;
+  // a completed barrier ends the current round of reduced/coalesced output
+  reduceBarrier(&GBLS.reduce, !midline);
+  coalesceBarrier(&GBLS.coalesce, !midline);
+  VPRINT("gather %s: %d of %d arrived in %f secs\n", gatherStateStr(this),
+	 this->arrived, this->targets, tsDiff(&(this->end), &(this->start)));
+  // let an interactive monitor user know the barrier fired
+  monprintf("\ngather %s: %d/%d arrived in %.6f secs\n", gatherStateStr(this),
+	    this->arrived, this->targets,
+	    tsDiff(&(this->end), &(this->start)));
+}
+
+static evnthdlrrc_t
+gatherTimeout(void *obj, uint32_t evnts, int epollfd)
+{
+  gather_t *this = obj;
+  if (this->state == GATHER_WAITING) {
+    gatherFinish(this, GATHER_TIMEDOUT, false);
+  }
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+gatherInit(gather_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(gather_t));
+  this->state     = GATHER_IDLE;
+  return tmrInit(&(this->tmr), gatherTimeout, this, iszeroed);
+}
+
+extern const char *
+gatherStateStr(gather_t *this)
+{
+  switch (this->state) {
+  case GATHER_IDLE:      return "idle";
+  case GATHER_WAITING:   return "waiting";
+  case GATHER_DONE:      return "done";
+  case GATHER_TIMEDOUT:  return "timeout";
+  case GATHER_CANCELLED: return "cancelled";
+  }
+  return "unknown";
+}
+
+// start a new gather on marker.  If namecnt is 0 all current commands are
+// targeted otherwise only the named commands.  A timeout of 0 waits forever.
+// Starting a gather abandons any gather in progress.
+extern bool
+gatherStart(gather_t *this, char *marker, double timeout, char **names,
+	    int namecnt, int epollfd, FILE *f)
+{
+  cmd_t *cmd, *tmp;
+
+  if (marker == NULL || *marker == '\0') {
+    EPRINT(f, "%s", "gather marker must not be empty\n");
+    return false;
+  }
+  for (int i=0; i<namecnt; i++) {
+    HASH_FIND_STR(GBLS.cmds, names[i], cmd);
+    if (cmd == NULL) {
+      EPRINT(f, "%s is not a current command\n", names[i]);
+      return false;
+    }
+  }
+  if (!kmpInit(&this->marker, marker)) {
+    EPRINT(f, "%s", "failed to build gather marker matcher\n");
+    return false;
+  }
+  tmrDisarm(&(this->tmr));
+  this->timeout   = timeout;
+  this->targets   = 0;
+  this->arrived   = 0;
+  this->lost      = 0;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    cmd->gthr = (cmdgather_t){ .target = (namecnt == 0) };
+  }
+  for (int i=0; i<namecnt; i++) {
+    HASH_FIND_STR(GBLS.cmds, names[i], cmd);
+    cmd->gthr.target = true;
+  }
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->gthr.target) this->targets++;
+  }
+  if (clock_gettime(CLOCK_SOURCE, &(this->start)) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  this->rounds++;
+  this->state = GATHER_WAITING;
+  if (this->targets == 0) {
+    gatherFinish(this, GATHER_DONE, false);
+    return true;
+  }
+  if (timeout > 0.0 && !tmrArm(&(this->tmr), epollfd, timeout, 0.0)) {
+    EPRINT(f, "%s", "failed to arm gather timeout\n");
+    this->state = GATHER_CANCELLED;
+    return false;
+  }
+  return true;
+}
+
+extern void
+gatherCancel(gather_t *this)
+{
+  if (this->state == GATHER_WAITING) {
+    gatherFinish(this, GATHER_CANCELLED, false);
+  }
+}
+
+// cmd emitted the marker
+extern void
+gatherArrive(gather_t *this, cmd_t *cmd)
+{
+  struct timespec now;
+  ASSERT(this->state == GATHER_WAITING && cmd->gthr.target);
+  if (cmd->gthr.arrived) return;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  cmd->gthr.arrived = true;
+  cmd->gthr.latency = tsDiff(&now, &(this->start));
+  this->arrived++;
+  VLPRINT(2, "%s: arrived %d/%d latency=%f\n", cmd->name, this->arrived,
+	  this->targets, cmd->gthr.latency);
+  if (this->arrived == this->targets) gatherFinish(this, GATHER_DONE, true);
+}
+
+// must be called before cmd is removed from GBLS.cmds and freed.  A deleted
+// command can no longer arrive so it is no longer waited for.
+extern void
+gatherForgetCmd(gather_t *this, cmd_t *cmd)
+{
+  if (!cmd->gthr.target) return;
+  cmd->gthr.target = false;
+  this->targets--;
+  if (cmd->gthr.arrived) this->arrived--;
+  else this->lost++;
+  if (this->state == GATHER_WAITING && this->arrived == this->targets) {
+    gatherFinish(this, GATHER_DONE, false);
+  }
+}
+
+static int
+latencyCmp(const void *a, const void *b)
+{
+  double la = (*(cmd_t **)a)->gthr.latency;
+  double lb = (*(cmd_t **)b)->gthr.latency;
+  return (la > lb) - (la < lb);
+}
+
+// human readable report of the current or last gather: a summary line,
+// the stragglers and then the arrival latency of each command (in order
+// of arrival)
+extern void
+gatherReport(gather_t *this, FILE *f)
+{
+  struct timespec now;
+  cmd_t *cmd, *tmp;
+  int    n = 0;
+
+  if (this->state == GATHER_IDLE) {
+    fprintf(f, "gather: state:idle\n");
+    return;
+  }
+  if (this->state == GATHER_WAITING) {
+    if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+      perror("clock_gettime");
+      NYI;
+    }
+  } else {
+    now = this->end;
+  }
+  fprintf(f, "gather: state:%s marker:%s round:%lu arrived:%d targets:%d "
+	  "lost:%d elapsed:%.6f timeout:%.6f\n", gatherStateStr(this),
+	  this->marker.str, this->rounds, this->arrived, this->targets,
+	  this->lost, tsDiff(&now, &(this->start)), this->timeout);
+  fprintf(f, "stragglers:");
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->gthr.target && !cmd->gthr.arrived) fprintf(f, " %s", cmd->name);
+  }
+  fprintf(f, "\n");
+  cmd_t **arrivals = malloc(sizeof(cmd_t *) * (this->arrived + 1));
+  assert(arrivals);
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->gthr.target && cmd->gthr.arrived && n < this->arrived) {
+      arrivals[n++] = cmd;
+    }
+  }
+  qsort(arrivals, n, sizeof(cmd_t *), latencyCmp);
+  for (int i=0; i<n; i++) {
+    fprintf(f, "  %s %.6f\n", arrivals[i]->name, arrivals[i]->gthr.latency);
+  }
+  free(arrivals);
+}
+
+extern void
+gatherCleanup(gather_t *this)
+{
+  tmrCleanup(&(this->tmr));
+  kmpCleanup(&this->marker);
+  this->state     = GATHER_IDLE;
+}
+
+extern void
+gatherDump(gather_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sgather: this=%p state=%s marker=%s targets=%d arrived=%d "
+	  "lost=%d timeout=%f rounds=%lu\n", prefix, this,
+	  gatherStateStr(this), this->marker.str, this->targets, this->arrived,
+	  this->lost, this->timeout, this->rounds);
+  tmrDump(&(this->tmr), f, prefix);
+}
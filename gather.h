@@ -0,0 +1,56 @@
+#ifndef __YAR_GATHER_H__
+#define __YAR_GATHER_H__
+
+struct cmd;
+
+typedef enum {
+  GATHER_IDLE=0,       // no gather has been started
+  GATHER_WAITING=1,    // waiting for targeted commands to emit the marker
+  GATHER_DONE=2,       // all targeted commands emitted the marker
+  GATHER_TIMEDOUT=3,   // timeout expired before all commands emitted it
+  GATHER_CANCELLED=4   // cancelled via the monitor
+} gatherstate_t;
+
+// per command gather state (embedded in each cmd_t)
+typedef struct {
+  double latency;      // seconds from gather start to marker arrival
+  int    markercnt;    // marker match state (see kmpStep)
+  bool   target;       // command is part of the current gather
+  bool   arrived;      // command has emitted the marker
+} cmdgather_t;
+
+// Gather Object
+//   A barrier across the commands: once started, the output of every
+//   targeted command is incrementally matched (as it streams through yar)
+//   against a marker string.  The gather completes when every targeted
+//   command has emitted the marker or the timeout expires.  The result
+//   records the per command arrival latency and the stragglers.
+typedef struct {
+  tmr_t            tmr;        // timeout timer
+  kmp_t            marker;     // marker matcher
+  struct timespec  start;      // time gather was started
+  struct timespec  end;        // time gather completed
+  double           timeout;    // seconds, 0 for no timeout
+  uint64_t         rounds;     // number of gathers started
+  gatherstate_t    state;
+  int              targets;    // number of commands targeted
+  int              arrived;    // number of targeted commands that arrived
+  int              lost;       // targeted commands deleted before arriving
+} gather_t;
+
+extern bool gatherInit(gather_t *this, bool iszeroed);
+extern bool gatherStart(gather_t *this, char *marker, double timeout,
+			char **names, int namecnt, int epollfd, FILE *f);
+extern void gatherCancel(gather_t *this);
+extern void gatherArrive(gather_t *this, struct cmd *cmd);
+extern void gatherForgetCmd(gather_t *this, struct cmd *cmd);
+extern const char *gatherStateStr(gather_t *this);
+extern void gatherReport(gather_t *this, FILE *f);
+extern void gatherCleanup(gather_t *this);
+extern void gatherDump(gather_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool gatherIsWaiting(gather_t *this)
+{
+  return (this->state == GATHER_WAITING);
+}
+#endif
@@ -0,0 +1,150 @@
+#include "yar.h"
+#include <math.h>
+
+// bucket index of magnitude m (m > 0)
+static int
+histBucket(double m)
+{
+  int    e;
+  double f = frexp(m, &e);   // m = f * 2^e with f in [0.5, 1)
+  int    sub;
+
+  if (e <= HIST_EMIN) return 0;
+  if (e > HIST_EMAX) return HIST_BUCKETS - 1;
+  sub = (int)((f - 0.5) * 2 * HIST_SUBS);
+  if (sub >= HIST_SUBS) sub = HIST_SUBS - 1;
+  return (e - HIST_EMIN - 1) * HIST_SUBS + sub;
+}
+
+// midpoint of the magnitudes that map to bucket i
+static double
+histBucketValue(int i)
+{
+  int    e   = i / HIST_SUBS + HIST_EMIN + 1;
+  int    sub = i % HIST_SUBS;
+  double f   = 0.5 + (sub + 0.5) / (2 * HIST_SUBS);
+  return ldexp(f, e);
+}
+
+extern void
+histInit(hist_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(hist_t));
+  this->pos = NULL;
+  this->neg = NULL;
+  histReset(this);
+}
+
+extern void
+histRecord(hist_t *this, double v)
+{
+  uint64_t **buckets;
+
+  if (this->count == 0 || v < this->min) this->min = v;
+  if (this->count == 0 || v > this->max) this->max = v;
+  this->count++;
+  this->sum += v;
+  if (v == 0.0 || isnan(v)) {
+    this->zero++;
+    return;
+  }
+  buckets = (v > 0.0) ? &(this->pos) : &(this->neg);
+  if (*buckets == NULL) {
+    *buckets = calloc(HIST_BUCKETS, sizeof(uint64_t));
+    assert(*buckets);
+  }
+  (*buckets)[histBucket(fabs(v))]++;
+}
+
+// approximate p'th percentile (0 <= p <= 100) of the recorded values
+extern double
+histPercentile(hist_t *this, double p)
+{
+  uint64_t rank, seen = 0;
+  double   v = 0.0;
+
+  if (this->count == 0) return 0.0;
+  if (p <= 0.0) return this->min;
+  if (p >= 100.0) return this->max;
+  rank = (uint64_t)ceil(p / 100.0 * this->count);
+  if (rank == 0) rank = 1;
+  // walk values in increasing order: negatives (largest magnitude first),
+  // zero, then positives
+  if (this->neg) {
+    for (int i=HIST_BUCKETS-1; i>=0; i--) {
+      seen += this->neg[i];
+      if (seen >= rank) { v = -histBucketValue(i); goto found; }
+    }
+  }
+  seen += this->zero;
+  if (seen >= rank) { v = 0.0; goto found; }
+  if (this->pos) {
+    for (int i=0; i<HIST_BUCKETS; i++) {
+      seen += this->pos[i];
+      if (seen >= rank) { v = histBucketValue(i); goto found; }
+    }
+  }
+  v = this->max;
+ found:
+  // the bucket midpoint can lie outside of the actual range
+  if (v < this->min) v = this->min;
+  if (v > this->max) v = this->max;
+  return v;
+}
+
+// approximate number of recorded values <= each of les[0..n-1] (ascending)
+// into counts[0..n-1], as for the buckets of a Prometheus histogram.  A
+// single pass over the buckets
+extern void
+histCumulative(hist_t *this, const double *les, int n, uint64_t *counts)
+{
+  uint64_t seen = 0;
+  int      j    = 0;
+  double   b;
+
+  // walk values in increasing order as histPercentile does
+  if (this->neg) {
+    for (int i=HIST_BUCKETS-1; i>=0; i--) {
+      b = -histBucketValue(i);
+      while (j<n && les[j] < b) counts[j++] = seen;
+      seen += this->neg[i];
+    }
+  }
+  while (j<n && les[j] < 0.0) counts[j++] = seen;
+  seen += this->zero;
+  if (this->pos) {
+    for (int i=0; i<HIST_BUCKETS && j<n; i++) {
+      b = histBucketValue(i);
+      while (j<n && les[j] < b) counts[j++] = seen;
+      seen += this->pos[i];
+    }
+  }
+  while (j<n) counts[j++] = this->count;
+  // min and max are exact
+  for (j=0; j<n; j++) {
+    if (this->count == 0 || les[j] < this->min) counts[j] = 0;
+    else if (les[j] >= this->max) counts[j] = this->count;
+  }
+}
+
+extern void
+histReset(hist_t *this)
+{
+  if (this->pos) bzero(this->pos, HIST_BUCKETS * sizeof(uint64_t));
+  if (this->neg) bzero(this->neg, HIST_BUCKETS * sizeof(uint64_t));
+  this->zero  = 0;
+  this->count = 0;
+  this->sum   = 0.0;
+  this->min   = 0.0;
+  this->max   = 0.0;
+}
+
+extern void
+histCleanup(hist_t *this)
+{
+  if (this->pos) free(this->pos);
+  if (this->neg) free(this->neg);
+  this->pos = NULL;
+  this->neg = NULL;
+  histReset(this);
+}
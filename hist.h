@@ -0,0 +1,41 @@
+#ifndef __YAR_HIST_H__
+#define __YAR_HIST_H__
+
+// log-linear bucketing: each power of two is split into 2^HIST_SUBBITS
+// linear sub-buckets so a recorded value is known to within about
+// 1/2^(HIST_SUBBITS+1) (~1.5%) of its magnitude (as in HDR histograms).
+// Magnitudes outside [2^HIST_EMIN, 2^HIST_EMAX) are clamped to the end
+// buckets (min and max are always exact).
+#define HIST_SUBBITS 5
+#define HIST_SUBS    (1 << HIST_SUBBITS)
+#define HIST_EMIN    (-24)
+#define HIST_EMAX    40
+#define HIST_BUCKETS ((HIST_EMAX - HIST_EMIN) * HIST_SUBS)
+
+// Histogram Object
+//   Streaming summary of a set of values: count, sum, min, max and
+//   approximate percentiles in constant memory.  Bucket arrays are only
+//   allocated once a value of that sign is recorded.
+typedef struct {
+  uint64_t *pos;        // buckets for values > 0
+  uint64_t *neg;        // buckets for values < 0 (by magnitude)
+  uint64_t  zero;       // count of values == 0
+  uint64_t  count;
+  double    sum;
+  double    min;
+  double    max;
+} hist_t;
+
+extern void   histInit(hist_t *this, bool iszeroed);
+extern void   histRecord(hist_t *this, double v);
+extern double histPercentile(hist_t *this, double p);
+extern void   histCumulative(hist_t *this, const double *les, int n,
+			     uint64_t *counts);
+extern void   histReset(hist_t *this);
+extern void   histCleanup(hist_t *this);
+
+__attribute__((unused)) static inline double histMean(hist_t *this)
+{
+  return (this->count) ? this->sum / this->count : 0.0;
+}
+#endif
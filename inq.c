@@ -0,0 +1,154 @@
+#include "yar.h"
+
+// cmd has started (or stopped) waiting for its tty.  Broadcast input and
+// the command's client tty input are paused while it waits (the client tty
+// stays paused if its pacing has stopped it too, see paceThrottle)
+static void
+inqWait(inq_t *this, cmd_t *cmd, bool wait)
+{
+  this->waiting += (wait) ? 1 : -1;
+  ASSERT(this->waiting >= 0);
+  if (this->epollfd == -1) return;
+  if (cmd->clttty.dfd != -1 && (wait || !tmrIsArmed(&(cmd->pace.tmr)))) {
+    ttyInputEnable(&(cmd->clttty), this->epollfd, !wait);
+  }
+  if (wait && this->waiting == 1) {
+    bcstPause(BCST_PAUSE_INPUT, true, this->epollfd);
+    tmrArm(&(this->tmr), this->epollfd, INQ_RETRY, INQ_RETRY);
+  } else if (!wait && this->waiting == 0) {
+    bcstPause(BCST_PAUSE_INPUT, false, this->epollfd);
+    tmrDisarm(&(this->tmr));
+  }
+}
+
+// write as much of cmd's pending input as its tty takes
+static void
+inqFlush(inq_t *this, cmd_t *cmd)
+{
+  cmdinq_t *q = &(cmd->inq);
+  int       w = cmdttyWrite(cmd, &(q->buf[q->off]), q->n);
+
+  if (w <= 0) return;
+  cmdSent(cmd, &(q->buf[q->off]), w);
+  q->off += w;
+  q->n   -= w;
+  VLPRINT(2, "%s: wrote %d pending bytes %d left\n", cmd->name, w, q->n);
+  if (q->n == 0) {
+    q->off = 0;
+    inqWait(this, cmd, false);
+  }
+}
+
+// periodic while commands are waiting: write more of their pending input
+static evnthdlrrc_t
+inqRetryEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  inq_t *this = obj;
+  cmd_t *cmd, *tmp;
+
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (inqIsWaiting(&(cmd->inq))) inqFlush(this, cmd);
+  }
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+inqInit(inq_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(inq_t));
+  this->waiting = 0;
+  this->epollfd = -1;
+  return tmrInit(&(this->tmr), inqRetryEvent, this, iszeroed);
+}
+
+extern void
+inqRegisterEvents(inq_t *this, int epollfd)
+{
+  this->epollfd = epollfd;
+}
+
+// add len bytes of buf to the end of cmd's pending input
+extern void
+inqQueue(inq_t *this, cmd_t *cmd, char *buf, int len, int epollfd)
+{
+  cmdinq_t *q = &(cmd->inq);
+
+  if (len <= 0) return;
+  if (epollfd != -1) this->epollfd = epollfd;
+  if (q->off + q->n + len > q->sz) {
+    if (q->off) memmove(q->buf, &(q->buf[q->off]), q->n);
+    q->off = 0;
+    if (q->n + len > q->sz) {
+      q->sz  = (q->n + len) * 2;
+      q->buf = realloc(q->buf, q->sz);
+      assert(q->buf);
+    }
+  }
+  memcpy(&(q->buf[q->off + q->n]), buf, len);
+  q->n      += len;
+  q->queued += len;
+  this->queued += len;
+  VLPRINT(2, "%s: tty full %d bytes pending\n", cmd->name, q->n);
+  if (q->n == len) inqWait(this, cmd, true);
+}
+
+// write len bytes of buf to cmd (after any input already pending).  What
+// the tty does not take is queued: returns len
+extern int
+inqWrite(inq_t *this, cmd_t *cmd, char *buf, int len, int epollfd)
+{
+  int w = 0;
+
+  if (len <= 0) return 0;
+  if (!inqIsWaiting(&(cmd->inq))) w = cmdWriteBuf(cmd, buf, len);
+  if (w < len) inqQueue(this, cmd, &buf[w], len - w, epollfd);
+  return len;
+}
+
+// cmd's process has gone: the input pending for it is dropped
+extern void
+inqStop(inq_t *this, cmd_t *cmd)
+{
+  cmdinq_t *q = &(cmd->inq);
+
+  if (!inqIsWaiting(q)) return;
+  VLPRINT(1, "%s: dropping %d bytes of pending input\n", cmd->name, q->n);
+  q->drops    += q->n;
+  this->drops += q->n;
+  q->n   = 0;
+  q->off = 0;
+  inqWait(this, cmd, false);
+}
+
+// must be called before cmd is cleaned up
+extern void
+inqForgetCmd(inq_t *this, cmd_t *cmd)
+{
+  inqStop(this, cmd);
+  if (cmd->inq.buf) free(cmd->inq.buf);
+  cmd->inq.buf = NULL;
+  cmd->inq.sz  = 0;
+}
+
+extern void
+inqCleanup(inq_t *this)
+{
+  cmd_t *cmd, *tmp;
+
+  // frees the per command state
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->inq.buf) free(cmd->inq.buf);
+    cmd->inq = (cmdinq_t){ 0 };
+  }
+  tmrCleanup(&(this->tmr));
+  this->waiting = 0;
+}
+
+extern void
+inqDump(inq_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sinq: this=%p waiting=%d queued=%lu drops=%lu epollfd=%d\n",
+	  prefix, this, this->waiting, this->queued, this->drops,
+	  this->epollfd);
+  tmrDump(&(this->tmr), f, prefix);
+}
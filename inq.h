@@ -0,0 +1,54 @@
+#ifndef __YAR_INQ_H__
+#define __YAR_INQ_H__
+
+struct cmd;
+
+#define INQ_RETRY 0.01  // seconds between retries of full ttys
+
+// per command pending input (embedded in each cmd_t)
+typedef struct {
+  char    *buf;         // input the command's tty has not taken yet
+  uint64_t queued;      // bytes that had to wait for the tty
+  uint64_t drops;       // bytes dropped as the command stopped
+  int      sz;          // bytes allocated for buf
+  int      off;         // first byte of buf still to be written
+  int      n;           // bytes still to be written
+} cmdinq_t;
+
+// Input Queue Object
+//   Input for a command whose tty is full (a pty takes about 4KB before
+//   the command reads it) is not lost: what the tty does not take is kept
+//   in the command's pending input and written, before anything newer, as
+//   the tty drains.  While any command has pending input broadcast input
+//   is paused (see bcstPause) and so is the client tty input of the
+//   command, so the queue is bounded by what was already read.  A full
+//   tty does not signal when it has room (the command's tty may be a
+//   child yar or be replaced by a standby instance) so a timer retries
+//   every INQ_RETRY.  Writers that have their own way of waiting for a
+//   full tty (eg. the work queue) use cmdWriteBuf which takes nothing while
+//   input is pending so the order is kept.  Pending input is dropped when
+//   the command stops.
+typedef struct {
+  tmr_t    tmr;         // retries writes to full ttys (while waiting)
+  uint64_t queued;      // total bytes that had to wait
+  uint64_t drops;       // total bytes dropped as commands stopped
+  int      waiting;     // commands with pending input
+  int      epollfd;     // for pausing input outside of our events
+} inq_t;
+
+extern bool inqInit(inq_t *this, bool iszeroed);
+extern void inqRegisterEvents(inq_t *this, int epollfd);
+extern int  inqWrite(inq_t *this, struct cmd *cmd, char *buf, int len,
+		     int epollfd);
+extern void inqQueue(inq_t *this, struct cmd *cmd, char *buf, int len,
+		     int epollfd);
+extern void inqStop(inq_t *this, struct cmd *cmd);
+extern void inqForgetCmd(inq_t *this, struct cmd *cmd);
+extern void inqCleanup(inq_t *this);
+extern void inqDump(inq_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool inqIsWaiting(cmdinq_t *this)
+{
+  return (this->n != 0);
+}
+#endif
@@ -0,0 +1,165 @@
+#include "yar.h"
+
+extern void
+journalInit(journal_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(journal_t));
+  this->ring      = NULL;
+  this->start     = 0;
+  this->end       = 0;
+  this->size      = 0;
+  this->recording = false;
+}
+
+// (re)enable with a ring of size bytes.  Anything recorded is discarded
+static bool
+journalOn(journal_t *this, int size, FILE *f)
+{
+  char *ring = malloc(size);
+  if (ring == NULL) {
+    EPRINT(f, "failed to allocate a %d byte journal\n", size);
+    return false;
+  }
+  if (this->ring) free(this->ring);
+  this->ring      = ring;
+  this->size      = size;
+  this->start     = this->end;
+  this->recording = true;
+  return true;
+}
+
+// spec is one of:
+//   "on[:<bytes>]" record broadcast input in a ring of bytes (default
+//                  JOURNAL_DEFAULT_SIZE)
+//   "checkpoint"   discard what has been recorded (and resume recording)
+//   "freeze"       stop recording: what is recorded is replayed as is
+//   "off"          stop recording and discard the journal
+extern bool
+journalSet(journal_t *this, char *spec, FILE *f)
+{
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing journal setting\n");
+    return false;
+  }
+  if (strncmp(spec, "on", 2) == 0 && (spec[2] == '\0' || spec[2] == ':')) {
+    int size = JOURNAL_DEFAULT_SIZE;
+    if (spec[2] == ':') {
+      char *end;
+      errno = 0;
+      size  = strtol(&spec[3], &end, 10);
+      if (errno != 0 || end == &spec[3] || *end != '\0' || size < 1) {
+	EPRINT(f, "bad journal size: %s\n", spec);
+	return false;
+      }
+    }
+    return journalOn(this, size, f);
+  }
+  if (strcmp(spec, "off") == 0) {
+    journalCleanup(this);
+    return true;
+  }
+  if (!journalIsOn(this)) {
+    EPRINT(f, "journal is off: %s\n", spec);
+    return false;
+  }
+  if (strcmp(spec, "checkpoint") == 0) {
+    this->start     = this->end;
+    this->recording = true;
+  } else if (strcmp(spec, "freeze") == 0) {
+    this->recording = false;
+  } else {
+    EPRINT(f, "unknown journal setting: %s\n", spec);
+    return false;
+  }
+  return true;
+}
+
+// record a byte of broadcast input
+extern void
+journalChar(journal_t *this, char c)
+{
+  if (!this->recording) return;
+  if (this->end - this->start == this->size) {
+    // full: discard the oldest line (or what is left of it) so that a
+    // replay never starts part way through a line
+    char old;
+    do {
+      old = this->ring[this->start % this->size];
+      this->start++;
+      this->truncated++;
+    } while (old != '\n' && this->start < this->end);
+  }
+  this->ring[this->end % this->size] = c;
+  this->end++;
+}
+
+// cmd is being restarted: replay what was recorded up to now once it is
+// ready (input after this point reaches it as usual)
+extern void
+journalRestart(journal_t *this, cmd_t *cmd)
+{
+  if (!journalIsOn(this)) return;
+  cmd->jrnl.pending  = true;
+  cmd->jrnl.replayto = this->end;
+}
+
+// cmd is ready: if it restarted write the journal to it.  The ring is
+// written in (at most two) contiguous runs and what the tty does not take
+// is queued (see inq.h) so newer input follows the whole replay
+extern void
+journalReplay(journal_t *this, cmd_t *cmd)
+{
+  uint64_t pos;
+  int      n = 0, run;
+
+  if (!cmd->jrnl.pending) return;
+  cmd->jrnl.pending = false;
+  if (!journalIsOn(this)) return;
+  for (pos = this->start; pos < cmd->jrnl.replayto; pos += run) {
+    int off = pos % this->size;
+    run = this->size - off;
+    if (run > cmd->jrnl.replayto - pos) run = cmd->jrnl.replayto - pos;
+    inqWrite(&GBLS.inq, cmd, &(this->ring[off]), run, -1);
+    n += run;
+  }
+  this->replayed += n;
+  this->replays++;
+  cmd->jrnl.replays++;
+  VPRINT("%s: replayed %d journal bytes\n", cmd->name, n);
+}
+
+extern void
+journalReport(journal_t *this, FILE *f)
+{
+  cmd_t *cmd, *tmp;
+  fprintf(f, "journal: state:%s size:%d bytes:%lu truncated:%lu replays:%lu "
+	  "replayed:%lu\n",
+	  (!journalIsOn(this)) ? "off" :
+	  (this->recording) ? "recording" : "frozen",
+	  this->size, this->end - this->start, this->truncated, this->replays,
+	  this->replayed);
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->jrnl.replays == 0 && !cmd->jrnl.pending) continue;
+    fprintf(f, "  %s replays:%lu pending:%d\n", cmd->name, cmd->jrnl.replays,
+	    cmd->jrnl.pending);
+  }
+}
+
+extern void
+journalCleanup(journal_t *this)
+{
+  if (this->ring) free(this->ring);
+  this->ring      = NULL;
+  this->size      = 0;
+  this->start     = this->end;
+  this->recording = false;
+}
+
+extern void
+journalDump(journal_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sjournal: this=%p ring=%p size=%d start=%lu end=%lu "
+	  "recording=%d truncated=%lu replays=%lu replayed=%lu\n",
+	  prefix, this, this->ring, this->size, this->start, this->end,
+	  this->recording, this->truncated, this->replays, this->replayed);
+}
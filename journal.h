@@ -0,0 +1,50 @@
+#ifndef __YAR_JOURNAL_H__
+#define __YAR_JOURNAL_H__
+
+struct cmd;
+
+#define JOURNAL_DEFAULT_SIZE 4096
+
+// per command journal state (embedded in each cmd_t)
+typedef struct {
+  uint64_t replayto;   // journal position when the command restarted
+  uint64_t replays;    // number of times the journal was replayed to it
+  bool     pending;    // restarted and waiting to be ready for the replay
+} cmdjournal_t;
+
+// Journal Object
+//   Records the input broadcast to the commands (eg. the cd and export
+//   commands that set up a session) in a bounded ring so that it can be
+//   replayed to a command that restarts (eg. after an ssh connection
+//   drops).  The replay happens once the restarted command is ready (see
+//   ready.h) or, if it has no ready spec, on its first output or just
+//   before newer input is written to it so it never overtakes the replay.
+//   A checkpoint discards what has been recorded so far and freezing stops
+//   recording, leaving a fixed session preamble.  Positions are byte
+//   sequence numbers since the journal was enabled.  If the ring fills the
+//   oldest whole lines are discarded.
+typedef struct {
+  char     *ring;        // recorded bytes (NULL when off)
+  uint64_t  start;       // position of oldest recorded byte
+  uint64_t  end;         // position one past the newest recorded byte
+  uint64_t  truncated;   // bytes discarded because the ring was full
+  uint64_t  replays;     // number of replays done
+  uint64_t  replayed;    // bytes replayed
+  int       size;        // ring size
+  bool      recording;   // broadcast input is being recorded
+} journal_t;
+
+extern void journalInit(journal_t *this, bool iszeroed);
+extern bool journalSet(journal_t *this, char *spec, FILE *f);
+extern void journalChar(journal_t *this, char c);
+extern void journalRestart(journal_t *this, struct cmd *cmd);
+extern void journalReplay(journal_t *this, struct cmd *cmd);
+extern void journalReport(journal_t *this, FILE *f);
+extern void journalCleanup(journal_t *this);
+extern void journalDump(journal_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool journalIsOn(journal_t *this)
+{
+  return (this->ring != NULL);
+}
+#endif
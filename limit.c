@@ -0,0 +1,248 @@
+#include "yar.h"
+
+// write a summary of cmd's suppressed output to the broadcast tty
+static void
+limitSummary(limit_t *this, cmd_t *cmd)
+{
+  char   line[256];
+  double v = cmd->lmt.pending;
+  char  *units;
+  int    len;
+
+  if (v >= 1e9)      { v /= 1e9; units = "GB"; }
+  else if (v >= 1e6) { v /= 1e6; units = "MB"; }
+  else if (v >= 1e3) { v /= 1e3; units = "KB"; }
+  else units = "bytes";
+  if (units[0] == 'b') {
+    len = snprintf(line, sizeof(line), "[%s: %lu bytes suppressed]\n",
+		   cmd->name, cmd->lmt.pending);
+  } else {
+    len = snprintf(line, sizeof(line), "[%s: %.1f %s suppressed]\n",
+		   cmd->name, v, units);
+  }
+  if (len >= sizeof(line)) len = sizeof(line) - 1;
+  fairqWrite(&GBLS.fairq, cmd, line, len, -1);
+  cmd->lmt.pending = 0;
+  this->summaries++;
+}
+
+// summarize the output suppressed since the last interval.  The timer is
+// rearmed as long as some command is still being suppressed
+static evnthdlrrc_t
+limitTmrEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  limit_t *this = obj;
+  cmd_t   *cmd, *tmp;
+  bool     pending = false;
+
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->lmt.pending) {
+      limitSummary(this, cmd);
+      pending = true;
+    }
+  }
+  if (pending) tmrArm(&(this->tmr), epollfd, LIMIT_INTERVAL, 0.0);
+  return EVNT_HDLR_SUCCESS;
+}
+
+static void
+limitCmdSet(limit_t *this, cmd_t *cmd, bool on, double rate, int burst)
+{
+  if (!on && cmd->lmt.pending) limitSummary(this, cmd);
+  cmd->lmt.on    = on;
+  cmd->lmt.chunk = 0;
+  if (on) bucketSet(&(cmd->lmt.bkt), rate, burst);
+}
+
+extern bool
+limitInit(limit_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(limit_t));
+  this->on    = false;
+  this->rate  = 0.0;
+  this->burst = 0;
+  return tmrInit(&(this->tmr), limitTmrEvent, this, iszeroed);
+}
+
+// spec is "off" or "<bytes/sec>[:<burst>]" (burst defaults to one second
+// of output).  Applies to cmd or, if cmd is NULL, to all commands that do
+// not have their own setting including those added later.  For a command
+// "off" sticks whatever the default and "default" returns it to the default
+extern bool
+limitSet(limit_t *this, cmd_t *cmd, char *spec, FILE *f)
+{
+  cmd_t *c, *tmp;
+  double rate  = 0.0;
+  int    burst = 0;
+  bool   on    = true;
+
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing limit spec\n");
+    return false;
+  }
+  if (cmd && strcmp(spec, "default") == 0) {
+    cmd->lmt.mode = LIMIT_DEFAULT;
+    limitCmdSet(this, cmd, this->on, this->rate, this->burst);
+    return true;
+  }
+  if (strcmp(spec, "off") == 0) {
+    on = false;
+  } else {
+    char *end;
+    errno = 0;
+    rate  = strtod(spec, &end);
+    if (errno != 0 || end == spec || rate <= 0.0 ||
+	(*end != '\0' && *end != ':')) {
+      EPRINT(f, "bad limit rate: %s\n", spec);
+      return false;
+    }
+    burst = (rate < INT_MAX) ? (int)rate : INT_MAX;
+    if (burst < 1) burst = 1;
+    if (*end == ':') {
+      char *bstr = end + 1;
+      errno = 0;
+      burst = strtol(bstr, &end, 10);
+      if (errno != 0 || end == bstr || *end != '\0' || burst < 1) {
+	EPRINT(f, "bad limit burst: %s\n", spec);
+	return false;
+      }
+    }
+  }
+  if (cmd) {
+    cmd->lmt.mode = (on) ? LIMIT_ON : LIMIT_OFF;
+    limitCmdSet(this, cmd, on, rate, burst);
+    return true;
+  }
+  this->on    = on;
+  this->rate  = rate;
+  this->burst = burst;
+  HASH_ITER(hh, GBLS.cmds, c, tmp) {
+    if (c->lmt.mode == LIMIT_DEFAULT) limitCmdSet(this, c, on, rate, burst);
+  }
+  return true;
+}
+
+// count len bytes of cmd's output as suppressed
+static void
+limitSuppress(limit_t *this, cmd_t *cmd, int len, int epollfd)
+{
+  cmdlimit_t *lmt = &(cmd->lmt);
+
+  if (lmt->pending == 0) {
+    lmt->episodes++;
+    VLPRINT(1, "%s: suppressing output to the broadcast tty\n", cmd->name);
+  }
+  lmt->pending    += len;
+  lmt->suppressed += len;
+  this->suppressed += len;
+  if (!tmrIsArmed(&(this->tmr)) && epollfd != -1) {
+    tmrArm(&(this->tmr), epollfd, LIMIT_INTERVAL, 0.0);
+  }
+}
+
+// may len bytes of cmd's output be written to the broadcast tty?  If not
+// they are counted to be summarized.  Once a command is being suppressed
+// its bucket must refill before its output is allowed again (so a flood
+// yields a summary per burst rather than per line).  A line longer than
+// the burst passes when the bucket is full (and goes into debt)
+extern bool
+limitPass(limit_t *this, cmd_t *cmd, int len, int epollfd)
+{
+  cmdlimit_t *lmt  = &(cmd->lmt);
+  int         need = (lmt->pending || len > lmt->bkt.burst) ?
+                     lmt->bkt.burst : len;
+
+  if (bucketAvail(&(lmt->bkt), need) == need) {
+    if (lmt->pending) limitSummary(this, cmd);
+    bucketUse(&(lmt->bkt), len);
+    return true;
+  }
+  limitSuppress(this, cmd, len, epollfd);
+  return false;
+}
+
+// limitPass for a single byte of unbuffered output.  Refilling the bucket
+// reads the clock so rather than refilling per byte the fate of a chunk of
+// up to LIMIT_CHUNK bytes is decided at once: as many as the bucket holds
+// when they pass, LIMIT_CHUNK when they are suppressed
+extern bool
+limitPassChar(limit_t *this, cmd_t *cmd, int epollfd)
+{
+  cmdlimit_t *lmt = &(cmd->lmt);
+
+  if (lmt->chunk > 0) {
+    lmt->chunk--;
+    if (lmt->chunkpass) {
+      bucketUse(&(lmt->bkt), 1);
+      return true;
+    }
+    limitSuppress(this, cmd, 1, epollfd);
+    return false;
+  }
+  lmt->chunkpass = limitPass(this, cmd, 1, epollfd);
+  if (lmt->chunkpass) {
+    lmt->chunk = (lmt->bkt.tokens < LIMIT_CHUNK) ? (int)lmt->bkt.tokens :
+                 LIMIT_CHUNK;
+    if (lmt->chunk < 0) lmt->chunk = 0;
+  } else {
+    lmt->chunk = LIMIT_CHUNK - 1;
+  }
+  return lmt->chunkpass;
+}
+
+extern void
+limitAddCmd(limit_t *this, cmd_t *cmd)
+{
+  bucketInit(&(cmd->lmt.bkt), this->rate, this->burst, true);
+  cmd->lmt.on   = this->on;
+  cmd->lmt.mode = LIMIT_DEFAULT;
+}
+
+// must be called before cmd is cleaned up
+extern void
+limitForgetCmd(limit_t *this, cmd_t *cmd)
+{
+  if (cmd->lmt.pending) limitSummary(this, cmd);
+}
+
+// human readable report of the output limit of each command
+extern void
+limitReport(limit_t *this, FILE *f)
+{
+  cmd_t *cmd, *tmp;
+  if (this->on) {
+    fprintf(f, "limit: default rate:%.0f burst:%d suppressed:%lu "
+	    "summaries:%lu\n", this->rate, this->burst, this->suppressed,
+	    this->summaries);
+  } else {
+    fprintf(f, "limit: default off suppressed:%lu summaries:%lu\n",
+	    this->suppressed, this->summaries);
+  }
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    cmdlimit_t *lmt = &(cmd->lmt);
+    if (!lmt->on) {
+      fprintf(f, "  %s%s off suppressed:%lu\n", cmd->name,
+	      (lmt->mode == LIMIT_OFF) ? "*" : "", lmt->suppressed);
+      continue;
+    }
+    fprintf(f, "  %s%s rate:%.0f burst:%d passed:%lu suppressed:%lu "
+	    "episodes:%lu%s\n", cmd->name, (lmt->mode == LIMIT_ON) ? "*" : "",
+	    lmt->bkt.rate, lmt->bkt.burst, lmt->bkt.bytes, lmt->suppressed,
+	    lmt->episodes, (lmt->pending) ? " SUPPRESSING" : "");
+  }
+}
+
+extern void
+limitCleanup(limit_t *this)
+{
+  tmrCleanup(&(this->tmr));
+}
+
+extern void
+limitDump(limit_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%slimit: this=%p on=%d rate=%f burst=%d suppressed=%lu "
+	  "summaries=%lu\n", prefix, this, this->on, this->rate, this->burst,
+	  this->suppressed, this->summaries);
+  tmrDump(&(this->tmr), f, prefix);
+}
@@ -0,0 +1,55 @@
+#ifndef __YAR_LIMIT_H__
+#define __YAR_LIMIT_H__
+
+struct cmd;
+
+#define LIMIT_INTERVAL 1.0   // seconds between summaries of suppressed output
+#define LIMIT_CHUNK    256   // max unbuffered bytes decided per bucket refill
+
+// how a command's limit is set
+typedef enum {
+  LIMIT_DEFAULT=0,     // follows the default limit (-O or limit * ...)
+  LIMIT_ON=1,          // has its own rate and burst
+  LIMIT_OFF=2          // not limited whatever the default
+} limitmode_t;
+
+// per command output limit state (embedded in each cmd_t)
+typedef struct {
+  bucket_t bkt;              // output allowed onto the broadcast tty
+  uint64_t suppressed;       // total bytes suppressed
+  uint64_t pending;          // bytes suppressed since the last summary
+  uint64_t episodes;         // times the command started being suppressed
+  limitmode_t mode;          // own limit, own off or the default
+  int      chunk;            // unbuffered bytes left whose fate is decided
+  bool     chunkpass;        // ... and whether they pass
+  bool     on;
+} cmdlimit_t;
+
+// Limit Object
+//   Protects the broadcast tty from commands that flood it (eg. a node
+//   stuck printing a stack trace in a loop).  Output of each command that
+//   goes to the broadcast tty passes through a token bucket (see bucket.h).
+//   Output beyond the rate and burst is counted rather than written (whole
+//   lines when line buffering) and every LIMIT_INTERVAL, and when the
+//   command's output is allowed again, a summary line such as
+//   "[node17: 12.3 MB suppressed]" is written in its place.  The command's
+//   own client tty still gets all of its output.
+typedef struct {
+  tmr_t    tmr;              // summary timer (armed while suppressing)
+  uint64_t suppressed;       // total bytes suppressed
+  uint64_t summaries;        // summary lines written
+  double   rate;             // default bytes/sec
+  int      burst;            // default burst (bytes)
+  bool     on;               // limit commands without their own limit
+} limit_t;
+
+extern bool limitInit(limit_t *this, bool iszeroed);
+extern bool limitSet(limit_t *this, struct cmd *cmd, char *spec, FILE *f);
+extern bool limitPass(limit_t *this, struct cmd *cmd, int len, int epollfd);
+extern bool limitPassChar(limit_t *this, struct cmd *cmd, int epollfd);
+extern void limitAddCmd(limit_t *this, struct cmd *cmd);
+extern void limitForgetCmd(limit_t *this, struct cmd *cmd);
+extern void limitReport(limit_t *this, FILE *f);
+extern void limitCleanup(limit_t *this);
+extern void limitDump(limit_t *this, FILE *f, char *prefix);
+#endif
@@ -0,0 +1,171 @@
+#include "yar.h"
+
+static double
+lingerSecs(linger_t *this, cmd_t *cmd)
+{
+  return (cmd->lngr.own) ? cmd->lngr.secs : this->secs;
+}
+
+// arm the timer for the earliest deadline of the lingering commands
+static void
+lingerArm(linger_t *this, struct timespec *now, int epollfd)
+{
+  cmd_t *cmd, *tmp;
+  double wait = -1.0;
+
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (!cmd->lngr.pending) continue;
+    double left = lingerSecs(this, cmd) - tsDiff(now, &(cmd->lngr.idlets));
+    if (wait < 0.0 || left < wait) wait = left;
+  }
+  if (wait < 0.0) tmrDisarm(&(this->tmr));
+  else tmrArm(&(this->tmr), epollfd, wait, 0.0);
+}
+
+// stop the lingering commands whose linger period is over.  A command that
+// is no longer idle is left running (cmdStop checks)
+static evnthdlrrc_t
+lingerTmrEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  linger_t *this = obj;
+  struct timespec now;
+  cmd_t *cmd, *tmp;
+
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (!cmd->lngr.pending ||
+	tsDiff(&now, &(cmd->lngr.idlets)) < lingerSecs(this, cmd)) continue;
+    cmd->lngr.pending = false;
+    cmd->lngr.expired = true;
+    if (cmdStop(cmd, epollfd, false)) {
+      VPRINT("%s: stopped after lingering %f\n", cmd->name,
+	     lingerSecs(this, cmd));
+      this->stops++;
+    } else if (cmdIsRunning(cmd)) {
+      this->kept++;
+    }
+    cmd->lngr.expired = false;
+  }
+  lingerArm(this, &now, epollfd);
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+lingerInit(linger_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(linger_t));
+  this->secs  = 0.0;
+  this->stops = 0;
+  this->kept  = 0;
+  return tmrInit(&(this->tmr), lingerTmrEvent, this, iszeroed);
+}
+
+// spec is the linger period in seconds ("off" or 0 to stop idle commands
+// at once).  Applies to cmd or, if cmd is NULL, to all commands that do
+// not have their own period including those added later
+extern bool
+lingerSet(linger_t *this, cmd_t *cmd, char *spec, FILE *f)
+{
+  struct timespec now;
+  double secs = 0.0;
+  char  *end;
+
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing linger period\n");
+    return false;
+  }
+  if (strcmp(spec, "off") != 0) {
+    errno = 0;
+    secs  = strtod(spec, &end);
+    if (errno != 0 || end == spec || *end != '\0' || secs < 0.0) {
+      EPRINT(f, "bad linger period: %s\n", spec);
+      return false;
+    }
+  }
+  if (cmd == NULL) {
+    this->secs = secs;
+  } else {
+    cmd->lngr.secs = secs;
+    cmd->lngr.own  = true;
+  }
+  // rearm for the new earliest deadline, lingering commands whose new
+  // period is already over are stopped on the next tick.  The timer is
+  // registered already if any command is lingering
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  lingerArm(this, &now, -1);
+  return true;
+}
+
+// cmd is idle and would be stopped: returns true if it should linger
+// instead.  Called every time the command is found idle, the linger period
+// counts from the last of these
+extern bool
+lingerHold(linger_t *this, cmd_t *cmd, int epollfd)
+{
+  struct timespec now;
+
+  if (cmd->lngr.expired || lingerSecs(this, cmd) <= 0.0 || epollfd == -1) {
+    return false;
+  }
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  cmd->lngr.idlets = now;
+  if (!cmd->lngr.pending) {
+    VLPRINT(1, "%s: idle lingering for %f\n", cmd->name,
+	    lingerSecs(this, cmd));
+    cmd->lngr.pending = true;
+    cmd->lngr.lingers++;
+    // this command may have a shorter period than those already lingering
+    lingerArm(this, &now, epollfd);
+  }
+  return true;
+}
+
+extern void
+lingerReport(linger_t *this, FILE *f)
+{
+  struct timespec now;
+  cmd_t *cmd, *tmp;
+
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  fprintf(f, "linger: default:%.3f stops:%lu kept:%lu\n", this->secs,
+	  this->stops, this->kept);
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (!cmd->lngr.own && !cmd->lngr.pending && cmd->lngr.lingers == 0) {
+      continue;
+    }
+    fprintf(f, "  %s linger:%.3f%s lingers:%lu", cmd->name,
+	    lingerSecs(this, cmd), (cmd->lngr.own) ? "" : "(default)",
+	    cmd->lngr.lingers);
+    if (cmd->lngr.pending) {
+      fprintf(f, " stopping in:%.3f", lingerSecs(this, cmd) -
+	      tsDiff(&now, &(cmd->lngr.idlets)));
+    }
+    fprintf(f, "\n");
+  }
+}
+
+extern void
+lingerCleanup(linger_t *this)
+{
+  tmrCleanup(&(this->tmr));
+}
+
+extern void
+lingerDump(linger_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%slinger: this=%p secs=%f stops=%lu kept=%lu\n", prefix, this,
+	  this->secs, this->stops, this->kept);
+  tmrDump(&(this->tmr), f, prefix);
+}
@@ -0,0 +1,39 @@
+#ifndef __YAR_LINGER_H__
+#define __YAR_LINGER_H__
+
+struct cmd;
+
+// per command linger state (embedded in each cmd_t)
+typedef struct {
+  struct timespec idlets;    // last time the command was found idle
+  uint64_t        lingers;   // times the command lingered once idle
+  double          secs;      // linger period (if own)
+  bool            own;       // period set for this command (not the default)
+  bool            pending;   // lingering: idle and waiting to be stopped
+  bool            expired;   // linger period is over: stop it
+} cmdlinger_t;
+
+// Linger Object
+//   Keeps an idle command running for a while rather than stopping it as
+//   soon as its client tty and the broadcast tty are closed, so that
+//   scripts that open and close the ttys in a loop (eg. 'echo cmd >
+//   ./wrks; cat ./wrks') do not tear down and respawn every command (eg.
+//   an ssh session) each time round.  An idle command is stopped linger
+//   seconds after the last time it was found idle.  A single timer, armed
+//   for the earliest such deadline, stops the commands that are still idle
+//   when their period is over.  A command that was used again in the mean
+//   time is not stopped.
+typedef struct {
+  tmr_t    tmr;              // expires the earliest deadline
+  uint64_t stops;            // commands stopped after lingering
+  uint64_t kept;             // lingering commands that were used again
+  double   secs;             // default linger period (0 stop at once)
+} linger_t;
+
+extern bool lingerInit(linger_t *this, bool iszeroed);
+extern bool lingerSet(linger_t *this, struct cmd *cmd, char *spec, FILE *f);
+extern bool lingerHold(linger_t *this, struct cmd *cmd, int epollfd);
+extern void lingerReport(linger_t *this, FILE *f);
+extern void lingerCleanup(linger_t *this);
+extern void lingerDump(linger_t *this, FILE *f, char *prefix);
+#endif
@@ -18,6 +18,24 @@ static int monDrain(int, int);
 static int monIdleExit(int, int);
 static int monDel(int, int);
 static int monList(int, int);
+static int monScatter(int, int);
+static int monWorkq(int, int);
+static int monGather(int, int);
+static int monCoalesce(int, int);
+static int monReduce(int, int);
+static int monMerge(int, int);
+static int monWatch(int, int);
+static int monReady(int, int);
+static int monJournal(int, int);
+static int monWave(int, int);
+static int monPace(int, int);
+static int monLimit(int, int);
+static int monFair(int, int);
+static int monRelay(int, int);
+static int monStandby(int, int);
+static int monLinger(int, int);
+static int monWatchdog(int, int);
+static int monPing(int, int);
 static int monToggleSilent(int, int) {
   GBLS.mon.silent = !GBLS.mon.silent;
   if (GBLS.mon.silent) { monprintf("monitor silent: true\n"); }
@@ -104,6 +122,98 @@ struct MonCmdDesc {
    .cmd = monVerboseDec },
   {.name = "silent", .usage="unsilence/silence monitor output",
    .cmd = monToggleSilent },
+  {.name = "scatter", .usage="[off|rr|hash[:<field>]] set or display how\n"
+                             "\t\tbroadcast input lines are dispatched. See -S",
+   .cmd = monScatter },
+  {.name = "workq", .usage="[marker <string>|depth <n>] display work queue\n"
+                           "\t\tstatistics or set its completion marker or\n"
+                           "\t\tmaximum depth. See -S queue",
+   .cmd = monWorkq },
+  {.name = "gather", .usage="[<marker> [<timeout> [<cmd>...]]|cancel] start\n"
+                            "\t\ta barrier: wait for all (or the listed)\n"
+                            "\t\tcommands to output marker.  Timeout is in\n"
+                            "\t\tseconds (0 no timeout).  Without arguments\n"
+                            "\t\tdisplays the state of the current or last\n"
+                            "\t\tgather: stragglers and per command latency",
+   .cmd = monGather },
+  {.name = "coalesce", .usage="[off|flush|<timeout>[:<flags>]] display or\n"
+                              "\t\tset coalescing of broadcast output. See -c",
+   .cmd = monCoalesce },
+  {.name = "reduce", .usage="[off|flush|<timeout>:<field>] display or set\n"
+                            "\t\tnumeric reduction of broadcast output. See -a",
+   .cmd = monReduce },
+  {.name = "merge", .usage="[off|flush|<window>] display or set timestamp\n"
+                           "\t\tordered merging of broadcast output. See -o",
+   .cmd = monMerge },
+  {.name = "watch", .usage="[add <pattern>|del <pattern>|clear] display\n"
+                           "\t\tpattern match counts and last matching\n"
+                           "\t\tline per command or change the patterns\n"
+                           "\t\twatched for. See -w",
+   .cmd = monWatch },
+  {.name = "ready", .usage="[<cmd>|* <string>|/<regex>/|clear]|\n"
+                           "\t\t[hold <bytes>[:<timeout>]] display the ready\n"
+                           "\t\tstate, time to ready and held input of each\n"
+                           "\t\tcommand (slowest first) or add to (or clear)\n"
+                           "\t\tthe ready spec of a command or of all\n"
+                           "\t\tcommands without their own (*) or set how\n"
+                           "\t\tinput is held. See -R and -H",
+   .cmd = monReady },
+  {.name = "journal", .usage="[on[:<bytes>]|checkpoint|freeze|off] display\n"
+                             "\t\tor control the journal of broadcast input\n"
+                             "\t\treplayed to restarted commands. See -J",
+   .cmd = monJournal },
+  {.name = "wave", .usage="[off|<canary>:<k>:<delay>[:<marker>]|resume|abort]\n"
+                          "\t\tdisplay or set staged delivery of broadcast\n"
+                          "\t\tinput, or resume (with half the wave size) or\n"
+                          "\t\tabandon a halted rollout. See -g",
+   .cmd = monWave },
+  {.name = "pace", .usage="[<cmd>|* off|aimd[:<min>[:<max>[:<inc>[:<lag>]]]]|\n"
+                          "\t\t<delay>|<bytes>/s[:<burst>]]\n"
+                          "\t\tdisplay the pacing (current rate) of each\n"
+                          "\t\tcommand or set adaptive pacing, or a fixed\n"
+                          "\t\tdelay or rate and burst, of a command\n"
+                          "\t\tor all commands (*). See -P and -d",
+   .cmd = monPace },
+  {.name = "limit", .usage="[<cmd>|* <bytes/sec>[:<burst>]|off|default]\n"
+                           "\t\tdisplay the output limit of each command\n"
+                           "\t\tor set the limit of a command or the\n"
+                           "\t\tdefault for all commands (*).  A command\n"
+                           "\t\tset to default follows the default again.\n"
+                           "\t\tSee -O",
+   .cmd = monLimit },
+  {.name = "fair", .usage="[<cmd>|* <weight>]\n"
+                          "\t\tdisplay the queueing of command output for\n"
+                          "\t\tthe broadcast tty or set the weight (share\n"
+                          "\t\tof the broadcast tty when it is full) of a\n"
+                          "\t\tcommand or all commands (*)",
+   .cmd = monFair },
+  {.name = "relay", .usage="[<cmd>[/<node>...] <string>]\n"
+                           "\t\tdisplay the nodes of the child yars (see\n"
+                           "\t\tRelays) or write string and a newline to a\n"
+                           "\t\tcommand or to a node of a child yar",
+   .cmd = monRelay },
+  {.name = "standby", .usage="[<cmd>|* <n>]\n"
+                             "\t\tdisplay the standby instances of each\n"
+                             "\t\tcommand or set the number of standbys\n"
+                             "\t\tof a command or all commands (*)",
+   .cmd = monStandby },
+  {.name = "linger", .usage="[<cmd>|* <sec>|off]\n"
+                            "\t\tdisplay the idle commands lingering\n"
+                            "\t\tbefore being stopped or set the linger\n"
+                            "\t\tperiod of a command or the default for\n"
+                            "\t\tall commands (*). See -I",
+   .cmd = monLinger },
+  {.name = "watchdog", .usage="[<cmd>|* <spec>]\n"
+                              "\t\tdisplay the hung commands found or set\n"
+                              "\t\tthe liveness check of a command or the\n"
+                              "\t\tdefault for all commands (*). See -G",
+   .cmd = monWatchdog },
+  {.name = "ping", .usage="[<sec>[:<timeout>]|off|<cmd> on|off]\n"
+                          "\t\tdisplay the round trip times of the\n"
+                          "\t\tcommands, slowest first, set how often\n"
+                          "\t\tidle commands are probed or whether a\n"
+                          "\t\tcommand is probed at all. See -Q",
+   .cmd = monPing },
   {.name = NULL,   .cmd=NULL }            // mark end of command array
 };
 
@@ -169,13 +279,21 @@ usage(char *name, FILE *fp)
   "To specify you must use a 'yar' command specification. The syntax is\n"
   "as follows:\n\n"
 	  
-  "    <name>,[pty link name],[log],[delay],<command line>\n\n"
+  "    <name>[+<standbys>],[pty link name],[log],[delay],<command line>\n\n"
 	  
   " <name>: is a required unique name you must provide to identify this\n"
   " command line instance.  Eg. \n"
   "           'csa2,,,,ssh csa2.bu.edu'\n"
   " would associate the name 'csa2'  with an instance of the command\n"
   " 'ssh csa2.bu.edu'.\n\n"
+
+  " [+<standbys>]: keep up to %d extra instances of the command line\n"
+  " running (and, with a ready spec see -R, ready) on ptys of their own.\n"
+  " When the command exits a standby takes its place at once, keeping\n"
+  " its pty and broadcast membership, rather than it being restarted\n"
+  " from scratch.  A replacement standby is then started in the\n"
+  " background.  Eg. 'csa2+1,,,,ssh csa2.bu.edu'.  See the standby\n"
+  " monitor command.\n\n"
 	  
   " [pty link name]: 'yar' will create a pty (see man pty) for the\n"
   " input and output of each command line instance. Additionally, 'yar'\n"
@@ -212,6 +330,10 @@ usage(char *name, FILE *fp)
   " via its pty then a delay of .01 seconds will be added between\n"
   " reading each character.  This in turn will force the data written\n"
   " to the command to be written at a rate that reflects this delay.\n"
+  " Alternatively the pacing can be given as a rate and burst:\n"
+  " '<bytes>/s[:<burst>]' eg. '960/s:64' lets 64 bytes go at once while\n"
+  " keeping to 960 bytes a second on average (the burst defaults to %d).\n"
+  " A delay is the same as a rate of 1/delay with a burst of 1.\n"
   " See the global -d option for the default behavour if the value this\n"
   " value is omitted from a command specification\n\n"
 
@@ -241,11 +363,46 @@ usage(char *name, FILE *fp)
   "         1.  yar -l -p 'bu1,,,,ssh bu' 'bu2,,,,ssh bu'\n"
   "         2.  yar -l -p 'bu1,,,,ssh csa1.bu.edu' "
   "'bu2,,,,ssh csa2.bu.edu'\n\n"
+
+  "Relays: a command line starting with '@' runs a child 'yar' whose\n"
+  " arguments are the rest of the command line.  This lets yars form a\n"
+  " tree so that no single yar has to write to the ptys of a very large\n"
+  " set of nodes.  Eg.\n"
+  "   yar -l -p 'rack1,,,,@ \"n1,,,,ssh n1\" \"n2,,,,ssh n2\"' \\\n"
+  "             'rack2,,,,@ \"n3,,,,ssh n3\" \"n4,,,,ssh n4\"'\n"
+  " Broadcast input reaches every node, the output of the nodes is\n"
+  " relayed a line at a time and is written to the broadcast tty as\n"
+  " that of 'rack1/n1' etc.  The relay command's own pty reaches all of\n"
+  " its nodes.  Use the 'relay' monitor command to list the nodes (and\n"
+  " their ready state and stats) or to write to a single node.\n\n"
 	  
   "Global Options:\n"
   " -h print this usage message\n"
+  " -A <path> create an alert tty at path.  A line is written to it for\n"
+  "    every line of command output that matches a watch pattern (see -w)\n"
+  "    in the form '<name>: [<pattern>] <line>'.\n"
+  " -a <timeout>:<field> reduce the output written to the broadcast tty.\n"
+  "    A number is extracted from each line output by the commands and\n"
+  "    only a summary line is written at the end of a round:\n"
+  "      'reduce: n= sum= min= max= mean= p50= p90= p99='\n"
+  "    <field> is either a column number (whitespace separated, from 1)\n"
+  "    or /<regex>/ in which case the number is taken from the start of\n"
+  "    what the regex (or its first parenthesized subexpression) matches.\n"
+  "    Lines without a number pass through.  A round ends <timeout>\n"
+  "    seconds (0 never) after its first value, when a gather completes or\n"
+  "    via the reduce monitor command.  Eg. -a 2:1 with 'cat /proc/loadavg'\n"
+  "    or -a 2:'/([0-9]+)%%/' with 'df --output=pcent /'.  Requires -l.\n"
   " -b <path> path name for broadcast tty link (default %s)\n"
-  " -d <delay sec> default value to pace all tty reads and there by\n"
+  " -c <timeout>[:<flags>] coalesce (dshbak style) output written to the\n"
+  "    broadcast tty.  Identical lines from all commands are held and\n"
+  "    written once as 'N commands: <line>' at the end of a round.  A round\n"
+  "    ends <timeout> seconds (0 never) after its first line, when a gather\n"
+  "    completes or via the coalesce monitor command.  flags normalize\n"
+  "    lines before they are compared: 'd' runs of digits compare equal\n"
+  "    (shown as '#'), 'p' ignore everything up to the first ': '.\n"
+  "    Requires -l.\n"
+  " -d <delay sec>|<bytes>/s[:<burst>] default value to pace all tty\n"
+  "    reads (see [delay] above) and there by\n"
   "    trottle the rate at which data is written to commands.\n"
   "    For example, if you passed \"-d 1.25\", then by default bytes\n"
   "    will not be read faster than 1.25 seconds even if they are\n"
@@ -260,16 +417,100 @@ usage(char *name, FILE *fp)
   " -f directory that the yar control synthetic filesystem mount point will be\n"
   "    created in.  The mount point name will be the pid of the yar instance\n"
   "    suffixed with .fs"
+  " -g <canary>:<k>:<delay>[:<marker>] staged (wave) delivery of input\n"
+  "    written to the broadcast tty.  Each line is sent to <canary>\n"
+  "    commands first and then to waves of <k> commands.  A wave ends\n"
+  "    after <delay> seconds or, if <marker> is given, once every command\n"
+  "    in it has printed the marker.  If the marker is not seen within\n"
+  "    <delay> (0 wait forever) the rollout halts (see the wave monitor\n"
+  "    command).  With a marker the wave size doubles when a wave takes\n"
+  "    less than half of <delay> and halves when it takes more than 3/4.\n"
+  "    Lines are rolled out one at a time.  Eg. -g 1:4:60:@OK@ with\n"
+  "    'yum -y update && echo @O\"\"K@'.\n"
   " -l enable line buffering of output from commands when written to \n"
   "    the broadcast tty (note even if -l is specified data from a commnd\n"
   "    will NOT be line buffered to the command's pty rather only data\n"
   "    written to the broadcast tty will be line buffered.\n"
   " -m <diretory path> the directory in which the monitor tty link will\n"
   "    be created in.  The link's name is process id (pid) of yar '.mon'.\n"
+  " -o <window sec> merge the output written to the broadcast tty in\n"
+  "    timestamp order.  Each line is stamped with the time its first byte\n"
+  "    was read and held for <window> seconds (eg. 0.05) so that lines from\n"
+  "    different commands are written in the order they were produced\n"
+  "    rather than the order they were completed.  Requires -l.\n"
   " -p enable prefixing the output from commands written to the\n"
   "    broadcast tty with the specified name for the command.\n"
+  " -O <bytes/sec>[:<burst>] limit the output of each command written to\n"
+  "    the broadcast tty (burst defaults to one second's worth).  Output\n"
+  "    over the limit (whole lines with -l) is not written, instead a\n"
+  "    summary such as '[node17: 12.3 MB suppressed]' is written every\n"
+  "    second and when the command's output is allowed again.  Each\n"
+  "    command's client tty still gets all of its output.  Limits of\n"
+  "    individual commands can be set with the limit monitor command.\n"
+  " -P aimd[:<min>[:<max>[:<inc>[:<lag>]]]] adaptive pacing of input to\n"
+  "    commands that echo it (eg. serial consoles).  Each command's rate\n"
+  "    (bytes/sec, between <min> and <max>, default %.0f and %.0f) rises by\n"
+  "    <inc> (default %.0f) for every byte echoed within <lag> seconds\n"
+  "    (default %.1f) and halves when an echo is lost or late.  The rate\n"
+  "    replaces the command's delay (starting from it if one is set).\n"
+  "    See the pace monitor command.\n"
+  " -Q <sec>[:<timeout>] measure the round trip time of each command:\n"
+  "    every <sec> seconds that a ready command has been idle (no input or\n"
+  "    output) it is sent ' echo @YAR\"\"PING:<seq>@' and the time until\n"
+  "    @YARPING:<seq>@ comes back is recorded.  The probes, their answers\n"
+  "    and the prompt written after the answer are stripped from the\n"
+  "    output.  A probe not answered within <timeout> seconds (default\n"
+  "    %.1f) is counted as lost.  Meant for commands that run a shell\n"
+  "    (eg. ssh): the probes are added to the shell's history unless it\n"
+  "    ignores lines starting with a space (eg. bash's\n"
+  "    HISTCONTROL=ignorespace).  Every command is probed, others can be\n"
+  "    left out with 'ping <cmd> off'.  The min/avg/p99 round trip time\n"
+  "    is shown by 'list -l'.  See the ping monitor command.\n"
+  " -R <string>|/<regex>/ ready spec: a command is not sent input (from\n"
+  "    its tty or the broadcast tty) after it starts until its output\n"
+  "    contains <string> (or the current line matches <regex>).  Until\n"
+  "    then broadcast input for it is held (see -H).  Can be\n"
+  "    specified multiple times (up to %d strings): any string matching\n"
+  "    makes the command ready.  Eg. -R '$ ' -R '# '.  Each command's time\n"
+  "    to ready is recorded, see the ready monitor command.\n"
   " -s <string> this sting will be sent to the command line when\n"
   "    stopping it.  If specified a newline will always be prepended.\n"
+  " -S <mode> scatter rather than broadcast data written to the broadcast\n"
+  "    tty.  Each line written is sent to exactly one command rather than\n"
+  "    all of them.  Output from the commands is still gathered on the\n"
+  "    broadcast tty. <mode> is one of:\n"
+  "      'rr'           lines are sent to the commands in round robin order\n"
+  "      'hash[:<n>]'   lines are routed by a hash of their n'th\n"
+  "                     whitespace separated field (the whole line if n is\n"
+  "                     omitted or 0).  Lines with the same key always go\n"
+  "                     to the same command (sticky routing).\n"
+  "      'queue[:<k>]'  lines are queued and a line is only sent to a\n"
+  "                     command when it has fewer than k (default %d)\n"
+  "                     lines outstanding.  A command signals that it has\n"
+  "                     finished a line by printing the completion marker\n"
+  "                     (see -W).  Lines outstanding on a command that\n"
+  "                     dies are requeued.  Use the 'workq' monitor command\n"
+  "                     to see queue depth and per command throughput and\n"
+  "                     latency.\n"
+  "      'off'          normal broadcast (default)\n"
+  " -T <n> use a pool of n (at most %d) writer threads to write\n"
+  "    broadcast input to the commands in parallel.  Only used when at\n"
+  "    least %d commands are ready.  Each chunk is completely written\n"
+  "    before more broadcast input is read.\n"
+  " -U use io_uring to write broadcast input to all the commands with a\n"
+  "    single system call per chunk rather than one write per command.\n"
+  "    Reads of command output are not affected.  Falls back to plain\n"
+  "    writes if io_uring is not available.\n"
+  " -Y <path> run as the child of another yar (see Relays above): this is\n"
+  "    done by the parent, not by hand.  Input comes from and output goes\n"
+  "    to the parent over stdin and stdout rather than a broadcast tty.\n"
+  " -W <string> work queue completion marker (see -S queue). Eg.\n"
+  "    -W @DONE@ with lines like 'gzip $f; echo @DO\"\"NE@' (the quotes\n"
+  "    stop an echo of the line itself from matching the marker).\n"
+  " -w <pattern> watch the output of all commands for pattern (a plain\n"
+  "    string).  Can be specified multiple times.  All patterns are matched\n"
+  "    in a single pass over the output.  See -A and the watch monitor\n"
+  "    command.\n"
   " -v increase debug message verbosity.  This option can be used\n"
   "    multiple times to the verbosity Eg. -v versus -vv etc.\n"
   " -x exit if there are no commands left (eg. all commands get deleted).\n"
@@ -279,6 +520,30 @@ usage(char *name, FILE *fp)
   " -D run in Daemon mode (disconnect from tty and send stdout and stderr to\n"
   "    a log file (unless -L is specified the log file will be placed in the\n"
   "    current working directory).  See -L and -K.\n"
+  " -G <spec> watchdog: kill commands that are running but hung so they\n"
+  "    are restarted (or a standby takes over, see name+<n>).  <spec> is\n"
+  "    off, idle:<sec> (hung if there is no output for <sec> seconds) or\n"
+  "    probe:<every>:<timeout>:<string>[:<pattern>] (every <every> seconds\n"
+  "    write <string> and a newline to a ready command, it is hung if\n"
+  "    <pattern>, default <string>, is not in its output within <timeout>\n"
+  "    seconds).  A hung command is sent SIGTERM and SIGKILL if it has not\n"
+  "    exited a couple of seconds later.  See the watchdog monitor command.\n"
+  " -H <bytes>[:<timeout>] broadcast input for a command that is not\n"
+  "    ready (see -R) is held, up to <bytes> (default %d) and for at most\n"
+  "    <timeout> seconds (default forever), and written to it when it\n"
+  "    becomes ready.  Commands that are ready get input immediately.\n"
+  " -I <sec> linger: keep a command running for <sec> seconds after it\n"
+  "    becomes idle (its pty and the broadcast pty are closed) rather than\n"
+  "    stopping it at once.  It is only stopped if it is still idle then.\n"
+  "    Saves respawning eg. ssh sessions when a script opens and closes\n"
+  "    the ptys in a loop.  See the linger monitor command.\n"
+  " -J on[:<bytes>] journal the input written to the broadcast tty (in a\n"
+  "    ring of <bytes>, default %d, oldest lines are discarded when full).\n"
+  "    When a command restarts the journal is replayed to it once it is\n"
+  "    ready (see -R) so it catches up with eg. cd and export commands that\n"
+  "    were broadcast.  Use the journal monitor command to checkpoint\n"
+  "    (discard what has been recorded so far) or freeze it (stop\n"
+  "    recording so what is recorded becomes a fixed session preamble).\n"
   " -K do not delete the log file on exit rather keep it -- useful for \n"
   "    debugging\n"
   " -L <directory path> if specified all debugging and error messages will be\n"
@@ -292,8 +557,11 @@ usage(char *name, FILE *fp)
   "use the '-f <dir>' option to explicitly set the location.  In this\n"
   "in this directory you will find files that let you interact with the 'yar'\n"
 	  "process.  The folling documents these files.\n",
-	  	  name, DEFAULT_BCSTTTY_LINK,
-	  GBLS.defaultcmddelay, GBLS.restartcmddelay, GBLS.errrestartcmddelay);
+	  	  name, STANDBY_MAX, PACE_DEFAULT_BURST, DEFAULT_BCSTTTY_LINK,
+	  GBLS.defaultcmddelay, GBLS.restartcmddelay, GBLS.errrestartcmddelay,
+	  PACE_DEFAULT_MIN, PACE_DEFAULT_MAX, PACE_DEFAULT_INC, PACE_DEFAULT_LAG,
+	  PING_DEFAULT_TIMEOUT, READY_MAXSTRS, WORKQ_DEFAULT_INFLIGHT, WPOOL_MAXTHREADS,
+	  WPOOL_MINCMDS, READY_DEFAULT_HOLDMAX, JOURNAL_DEFAULT_SIZE);
   yarfsUsage(fp);
 	  
   fprintf(fp, 
@@ -317,16 +585,35 @@ GBLSDump(FILE *f)
   fprintf(f, "GBLS.pid=%" PRIdMAX "\n", (intmax_t)GBLS.pid);
   fprintf(f, "GBLS.verbose=%d\n", GBLS.verbose);
   fprintf(f, "GBLS.logpath=%s GBLS.logfile=%p\n", GBLS.logpath, GBLS.logfile);
-  fprintf(f, "GBLS.readystr=%s GBLS.readystrlen=%d GBLS.cmdsreadycnt=%d\n", GBLS.readystr,
-	  GBLS.readystrlen, GBLS.cmdsreadycnt);
+  readyDump(&(GBLS.ready), f, "GBLS.");
+  inqDump(&(GBLS.inq), f, "GBLS.");
+  journalDump(&(GBLS.journal), f, "GBLS.");
+  waveDump(&(GBLS.wave), f, "GBLS.");
+  paceDump(&(GBLS.pace), f, "GBLS.");
+  limitDump(&(GBLS.limit), f, "GBLS.");
+  fairqDump(&(GBLS.fairq), f, "GBLS.");
+  uringDump(&(GBLS.uring), f, "GBLS.");
+  wpoolDump(&(GBLS.wpool), f, "GBLS.");
+  fprintf(f, "GBLS.fanout: n=%d cap=%d\n", GBLS.fanout.n, GBLS.fanout.cap);
+  relayDump(&(GBLS.relay), f, "GBLS.");
+  standbyDump(&(GBLS.standby), f, "GBLS.");
+  lingerDump(&(GBLS.linger), f, "GBLS.");
+  watchdogDump(&(GBLS.watchdog), f, "GBLS.");
+  pingDump(&(GBLS.ping), f, "GBLS.");
+  statsDump(&(GBLS.stats), f, "GBLS.");
   fprintf(f, "GBLS.stopstr=%s\n", GBLS.stopstr);
+  fprintf(f, "GBLS.loop: head=%p tail=%p waits=%lu events=%lu "
+	  "dispatches=%lu deferrals=%lu\n", GBLS.loop.head, GBLS.loop.tail,
+	  GBLS.loop.waits, GBLS.loop.events, GBLS.loop.dispatches,
+	  GBLS.loop.deferrals);
   fprintf(f, "GBLS.defaultcmddelay=%f\n", GBLS.defaultcmddelay);
+  fprintf(f, "GBLS.defaultcmdburst=%d\n", GBLS.defaultcmdburst);
   fprintf(f, "GBLS.restartcmddelay=%f\n", GBLS.restartcmddelay);
   fprintf(f, "GBLS.errrestartcmddelay=%f\n", GBLS.errrestartcmddelay);
   fprintf(f, "GBLS: restart=%d linebufferbst:%d prefixbcst:%d bcstflg:%d "
-	  "exitonidle:%d cmddelonexit:%d keeplog:%d\n",
+	  "bcstpaused:0x%x exitonidle:%d cmddelonexit:%d keeplog:%d\n",
 	  GBLS.restart, GBLS.linebufferbcst, GBLS.prefixbcst, GBLS.bcstflg,
-	  GBLS.exitonidle, GBLS.cmddelonexit, GBLS.keeplog);
+	  GBLS.bcstpaused, GBLS.exitonidle, GBLS.cmddelonexit, GBLS.keeplog);
   ttyDump(&GBLS.bcsttty, stderr, "GBLS.bcsttty: ");
   fprintf(f, "GBLS.cmds:");
   {
@@ -335,9 +622,19 @@ GBLSDump(FILE *f)
 	cmdDump(cmd, stderr, "\n  ");
       }
   }
+  scatterDump(&GBLS.scatter, f, "GBLS.");
+  workqDump(&GBLS.workq, f, "GBLS.");
+  gatherDump(&GBLS.gather, f, "GBLS.");
+  coalesceDump(&GBLS.coalesce, f, "GBLS.");
+  reduceDump(&GBLS.reduce, f, "GBLS.");
+  mergeDump(&GBLS.merge, f, "GBLS.");
+  watchDump(&GBLS.watch, f, "GBLS.");
   fprintf(f, "GBLS.slowestcmd=%p", GBLS.slowestcmd);
   if (GBLS.slowestcmd) fprintf(f, "(%s)\n", GBLS.slowestcmd->name);
   else fprintf(f, "\n");
+  fprintf(f, "GBLS.runnerupcmd=%p", GBLS.runnerupcmd);
+  if (GBLS.runnerupcmd) fprintf(f, "(%s)", GBLS.runnerupcmd->name);
+  fprintf(f, " runnerupdelay=%f\n", GBLS.runnerupdelay);
 }
 
 static bool checkpath(char *path, int type)
@@ -360,7 +657,8 @@ static bool checkpath(char *path, int type)
 // modifies the cmdstr string (places nulls at appopriate points)
 static bool
 cmdspecParse(char *cmdstr, char **name, char **cmdline,
-	    double *delay, char **ttylink, char **log, FILE *f)
+	     double *delay, int *burst, char **ttylink, char **log,
+	     int *standbys, FILE *f)
 {
   char  *orig=NULL, *nptr=NULL; // next token pointer, original cmdstr
   bool rc=true;
@@ -374,6 +672,16 @@ cmdspecParse(char *cmdstr, char **name, char **cmdline,
     goto done;
   }
   *name=nptr;
+  // the name can be followed by +<n>: the number of standby instances
+  *standbys = 0;
+  nptr = strchr(*name, '+');
+  if (nptr) {
+    *nptr = '\0';
+    if (!standbyParse(nptr+1, standbys, f)) {
+      rc = false;
+      goto done;
+    }
+  }
   
   nptr = strsep(&cmdstr, ",");     // parse ttylink
   if (nptr == NULL || cmdstr == NULL) {
@@ -415,14 +723,10 @@ cmdspecParse(char *cmdstr, char **name, char **cmdline,
   }
   if (*nptr==0) { // none specified
      *delay = GBLS.defaultcmddelay;
-  } else {
-    errno = 0;
-    *delay = strtod(nptr, NULL);
-    if (errno != 0) {
-      EPRINT(f, "bad delay value: errno=%d\n", errno);
-      rc = false;
-      goto done;
-    }
+     *burst = GBLS.defaultcmdburst;
+  } else if (!paceParse(nptr, delay, burst, f)) {
+    rc = false;
+    goto done;
   }
 
   // commandline is everthing that list left (avoid parsing incase command
@@ -443,19 +747,21 @@ GBLSAddCmd(char *cstr, cmd_t **cmdptr, FILE *f)
 {
   char *cmdstr,*name, *cmdline, *ttylink, *log;
   double delay;
+  int    burst, standbys;
   cmd_t *cmd;
   
   // WE ASSUME cmdstr is a properly null terminated string!
   cmdstr=strdup(cstr);
   
-  if (!cmdspecParse(cmdstr, &name, &cmdline, &delay, &ttylink,
-		   &log, f)) return false;
+  if (!cmdspecParse(cmdstr, &name, &cmdline, &delay, &burst, &ttylink,
+		    &log, &standbys, f)) return false;
   // check to see if name is already used
   HASH_FIND_STR(GBLS.cmds, name, cmd);
   if (cmd == NULL) {
     // new command
     cmd=malloc(sizeof(cmd_t));
-    if (!cmdInit(cmd, cmdstr, name, cmdline, delay, ttylink, log, false)) {
+    if (!cmdInit(cmd, cmdstr, name, cmdline, delay, burst, ttylink, log,
+		 false)) {
       EPRINT(f, "Failed to initCmd(%p,%s,%s,%f,%s,%s)", cmd, name, cmdline,
 	     delay, ttylink, log);
       free(cmdstr);
@@ -469,12 +775,19 @@ GBLSAddCmd(char *cstr, cmd_t **cmdptr, FILE *f)
       free(cmd);
       return false;
     }
-    if (GBLS.slowestcmd) {
-      if (delay > GBLS.slowestcmd->delay) GBLS.slowestcmd = cmd;
-    } else {
-      GBLS.slowestcmd = cmd;
+    if (!standbySet(&GBLS.standby, cmd, standbys, -1, f)) {
+      cmdCleanup(cmd);
+      free(cmd);
+      return false;
     }
     HASH_ADD_KEYPTR(hh, GBLS.cmds, cmd->name, strlen(cmd->name), cmd);
+    relayAddCmd(&GBLS.relay, cmd);    // a child yar tells its parent
+    readyAddCmd(&GBLS.ready, cmd);
+    paceAddCmd(&GBLS.pace, cmd);      // also tracks the slowest command
+    limitAddCmd(&GBLS.limit, cmd);
+    fairqAddCmd(&GBLS.fairq, cmd);
+    watchdogAddCmd(&GBLS.watchdog, cmd);
+    pingAddCmd(&GBLS.ping, cmd);
     if (cmdptr) *cmdptr = cmd;
   } else {
     EPRINT(f, "%s: command names must be unique. %s already used:",
@@ -485,17 +798,132 @@ GBLSAddCmd(char *cstr, cmd_t **cmdptr, FILE *f)
   return true;
 }
 
+// find the slowest command and the runner-up (eg. after the slowest was
+// removed or its delay fell below that of the runner-up)
+extern void
+GBLSFindSlowestCmd()
+{
+  cmd_t *c, *tmp;
+  GBLS.slowestcmd  = NULL;
+  GBLS.runnerupcmd = NULL;
+  HASH_ITER(hh, GBLS.cmds, c, tmp) {
+    if (GBLS.slowestcmd == NULL || c->delay > GBLS.slowestcmd->delay) {
+      GBLS.runnerupcmd = GBLS.slowestcmd;
+      GBLS.slowestcmd  = c;
+    } else if (GBLS.runnerupcmd == NULL ||
+	       c->delay > GBLS.runnerupcmd->delay) {
+      GBLS.runnerupcmd = c;
+    }
+  }
+  if (GBLS.runnerupcmd) GBLS.runnerupdelay = GBLS.runnerupcmd->delay;
+  paceBcstUpdate(&GBLS.pace);
+}
+
+// remove a command from the global set of commands and release it
+extern void
+GBLSDelCmd(cmd_t *cmd)
+{
+  VPRINT("cleanup up cmd %s\n", cmd->name);
+  scatterForgetCmd(&GBLS.scatter, cmd);
+  workqForgetCmd(&GBLS.workq, cmd);
+  gatherForgetCmd(&GBLS.gather, cmd);
+  mergeForgetCmd(&GBLS.merge, cmd);
+  watchForgetCmd(&GBLS.watch, cmd);
+  waveForgetCmd(&GBLS.wave, cmd);
+  paceForgetCmd(&GBLS.pace, cmd);
+  limitForgetCmd(&GBLS.limit, cmd);
+  fairqForgetCmd(&GBLS.fairq, cmd);
+  relayForgetCmd(&GBLS.relay, cmd);
+  standbyForgetCmd(&GBLS.standby, cmd);
+  inqForgetCmd(&GBLS.inq, cmd);
+  cmdCleanup(cmd);
+  HASH_DEL(GBLS.cmds, cmd);
+  readyForgetCmd(&GBLS.ready, cmd);
+  watchdogForgetCmd(&GBLS.watchdog, cmd);
+  pingForgetCmd(&GBLS.ping, cmd);
+  statsForgetCmd(&GBLS.stats, cmd);
+  if (GBLS.runnerupcmd == cmd) GBLS.runnerupcmd = NULL;
+  if (GBLS.slowestcmd == cmd) GBLSFindSlowestCmd();
+  free(cmd);
+  if (HASH_COUNT(GBLS.cmds) == 0 && GBLS.exitonidle) {
+    cleanup();
+    exit(EXIT_SUCCESS);
+  }
+}
+
+// the broadcast fan-out through a backend (see fanout_t): commands that
+// are ready and have their tty open are written to by writefds, the others
+// are handled as usual.  The book keeping is done here after the backend
+// is done.  Returns the number of commands written to
 static int
-GBLSCmdsWriteChar(char c)
+GBLSFanout(fanoutwrite_t writefds, void *backend, char *buf, int len,
+	   int epollfd)
 {
-  int n, cnt=0;
-  cmd_t *cmd, *tmp;
+  fanout_t *fo = &(GBLS.fanout);
+  int       cnt = 0, w;
+  cmd_t    *cmd, *tmp;
+
+  if (len == 0) return 0;
+  if (fo->cap < HASH_COUNT(GBLS.cmds)) {
+    fo->cap  = HASH_COUNT(GBLS.cmds) * 2;
+    fo->cmds = realloc(fo->cmds, fo->cap * sizeof(cmd_t *));
+    fo->fds  = realloc(fo->fds, fo->cap * sizeof(int));
+    fo->res  = realloc(fo->res, fo->cap * sizeof(int));
+    assert(fo->cmds && fo->fds && fo->res);
+  }
+  fo->n = 0;
   HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
-    n=cmdWriteChar(cmd, c);
-    if ( n != 1 ) {
-      EPRINT(stderr, "  write returned: n=%d\n", n);
+    if (!cmdIsReady(cmd)) {
+      readyHold(&GBLS.ready, cmd, buf, len, epollfd);
+    } else if (cmd->cmdtty.opens == 0 || cmd->rly.on ||
+	       inqIsWaiting(&(cmd->inq))) {
+      // discarded by the tty, framed or queued behind pending input
+      inqWrite(&GBLS.inq, cmd, buf, len, epollfd);
+    } else {
+      fo->cmds[fo->n]  = cmd;
+      fo->fds[fo->n++] = cmd->cmdtty.dfd;
+      continue;
+    }
+    cnt++;
+  }
+  if (fo->n) writefds(backend, fo, buf, len);
+  for (int i=0; i<fo->n; i++) {
+    cmd = fo->cmds[i];
+    w   = fo->res[i];
+    if (w > 0) {
+      ttyWrote(&(cmd->cmdtty), buf, w, &(cmd->lastwrite));
+      cmdSent(cmd, buf, w);
+    } else if (w == -EAGAIN) {
+      VLPRINT(2, "%s(%s) client is a slow child be kind\n", cmd->cmdtty.link,
+	      cmd->cmdtty.path);
+      w = 0;
+    } else {
+      errno = -w;
+      perror("fan-out write failed");
       NYI;
     }
+    // the rest waits for the tty to drain (see inq.h)
+    if (w < len) inqQueue(&GBLS.inq, cmd, &buf[w], len - w, epollfd);
+    cnt++;
+  }
+  return cnt;
+}
+
+// write a chunk of broadcast input to every command: commands that are not
+// ready yet have it held for them and what a full tty does not take is
+// queued (see inq.h)
+static int
+GBLSCmdsWriteBuf(char *buf, int len, int epollfd)
+{
+  int n, cnt=0;
+  cmd_t *cmd, *tmp;
+  if (wpoolIsOn(&GBLS.wpool)) return GBLSFanout(wpoolFanout, &GBLS.wpool,
+						buf, len, epollfd);
+  if (uringIsOn(&GBLS.uring)) return GBLSFanout(uringFanout, &GBLS.uring,
+						buf, len, epollfd);
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmdIsReady(cmd)) n=inqWrite(&GBLS.inq, cmd, buf, len, epollfd);
+    else n=readyHold(&GBLS.ready, cmd, buf, len, epollfd);
     if (n) cnt++;
   }
   return cnt;
@@ -567,6 +995,8 @@ bcstttyNotify(void *obj, uint32_t mask, int epollfd)
 	VPRINT("%s started pidfd=%d pid=%d\n", cmd->name, cmd->pidfd, cmd->pid);
       }
     }
+    // with no reader queued output is discarded by the tty
+    if (this->opens == 0) fairqDrain(&GBLS.fairq);
     mask = mask & ~IN_OPEN;
     mask = mask & ~IN_CLOSE;
     break;
@@ -578,6 +1008,45 @@ bcstttyNotify(void *obj, uint32_t mask, int epollfd)
   return EVNT_HDLR_SUCCESS;
 }
 
+// dispatch a chunk of broadcast input (read from the broadcast tty or, for
+// a child yar, sent by its parent see relay.h)
+extern void
+bcstInput(char *buf, int n, int epollfd)
+{
+  if (scatterIsOn(&GBLS.scatter)) {
+    for (int i=0; i<n; i++) scatterChar(&GBLS.scatter, buf[i], epollfd);
+  } else {
+    if (journalIsOn(&GBLS.journal)) {
+      for (int i=0; i<n; i++) journalChar(&GBLS.journal, buf[i]);
+    }
+    if (waveIsOn(&GBLS.wave)) {
+      for (int i=0; i<n; i++) waveChar(&GBLS.wave, buf[i], epollfd);
+    } else {
+      GBLSCmdsWriteBuf(buf, n, epollfd);
+    }
+  }
+}
+
+// pause (on) or resume broadcast input for reason (a BCST_PAUSE_*).  Input
+// is read again once no reason is left.  For a child yar broadcast input
+// is the input from its parent (see relay.h)
+extern void
+bcstPause(int reason, bool on, int epollfd)
+{
+  int was = GBLS.bcstpaused;
+
+  if (on) GBLS.bcstpaused |= reason;
+  else GBLS.bcstpaused &= ~reason;
+  if ((was != 0) == (GBLS.bcstpaused != 0)) return;
+  VLPRINT(1, "%s broadcast input (reasons:0x%x)\n",
+	  (on) ? "pausing" : "resuming", (on) ? GBLS.bcstpaused : was);
+  if (relayIsUplink(&GBLS.relay)) {
+    relayUplinkEnable(&GBLS.relay, epollfd, !on);
+  } else if (GBLS.bcstflg) {
+    ttyInputEnable(&GBLS.bcsttty, epollfd, !on);
+  }
+}
+
 evnthdlrrc_t
 bcstttyEvent(void *obj, uint32_t evnts, int epollfd)
 {
@@ -587,27 +1056,22 @@ bcstttyEvent(void *obj, uint32_t evnts, int epollfd)
   VLPRINT(3,"START: BCSTTY: tty(%p):%s(%s) fd:%d evnts:0x%08x\n", tty, 
 	  tty->link, tty->path, fd, evnts);
   if (evnts & EPOLLIN) {
-    char c;
-    // pretend we are reading characters for the slowest command
+    char buf[PACE_CHUNK];
+    // read as much as the broadcast pacing (that of the slowest command)
+    // allows and stop reading until its bucket refills if it allows nothing
     VLPRINT(3, "bcsttty(%p)\n", obj);
-    if (GBLS.readystr && GBLS.cmdsreadycnt < HASH_COUNT(GBLS.cmds)) {
-      VLPRINT(2, "%p: skipping ttyRead as all commands are not ready\n",
-	     obj);
-      goto done;
-    }
-    int n = ttyReadChar(&GBLS.bcsttty, &c,
-			&(GBLS.slowestcmd->lastwrite),
-			GBLS.slowestcmd->delay);
+    // input is not held back for commands that are not ready: it is held
+    // for them (see readyHold) or, in queue mode, waits in the work queue
+    int n = bucketAvail(&(GBLS.pace.bkt), sizeof(buf));
+    if (n == 0) paceThrottle(&GBLS.pace, NULL, epollfd);
+    else n = ttyReadBuf(&GBLS.bcsttty, buf, n);
     if (n) {
-      if (verbose(2)) {
-	asciistr_t charstr;
-	ascii_char2str((int)c, charstr);
-	VPRINT("---> BCSTTY: START: EIN: tty(%p):%s(%s) fd:%d evnts:0x%08x\n"
-	       "ttyReadChar:    %p:%s(%s) fd:%d n:%d: %02x(%s)\n",
-	       tty, tty->link, tty->path, fd, evnts,
-	       tty, tty->link, tty->path, fd, n, c, charstr);
-      }
-      n=GBLSCmdsWriteChar(c);
+      VLPRINT(2, "---> BCSTTY: START: EIN: tty(%p):%s(%s) fd:%d evnts:0x%08x\n"
+	      "ttyReadBuf:    %p:%s(%s) fd:%d n:%d\n",
+	      tty, tty->link, tty->path, fd, evnts,
+	      tty, tty->link, tty->path, fd, n);
+      bucketUse(&(GBLS.pace.bkt), n);
+      bcstInput(buf, n, epollfd);
       VLPRINT(2, "<--- BCSTTY: END: EIN: tty(%p):%s(%s) fd:%d evnts:0x%08x "
 	      "n=%d\n", tty, tty->link, tty->path, fd, evnts, n);
     }
@@ -697,7 +1161,8 @@ monAdd(int args, int epollfd)
 	monprintf("failed to register ttyEvents (%s)\n", cmdstr);
 	rc = -1;
       } else {
-	if (GBLS.bcstflg == false && (HASH_COUNT(GBLS.cmds) > 1)) {
+	if (GBLS.bcstflg == false && (HASH_COUNT(GBLS.cmds) > 1) &&
+	    !relayIsUplink(&GBLS.relay)) {
 	  // incase we now have more than one command we might need
 	  // to create the broadcast tty 
 	  GBLS.bcstflg = true;
@@ -706,7 +1171,9 @@ monAdd(int args, int epollfd)
 	} else {
 	  // if the broadcast tty is currently open then start command
 	  // immediately
-	  if (GBLS.bcsttty.opens>0 && cmdStart(cmd, true, epollfd, 0.0)) {
+	  // (a child yar's commands run as long as it does)
+	  if ((GBLS.bcsttty.opens>0 || relayIsUplink(&GBLS.relay)) &&
+	      cmdStart(cmd, true, epollfd, 0.0)) {
 	    VPRINT("%s started pidfd=%d pid=%d\n", cmd->name, cmd->pidfd,
 		   cmd->pid);
 	  }
@@ -743,14 +1210,7 @@ monDel(int args, int epollfd)
     return -1;
   }
 
-  VPRINT("cleanup up cmd %s\n", cmd->name);
-  cmdCleanup(cmd);
-  HASH_DEL(GBLS.cmds, cmd);
-  free(cmd);
-  if (HASH_COUNT(GBLS.cmds) == 0 && GBLS.exitonidle) {
-    cleanup();
-    exit(EXIT_SUCCESS);
-  }
+  GBLSDelCmd(cmd);
   return 0;
 }
 
@@ -760,7 +1220,8 @@ monDrain(int args, int epollfd)
   cmd_t *cmd, *tmp;
   HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
     // drain cmd output tty
-    cmdttyDrain(cmd);  // read any outstanding command output and process
+    cmdttyDrain(cmd, epollfd); // read any outstanding command output and
+                               // process
     cmd->bufstart = 0; cmd->bufn = 0;    // reset buffer
     // drain client tty buffer
     ttySubFlush(&(cmd->clttty));
@@ -786,8 +1247,12 @@ monList(int args, int epollfd)
   HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
     monprintf("%s", cmd->name);
     if (lflg) {
-      monprintf(" tty:%s pid:%d restarts:%d cmdline:%s\n",
-	     cmd->clttty.link, cmd->pid, cmd->restartcnt, cmd->cmdline);
+      monprintf(" tty:%s pid:%d restarts:%d",
+	     cmd->clttty.link, cmd->pid, cmd->restartcnt);
+      if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+	pingCmdDesc(cmd, GBLS.mon.fileptr);
+      }
+      monprintf(" cmdline:%s\n", cmd->cmdline);
     } else if (dflg) {
       if (GBLS.mon.tty.opens !=0 ) cmdDump(cmd,GBLS.mon.fileptr, "\n");
     } else monprintf("\n");
@@ -800,6 +1265,507 @@ monList(int args, int epollfd)
   return 0;
 }
 
+int
+monScatter(int args, int epollfd)
+{
+  if (args) {
+    if (strncmp(&GBLS.mon.line[args], "queue", 5) == 0 &&
+	!kmpIsSet(&GBLS.workq.marker)) {
+      monprintf("queue mode requires a completion marker: "
+		"workq marker <string>\n");
+      return -1;
+    }
+    if (strcmp(&GBLS.mon.line[args], "off") != 0 && waveIsOn(&GBLS.wave)) {
+      monprintf("scatter can not be used with waves\n");
+      return -1;
+    }
+    if (!scatterSetMode(&GBLS.scatter, &GBLS.mon.line[args],
+			GBLS.mon.fileptr)) return -1;
+  }
+  monprintf("scatter: mode:%s", scatterModeStr(&GBLS.scatter));
+  if (GBLS.scatter.mode == SCATTER_HASH) {
+    monprintf(" keyfield:%d", GBLS.scatter.keyfield);
+  }
+  if (GBLS.scatter.mode == SCATTER_QUEUE) {
+    monprintf(" inflight:%d depth:%d", GBLS.workq.inflightmax,
+	      GBLS.workq.depth);
+  }
+  monprintf(" lines:%lu drops:%lu queued:%lu qdrops:%lu depth:%d\n",
+	    GBLS.scatter.lines, GBLS.scatter.drops, GBLS.scatter.queued,
+	    GBLS.scatter.qdrops, GBLS.scatter.depth);
+  return 0;
+}
+
+int
+monWorkq(int args, int epollfd)
+{
+  if (args) {
+    char *val, *arg = &GBLS.mon.line[args];
+    val = strchr(arg, ' ');
+    if (val == NULL) {
+      monprintf("USAGE: workq [marker <string>|depth <n>]\n");
+      return -1;
+    }
+    *val = '\0'; val++;
+    if (strcmp(arg, "marker") == 0) {
+      if (!workqSetMarker(&GBLS.workq, val, GBLS.mon.fileptr)) return -1;
+    } else if (strcmp(arg, "depth") == 0) {
+      int depth = atoi(val);
+      if (depth < 1) {
+	monprintf("bad depth: %s\n", val);
+	return -1;
+      }
+      GBLS.workq.maxdepth = depth;
+      workqDispatch(&GBLS.workq, epollfd); // resumes input if needed
+    } else {
+      monprintf("USAGE: workq [marker <string>|depth <n>]\n");
+      return -1;
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    workqReport(&GBLS.workq, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monGather(int args, int epollfd)
+{
+  if (args) {
+    char  *arg = &GBLS.mon.line[args];
+    char  *save, *marker, *tok;
+    char **names;
+    double timeout = 0.0;
+    int    namecnt = 0;
+    bool   rc;
+
+    marker = strtok_r(arg, " ", &save);
+    if (marker == NULL) {
+      monprintf("USAGE: gather [<marker> [<timeout> [<cmd>...]]|cancel]\n");
+      return -1;
+    }
+    if (strcmp(marker, "cancel") == 0) {
+      gatherCancel(&GBLS.gather);
+      return 0;
+    }
+    tok = strtok_r(NULL, " ", &save);
+    if (tok) {
+      char *end;
+      timeout = strtod(tok, &end);
+      if (*end != '\0' || timeout < 0.0) {
+	monprintf("bad timeout: %s\n", tok);
+	return -1;
+      }
+    }
+    names = malloc(sizeof(char *) * (strlen(GBLS.mon.line) / 2 + 1));
+    assert(names);
+    while ((tok = strtok_r(NULL, " ", &save))) names[namecnt++] = tok;
+    rc = gatherStart(&GBLS.gather, marker, timeout, names, namecnt, epollfd,
+		     GBLS.mon.fileptr);
+    free(names);
+    return (rc) ? 0 : -1;
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    gatherReport(&GBLS.gather, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monCoalesce(int args, int epollfd)
+{
+  if (args) {
+    char *arg = &GBLS.mon.line[args];
+    if (strcmp(arg, "flush") == 0) {
+      coalesceFlush(&GBLS.coalesce);
+    } else {
+      if (strcmp(arg, "off") != 0 && !GBLS.linebufferbcst) {
+	monprintf("coalescing requires line buffered broadcast output\n");
+	return -1;
+      }
+      if (!coalesceSet(&GBLS.coalesce, arg, GBLS.mon.fileptr)) return -1;
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    coalesceReport(&GBLS.coalesce, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monReduce(int args, int epollfd)
+{
+  if (args) {
+    char *arg = &GBLS.mon.line[args];
+    if (strcmp(arg, "flush") == 0) {
+      reduceFlush(&GBLS.reduce);
+    } else {
+      if (strcmp(arg, "off") != 0 && !GBLS.linebufferbcst) {
+	monprintf("reduction requires line buffered broadcast output\n");
+	return -1;
+      }
+      if (!reduceSet(&GBLS.reduce, arg, GBLS.mon.fileptr)) return -1;
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    reduceReport(&GBLS.reduce, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monMerge(int args, int epollfd)
+{
+  if (args) {
+    char *arg = &GBLS.mon.line[args];
+    if (strcmp(arg, "flush") == 0) {
+      mergeFlush(&GBLS.merge);
+    } else {
+      if (strcmp(arg, "off") != 0 && !GBLS.linebufferbcst) {
+	monprintf("merging requires line buffered broadcast output\n");
+	return -1;
+      }
+      if (!mergeSet(&GBLS.merge, arg, GBLS.mon.fileptr)) return -1;
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    mergeReport(&GBLS.merge, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monWatch(int args, int epollfd)
+{
+  if (args) {
+    char *arg = &GBLS.mon.line[args];
+    if (strncmp(arg, "add ", 4) == 0) {
+      if (!watchAdd(&GBLS.watch, &arg[4], GBLS.mon.fileptr)) return -1;
+    } else if (strncmp(arg, "del ", 4) == 0) {
+      if (!watchDel(&GBLS.watch, &arg[4], GBLS.mon.fileptr)) return -1;
+    } else if (strcmp(arg, "clear") == 0) {
+      watchClear(&GBLS.watch);
+    } else {
+      monprintf("USAGE: watch [add <pattern>|del <pattern>|clear]\n");
+      return -1;
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    watchReport(&GBLS.watch, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monReady(int args, int epollfd)
+{
+  if (args) {
+    char  *arg  = &GBLS.mon.line[args];
+    char  *spec = strchr(arg, ' ');
+    cmd_t *cmd  = NULL;
+    if (spec == NULL) {
+      monprintf("USAGE: ready [<cmd>|* <string>|/<regex>/|clear]"
+		"|[hold <bytes>[:<timeout>]]\n");
+      return -1;
+    }
+    *spec = '\0';
+    spec++;
+    if (strcmp(arg, "hold") == 0) {
+      if (!readySetHold(&GBLS.ready, spec, epollfd, GBLS.mon.fileptr)) return -1;
+      goto report;
+    }
+    if (strcmp(arg, "*") != 0) {
+      HASH_FIND_STR(GBLS.cmds, arg, cmd);
+      if (cmd == NULL) {
+	monprintf("%s is not a current command\n", arg);
+	return -1;
+      }
+    }
+    if (strcmp(spec, "clear") == 0) {
+      readyClear(&GBLS.ready, cmd);
+    } else if (!readyAdd(&GBLS.ready, cmd, spec, GBLS.mon.fileptr)) {
+      return -1;
+    }
+  }
+ report:
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    readyReport(&GBLS.ready, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monJournal(int args, int epollfd)
+{
+  if (args) {
+    if (!journalSet(&GBLS.journal, &GBLS.mon.line[args], GBLS.mon.fileptr)) {
+      return -1;
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    journalReport(&GBLS.journal, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monWave(int args, int epollfd)
+{
+  if (args) {
+    char *arg = &GBLS.mon.line[args];
+    if (strcmp(arg, "resume") == 0) {
+      if (!waveResume(&GBLS.wave, epollfd, GBLS.mon.fileptr)) return -1;
+    } else if (strcmp(arg, "abort") == 0) {
+      if (!waveAbort(&GBLS.wave, epollfd, GBLS.mon.fileptr)) return -1;
+    } else {
+      if (strcmp(arg, "off") != 0 && scatterIsOn(&GBLS.scatter)) {
+	monprintf("waves can not be used with scatter\n");
+	return -1;
+      }
+      if (!waveSet(&GBLS.wave, arg, epollfd, GBLS.mon.fileptr)) return -1;
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    waveReport(&GBLS.wave, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monPace(int args, int epollfd)
+{
+  if (args) {
+    char  *arg  = &GBLS.mon.line[args];
+    char  *spec = strchr(arg, ' ');
+    cmd_t *cmd  = NULL;
+    if (spec == NULL) {
+      monprintf("USAGE: pace [<cmd>|* off|aimd[:<min>[:<max>[:<inc>"
+		"[:<lag>]]]]|<delay>|<bytes>/s[:<burst>]]\n");
+      return -1;
+    }
+    *spec = '\0';
+    spec++;
+    if (strcmp(arg, "*") != 0) {
+      HASH_FIND_STR(GBLS.cmds, arg, cmd);
+      if (cmd == NULL) {
+	monprintf("%s is not a current command\n", arg);
+	return -1;
+      }
+    }
+    if (!paceSet(&GBLS.pace, cmd, spec, GBLS.mon.fileptr)) return -1;
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    paceReport(&GBLS.pace, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monLimit(int args, int epollfd)
+{
+  if (args) {
+    char  *arg  = &GBLS.mon.line[args];
+    char  *spec = strchr(arg, ' ');
+    cmd_t *cmd  = NULL;
+    if (spec == NULL) {
+      monprintf("USAGE: limit [<cmd>|* <bytes/sec>[:<burst>]|off|default]\n");
+      return -1;
+    }
+    *spec = '\0';
+    spec++;
+    if (strcmp(arg, "*") != 0) {
+      HASH_FIND_STR(GBLS.cmds, arg, cmd);
+      if (cmd == NULL) {
+	monprintf("%s is not a current command\n", arg);
+	return -1;
+      }
+    }
+    if (!limitSet(&GBLS.limit, cmd, spec, GBLS.mon.fileptr)) return -1;
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    limitReport(&GBLS.limit, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monFair(int args, int epollfd)
+{
+  if (args) {
+    char  *arg    = &GBLS.mon.line[args];
+    char  *weight = strchr(arg, ' ');
+    cmd_t *cmd    = NULL;
+    if (weight == NULL) {
+      monprintf("USAGE: fair [<cmd>|* <weight>]\n");
+      return -1;
+    }
+    *weight = '\0';
+    weight++;
+    if (strcmp(arg, "*") != 0) {
+      HASH_FIND_STR(GBLS.cmds, arg, cmd);
+      if (cmd == NULL) {
+	monprintf("%s is not a current command\n", arg);
+	return -1;
+      }
+    }
+    if (!fairqSetWeight(&GBLS.fairq, cmd, weight, GBLS.mon.fileptr)) {
+      return -1;
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    fairqReport(&GBLS.fairq, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monStandby(int args, int epollfd)
+{
+  if (args) {
+    char  *arg  = &GBLS.mon.line[args];
+    char  *spec = strchr(arg, ' ');
+    cmd_t *cmd, *tmp;
+    int    want;
+    if (spec == NULL) {
+      monprintf("USAGE: standby [<cmd>|* <n>]\n");
+      return -1;
+    }
+    *spec = '\0';
+    spec++;
+    if (!standbyParse(spec, &want, GBLS.mon.fileptr)) return -1;
+    if (strcmp(arg, "*") == 0) {
+      HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+	if (!cmd->rly.on) standbySet(&GBLS.standby, cmd, want, epollfd,
+				     GBLS.mon.fileptr);
+      }
+    } else {
+      HASH_FIND_STR(GBLS.cmds, arg, cmd);
+      if (cmd == NULL) {
+	monprintf("%s is not a current command\n", arg);
+	return -1;
+      }
+      if (!standbySet(&GBLS.standby, cmd, want, epollfd, GBLS.mon.fileptr)) {
+	return -1;
+      }
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    standbyReport(&GBLS.standby, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monLinger(int args, int epollfd)
+{
+  if (args) {
+    char  *arg  = &GBLS.mon.line[args];
+    char  *spec = strchr(arg, ' ');
+    cmd_t *cmd  = NULL;
+    if (spec == NULL) {
+      monprintf("USAGE: linger [<cmd>|* <sec>|off]\n");
+      return -1;
+    }
+    *spec = '\0';
+    spec++;
+    if (strcmp(arg, "*") != 0) {
+      HASH_FIND_STR(GBLS.cmds, arg, cmd);
+      if (cmd == NULL) {
+	monprintf("%s is not a current command\n", arg);
+	return -1;
+      }
+    }
+    if (!lingerSet(&GBLS.linger, cmd, spec, GBLS.mon.fileptr)) return -1;
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    lingerReport(&GBLS.linger, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monWatchdog(int args, int epollfd)
+{
+  if (args) {
+    char  *arg  = &GBLS.mon.line[args];
+    char  *spec = strchr(arg, ' ');
+    cmd_t *cmd  = NULL;
+    if (spec == NULL) {
+      monprintf("USAGE: watchdog [<cmd>|* <spec>]\n");
+      return -1;
+    }
+    *spec = '\0';
+    spec++;
+    if (strcmp(arg, "*") != 0) {
+      HASH_FIND_STR(GBLS.cmds, arg, cmd);
+      if (cmd == NULL) {
+	monprintf("%s is not a current command\n", arg);
+	return -1;
+      }
+    }
+    if (!watchdogSet(&GBLS.watchdog, cmd, spec, epollfd, GBLS.mon.fileptr)) {
+      return -1;
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    watchdogReport(&GBLS.watchdog, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monPing(int args, int epollfd)
+{
+  if (args) {
+    char  *arg  = &GBLS.mon.line[args];
+    char  *spec = strchr(arg, ' ');
+    cmd_t *cmd  = NULL;
+    if (spec != NULL) {
+      *spec = '\0';
+      spec++;
+      HASH_FIND_STR(GBLS.cmds, arg, cmd);
+      if (cmd == NULL) {
+	monprintf("%s is not a current command\n", arg);
+	return -1;
+      }
+    } else {
+      spec = arg;
+    }
+    if (!pingSet(&GBLS.ping, cmd, spec, epollfd, GBLS.mon.fileptr)) {
+      return -1;
+    }
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    pingReport(&GBLS.ping, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
+int
+monRelay(int args, int epollfd)
+{
+  if (args) {
+    char *arg = &GBLS.mon.line[args];
+    char *str = strchr(arg, ' ');
+    char  line[MON_LINELEN+1];
+    if (str == NULL) {
+      monprintf("USAGE: relay [<cmd>[/<node>...] <string>]\n");
+      return -1;
+    }
+    *str = '\0';
+    str++;
+    int len = snprintf(line, sizeof(line), "%s\n", str);
+    if (!relaySend(&GBLS.relay, arg, line, len, epollfd, GBLS.mon.fileptr)) {
+      return -1;
+    }
+    return 0;
+  }
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    relayReport(&GBLS.relay, GBLS.mon.fileptr);
+  }
+  return 0;
+}
+
 int
 monHelp(int args, int epollfd)
 {
@@ -1101,6 +2067,78 @@ static bool checkfd(int fd)
   return true;
 }
 
+// add a handler to the deferred list: it has work left but has used its
+// budget
+extern void
+loopDefer(evntdesc_t *ed)
+{
+  evntloop_t *this = &GBLS.loop;
+  if (ed->deferred) return;
+  ed->deferred = true;
+  ed->next     = NULL;
+  if (this->tail) this->tail->next = ed; else this->head = ed;
+  this->tail = ed;
+  this->deferrals++;
+}
+
+// must be called before the object of a deferred handler is released
+extern void
+loopUndefer(evntdesc_t *ed)
+{
+  evntloop_t *this = &GBLS.loop;
+  evntdesc_t *prev = NULL, *e;
+  if (!ed->deferred) return;
+  for (e = this->head; e && e != ed; e = e->next) prev = e;
+  ASSERT(e == ed);
+  if (prev) prev->next = ed->next; else this->head = ed->next;
+  if (this->tail == ed) this->tail = prev;
+  ed->next     = NULL;
+  ed->deferred = false;
+}
+
+// account for bytes processed by the current handler.  Returns false once
+// its budget (bytes or time) is used up
+extern bool
+loopBudgetUse(int bytes)
+{
+  evntloop_t *this = &GBLS.loop;
+  this->bytes -= bytes;
+  if (this->bytes <= 0) return false;
+  // the clock is only read every so often
+  if (++this->uses == 64) {
+    struct timespec now;
+    this->uses = 0;
+    if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+      perror("clock_gettime");
+      NYI;
+    }
+    if (tsDiff(&now, &(this->deadline)) > 0.0) {
+      this->bytes = 0;
+      return false;
+    }
+  }
+  return true;
+}
+
+// give the handler about to be dispatched a fresh budget
+static void
+loopBudgetReset()
+{
+  evntloop_t *this = &GBLS.loop;
+  this->bytes = EVNT_BUDGET_BYTES;
+  this->uses  = 0;
+  if (clock_gettime(CLOCK_SOURCE, &(this->deadline)) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  this->deadline.tv_nsec += (long)(EVNT_BUDGET_SECS * NSEC_IN_SECOND);
+  if (this->deadline.tv_nsec >= NSEC_IN_SECOND) {
+    this->deadline.tv_sec++;
+    this->deadline.tv_nsec -= NSEC_IN_SECOND;
+  }
+  this->dispatches++;
+}
+
 #define MAX_EVENTS 1024
 // epoll code is based on example from the man page
 static bool
@@ -1128,6 +2166,9 @@ theLoop()
   
   // register for the broadcast client interface events
   bcstttyRegisterEvents(epollfd);
+
+  // register for the alert tty events (if there is one)
+  watchRegisterEvents(&GBLS.watch, epollfd);
   
   // cmd now register for events when started as part of lazy start
   // register for the events for all the initial commands
@@ -1139,12 +2180,26 @@ theLoop()
       if (!cmdRegisterttyEvents(cmd, epollfd)) return false;
     }
   }
+
+  // a child yar: register for input from the parent (starts the commands)
+  relayRegisterEvents(&GBLS.relay, epollfd);
+
+  // hung command checks (if a watchdog spec was given)
+  watchdogRegisterEvents(&GBLS.watchdog, epollfd);
+
+  // retries of writes to commands with full ttys
+  inqRegisterEvents(&GBLS.inq, epollfd);
+
+  // round trip time probes (if -Q was given)
+  pingRegisterEvents(&GBLS.ping, epollfd);
   
   // loop: detect events and dispatch handlers
   for (;;) {
     struct epoll_event events[MAX_EVENTS];
     errno = 0;
-    int nfds = epoll_wait(epollfd, events, MAX_EVENTS, -1);
+    // do not block if there are deferred handlers with work left
+    int nfds = epoll_wait(epollfd, events, MAX_EVENTS,
+			  (GBLS.loop.head) ? 0 : -1);
     if (nfds == -1) {
       if (verbose(1)) perror("epoll_wait");
       if (errno == EINTR) {
@@ -1166,6 +2221,13 @@ theLoop()
 	     errno, epollfd, MAX_EVENTS, checkfd(epollfd));
       goto done;
     }
+    GBLS.loop.waits++;
+    GBLS.loop.events += nfds;
+    {
+      int b = 0;
+      while (b < EVNT_BATCHES - 1 && (1 << b) < nfds) b++;
+      GBLS.loop.batches[b]++;
+    }
     
     for (int n = 0; n < nfds; ++n) {
       evnthdlrrc_t erc;
@@ -1175,7 +2237,10 @@ theLoop()
       VLPRINT(3, "%d/%d: ed:%p (.hdlr=0x%p .obj=Ox%p) evnts:0x%08x\n",
 	      n, nfds, ed, ed->hdlr, ed->obj, evnts);
       assert(ed->hdlr);
+      // a deferred handler is called below (once per iteration)
+      if (ed->deferred && evnts == EPOLLIN) continue;
       // call handler registered for this event source 
+      loopBudgetReset();
       erc = ed->hdlr(ed->obj, evnts, epollfd);
       if (erc == EVNT_HDLR_EXIT_LOOP) {
 	VLPRINT(1, "eventhandler returned exiting loop rc"
@@ -1189,6 +2254,28 @@ theLoop()
 	goto done;
       }
     }
+
+    // continue the handlers that used up their budget.  Only those
+    // deferred before this point run: a handler that defers again waits
+    // for the next iteration
+    evntdesc_t *ed = GBLS.loop.head, *last = GBLS.loop.tail;
+    while (ed) {
+      evntdesc_t *next = (ed == last) ? NULL : ed->next;
+      evnthdlrrc_t erc;
+      loopUndefer(ed);
+      loopBudgetReset();
+      erc = ed->hdlr(ed->obj, EPOLLIN, epollfd);
+      if (erc == EVNT_HDLR_EXIT_LOOP) {
+	rc = true;
+	goto done;
+      } else if (erc == EVNT_HDLR_FAILED) {
+	EPRINT(stderr, "deferred event handler failed hdlr:%p obj:0x%p\n",
+	       ed->hdlr, ed->obj);
+	rc = false;
+	goto done;
+      }
+      ed = next;
+    }
   }
   
   // Exit logic
@@ -1202,11 +2289,25 @@ argsParse(int argc, char **argv)
 {
     int opt;
     
-    while ((opt = getopt(argc, argv, "DKL:R:b:d:e:f:hlm:pr:s:vx")) != -1) {
+    while ((opt = getopt(argc, argv, "A:DG:H:I:J:KL:O:P:Q:R:S:T:UW:Y:a:b:c:d:e:f:g:hlm:o:pr:s:vw:x")) != -1) {
     switch (opt) {
     case 'D':
       GBLS.daemonize = true;
       break;
+    case 'G':
+      if (!watchdogSet(&(GBLS.watchdog), NULL, optarg, -1, stderr)) {
+	return false;
+      }
+      break;
+    case 'H':
+      if (!readySetHold(&(GBLS.ready), optarg, -1, stderr)) return false;
+      break;
+    case 'I':
+      if (!lingerSet(&(GBLS.linger), NULL, optarg, stderr)) return false;
+      break;
+    case 'J':
+      if (!journalSet(&(GBLS.journal), optarg, stderr)) return false;
+      break;
     case 'K':
       GBLS.keeplog = true;
       break;
@@ -1214,10 +2315,17 @@ argsParse(int argc, char **argv)
       GBLS.uselog  = true;
       GBLS.logdir  = strdup(optarg);
       break;
+    case 'O':
+      if (!limitSet(&(GBLS.limit), NULL, optarg, stderr)) return false;
+      break;
+    case 'P':
+      if (!paceSet(&(GBLS.pace), NULL, optarg, stderr)) return false;
+      break;
+    case 'Q':
+      if (!pingSet(&(GBLS.ping), NULL, optarg, -1, stderr)) return false;
+      break;
     case  'R':
-      GBLS.readystr     = strdup(optarg);
-      GBLS.readystrlen  = strlen(optarg);
-      GBLS.cmdsreadycnt = 0;
+      if (!readyAdd(&(GBLS.ready), NULL, optarg, stderr)) return false;
       break;
     case 'b':
       GBLS.bcstttylink = strdup(optarg);
@@ -1229,13 +2337,22 @@ argsParse(int argc, char **argv)
       // the force its creation at startup
       GBLS.bcstflg=true;
       break;
-    case 'd':
-      errno = 0;
-      GBLS.defaultcmddelay = strtod(optarg, NULL);
-      if (errno != 0) {
-	perror("bad delay value");
-	return  false;
+    case 'A':
+      if (checkpath(optarg, 0)) {
+	fprintf(stderr, "ERROR: %s already exists\n", optarg);
+	return false;
       }
+      GBLS.watch.alertlink = strdup(optarg);
+      break;
+    case 'a':
+      if (!reduceSet(&GBLS.reduce, optarg, stderr)) return false;
+      break;
+    case 'c':
+      if (!coalesceSet(&GBLS.coalesce, optarg, stderr)) return false;
+      break;
+    case 'd':
+      if (!paceParse(optarg, &GBLS.defaultcmddelay, &GBLS.defaultcmdburst,
+		     stderr)) return false;
       break;
     case 'e':
       errno = 0;
@@ -1248,6 +2365,9 @@ argsParse(int argc, char **argv)
     case 'f':
       GBLS.fsmntptdir = strdup(optarg);
       break;
+    case 'g':
+      if (!waveSet(&(GBLS.wave), optarg, -1, stderr)) return false;
+      break;
     case 'h':
       usage(argv[0],stderr);
       return false;
@@ -1257,6 +2377,9 @@ argsParse(int argc, char **argv)
     case 'm':
       GBLS.monttylinkdir = strdup(optarg);
       break;
+    case 'o':
+      if (!mergeSet(&GBLS.merge, optarg, stderr)) return false;
+      break;
     case 'p':
       GBLS.prefixbcst = true;
       break;
@@ -1271,6 +2394,25 @@ argsParse(int argc, char **argv)
     case  's':
       GBLS.stopstr = strdup(optarg);
       break;
+    case  'T':
+      if (!wpoolSet(&GBLS.wpool, optarg, stderr)) return false;
+      break;
+    case  'U':
+      GBLS.uring.want = true;
+      break;
+    case  'Y':
+      GBLS.relay.uplink = true;
+      GBLS.relay.path   = strdup(optarg);
+      break;
+    case  'S':
+      if (!scatterSetMode(&GBLS.scatter, optarg, stderr)) return false;
+      break;
+    case  'w':
+      if (!watchAdd(&GBLS.watch, optarg, stderr)) return false;
+      break;
+    case  'W':
+      if (!workqSetMarker(&GBLS.workq, optarg, stderr)) return false;
+      break;
     case 'v':
       GBLS.verbose++;
       break;
@@ -1283,6 +2425,37 @@ argsParse(int argc, char **argv)
     }
   } 
 
+  if (scatterIsOn(&GBLS.scatter) && waveIsOn(&GBLS.wave)) {
+    fprintf(stderr, "ERROR: -S and -g can not be used together\n");
+    return false;
+  }
+  if (GBLS.wpool.nthreads && GBLS.uring.want) {
+    fprintf(stderr, "ERROR: -T and -U can not be used together\n");
+    return false;
+  }
+  if (GBLS.relay.uplink && GBLS.bcstttylink) {
+    fprintf(stderr, "ERROR: -Y and -b can not be used together\n");
+    return false;
+  }
+
+  if (GBLS.scatter.mode == SCATTER_QUEUE && !kmpIsSet(&GBLS.workq.marker)) {
+    fprintf(stderr, "ERROR: -S queue requires a completion marker (-W)\n");
+    return false;
+  }
+
+  if (coalesceIsOn(&GBLS.coalesce) && !GBLS.linebufferbcst) {
+    fprintf(stderr, "ERROR: -c requires line buffered output (-l)\n");
+    return false;
+  }
+  if (reduceIsOn(&GBLS.reduce) && !GBLS.linebufferbcst) {
+    fprintf(stderr, "ERROR: -a requires line buffered output (-l)\n");
+    return false;
+  }
+  if (mergeIsOn(&GBLS.merge) && !GBLS.linebufferbcst) {
+    fprintf(stderr, "ERROR: -o requires line buffered output (-l)\n");
+    return false;
+  }
+
   int anum=argc-optind;
   char **args=&(argv[optind]);
     
@@ -1293,8 +2466,10 @@ argsParse(int argc, char **argv)
     char *tmp = strdup(args[i]);
     char *name, *cmdline, *ttylink, *log;
     double delay;
+    int    burst, standbys;
     
-    if (!cmdspecParse(tmp, &name, &cmdline, &delay, &ttylink, &log, stderr)) {
+    if (!cmdspecParse(tmp, &name, &cmdline, &delay, &burst, &ttylink, &log,
+		      &standbys, stderr)) {
       // failed to parse cmd spec
       free(tmp);
       return false;
@@ -1305,6 +2480,8 @@ argsParse(int argc, char **argv)
   GBLS.initialcmdspecscnt=anum;
 
   if (anum>1) GBLS.bcstflg=true;
+  // a child yar's uplink takes the place of the broadcast tty
+  if (GBLS.relay.uplink) GBLS.bcstflg=false;
   
   if (verbose(1)) GBLSDump(stderr); 
   return true;
@@ -1315,6 +2492,28 @@ void cleanup(void)
 {
   VPRINT("GBLS:%p\n", &GBLS);
   if (GBLS.bcstflg) ttyCleanup(&GBLS.bcsttty);
+  mergeCleanup(&(GBLS.merge));  // held lines reference the commands
+  watchCleanup(&(GBLS.watch));  // frees per command watch state
+  readyCleanup(&(GBLS.ready));  // frees per command ready specs
+  inqCleanup(&(GBLS.inq));      // frees per command pending input
+  journalCleanup(&(GBLS.journal));
+  waveCleanup(&(GBLS.wave));
+  paceCleanup(&(GBLS.pace));
+  limitCleanup(&(GBLS.limit));
+  fairqCleanup(&(GBLS.fairq));
+  uringCleanup(&(GBLS.uring));
+  wpoolCleanup(&(GBLS.wpool));
+  if (GBLS.fanout.cmds) free(GBLS.fanout.cmds);
+  if (GBLS.fanout.fds) free(GBLS.fanout.fds);
+  if (GBLS.fanout.res) free(GBLS.fanout.res);
+  GBLS.fanout = (fanout_t){ 0 };
+  relayCleanup(&(GBLS.relay));  // frees per command relay state
+  standbyCleanup(&(GBLS.standby)); // stops the standby instances
+  lingerCleanup(&(GBLS.linger));
+  watchdogCleanup(&(GBLS.watchdog)); // frees per command watchdog specs
+  pingCleanup(&(GBLS.ping));    // frees per command round trip times
+  statsCleanup(&(GBLS.stats));
+  scatterCleanup(&(GBLS.scatter)); // frees per command scatter queues
   {
     cmd_t *cmd, *tmp;
     HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
@@ -1325,6 +2524,11 @@ void cleanup(void)
     }
   }
   GBLS.slowestcmd = NULL;
+  GBLS.runnerupcmd = NULL;
+  workqCleanup(&(GBLS.workq));
+  gatherCleanup(&(GBLS.gather));
+  coalesceCleanup(&(GBLS.coalesce));
+  reduceCleanup(&(GBLS.reduce));
   fsCleanup(&(GBLS.fs));
   monCleanup();
   if (GBLS.logfile) {
@@ -1338,11 +2542,6 @@ void cleanup(void)
   if (GBLS.logpath) { free(GBLS.logpath); GBLS.logpath=NULL;  }
   GBLS.initialcmdspecs = NULL;   // points to argv values
   GBLS.initialcmdspecscnt = 0;
-  if (GBLS.readystr) {
-    free(GBLS.readystr);
-    GBLS.readystr    = NULL;
-    GBLS.readystrlen = 0;
-  }
   if (GBLS.stopstr) { free(GBLS.stopstr); GBLS.stopstr = NULL; }
   if (GBLS.bcstttylink) { free(GBLS.bcstttylink); GBLS.bcstttylink = NULL; }
   if (GBLS.monttylinkdir) {
@@ -1417,6 +2616,7 @@ GBLSInit()
     .cmddelonexit       = false,
     .keeplog            = false,
     .defaultcmddelay    = 0.0,
+    .defaultcmdburst    = 1,
     .restartcmddelay    = 5.0,
     .errrestartcmddelay = 10.0
   };
@@ -1427,6 +2627,28 @@ GBLSInit()
   fsInit(&(GBLS.fs),false,NULL,true);
   monInit(false,NULL,true);
   sigprocInit(&(GBLS.sigproc), true);
+  if (!scatterInit(&(GBLS.scatter), true)) EEXIT();
+  if (!workqInit(&(GBLS.workq), true)) EEXIT();
+  if (!gatherInit(&(GBLS.gather), true)) EEXIT();
+  if (!coalesceInit(&(GBLS.coalesce), true)) EEXIT();
+  if (!reduceInit(&(GBLS.reduce), true)) EEXIT();
+  if (!mergeInit(&(GBLS.merge), true)) EEXIT();
+  watchInit(&(GBLS.watch), true);
+  if (!readyInit(&(GBLS.ready), true)) EEXIT();
+  if (!inqInit(&(GBLS.inq), true)) EEXIT();
+  journalInit(&(GBLS.journal), true);
+  if (!waveInit(&(GBLS.wave), true)) EEXIT();
+  if (!paceInit(&(GBLS.pace), true)) EEXIT();
+  if (!limitInit(&(GBLS.limit), true)) EEXIT();
+  fairqInit(&(GBLS.fairq), true);
+  uringInit(&(GBLS.uring), true);
+  wpoolInit(&(GBLS.wpool), true);
+  if (!relayInit(&(GBLS.relay), true)) EEXIT();
+  standbyInit(&(GBLS.standby), true);
+  if (!lingerInit(&(GBLS.linger), true)) EEXIT();
+  if (!watchdogInit(&(GBLS.watchdog), true)) EEXIT();
+  if (!pingInit(&(GBLS.ping), true)) EEXIT();
+  statsInit(&(GBLS.stats), true);
 }
 
 char * cwdPrefix(const char *path) {
@@ -1448,6 +2670,9 @@ int main(int argc, char **argv)
   // parse arguments potentially updating GBLS
   if (!argsParse(argc, argv)) EEXIT();
 
+  // a child yar: take over stdin and stdout to talk to the parent
+  if (relayIsUplink(&GBLS.relay) && !relayUplinkCreate(&GBLS.relay)) EEXIT();
+
   // daemonize: do NOT change directory or close stdin,out,err
   if (GBLS.daemonize) assert(daemon(1,1)==0);
   
@@ -1505,6 +2730,17 @@ int main(int argc, char **argv)
   // create the broadcast tty
   bcstttyCreate();
 
+  // create the watch alert tty
+  if (GBLS.watch.alertlink && !watchAlertttyCreate(&GBLS.watch)) EEXIT();
+
+  // set up io_uring for the broadcast fan-out (plain writes are used if it
+  // is not available)
+  if (GBLS.uring.want && !uringCreate(&GBLS.uring)) {
+    EPRINT(stderr, "%s", "io_uring not available using write(2)\n");
+  }
+  // start the writer pool if requested
+  if (!wpoolCreate(&GBLS.wpool)) EEXIT();
+
   // sigproc is not affected by arguments so there is no need to reinit it
   
   if (!theLoop()) EEXIT();
@@ -0,0 +1,39 @@
+#include "yar.h"
+
+// (re)initialize this to match str.  str must not be empty
+extern bool
+kmpInit(kmp_t *this, const char *str)
+{
+  int len = strlen(str);
+  int x   = 0;   // state reached by the longest proper border so far
+  int *delta;
+
+  if (len == 0) return false;
+  delta = malloc(sizeof(int) * (len + 1) * 256);
+  if (delta == NULL) return false;
+  kmpCleanup(this);
+  this->str   = strdup(str);
+  this->len   = len;
+  this->delta = delta;
+  for (int c=0; c<256; c++) delta[c] = 0;
+  delta[(uint8_t)str[0]] = 1;
+  for (int j=1; j<=len; j++) {
+    // on a mismatch behave as the border state would
+    memcpy(&delta[j*256], &delta[x*256], sizeof(int) * 256);
+    if (j < len) {
+      delta[j*256 + (uint8_t)str[j]] = j + 1;
+      x = delta[x*256 + (uint8_t)str[j]];
+    }
+  }
+  return true;
+}
+
+extern void
+kmpCleanup(kmp_t *this)
+{
+  if (this->str) free(this->str);
+  if (this->delta) free(this->delta);
+  this->str   = NULL;
+  this->delta = NULL;
+  this->len   = 0;
+}
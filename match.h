@@ -0,0 +1,36 @@
+#ifndef __YAR_MATCH_H__
+#define __YAR_MATCH_H__
+
+// KMP Matcher Object
+//   Incremental (streaming) exact string matcher.  The Knuth-Morris-Pratt
+//   failure function is expanded into a complete transition table so that
+//   matching costs a single table lookup per byte with no backtracking and
+//   overlapping prefixes are handled correctly (eg. "aab" is found in
+//   "aaab").  The caller keeps the match state (0..len) per stream, a state
+//   of len means the string was just matched.
+typedef struct {
+  char *str;       // string to match (NULL if not set)
+  int  *delta;     // transitions: delta[state*256 + byte]
+  int   len;
+} kmp_t;
+
+extern bool kmpInit(kmp_t *this, const char *str);
+extern void kmpCleanup(kmp_t *this);
+
+__attribute__((unused)) static inline bool kmpIsSet(kmp_t *this)
+{
+  return (this->str != NULL);
+}
+
+// advance state over byte c returning the new state
+__attribute__((unused)) static inline int
+kmpStep(kmp_t *this, int state, char c)
+{
+  return this->delta[state*256 + (uint8_t)c];
+}
+
+__attribute__((unused)) static inline bool kmpMatched(kmp_t *this, int state)
+{
+  return (state == this->len);
+}
+#endif
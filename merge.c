@@ -0,0 +1,251 @@
+#include "yar.h"
+
+static inline int
+tsCmp(struct timespec *a, struct timespec *b)
+{
+  if (a->tv_sec != b->tv_sec) return (a->tv_sec < b->tv_sec) ? -1 : 1;
+  if (a->tv_nsec != b->tv_nsec) return (a->tv_nsec < b->tv_nsec) ? -1 : 1;
+  return 0;
+}
+
+static inline bool
+heapLess(merge_t *this, int i, int j)
+{
+  return tsCmp(&(this->heap[i]->mrg.head->ts),
+	       &(this->heap[j]->mrg.head->ts)) < 0;
+}
+
+static inline void
+heapSwap(merge_t *this, int i, int j)
+{
+  cmd_t *tmp    = this->heap[i];
+  this->heap[i] = this->heap[j];
+  this->heap[j] = tmp;
+  this->heap[i]->mrg.heapidx = i;
+  this->heap[j]->mrg.heapidx = j;
+}
+
+static void
+heapUp(merge_t *this, int i)
+{
+  while (i > 0 && heapLess(this, i, (i-1)/2)) {
+    heapSwap(this, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+}
+
+static void
+heapDown(merge_t *this, int i)
+{
+  for (;;) {
+    int l = 2*i+1, r = l+1, m = i;
+    if (l < this->heapn && heapLess(this, l, m)) m = l;
+    if (r < this->heapn && heapLess(this, r, m)) m = r;
+    if (m == i) return;
+    heapSwap(this, i, m);
+    i = m;
+  }
+}
+
+static void
+heapInsert(merge_t *this, cmd_t *cmd)
+{
+  if (this->heapn == this->heapcap) {
+    this->heapcap = (this->heapcap) ? this->heapcap * 2 : 64;
+    this->heap    = realloc(this->heap, sizeof(cmd_t *) * this->heapcap);
+    assert(this->heap);
+  }
+  this->heap[this->heapn] = cmd;
+  cmd->mrg.heapidx = this->heapn;
+  this->heapn++;
+  heapUp(this, this->heapn - 1);
+}
+
+static void
+heapRemove(merge_t *this, int i)
+{
+  cmd_t *cmd = this->heap[i];
+  this->heapn--;
+  if (i != this->heapn) {
+    heapSwap(this, i, this->heapn);
+    heapDown(this, i);
+    heapUp(this, i);
+  }
+  cmd->mrg.heapidx = -1;
+}
+
+// write the oldest held line of the command at heap position i
+static void
+mergeReleaseOne(merge_t *this, int i)
+{
+  cmd_t   *cmd  = this->heap[i];
+  mline_t *line = cmd->mrg.head;
+
+  cmd->mrg.head = line->next;
+  if (cmd->mrg.head == NULL) {
+    cmd->mrg.tail = NULL;
+    heapRemove(this, i);
+  } else {
+    // the command's next line is younger so it can only move down
+    heapDown(this, i);
+  }
+  cmdBcstWriteLine(cmd, line->data, line->len);
+  free(line);
+  this->held--;
+  this->released++;
+}
+
+// release every line older than the window and arm the timer for the
+// next one to become due
+static void
+mergeRelease(merge_t *this, int epollfd)
+{
+  struct timespec now;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  while (this->heapn &&
+	 tsDiff(&now, &(this->heap[0]->mrg.head->ts)) >= this->window) {
+    mergeReleaseOne(this, 0);
+  }
+  if (this->heapn) {
+    struct timespec *ts = &(this->heap[0]->mrg.head->ts);
+    if (!tmrIsArmed(&(this->tmr)) || tsCmp(ts, &(this->deadline)) < 0) {
+      this->deadline = *ts;
+      tmrArm(&(this->tmr), epollfd, this->window - tsDiff(&now, ts), 0.0);
+    }
+  } else {
+    tmrDisarm(&(this->tmr));
+  }
+}
+
+static evnthdlrrc_t
+mergeTimeout(void *obj, uint32_t evnts, int epollfd)
+{
+  mergeRelease(obj, epollfd);
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+mergeInit(merge_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(merge_t));
+  this->heap    = NULL;
+  this->heapn   = 0;
+  this->heapcap = 0;
+  this->held    = 0;
+  this->maxheld = MERGE_DEFAULT_MAXHELD;
+  this->on      = false;
+  return tmrInit(&(this->tmr), mergeTimeout, this, iszeroed);
+}
+
+// spec is "off" or the reorder window in seconds
+extern bool
+mergeSet(merge_t *this, char *spec, FILE *f)
+{
+  char  *end;
+  double window;
+
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing merge window\n");
+    return false;
+  }
+  if (strcmp(spec, "off") == 0) {
+    mergeFlush(this);
+    this->on = false;
+    return true;
+  }
+  errno = 0;
+  window = strtod(spec, &end);
+  if (errno != 0 || end == spec || *end != '\0' || window < 0.0) {
+    EPRINT(f, "bad merge window: %s\n", spec);
+    return false;
+  }
+  this->window = window;
+  this->on     = true;
+  return true;
+}
+
+// hold a complete line output by cmd.  Its timestamp is the read time of
+// its first byte (cmd->mrg.linets)
+extern void
+mergeLine(merge_t *this, cmd_t *cmd, char *line, int len, int epollfd)
+{
+  mline_t *ml = malloc(sizeof(mline_t) + len);
+  assert(ml);
+  ml->next = NULL;
+  ml->ts   = cmd->mrg.linets;
+  ml->len  = len;
+  memcpy(ml->data, line, len);
+  if (cmd->mrg.tail) {
+    cmd->mrg.tail->next = ml;
+    cmd->mrg.tail = ml;
+  } else {
+    cmd->mrg.head = cmd->mrg.tail = ml;
+    heapInsert(this, cmd);
+  }
+  this->held++;
+  while (this->held > this->maxheld) {
+    mergeReleaseOne(this, 0);
+    this->forced++;
+  }
+  mergeRelease(this, epollfd);
+}
+
+// release all held lines (in order) now
+extern void
+mergeFlush(merge_t *this)
+{
+  while (this->heapn) mergeReleaseOne(this, 0);
+  tmrDisarm(&(this->tmr));
+}
+
+// must be called before cmd is removed from GBLS.cmds and freed.  The held
+// lines of the command are written immediately.
+extern void
+mergeForgetCmd(merge_t *this, cmd_t *cmd)
+{
+  while (cmd->mrg.heapidx != -1) mergeReleaseOne(this, cmd->mrg.heapidx);
+}
+
+extern void
+mergeReport(merge_t *this, FILE *f)
+{
+  fprintf(f, "merge: %s window:%f held:%d maxheld:%d cmds:%d released:%lu "
+	  "forced:%lu\n", (this->on) ? "on" : "off", this->window, this->held,
+	  this->maxheld, this->heapn, this->released, this->forced);
+}
+
+// frees held lines without writing them
+extern void
+mergeCleanup(merge_t *this)
+{
+  for (int i=0; i<this->heapn; i++) {
+    cmd_t   *cmd = this->heap[i];
+    mline_t *ml;
+    while ((ml = cmd->mrg.head)) {
+      cmd->mrg.head = ml->next;
+      free(ml);
+    }
+    cmd->mrg.tail    = NULL;
+    cmd->mrg.heapidx = -1;
+  }
+  if (this->heap) free(this->heap);
+  this->heap    = NULL;
+  this->heapn   = 0;
+  this->heapcap = 0;
+  this->held    = 0;
+  tmrCleanup(&(this->tmr));
+  this->on = false;
+}
+
+extern void
+mergeDump(merge_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%smerge: this=%p on=%d window=%f held=%d maxheld=%d heapn=%d "
+	  "heapcap=%d released=%lu forced=%lu\n", prefix, this, this->on,
+	  this->window, this->held, this->maxheld, this->heapn, this->heapcap,
+	  this->released, this->forced);
+  tmrDump(&(this->tmr), f, prefix);
+}
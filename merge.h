@@ -0,0 +1,62 @@
+#ifndef __YAR_MERGE_H__
+#define __YAR_MERGE_H__
+
+struct cmd;
+
+#define MERGE_DEFAULT_MAXHELD 16384  // lines held before forcing release
+
+// a line held for merging
+typedef struct mline {
+  struct mline   *next;
+  struct timespec ts;       // time the first byte of the line was read
+  int             len;
+  char            data[];
+} mline_t;
+
+// per command merge state (embedded in each cmd_t)
+typedef struct {
+  mline_t        *head;     // held lines (oldest first, so already in
+  mline_t        *tail;     // timestamp order)
+  struct timespec linets;   // read time of first byte of the current line
+  int             heapidx;  // position in the merge heap, -1 if not in it
+} cmdmerge_t;
+
+// Merge Object
+//   Timestamp ordered merge of the line buffered output written to the
+//   broadcast tty.  Each line is stamped with the time its first byte was
+//   read and held for a reorder window.  Lines of a command are already in
+//   timestamp order so only the oldest held line of each command needs
+//   ordering: commands with held lines are kept in a min-heap keyed on that
+//   line's timestamp (O(log N) per line in the number of commands).  Lines
+//   are released in global timestamp order once they are older than the
+//   window.  If more than maxheld lines are held the oldest are released
+//   early so memory is bounded.
+typedef struct {
+  tmr_t            tmr;        // fires when the oldest held line is due
+  struct cmd     **heap;       // min-heap of commands with held lines
+  struct timespec  deadline;   // time tmr is armed for
+  uint64_t         released;   // total lines released
+  uint64_t         forced;     // lines released early as too many were held
+  double           window;     // reorder window in seconds
+  int              heapn;
+  int              heapcap;
+  int              held;       // number of lines held
+  int              maxheld;
+  bool             on;
+} merge_t;
+
+extern bool mergeInit(merge_t *this, bool iszeroed);
+extern bool mergeSet(merge_t *this, char *spec, FILE *f);
+extern void mergeLine(merge_t *this, struct cmd *cmd, char *line, int len,
+		      int epollfd);
+extern void mergeFlush(merge_t *this);
+extern void mergeForgetCmd(merge_t *this, struct cmd *cmd);
+extern void mergeReport(merge_t *this, FILE *f);
+extern void mergeCleanup(merge_t *this);
+extern void mergeDump(merge_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool mergeIsOn(merge_t *this)
+{
+  return this->on;
+}
+#endif
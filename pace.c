@@ -0,0 +1,395 @@
+#include "yar.h"
+
+// only bytes that a console echoes as is are tracked
+static bool
+paceTracked(char c)
+{
+  return ((c >= ' ' && c <= '~') || c == '\r' || c == '\n' || c == '\t');
+}
+
+// a carriage return or newline may be echoed as either (or both)
+static bool
+paceSame(char sent, char echo)
+{
+  if (sent == echo) return true;
+  return ((sent == '\r' || sent == '\n') && (echo == '\r' || echo == '\n'));
+}
+
+static void
+paceSetRate(cmd_t *cmd, double rate)
+{
+  cmdpace_t *pace = &(cmd->pace);
+  if (rate < pace->aimd.min) rate = pace->aimd.min;
+  if (rate > pace->aimd.max) rate = pace->aimd.max;
+  pace->rate = rate;
+  cmd->delay = 1.0 / rate;
+  paceUpdate(&GBLS.pace, cmd);
+}
+
+static void
+paceBackoff(cmd_t *cmd)
+{
+  cmd->pace.backoffs++;
+  paceSetRate(cmd, cmd->pace.rate / 2.0);
+  VLPRINT(2, "%s: backoff rate=%f\n", cmd->name, cmd->pace.rate);
+}
+
+static void
+pacePop(cmdpace_t *pace, int k)
+{
+  pace->head = (pace->head + k) % PACE_WINDOW;
+  pace->n   -= k;
+}
+
+static void
+paceCmdOn(cmd_t *cmd, paceaimd_t *aimd)
+{
+  cmdpace_t *pace = &(cmd->pace);
+  if (!pace->on) pace->basedelay = cmd->delay;
+  pace->aimd = *aimd;
+  pace->on   = true;
+  pace->head = pace->n = 0;
+  paceSetRate(cmd, (pace->basedelay > 0.0) ? 1.0 / pace->basedelay :
+	      aimd->min);
+}
+
+static void
+paceCmdOff(cmd_t *cmd)
+{
+  if (!cmd->pace.on) return;
+  cmd->pace.on = false;
+  cmd->delay   = cmd->pace.basedelay;
+  paceUpdate(&GBLS.pace, cmd);
+}
+
+static void
+paceCmdRate(cmd_t *cmd, double delay, int burst)
+{
+  cmd->pace.on = false;
+  cmd->delay   = delay;
+  cmd->burst   = burst;
+  paceUpdate(&GBLS.pace, cmd);
+}
+
+// the client tty of cmd has been throttled long enough (it stays paused
+// while the command has input pending, see inq.h)
+static evnthdlrrc_t
+paceCmdTmrEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  cmd_t *cmd = obj;
+  if (inqIsWaiting(&(cmd->inq))) return EVNT_HDLR_SUCCESS;
+  VLPRINT(2, "%s: resuming client tty input\n", cmd->name);
+  ttyInputEnable(&(cmd->clttty), epollfd, true);
+  return EVNT_HDLR_SUCCESS;
+}
+
+// the broadcast tty has been throttled long enough
+static evnthdlrrc_t
+paceBcstTmrEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  bcstPause(BCST_PAUSE_PACE, false, epollfd);
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+paceInit(pace_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(pace_t));
+  this->on   = false;
+  this->aimd = (paceaimd_t){ .min = PACE_DEFAULT_MIN, .max = PACE_DEFAULT_MAX,
+			     .inc = PACE_DEFAULT_INC, .lag = PACE_DEFAULT_LAG };
+  bucketInit(&(this->bkt), 0.0, 1, true);
+  return tmrInit(&(this->tmr), paceBcstTmrEvent, this, true);
+}
+
+// str is either a delay in seconds between bytes (burst of 1) or
+// "<rate>/s[:<burst>]" in bytes/sec (burst default PACE_DEFAULT_BURST)
+extern bool
+paceParse(char *str, double *delay, int *burst, FILE *f)
+{
+  char  *end;
+  double v;
+
+  errno = 0;
+  v     = strtod(str, &end);
+  if (errno != 0 || end == str || v < 0.0) {
+    EPRINT(f, "bad delay or rate: %s\n", str);
+    return false;
+  }
+  if (*end == '\0') {
+    *delay = v;
+    *burst = 1;
+    return true;
+  }
+  if (strncmp(end, "/s", 2) != 0 || (end[2] != '\0' && end[2] != ':')) {
+    EPRINT(f, "bad delay or rate: %s\n", str);
+    return false;
+  }
+  *delay = (v > 0.0) ? 1.0 / v : 0.0;
+  *burst = PACE_DEFAULT_BURST;
+  if (end[2] == ':') {
+    char *bstr = &end[3];
+    errno  = 0;
+    *burst = strtol(bstr, &end, 10);
+    if (errno != 0 || end == bstr || *end != '\0' || *burst < 1) {
+      EPRINT(f, "bad burst: %s\n", str);
+      return false;
+    }
+  }
+  return true;
+}
+
+// the broadcast tty is paced for the slowest command
+extern void
+paceBcstUpdate(pace_t *this)
+{
+  cmd_t *slowest = GBLS.slowestcmd;
+  if (slowest) bucketSet(&(this->bkt), slowest->pace.bkt.rate, slowest->burst);
+  else bucketSet(&(this->bkt), 0.0, 1);
+}
+
+// cmd's delay or burst changed.  With adaptive pacing this happens for
+// every byte echoed so the commands are only rescanned for the slowest
+// when its delay falls below that of the runner-up (or the runner-up is
+// not known)
+extern void
+paceUpdate(pace_t *this, cmd_t *cmd)
+{
+  cmd_t *runnerup = GBLS.runnerupcmd;
+
+  bucketSet(&(cmd->pace.bkt), (cmd->delay > 0.0) ? 1.0 / cmd->delay : 0.0,
+	    cmd->burst);
+  if (GBLS.slowestcmd == NULL) {
+    GBLS.slowestcmd = cmd;
+    paceBcstUpdate(this);
+  } else if (GBLS.slowestcmd == cmd) {
+    if (runnerup && cmd->delay >= runnerup->delay) paceBcstUpdate(this);
+    else GBLSFindSlowestCmd();
+  } else if (cmd->delay > GBLS.slowestcmd->delay) {
+    // the old slowest is slower than all the others
+    GBLS.runnerupcmd   = GBLS.slowestcmd;
+    GBLS.runnerupdelay = GBLS.slowestcmd->delay;
+    GBLS.slowestcmd    = cmd;
+    paceBcstUpdate(this);
+  } else if (runnerup == cmd) {
+    // another command may now be the runner-up if its delay fell
+    if (cmd->delay >= GBLS.runnerupdelay) GBLS.runnerupdelay = cmd->delay;
+    else GBLS.runnerupcmd = NULL;
+  } else if (runnerup && cmd->delay > runnerup->delay) {
+    GBLS.runnerupcmd   = cmd;
+    GBLS.runnerupdelay = cmd->delay;
+  }
+}
+
+// the bucket of cmd (or of the broadcast tty if cmd is NULL) is empty:
+// stop reading the tty until a full burst can be sent
+extern void
+paceThrottle(pace_t *this, cmd_t *cmd, int epollfd)
+{
+  bucket_t *bkt = (cmd) ? &(cmd->pace.bkt) : &(this->bkt);
+  tmr_t    *tmr = (cmd) ? &(cmd->pace.tmr) : &(this->tmr);
+
+  if (cmd) {
+    cmd->pace.throttles++;
+    ttyInputEnable(&(cmd->clttty), epollfd, false);
+  } else {
+    this->throttles++;
+    bcstPause(BCST_PAUSE_PACE, true, epollfd);
+  }
+  if (!tmrIsArmed(tmr)) {
+    double wait = bucketWait(bkt, bkt->burst);
+    // the timer cannot be armed with 0
+    tmrArm(tmr, epollfd, (wait > 0.0) ? wait : 1e-6, 0.0);
+  }
+}
+
+// spec is "off", "aimd[:<min>[:<max>[:<inc>[:<lag>]]]]" (rates in
+// bytes/sec, lag in seconds) or a fixed delay or rate (see paceParse).
+// Applies to cmd or, if cmd is NULL, to all commands including those
+// added later
+extern bool
+paceSet(pace_t *this, cmd_t *cmd, char *spec, FILE *f)
+{
+  paceaimd_t aimd = { .min = PACE_DEFAULT_MIN, .max = PACE_DEFAULT_MAX,
+		      .inc = PACE_DEFAULT_INC, .lag = PACE_DEFAULT_LAG };
+  double    *vals[] = { &aimd.min, &aimd.max, &aimd.inc, &aimd.lag };
+  cmd_t     *c, *tmp;
+
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing pace spec\n");
+    return false;
+  }
+  if (strcmp(spec, "off") == 0) {
+    if (cmd) {
+      paceCmdOff(cmd);
+    } else {
+      this->on = false;
+      HASH_ITER(hh, GBLS.cmds, c, tmp) paceCmdOff(c);
+    }
+    return true;
+  }
+  if (strncmp(spec, "aimd", 4) != 0 || (spec[4] != '\0' && spec[4] != ':')) {
+    double delay;
+    int    burst;
+    if (!paceParse(spec, &delay, &burst, f)) return false;
+    if (cmd) {
+      paceCmdRate(cmd, delay, burst);
+    } else {
+      this->on             = false;
+      GBLS.defaultcmddelay = delay;
+      GBLS.defaultcmdburst = burst;
+      HASH_ITER(hh, GBLS.cmds, c, tmp) paceCmdRate(c, delay, burst);
+    }
+    return true;
+  }
+  char *p = &spec[4];
+  for (int i=0; i<4 && *p == ':'; i++) {
+    char *end;
+    errno    = 0;
+    *vals[i] = strtod(p + 1, &end);
+    if (errno != 0 || end == p + 1 || *vals[i] <= 0.0) {
+      EPRINT(f, "bad pace value: %s\n", spec);
+      return false;
+    }
+    p = end;
+  }
+  if (*p != '\0' || aimd.min > aimd.max) {
+    EPRINT(f, "bad pace spec: %s\n", spec);
+    return false;
+  }
+  if (cmd) {
+    paceCmdOn(cmd, &aimd);
+  } else {
+    this->on   = true;
+    this->aimd = aimd;
+    HASH_ITER(hh, GBLS.cmds, c, tmp) paceCmdOn(c, &aimd);
+  }
+  return true;
+}
+
+// must be called after cmd is added to GBLS.cmds
+extern void
+paceAddCmd(pace_t *this, cmd_t *cmd)
+{
+  bucketInit(&(cmd->pace.bkt), 0.0, 1, true);
+  if (!tmrInit(&(cmd->pace.tmr), paceCmdTmrEvent, cmd, true)) NYI;
+  paceUpdate(this, cmd);
+  if (this->on) paceCmdOn(cmd, &(this->aimd));
+}
+
+// must be called before cmd is cleaned up
+extern void
+paceForgetCmd(pace_t *this, cmd_t *cmd)
+{
+  tmrCleanup(&(cmd->pace.tmr));
+}
+
+// c was written to cmd: remember it until it is echoed.  Bytes that have
+// waited longer than lag are given up on (a lag)
+extern void
+paceSent(cmd_t *cmd, char c)
+{
+  cmdpace_t *pace = &(cmd->pace);
+  struct timespec now;
+  bool   late = false;
+
+  if (!paceTracked(c)) return;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  while (pace->n && (pace->n == PACE_WINDOW ||
+		     tsDiff(&now, &(pace->ts[pace->head])) > pace->aimd.lag)) {
+    pacePop(pace, 1);
+    pace->lagged++;
+    late = true;
+  }
+  if (late) paceBackoff(cmd);
+  int i = (pace->head + pace->n) % PACE_WINDOW;
+  pace->sent[i] = c;
+  pace->ts[i]   = now;
+  pace->n++;
+}
+
+// c was output by cmd: if it is the echo of the oldest byte sent the rate
+// is increased.  If it is the echo of a later byte the bytes in between
+// were lost and the rate is decreased
+extern void
+paceEcho(cmd_t *cmd, char c)
+{
+  cmdpace_t *pace = &(cmd->pace);
+  struct timespec now;
+  int    i;
+
+  if (pace->n == 0) return;
+  for (i=0; i<pace->n && i<PACE_SEARCH; i++) {
+    if (paceSame(pace->sent[(pace->head + i) % PACE_WINDOW], c)) break;
+  }
+  if (i == pace->n || i == PACE_SEARCH) return;   // not an echo
+  if (i > 0) {
+    pace->lost += i;
+    pacePop(pace, i + 1);
+    paceBackoff(cmd);
+    return;
+  }
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  // the echo is of the oldest byte sent (i is 0)
+  if (tsDiff(&now, &(pace->ts[pace->head])) > pace->aimd.lag) {
+    pace->lagged++;
+    pacePop(pace, 1);
+    paceBackoff(cmd);
+    return;
+  }
+  pace->clean++;
+  pacePop(pace, 1);
+  paceSetRate(cmd, pace->rate + pace->aimd.inc);
+}
+
+// human readable report of the pacing of each command
+extern void
+paceReport(pace_t *this, FILE *f)
+{
+  cmd_t *cmd, *tmp;
+  fprintf(f, "pace: broadcast rate:%.3f burst:%d waits:%lu throttles:%lu\n",
+	  this->bkt.rate, this->bkt.burst, this->bkt.waits, this->throttles);
+  if (this->on) {
+    fprintf(f, "pace: default:aimd min:%.3f max:%.3f inc:%.3f lag:%.3f\n",
+	    this->aimd.min, this->aimd.max, this->aimd.inc, this->aimd.lag);
+  } else {
+    fprintf(f, "pace: default:static delay:%.6f burst:%d\n",
+	    GBLS.defaultcmddelay, GBLS.defaultcmdburst);
+  }
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    cmdpace_t *pace = &(cmd->pace);
+    if (!pace->on) {
+      fprintf(f, "  %s static rate:%.3f delay:%.6f burst:%d waits:%lu "
+	      "throttles:%lu\n", cmd->name, pace->bkt.rate, cmd->delay,
+	      cmd->burst, pace->bkt.waits, pace->throttles);
+      continue;
+    }
+    fprintf(f, "  %s aimd rate:%.3f delay:%.6f burst:%d waits:%lu "
+	    "throttles:%lu clean:%lu lost:%lu lagged:%lu backoffs:%lu "
+	    "unechoed:%d\n", cmd->name, pace->rate, cmd->delay, cmd->burst,
+	    pace->bkt.waits, pace->throttles, pace->clean, pace->lost,
+	    pace->lagged, pace->backoffs, pace->n);
+  }
+}
+
+extern void
+paceCleanup(pace_t *this)
+{
+  tmrCleanup(&(this->tmr));
+}
+
+extern void
+paceDump(pace_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%space: this=%p on=%d min=%f max=%f inc=%f lag=%f "
+	  "throttles=%lu\n", prefix, this, this->on, this->aimd.min,
+	  this->aimd.max, this->aimd.inc, this->aimd.lag, this->throttles);
+  bucketDump(&(this->bkt), f, prefix);
+  tmrDump(&(this->tmr), f, prefix);
+}
@@ -0,0 +1,82 @@
+#ifndef __YAR_PACE_H__
+#define __YAR_PACE_H__
+
+struct cmd;
+
+#define PACE_WINDOW      64    // bytes sent and awaiting their echo
+#define PACE_SEARCH      8     // how far past a lost echo we look
+#define PACE_DEFAULT_MIN 10.0  // bytes/sec
+#define PACE_DEFAULT_MAX 10000.0
+#define PACE_DEFAULT_INC 1.0   // bytes/sec added per clean echo
+#define PACE_DEFAULT_LAG 0.5   // seconds an echo may take
+#define PACE_DEFAULT_BURST 64  // bytes written at once for <rate>/s specs
+#define PACE_CHUNK       1024  // most bytes read from a tty per event
+
+// adaptive pacing parameters
+typedef struct {
+  double min;          // lowest rate (bytes/sec)
+  double max;          // highest rate (bytes/sec)
+  double inc;          // additive increase per cleanly echoed byte
+  double lag;          // an echo later than this is treated as a loss
+} paceaimd_t;
+
+// per command pacing state (embedded in each cmd_t)
+typedef struct {
+  bucket_t        bkt;               // paces input: rate 1/delay of the cmd
+  tmr_t           tmr;               // re-enables client tty input once
+                                     // the bucket has refilled
+  paceaimd_t      aimd;              // parameters (if on)
+  struct timespec ts[PACE_WINDOW];   // when each byte awaiting echo was sent
+  char            sent[PACE_WINDOW]; // bytes awaiting echo (a ring)
+  double          rate;              // current rate (bytes/sec)
+  double          basedelay;         // delay to restore when turned off
+  uint64_t        clean;             // bytes echoed cleanly
+  uint64_t        lost;              // bytes whose echo was lost
+  uint64_t        lagged;            // echoes that were too late
+  uint64_t        backoffs;          // multiplicative decreases
+  uint64_t        throttles;         // times client tty input was stopped
+                                     // until the bucket refilled
+  int             head;
+  int             n;
+  bool            on;                // adaptive pacing
+} cmdpace_t;
+
+// Pace Object
+//   Input written to a command is paced by a token bucket (see bucket.h)
+//   whose rate is 1/delay of the command and whose depth is the command's
+//   burst.  Bytes are read from the client tty in chunks of up to the
+//   tokens available.  When the bucket is empty input from the tty is
+//   disabled and a timer re-enables it once a full burst has accrued, so a
+//   paced tty costs one wakeup per burst rather than per byte.  The
+//   broadcast tty has its own bucket that follows the slowest command.
+//
+//   Adaptive (AIMD) pacing of the input written to commands that echo it
+//   (eg. serial consoles).  The bytes written to a command are compared
+//   with its output: each byte echoed cleanly and promptly raises the
+//   command's rate additively while a lost or late echo halves it.  The
+//   rate sets the command's delay (the pacing used when reading its client
+//   tty and, via the slowest command, the broadcast tty).  Output that does
+//   not look like an echo is ignored.
+typedef struct {
+  bucket_t   bkt;      // paces the broadcast tty (follows slowest command)
+  tmr_t      tmr;      // re-enables broadcast tty input
+  paceaimd_t aimd;     // parameters given to new commands (if on)
+  uint64_t   throttles; // times broadcast tty input was stopped until the
+                        // bucket refilled
+  bool       on;       // pace new commands adaptively
+} pace_t;
+
+extern bool paceInit(pace_t *this, bool iszeroed);
+extern bool paceParse(char *str, double *delay, int *burst, FILE *f);
+extern bool paceSet(pace_t *this, struct cmd *cmd, char *spec, FILE *f);
+extern void paceUpdate(pace_t *this, struct cmd *cmd);
+extern void paceBcstUpdate(pace_t *this);
+extern void paceThrottle(pace_t *this, struct cmd *cmd, int epollfd);
+extern void paceAddCmd(pace_t *this, struct cmd *cmd);
+extern void paceForgetCmd(pace_t *this, struct cmd *cmd);
+extern void paceSent(struct cmd *cmd, char c);
+extern void paceEcho(struct cmd *cmd, char c);
+extern void paceReport(pace_t *this, FILE *f);
+extern void paceCleanup(pace_t *this);
+extern void paceDump(pace_t *this, FILE *f, char *prefix);
+#endif
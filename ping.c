@@ -0,0 +1,398 @@
+#include "yar.h"
+#include <ctype.h>
+
+// output passed on also makes up the prompt (see pingOutput)
+static void
+pingPass(ping_t *this, cmd_t *cmd, char *buf, int n, int epollfd)
+{
+  for (int i=0; i<n; i++) {
+    pingOutput(this, cmd, buf[i]);
+    cmdOutputChar(cmd, buf[i], epollfd);
+  }
+}
+
+// the probe is done with: output is no longer held
+static void
+pingDone(cmdping_t *p)
+{
+  p->linen    = 0;
+  p->blankn   = 0;
+  p->seq      = 0;
+  p->answered = false;
+  p->waiting  = false;
+}
+
+// pass the held output on as if the probe had never been written
+static void
+pingRelease(ping_t *this, cmd_t *cmd, int epollfd)
+{
+  cmdping_t *p = &(cmd->ping);
+  if (p->answered) {
+    // the part of the prompt matched so far
+    int n = (p->matchn > 0) ? p->matchn : 0;
+    pingDone(p);
+    for (int i=0; i<n; i++) cmdOutputChar(cmd, p->prompt[i], epollfd);
+  } else {
+    int n = p->linen;
+    pingDone(p);
+    pingPass(this, cmd, p->line, n, epollfd);
+  }
+}
+
+// true if the held line (after any blank line held) has the echo of the
+// outstanding probe
+static bool
+pingIsEcho(cmdping_t *p)
+{
+  char tok[48];
+  int  len = snprintf(tok, sizeof(tok), "@YAR\"\"PING:%lu@", p->seq);
+  return memmem(&p->line[p->blankn], p->linen - p->blankn, tok, len) != NULL;
+}
+
+// true if the held line (after any blank line held) has nothing but white
+// space and escape sequences, eg. what readline writes when it accepts the
+// probe's line
+static bool
+pingIsBlank(cmdping_t *p)
+{
+  for (int i=p->blankn; i<p->linen; i++) {
+    if (p->line[i] == '\033' && i+1 < p->linen && p->line[i+1] == '[') {
+      // skip a control sequence: parameters up to the final byte
+      for (i+=2; i<p->linen && (p->line[i] < 0x40 || p->line[i] > 0x7e); i++);
+    } else if (isgraph((unsigned char)p->line[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void
+pingProbe(ping_t *this, cmd_t *cmd, struct timespec *now)
+{
+  cmdping_t *p = &(cmd->ping);
+  char buf[64];
+  // the leading space keeps the probe out of the history of shells that
+  // ignore such lines
+  int  len = snprintf(buf, sizeof(buf), " echo @YAR\"\"PING:%lu@\n",
+		      this->seq + 1);
+
+  if (cmdttyWrite(cmd, buf, len) != len) {
+    VLPRINT(1, "%s: probe did not fit in the tty\n", cmd->name);
+    return;
+  }
+  this->seq++;
+  this->sent++;
+  p->seq      = this->seq;
+  p->sentts   = *now;
+  p->linen    = 0;
+  p->blankn   = 0;
+  p->matchn   = 0;
+  p->sent++;
+  p->answered = false;
+  p->waiting  = true;
+}
+
+// probe the idle commands and give up on the probes that took too long
+static evnthdlrrc_t
+pingTmrEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  ping_t *this = obj;
+  struct timespec now;
+  cmd_t *cmd, *tmp;
+
+  if (this->every == 0.0) {
+    tmrDisarm(&(this->tmr));
+    return EVNT_HDLR_SUCCESS;
+  }
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    cmdping_t *p = &(cmd->ping);
+    if (!cmdIsRunning(cmd)) {
+      // the last of the output of an exited command is not held back
+      if (p->waiting) pingRelease(this, cmd, epollfd);
+      continue;
+    }
+    if (p->pid != cmd->pid) {
+      // a new process: it is idle once it has been quiet for a while
+      p->pid     = cmd->pid;
+      p->lastout = now;
+      p->rbytes  = cmd->cmdtty.rbytes;
+      p->promptn = 0;
+      continue;
+    }
+    if (cmd->cmdtty.rbytes != p->rbytes) {
+      p->rbytes  = cmd->cmdtty.rbytes;
+      p->lastout = now;
+    }
+    if (p->waiting) {
+      if (tsDiff(&now, &(p->sentts)) >= this->timeout) {
+	if (!p->answered) {
+	  VLPRINT(1, "%s: probe %lu not answered\n", cmd->name, p->seq);
+	  p->lost++;
+	  this->lost++;
+	}
+	pingRelease(this, cmd, epollfd);
+      }
+      continue;
+    }
+    // a child yar would broadcast the probe to its nodes (see relay.h)
+    if (p->off || cmd->rly.on || !cmdIsReady(cmd)) continue;
+    if (tsDiff(&now, &(p->lastout))    >= this->every &&
+	tsDiff(&now, &(cmd->lastwrite)) >= this->every &&
+	tsDiff(&now, &(p->sentts))     >= this->every) {
+      pingProbe(this, cmd, &now);
+    }
+  }
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+pingInit(ping_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(ping_t));
+  this->seq      = 0;
+  this->sent     = 0;
+  this->answered = 0;
+  this->lost     = 0;
+  this->every    = 0.0;
+  this->timeout  = PING_DEFAULT_TIMEOUT;
+  this->epollfd  = -1;
+  return tmrInit(&(this->tmr), pingTmrEvent, this, iszeroed);
+}
+
+// spec is "off" or "<every sec>[:<timeout sec>]".  For a cmd it is "on"
+// or "off", whether the command is probed at all
+extern bool
+pingSet(ping_t *this, cmd_t *cmd, char *spec, int epollfd, FILE *f)
+{
+  double every, timeout = PING_DEFAULT_TIMEOUT;
+  char  *end;
+  cmd_t *tmp;
+
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing ping interval\n");
+    return false;
+  }
+  if (epollfd != -1) this->epollfd = epollfd;
+  if (cmd != NULL) {
+    if (strcmp(spec, "on") == 0) {
+      cmd->ping.off = false;
+    } else if (strcmp(spec, "off") == 0) {
+      cmd->ping.off = true;
+      if (cmd->ping.waiting) pingRelease(this, cmd, this->epollfd);
+    } else {
+      EPRINT(f, "bad ping setting: %s\n", spec);
+      return false;
+    }
+    return true;
+  }
+  if (strcmp(spec, "off") == 0) {
+    every = 0.0;
+  } else {
+    errno = 0;
+    every = strtod(spec, &end);
+    if (errno != 0 || end == spec || every <= 0.0 ||
+	(*end != '\0' && *end != ':')) {
+      EPRINT(f, "bad ping interval: %s\n", spec);
+      return false;
+    }
+    if (*end == ':') {
+      char *p = end + 1;
+      timeout = strtod(p, &end);
+      if (errno != 0 || end == p || *end != '\0' || timeout <= 0.0) {
+	EPRINT(f, "bad ping timeout: %s\n", spec);
+	return false;
+      }
+    }
+  }
+  this->every   = every;
+  this->timeout = timeout;
+  if (every == 0.0) {
+    // outstanding probes are abandoned
+    HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+      if (cmd->ping.waiting) pingRelease(this, cmd, this->epollfd);
+    }
+  } else if (this->epollfd != -1 && !tmrIsArmed(&(this->tmr))) {
+    tmrArm(&(this->tmr), this->epollfd, PING_TICK, PING_TICK);
+  }
+  return true;
+}
+
+// a byte of output passed on while probing is on: the output since the
+// last newline is kept as, once the command is idle, it is the prompt the
+// shell writes again after a probe's answer
+extern void
+pingOutput(ping_t *this, cmd_t *cmd, char c)
+{
+  cmdping_t *p = &(cmd->ping);
+  if (c == '\n') p->promptn = 0;
+  else if (p->promptn < 0) return;
+  else if (p->promptn < sizeof(p->prompt)) p->prompt[p->promptn++] = c;
+  else p->promptn = -1;        // too long to be a prompt
+}
+
+// a byte of output of a command with a probe outstanding: lines are held
+// until complete and the echo of the probe and the answer are dropped,
+// followed by the prompt if the shell writes it again.  Returns the number
+// of bytes consumed
+extern int
+pingChar(ping_t *this, cmd_t *cmd, char c, int epollfd)
+{
+  cmdping_t *p = &(cmd->ping);
+  char tok[32];
+  int  len;
+
+  if (p->answered) {
+    if (p->matchn < 0) {
+      // the rest of the answer's line
+      if (c == '\n') {
+	p->matchn = 0;
+	if (p->promptn <= 0) pingDone(p);
+      }
+    } else if (c == p->prompt[p->matchn]) {
+      if (++p->matchn == p->promptn) pingDone(p);
+    } else {
+      // not the prompt after all: pass it on
+      pingRelease(this, cmd, epollfd);
+      pingOutput(this, cmd, c);
+      cmdOutputChar(cmd, c, epollfd);
+    }
+    return 1;
+  }
+  p->line[p->linen++] = c;
+  if (c == '@') {
+    len = snprintf(tok, sizeof(tok), PING_TOKEN "%lu@", p->seq);
+    if (p->linen >= len && memcmp(&p->line[p->linen - len], tok, len) == 0) {
+      struct timespec now;
+      if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+	perror("clock_gettime");
+	NYI;
+      }
+      p->rtt = tsDiff(&now, &(p->sentts));
+      histRecord(&(p->rtts), p->rtt);
+      p->p99 = histPercentile(&(p->rtts), 99.0);
+      this->answered++;
+      // drop the answer's line (and the blank line before it)
+      p->answered = true;
+      p->matchn   = -1;
+      p->linen    = 0;
+      p->blankn   = 0;
+      return 1;
+    }
+  }
+  if (c != '\n' && p->linen < sizeof(p->line)) return 1;
+  if (pingIsEcho(p)) {
+    p->linen  = 0;
+    p->blankn = 0;
+  } else if (c == '\n' && pingIsBlank(p)) {
+    // pass on the blank line held before and hold this one instead
+    int n = p->blankn;
+    pingPass(this, cmd, p->line, n, epollfd);
+    memmove(p->line, &p->line[n], p->linen - n);
+    p->linen -= n;
+    p->blankn = p->linen;
+  } else {
+    // not the probe: pass it on (and keep waiting)
+    int n = p->linen;
+    p->linen  = 0;
+    p->blankn = 0;
+    pingPass(this, cmd, p->line, n, epollfd);
+  }
+  return 1;
+}
+
+// probing starts once the loop is running
+extern void
+pingRegisterEvents(ping_t *this, int epollfd)
+{
+  this->epollfd = epollfd;
+  if (this->every > 0.0) {
+    tmrArm(&(this->tmr), epollfd, PING_TICK, PING_TICK);
+  }
+}
+
+// must be called after cmd is added to GBLS.cmds
+extern void
+pingAddCmd(ping_t *this, cmd_t *cmd)
+{
+  histInit(&(cmd->ping.rtts), true);
+  cmd->ping.pid = -1;
+}
+
+// must be called before cmd is freed
+extern void
+pingForgetCmd(ping_t *this, cmd_t *cmd)
+{
+  histCleanup(&(cmd->ping.rtts));
+}
+
+// the round trip times of cmd (nothing if it has not answered a probe)
+extern void
+pingCmdDesc(cmd_t *cmd, FILE *f)
+{
+  hist_t *h = &(cmd->ping.rtts);
+  if (h->count == 0) return;
+  fprintf(f, " rtt(min/avg/p99):%.6f/%.6f/%.6f", h->min, histMean(h),
+	  cmd->ping.p99);
+}
+
+static int
+p99Cmp(const void *a, const void *b)
+{
+  double pa = (*(cmd_t **)a)->ping.p99;
+  double pb = (*(cmd_t **)b)->ping.p99;
+  return (pa < pb) - (pa > pb);
+}
+
+// human readable report: the settings and totals and then each command,
+// slowest (by p99 round trip time) first
+extern void
+pingReport(ping_t *this, FILE *f)
+{
+  cmd_t *cmd, *tmp, **cmds;
+  int    n = 0;
+
+  fprintf(f, "ping: every:%.3f timeout:%.3f sent:%lu answered:%lu "
+	  "lost:%lu\n", this->every, this->timeout, this->sent,
+	  this->answered, this->lost);
+  cmds = malloc(sizeof(cmd_t *) * (HASH_COUNT(GBLS.cmds) + 1));
+  assert(cmds);
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) cmds[n++] = cmd;
+  qsort(cmds, n, sizeof(cmd_t *), p99Cmp);
+  for (int i=0; i<n; i++) {
+    hist_t *h = &(cmds[i]->ping.rtts);
+    fprintf(f, "  %s sent:%lu lost:%lu", cmds[i]->name, cmds[i]->ping.sent,
+	    cmds[i]->ping.lost);
+    if (h->count) {
+      fprintf(f, " rtt: last:%.6f min:%.6f avg:%.6f p50:%.6f p99:%.6f "
+	      "max:%.6f", cmds[i]->ping.rtt, h->min, histMean(h),
+	      histPercentile(h, 50.0), cmds[i]->ping.p99, h->max);
+    }
+    if (cmds[i]->ping.off) fprintf(f, " off");
+    if (cmds[i]->ping.waiting) fprintf(f, " waiting");
+    fprintf(f, "\n");
+  }
+  free(cmds);
+}
+
+extern void
+pingCleanup(ping_t *this)
+{
+  cmd_t *cmd, *tmp;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) histCleanup(&(cmd->ping.rtts));
+  tmrCleanup(&(this->tmr));
+  this->every = 0.0;
+}
+
+extern void
+pingDump(ping_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sping: this=%p every=%f timeout=%f seq=%lu sent=%lu "
+	  "answered=%lu lost=%lu epollfd=%d\n", prefix, this, this->every,
+	  this->timeout, this->seq, this->sent, this->answered, this->lost,
+	  this->epollfd);
+  tmrDump(&(this->tmr), f, prefix);
+}
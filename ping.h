@@ -0,0 +1,80 @@
+#ifndef __YAR_PING_H__
+#define __YAR_PING_H__
+
+struct cmd;
+
+#define PING_TICK            0.1  // seconds between checks for idle commands
+#define PING_DEFAULT_TIMEOUT 5.0  // seconds to wait for a probe's answer
+#define PING_LINELEN         256  // output held while a probe is outstanding
+#define PING_TOKEN           "@YARPING:"
+
+// per command probe state (embedded in each cmd_t)
+typedef struct {
+  hist_t          rtts;      // round trip times of the answered probes
+  struct timespec sentts;    // time the last probe was written
+  struct timespec lastout;   // last time output was seen
+  uint64_t        rbytes;    // cmdtty bytes read when output was last seen
+  uint64_t        seq;       // sequence number of the outstanding probe
+                             // (0 once it is done with)
+  uint64_t        sent;      // probes written
+  uint64_t        lost;      // probes not answered in time
+  double          rtt;       // round trip time of the last answered probe
+  double          p99;       // 99th percentile of rtts (kept current)
+  pid_t           pid;       // process being probed
+  int             linen;     // bytes in line
+  int             blankn;    // bytes of line that are a blank line held
+                             // until the next shows if it is the answer
+  int             promptn;   // bytes in prompt (-1 line too long)
+  int             matchn;    // bytes of prompt matched after the answer
+                             // (-1 while the answer's line is dropped)
+  char            line[PING_LINELEN];   // current line of output (held)
+  char            prompt[PING_LINELEN]; // output since the last newline
+  bool            waiting;   // a probe is outstanding
+  bool            answered;  // its answer has been seen
+  bool            off;       // not probed (see the ping monitor command)
+} cmdping_t;
+
+// Ping Object
+//   Measures the responsiveness of each command so a sick node (eg. an
+//   overloaded host behind an ssh) stands out.  Every so many seconds
+//   each running, ready command that has been idle (no input or output)
+//   that long is sent ' echo @YAR""PING:<seq>@' (the quotes stop the
+//   tty's echo of the line from looking like the answer) and the time
+//   until '@YARPING:<seq>@' shows up in its output is recorded in a
+//   histogram per command.  While a probe is outstanding the command's
+//   output is held a line at a time: the line with the echo of the probe
+//   and the line with its answer are dropped, as is a blank line just
+//   before the answer (a shell that does not echo only ends the prompt's
+//   line), all other lines are passed on as usual.  The output since the last newline before the probe is
+//   taken to be the shell's prompt and is dropped too if the shell writes
+//   it again after the answer, so neither the client tty nor the
+//   broadcast tty see the probes.  The probes do end up in the shell's
+//   history unless it ignores lines starting with a space (eg. bash's
+//   HISTCONTROL=ignorespace).  A probe that is not answered within
+//   timeout is counted as lost.  Commands that do not run a shell can be
+//   left out (off).  A single timer checks all commands every PING_TICK
+//   while probing is on.
+typedef struct {
+  tmr_t    tmr;              // idle checks (armed while probing is on)
+  uint64_t seq;              // last sequence number (unique over commands)
+  uint64_t sent;             // probes written
+  uint64_t answered;         // probes answered in time
+  uint64_t lost;             // probes not answered in time
+  double   every;            // seconds of idleness between probes (0 off)
+  double   timeout;          // seconds to wait for an answer
+  int      epollfd;
+} ping_t;
+
+extern bool pingInit(ping_t *this, bool iszeroed);
+extern bool pingSet(ping_t *this, struct cmd *cmd, char *spec, int epollfd,
+		    FILE *f);
+extern void pingOutput(ping_t *this, struct cmd *cmd, char c);
+extern int  pingChar(ping_t *this, struct cmd *cmd, char c, int epollfd);
+extern void pingRegisterEvents(ping_t *this, int epollfd);
+extern void pingAddCmd(ping_t *this, struct cmd *cmd);
+extern void pingForgetCmd(ping_t *this, struct cmd *cmd);
+extern void pingCmdDesc(struct cmd *cmd, FILE *f);
+extern void pingReport(ping_t *this, FILE *f);
+extern void pingCleanup(ping_t *this);
+extern void pingDump(ping_t *this, FILE *f, char *prefix);
+#endif
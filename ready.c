@@ -0,0 +1,574 @@
+#include "yar.h"
+
+static readyspec_t *
+readySpecOf(ready_t *this, cmd_t *cmd)
+{
+  return (cmd->rdy.spec) ? cmd->rdy.spec : &(this->spec);
+}
+
+static void
+readySpecCleanup(readyspec_t *spec)
+{
+  for (int i=0; i<spec->nstrs; i++) kmpCleanup(&(spec->strs[i]));
+  spec->nstrs = 0;
+  if (spec->restr) {
+    regfree(&(spec->re));
+    free(spec->restr);
+    spec->restr = NULL;
+  }
+}
+
+// the spec to modify: the command's own (created on first use) or the default
+static readyspec_t *
+readySpecFor(ready_t *this, cmd_t *cmd)
+{
+  if (cmd == NULL) return &(this->spec);
+  if (cmd->rdy.spec == NULL) {
+    cmd->rdy.spec = calloc(1, sizeof(readyspec_t));
+    assert(cmd->rdy.spec);
+  }
+  return cmd->rdy.spec;
+}
+
+static void
+readyResetMatch(cmd_t *cmd)
+{
+  bzero(cmd->rdy.cnts, sizeof(cmd->rdy.cnts));
+  cmd->rdy.linen = 0;
+}
+
+// recompute the number of gated commands that are not ready.  Only done on
+// starts, stops and spec changes so a scan of the commands is fine
+static void
+readyRecount(ready_t *this)
+{
+  cmd_t *cmd, *tmp;
+  this->notready = 0;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (!cmdIsReady(cmd)) this->notready++;
+  }
+}
+
+// a spec changed: match states of the affected commands no longer refer to
+// valid automaton states.  Readiness already established is kept
+static void
+readySpecChanged(ready_t *this, cmd_t *cmd)
+{
+  cmd_t *c, *tmp;
+  HASH_ITER(hh, GBLS.cmds, c, tmp) {
+    if (c == cmd || (cmd == NULL && c->rdy.spec == NULL)) {
+      readyResetMatch(c);
+      standbySpecChanged(&GBLS.standby, c);
+    }
+  }
+  readyRecount(this);
+}
+
+// discard the input held for cmd
+static void
+readyDrop(ready_t *this, cmd_t *cmd)
+{
+  if (cmd->rdy.heldn == 0) return;
+  VLPRINT(1, "%s: dropping %d bytes of held input\n", cmd->name,
+	  cmd->rdy.heldn);
+  cmd->rdy.helddrops += cmd->rdy.heldn;
+  this->drops        += cmd->rdy.heldn;
+  cmd->rdy.heldn      = 0;
+}
+
+// cmd just became ready: write the input held for it.  The held bytes are
+// written in one go (not paced by the command's delay).  What the tty
+// cannot take yet is queued and drained over later turns (see inq.h)
+static void
+readyRelease(ready_t *this, cmd_t *cmd)
+{
+  if (cmd->rdy.heldn == 0) return;
+  inqWrite(&GBLS.inq, cmd, cmd->rdy.held, cmd->rdy.heldn, -1);
+  VLPRINT(2, "%s: released %d held bytes\n", cmd->name, cmd->rdy.heldn);
+  this->released += cmd->rdy.heldn;
+  cmd->rdy.heldn  = 0;
+}
+
+// check four times per timeout: held input lives at most 1.25 timeouts
+static void
+readyArmHold(ready_t *this, int epollfd)
+{
+  tmrArm(&(this->tmr), epollfd, this->holdtimeout / 4.0,
+	 this->holdtimeout / 4.0);
+}
+
+// periodic while input is held: drop held input older than holdtimeout
+static evnthdlrrc_t
+readyHoldTimeout(void *obj, uint32_t evnts, int epollfd)
+{
+  ready_t *this = obj;
+  struct timespec now;
+  cmd_t *cmd, *tmp;
+  bool   held = false;
+
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->rdy.heldn == 0) continue;
+    if (tsDiff(&now, &(cmd->rdy.heldts)) >= this->holdtimeout) {
+      readyDrop(this, cmd);
+    } else {
+      held = true;
+    }
+  }
+  if (!held) tmrDisarm(&(this->tmr));
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+readyInit(ready_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(ready_t));
+  this->spec.nstrs  = 0;
+  this->spec.restr  = NULL;
+  this->notready    = 0;
+  this->holdmax     = READY_DEFAULT_HOLDMAX;
+  this->holdtimeout = 0.0;
+  histInit(&(this->ttrhist), iszeroed);
+  return tmrInit(&(this->tmr), readyHoldTimeout, this, iszeroed);
+}
+
+// spec is "<bytes>[:<timeout>]": the most input held per not ready command
+// and optionally the number of seconds it is held before being dropped
+extern bool
+readySetHold(ready_t *this, char *spec, int epollfd, FILE *f)
+{
+  char  *end;
+  long   max;
+  double timeout = 0.0;
+  cmd_t *cmd, *tmp;
+
+  errno = 0;
+  max = strtol(spec, &end, 10);
+  if (errno != 0 || end == spec || max < 0 || max > INT_MAX ||
+      (*end != '\0' && *end != ':')) {
+    EPRINT(f, "bad ready hold size: %s\n", spec);
+    return false;
+  }
+  if (*end == ':') {
+    char *tend;
+    errno = 0;
+    timeout = strtod(end + 1, &tend);
+    if (errno != 0 || tend == end + 1 || *tend != '\0' || timeout < 0.0) {
+      EPRINT(f, "bad ready hold timeout: %s\n", spec);
+      return false;
+    }
+  }
+  this->holdmax     = max;
+  this->holdtimeout = timeout;
+  tmrDisarm(&(this->tmr));
+  if (timeout == 0.0 || epollfd == -1) return true;
+  // input already held now expires too
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->rdy.heldn) {
+      readyArmHold(this, epollfd);
+      break;
+    }
+  }
+  return true;
+}
+
+// a command that is not ready: if it is ready but for the replay of the
+// journal (see cmdIsReady) replay it so newer input can follow.  Returns
+// true if cmd is now ready
+extern bool
+readyCatchUp(ready_t *this, cmd_t *cmd)
+{
+  if (!cmd->jrnl.pending) return false;
+  // a child yar is only ready once it says hello (see relay.h)
+  if (!cmd->rdy.ready &&
+      (cmd->rly.on || readySpecIsSet(readySpecOf(this, cmd)))) return false;
+  this->notready--;
+  ASSERT(this->notready >= 0);
+  journalReplay(&GBLS.journal, cmd);
+  readyRelease(this, cmd);
+  return true;
+}
+
+// hold broadcast input for cmd until it is ready.  Bytes beyond holdmax are
+// dropped.  Returns len (the input is consumed either way) unless cmd was
+// only waiting for the journal replay and the input is written to it
+extern int
+readyHold(ready_t *this, cmd_t *cmd, char *buf, int len, int epollfd)
+{
+  cmdready_t *rdy = &(cmd->rdy);
+  int         n   = len;
+
+  // input before the command's first output: the replay goes first
+  if (readyCatchUp(this, cmd)) return inqWrite(&GBLS.inq, cmd, buf, len,
+					       epollfd);
+  if (rdy->heldsz < this->holdmax) {
+    // holdmax may have been raised since the buffer was allocated
+    rdy->held = realloc(rdy->held, this->holdmax);
+    assert(rdy->held);
+    rdy->heldsz = this->holdmax;
+  }
+  if (rdy->heldn == 0) {
+    if (clock_gettime(CLOCK_SOURCE, &(rdy->heldts)) == -1) {
+      perror("clock_gettime");
+      NYI;
+    }
+    if (this->holdtimeout > 0.0 && !tmrIsArmed(&(this->tmr)) &&
+	epollfd != -1) {
+      readyArmHold(this, epollfd);
+    }
+  }
+  // holdmax may have been lowered below what is already held
+  if (n > this->holdmax - rdy->heldn) n = this->holdmax - rdy->heldn;
+  if (n < 0) n = 0;
+  if (n > 0) {
+    memcpy(&(rdy->held[rdy->heldn]), buf, n);
+    rdy->heldn += n;
+  }
+  if (n < len) {
+    VLPRINT(2, "%s: hold buffer full dropping %d bytes\n", cmd->name, len - n);
+    rdy->helddrops += len - n;
+    this->drops    += len - n;
+  }
+  return len;
+}
+
+// add a ready string to cmd's spec (default spec if cmd is NULL)
+static bool
+readyAddStr(ready_t *this, cmd_t *cmd, char *str, FILE *f)
+{
+  readyspec_t *spec;
+  if (str == NULL || *str == '\0') {
+    EPRINT(f, "%s", "ready string must not be empty\n");
+    return false;
+  }
+  spec = readySpecFor(this, cmd);
+  if (spec->nstrs == READY_MAXSTRS) {
+    EPRINT(f, "too many ready strings (max %d)\n", READY_MAXSTRS);
+    return false;
+  }
+  if (!kmpInit(&(spec->strs[spec->nstrs]), str)) {
+    EPRINT(f, "%s", "failed to build ready string matcher\n");
+    return false;
+  }
+  spec->nstrs++;
+  readySpecChanged(this, cmd);
+  return true;
+}
+
+// set the ready regex (POSIX extended) of cmd's spec (default if cmd is NULL)
+static bool
+readySetRe(ready_t *this, cmd_t *cmd, char *re, FILE *f)
+{
+  readyspec_t *spec;
+  regex_t      preg;
+  int          rc;
+  if (re == NULL || *re == '\0') {
+    EPRINT(f, "%s", "ready regex must not be empty\n");
+    return false;
+  }
+  rc = regcomp(&preg, re, REG_EXTENDED | REG_NOSUB);
+  if (rc != 0) {
+    char errbuf[128];
+    regerror(rc, &preg, errbuf, sizeof(errbuf));
+    EPRINT(f, "bad ready regex: %s: %s\n", re, errbuf);
+    return false;
+  }
+  spec = readySpecFor(this, cmd);
+  if (spec->restr) {
+    regfree(&(spec->re));
+    free(spec->restr);
+  }
+  spec->re    = preg;
+  spec->restr = strdup(re);
+  readySpecChanged(this, cmd);
+  return true;
+}
+
+// arg is either a ready string to add or /<regex>/ to set the regex
+extern bool
+readyAdd(ready_t *this, cmd_t *cmd, char *arg, FILE *f)
+{
+  int len = (arg) ? strlen(arg) : 0;
+  if (len > 2 && arg[0] == '/' && arg[len-1] == '/') {
+    char *re = strndup(&arg[1], len - 2);
+    bool  rc = readySetRe(this, cmd, re, f);
+    free(re);
+    return rc;
+  }
+  return readyAddStr(this, cmd, arg, f);
+}
+
+// drop cmd's own spec (it reverts to the default) or, if cmd is NULL, empty
+// the default spec
+extern void
+readyClear(ready_t *this, cmd_t *cmd)
+{
+  if (cmd == NULL) {
+    readySpecCleanup(&(this->spec));
+  } else if (cmd->rdy.spec) {
+    readySpecCleanup(cmd->rdy.spec);
+    free(cmd->rdy.spec);
+    cmd->rdy.spec = NULL;
+  }
+  readySpecChanged(this, cmd);
+}
+
+// step the match state (string automata counts and line so far) of cmd's
+// ready spec by an output byte.  Returns true if the spec matched.  The
+// regex is tried once per completed line: trying the line so far on
+// every byte is quadratic in the line length.  Prompts are typically not
+// newline terminated so the callers also try the line so far once they
+// have processed the output read (see readyMatchLine)
+extern bool
+readyMatch(ready_t *this, cmd_t *cmd, int *cnts, char *line, int *linen,
+	   char c)
+{
+  readyspec_t *spec = readySpecOf(this, cmd);
+  bool         hit  = false;
+
+  for (int i=0; i<spec->nstrs; i++) {
+    cnts[i] = kmpStep(&(spec->strs[i]), cnts[i], c);
+    if (kmpMatched(&(spec->strs[i]), cnts[i])) hit = true;
+  }
+  if (spec->restr && !hit) {
+    if (c == '\n') {
+      hit    = readyMatchLine(this, cmd, line, *linen);
+      *linen = 0;
+    } else if (*linen < READY_LINELEN - 1) {
+      line[(*linen)++] = c;
+      line[*linen]     = '\0';
+    }
+  }
+  return hit;
+}
+
+// try cmd's ready regex against line (the line so far kept by readyMatch).
+// Returns true if it matched
+extern bool
+readyMatchLine(ready_t *this, cmd_t *cmd, char *line, int linen)
+{
+  readyspec_t *spec = readySpecOf(this, cmd);
+
+  if (!spec->restr || linen == 0) return false;
+  return (regexec(&(spec->re), line, 0, NULL, 0) == 0);
+}
+
+// feed a byte of output from a command that is not yet ready.  Returns true
+// if the command became ready.  This only happens until the command is
+// ready
+extern bool
+readyChar(ready_t *this, cmd_t *cmd, char c)
+{
+  cmdready_t *rdy = &(cmd->rdy);
+  // a restarted command without a ready spec catches up on its first
+  // output as input written before it has set up its tty can be flushed
+  if (readyCatchUp(this, cmd)) return true;
+  if (!readyMatch(this, cmd, rdy->cnts, rdy->line, &(rdy->linen), c)) {
+    return false;
+  }
+  readyMark(this, cmd);
+  return true;
+}
+
+// the output read from a command that is not yet ready has been processed:
+// try its regex against the line so far (eg. a prompt).  Returns true if
+// the command became ready
+extern bool
+readyPartial(ready_t *this, cmd_t *cmd)
+{
+  cmdready_t *rdy = &(cmd->rdy);
+
+  if (rdy->ready || cmd->rly.on ||
+      !readyMatchLine(this, cmd, rdy->line, rdy->linen)) return false;
+  readyMark(this, cmd);
+  return true;
+}
+
+// cmd has become ready (matched its ready spec or, for a child yar, said
+// hello see relay.h): record its time to ready and release held input
+extern void
+readyMark(ready_t *this, cmd_t *cmd)
+{
+  cmdready_t *rdy = &(cmd->rdy);
+  struct timespec now;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  rdy->ready = true;
+  rdy->ttr   = tsDiff(&now, &(rdy->start));
+  rdy->readies++;
+  histRecord(&(this->ttrhist), rdy->ttr);
+  readyResetMatch(cmd);
+  this->notready--;
+  ASSERT(this->notready >= 0);
+  VPRINT("%p(%s): READY: time to ready %f\n", cmd, cmd->name, rdy->ttr);
+  relayReady(&GBLS.relay, cmd);
+  // a restarted command catches up before it gets the input held for it
+  journalReplay(&GBLS.journal, cmd);
+  readyRelease(this, cmd);
+}
+
+// cmd has been (re)started: it must become ready again.  Commands that are
+// not gated are ready immediately
+extern void
+readyStart(ready_t *this, cmd_t *cmd)
+{
+  if (clock_gettime(CLOCK_SOURCE, &(cmd->rdy.start)) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  // a child yar is only ready once it says hello (see relay.h)
+  cmd->rdy.ready = !cmd->rly.on && !readySpecIsSet(readySpecOf(this, cmd));
+  if (cmd->rdy.ready) cmd->rdy.ttr = 0.0;
+  readyResetMatch(cmd);
+  readyRecount(this);
+  relayReady(&GBLS.relay, cmd);
+}
+
+// cmd has exited or been stopped
+extern void
+readyStop(ready_t *this, cmd_t *cmd)
+{
+  cmd->rdy.ready = false;
+  readyResetMatch(cmd);
+  readyRecount(this);
+  relayReady(&GBLS.relay, cmd);
+}
+
+// must be called after cmd is added to GBLS.cmds: until it is started and
+// becomes ready a gated command holds back broadcast input
+extern void
+readyAddCmd(ready_t *this, cmd_t *cmd)
+{
+  readyRecount(this);
+}
+
+// must be called after cmd is removed from GBLS.cmds and before it is freed
+extern void
+readyForgetCmd(ready_t *this, cmd_t *cmd)
+{
+  readyDrop(this, cmd);
+  if (cmd->rdy.held) {
+    free(cmd->rdy.held);
+    cmd->rdy.held   = NULL;
+    cmd->rdy.heldsz = 0;
+  }
+  if (cmd->rdy.spec) {
+    readySpecCleanup(cmd->rdy.spec);
+    free(cmd->rdy.spec);
+    cmd->rdy.spec = NULL;
+  }
+  readyRecount(this);
+}
+
+static void
+readySpecReport(readyspec_t *spec, FILE *f)
+{
+  if (!readySpecIsSet(spec)) {
+    fprintf(f, "none");
+    return;
+  }
+  for (int i=0; i<spec->nstrs; i++) {
+    fprintf(f, "%s\"%s\"", (i) ? "," : "", spec->strs[i].str);
+  }
+  if (spec->restr) fprintf(f, "%s/%s/", (spec->nstrs) ? "," : "", spec->restr);
+}
+
+static int
+ttrCmp(const void *a, const void *b)
+{
+  double ta = (*(cmd_t **)a)->rdy.ttr;
+  double tb = (*(cmd_t **)b)->rdy.ttr;
+  return (ta < tb) - (ta > tb);
+}
+
+// human readable report: the default spec, a time to ready summary and then
+// each command, slowest to become ready first (commands still waiting are
+// listed before those that are ready)
+extern void
+readyReport(ready_t *this, FILE *f)
+{
+  struct timespec now;
+  hist_t *h = &(this->ttrhist);
+  cmd_t  *cmd, *tmp, **cmds;
+  int     n = 0;
+
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  fprintf(f, "ready: spec:");
+  readySpecReport(&(this->spec), f);
+  fprintf(f, " notready:%d readies:%lu ttr: mean:%.6f p50:%.6f p99:%.6f "
+	  "max:%.6f\n", this->notready, h->count, histMean(h),
+	  histPercentile(h, 50.0), histPercentile(h, 99.0),
+	  (h->count) ? h->max : 0.0);
+  fprintf(f, "hold: max:%d timeout:%.3f released:%lu drops:%lu\n",
+	  this->holdmax, this->holdtimeout, this->released, this->drops);
+  cmds = malloc(sizeof(cmd_t *) * (HASH_COUNT(GBLS.cmds) + 1));
+  assert(cmds);
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) cmds[n++] = cmd;
+  qsort(cmds, n, sizeof(cmd_t *), ttrCmp);
+  for (int pass=0; pass<2; pass++) {
+    for (int i=0; i<n; i++) {
+      cmd = cmds[i];
+      if (cmdIsReady(cmd) == (pass == 0)) continue;
+      if (cmdIsReady(cmd)) {
+	fprintf(f, "  %s ready ttr:%.6f readies:%lu", cmd->name, cmd->rdy.ttr,
+		cmd->rdy.readies);
+      } else if (cmdIsRunning(cmd)) {
+	fprintf(f, "  %s waiting:%.6f readies:%lu held:%d drops:%lu",
+		cmd->name, tsDiff(&now, &(cmd->rdy.start)), cmd->rdy.readies,
+		cmd->rdy.heldn, cmd->rdy.helddrops);
+      } else {
+	fprintf(f, "  %s stopped readies:%lu held:%d drops:%lu", cmd->name,
+		cmd->rdy.readies, cmd->rdy.heldn, cmd->rdy.helddrops);
+      }
+      if (cmd->rdy.spec) {
+	fprintf(f, " spec:");
+	readySpecReport(cmd->rdy.spec, f);
+      }
+      fprintf(f, "\n");
+    }
+  }
+  free(cmds);
+}
+
+// releases the default spec and every command's own spec
+extern void
+readyCleanup(ready_t *this)
+{
+  cmd_t *cmd, *tmp;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->rdy.spec) {
+      readySpecCleanup(cmd->rdy.spec);
+      free(cmd->rdy.spec);
+      cmd->rdy.spec = NULL;
+    }
+    if (cmd->rdy.held) {
+      free(cmd->rdy.held);
+      cmd->rdy.held   = NULL;
+      cmd->rdy.heldsz = 0;
+      cmd->rdy.heldn  = 0;
+    }
+  }
+  tmrCleanup(&(this->tmr));
+  readySpecCleanup(&(this->spec));
+  histCleanup(&(this->ttrhist));
+  this->notready = 0;
+}
+
+extern void
+readyDump(ready_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sready: this=%p nstrs=%d restr=%s notready=%d readies=%lu "
+	  "holdmax=%d holdtimeout=%f released=%lu drops=%lu\n",
+	  prefix, this, this->spec.nstrs, this->spec.restr, this->notready,
+	  this->ttrhist.count, this->holdmax, this->holdtimeout, this->released,
+	  this->drops);
+  tmrDump(&(this->tmr), f, prefix);
+}
@@ -0,0 +1,86 @@
+#ifndef __YAR_READY_H__
+#define __YAR_READY_H__
+
+#include <regex.h>
+
+struct cmd;
+
+#define READY_MAXSTRS 8    // ready strings per spec
+#define READY_LINELEN 256  // bytes of a line kept for regex matching
+#define READY_DEFAULT_HOLDMAX 4096 // bytes of input held per not ready command
+
+// what a command must output to be considered ready: any one of a set of
+// strings or a line (or the line so far, eg. a prompt, once the output
+// read has been processed) matching a regular expression
+typedef struct {
+  kmp_t    strs[READY_MAXSTRS]; // string matchers
+  regex_t  re;                  // compiled regex (valid if restr != NULL)
+  char    *restr;               // source of regex, NULL if none
+  int      nstrs;
+} readyspec_t;
+
+// per command ready state (embedded in each cmd_t)
+typedef struct {
+  readyspec_t    *spec;                // own spec, NULL to use the default
+  struct timespec start;               // time the command was last started
+  double          ttr;                 // time to ready of the last start
+  uint64_t        readies;             // number of times it became ready
+  int             cnts[READY_MAXSTRS]; // match state of each string
+  char            line[READY_LINELEN]; // current line (truncated)
+  char           *held;                // input held until ready
+  int             heldsz;              // bytes allocated for held
+  struct timespec heldts;              // time the oldest held byte arrived
+  uint64_t        helddrops;           // bytes dropped (full or timed out)
+  int             heldn;               // bytes held
+  int             linen;
+  bool            ready;               // matched since the last start
+} cmdready_t;
+
+// Ready Object
+//   Decides when a command is ready to be written to.  Until a command
+//   whose spec is not empty has output one of its ready strings (or a line
+//   matching its regex) input from its client tty and the broadcast tty is
+//   held back.  Strings are matched incrementally with KMP automata (see
+//   match.h) so each byte of output costs one table lookup per string.  The
+//   time from a command's start to it becoming ready is recorded.
+//   Broadcast input for a command that is not ready is held (up to holdmax
+//   bytes, optionally for at most holdtimeout seconds) and written to it
+//   when it becomes ready so that ready commands are never held up.
+typedef struct {
+  readyspec_t spec;        // default spec (-R) used by commands without one
+  hist_t      ttrhist;     // time to ready of all commands
+  tmr_t       tmr;         // expires held input (if holdtimeout)
+  double      holdtimeout; // seconds held input is kept, 0 forever
+  uint64_t    released;    // held bytes written once commands were ready
+  uint64_t    drops;       // held bytes dropped
+  int         holdmax;     // max bytes held per command
+  int         notready;    // gated commands that are not ready
+} ready_t;
+
+extern bool readyInit(ready_t *this, bool iszeroed);
+extern bool readySetHold(ready_t *this, char *spec, int epollfd, FILE *f);
+extern int  readyHold(ready_t *this, struct cmd *cmd, char *buf, int len,
+		      int epollfd);
+extern bool readyAdd(ready_t *this, struct cmd *cmd, char *arg, FILE *f);
+extern void readyClear(ready_t *this, struct cmd *cmd);
+extern bool readyMatch(ready_t *this, struct cmd *cmd, int *cnts, char *line,
+		       int *linen, char c);
+extern bool readyMatchLine(ready_t *this, struct cmd *cmd, char *line,
+			   int linen);
+extern bool readyChar(ready_t *this, struct cmd *cmd, char c);
+extern bool readyPartial(ready_t *this, struct cmd *cmd);
+extern bool readyCatchUp(ready_t *this, struct cmd *cmd);
+extern void readyMark(ready_t *this, struct cmd *cmd);
+extern void readyStart(ready_t *this, struct cmd *cmd);
+extern void readyStop(ready_t *this, struct cmd *cmd);
+extern void readyAddCmd(ready_t *this, struct cmd *cmd);
+extern void readyForgetCmd(ready_t *this, struct cmd *cmd);
+extern void readyReport(ready_t *this, FILE *f);
+extern void readyCleanup(ready_t *this);
+extern void readyDump(ready_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool readySpecIsSet(readyspec_t *spec)
+{
+  return (spec->nstrs != 0 || spec->restr != NULL);
+}
+#endif
@@ -0,0 +1,203 @@
+#include "yar.h"
+#include <math.h>
+
+// extract the number from line (which is nul terminated).  Returns false if
+// the line has no such field or the field does not start with a finite
+// decimal number (strtod would also take nan, inf and hex)
+static bool
+reduceExtract(reduce_t *this, char *line, double *v)
+{
+  char *start, *end;
+
+  if (this->column) {
+    int i = 0, field;
+    start = NULL;
+    for (field=1; field<=this->column; field++) {
+      while (line[i]==' ' || line[i]=='\t') i++;
+      if (line[i]=='\0') return false;
+      start = &line[i];
+      while (line[i] && line[i]!=' ' && line[i]!='\t') i++;
+    }
+  } else {
+    regmatch_t m[2];
+    if (regexec(&(this->re), line, 2, m, 0) != 0) return false;
+    int sub = (this->re.re_nsub > 0 && m[1].rm_so != -1) ? 1 : 0;
+    start = &line[m[sub].rm_so];
+  }
+  errno = 0;
+  *v = strtod(start, &end);
+  if (end == start || errno != 0 || !isfinite(*v)) return false;
+  if (*start == '+' || *start == '-') start++;
+  return !(start[0] == '0' && (start[1] == 'x' || start[1] == 'X'));
+}
+
+static evnthdlrrc_t
+reduceTimeout(void *obj, uint32_t evnts, int epollfd)
+{
+  reduceFlush(obj);
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+reduceInit(reduce_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(reduce_t));
+  this->spec       = NULL;
+  this->summary[0] = '\0';
+  this->epollfd    = -1;
+  this->on         = false;
+  histInit(&(this->hist), iszeroed);
+  return tmrInit(&(this->tmr), reduceTimeout, this, iszeroed);
+}
+
+// spec is "off" or <timeout>:<column> or <timeout>:/<regex>/
+extern bool
+reduceSet(reduce_t *this, char *spec, FILE *f)
+{
+  char  *end;
+  double timeout;
+  int    column = 0;
+  regex_t re;
+
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing reduce spec\n");
+    return false;
+  }
+  if (strcmp(spec, "off") == 0) {
+    reduceFlush(this);
+    if (this->on && this->column == 0) regfree(&(this->re));
+    this->on = false;
+    return true;
+  }
+  errno = 0;
+  timeout = strtod(spec, &end);
+  if (errno != 0 || end == spec || timeout < 0.0 || *end != ':') {
+    EPRINT(f, "bad reduce spec (expected <timeout>:<field>): %s\n", spec);
+    return false;
+  }
+  end++;
+  if (*end == '/') {
+    int   len = strlen(end);
+    char *pat;
+    if (len < 3 || end[len-1] != '/') {
+      EPRINT(f, "bad reduce regex (expected /<regex>/): %s\n", end);
+      return false;
+    }
+    pat = strndup(end+1, len-2);
+    int rc = regcomp(&re, pat, REG_EXTENDED);
+    free(pat);
+    if (rc != 0) {
+      char err[128];
+      regerror(rc, &re, err, sizeof(err));
+      EPRINT(f, "bad reduce regex: %s\n", err);
+      return false;
+    }
+  } else {
+    char *cend;
+    column = strtol(end, &cend, 10);
+    if (*cend != '\0' || cend == end || column < 1) {
+      EPRINT(f, "bad reduce column: %s\n", end);
+      return false;
+    }
+  }
+  // values of the current round were extracted under the old spec
+  reduceFlush(this);
+  if (this->on && this->column == 0) regfree(&(this->re));
+  if (column == 0) this->re = re;
+  if (this->spec) free(this->spec);
+  this->spec    = strdup(spec);
+  this->column  = column;
+  this->timeout = timeout;
+  this->on      = true;
+  return true;
+}
+
+// fold a complete line output by cmd into the current round.  Returns true
+// if the line was consumed (a number was extracted)
+extern bool
+reduceLine(reduce_t *this, cmd_t *cmd, char *line, int len, int epollfd)
+{
+  char   buf[CMD_BUFSIZE+1];
+  double v;
+  bool   rc = false;
+
+  this->epollfd = epollfd;
+  while (len && (line[len-1] == '\n' || line[len-1] == '\r')) len--;
+  memcpy(buf, line, len);
+  buf[len] = '\0';
+  if (reduceExtract(this, buf, &v)) {
+    if (this->hist.count == 0 && this->timeout > 0.0) {
+      // first value of a round starts the round's clock
+      tmrArm(&(this->tmr), epollfd, this->timeout, 0.0);
+    }
+    histRecord(&(this->hist), v);
+    rc = true;
+  } else {
+    VLPRINT(2, "%s: no value in: %s\n", cmd->name, buf);
+    this->skipped++;
+  }
+  if (this->barrier) reduceFlush(this);
+  return rc;
+}
+
+// end the round: summarize it on the broadcast tty
+extern void
+reduceFlush(reduce_t *this)
+{
+  hist_t *h = &(this->hist);
+  int     n;
+
+  tmrDisarm(&(this->tmr));
+  this->barrier = false;
+  if (h->count == 0) return;
+  n = snprintf(this->summary, sizeof(this->summary),
+	       "reduce: n=%lu sum=%g min=%g max=%g mean=%g p50=%g p90=%g "
+	       "p99=%g\n", h->count, h->sum, h->min, h->max, histMean(h),
+	       histPercentile(h, 50.0), histPercentile(h, 90.0),
+	       histPercentile(h, 99.0));
+  if (n >= sizeof(this->summary)) n = sizeof(this->summary) - 1;
+  if (GBLS.bcstflg) {
+    fairqWrite(&GBLS.fairq, NULL, this->summary, n, this->epollfd);
+  }
+  histReset(h);
+  this->rounds++;
+}
+
+// see coalesceBarrier
+extern void
+reduceBarrier(reduce_t *this, bool now)
+{
+  if (!this->on) return;
+  if (now) reduceFlush(this);
+  else this->barrier = true;
+}
+
+extern void
+reduceReport(reduce_t *this, FILE *f)
+{
+  fprintf(f, "reduce: %s spec:%s pending:%lu rounds:%lu skipped:%lu\n",
+	  (this->on) ? "on" : "off", (this->spec) ? this->spec : "",
+	  this->hist.count, this->rounds, this->skipped);
+  if (this->summary[0]) fprintf(f, "last %s", this->summary);
+}
+
+extern void
+reduceCleanup(reduce_t *this)
+{
+  tmrCleanup(&(this->tmr));
+  histCleanup(&(this->hist));
+  if (this->on && this->column == 0) regfree(&(this->re));
+  if (this->spec) free(this->spec);
+  this->spec = NULL;
+  this->on   = false;
+}
+
+extern void
+reduceDump(reduce_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sreduce: this=%p on=%d spec=%s column=%d timeout=%f "
+	  "count=%lu rounds=%lu skipped=%lu\n", prefix, this, this->on,
+	  this->spec, this->column, this->timeout, this->hist.count,
+	  this->rounds, this->skipped);
+  tmrDump(&(this->tmr), f, prefix);
+}
@@ -0,0 +1,49 @@
+#ifndef __YAR_REDUCE_H__
+#define __YAR_REDUCE_H__
+
+#include <regex.h>
+
+struct cmd;
+
+#define REDUCE_SUMMARYLEN 256
+
+// Reduce Object
+//   Numeric reduction of the line buffered output of the commands.  A number
+//   is extracted from each complete line, either from a whitespace separated
+//   column or from the text matched by a regular expression (its first
+//   subexpression if it has one), and folded into streaming aggregates
+//   (count/sum/min/max and a histogram for percentiles).  Lines that yield
+//   a number are consumed; other lines pass through.  At the end of a round
+//   (timeout after its first value, a completed gather or via the monitor)
+//   a single summary line is written to the broadcast tty, queued like
+//   command output if it is full (see fairq.h).
+typedef struct {
+  tmr_t     tmr;                        // round timeout
+  hist_t    hist;                       // aggregates of the current round
+  regex_t   re;                         // compiled field regex
+  char     *spec;                       // spec as given
+  char      summary[REDUCE_SUMMARYLEN]; // summary of the last round
+  uint64_t  rounds;                     // number of rounds completed
+  uint64_t  skipped;                    // lines passed through (no number)
+  double    timeout;                    // seconds a round stays open
+  int       column;                     // 1..n column of field, 0 use re
+  int       epollfd;                    // for flushes outside our events
+  bool      on;
+  bool      barrier;                    // end round after the current line
+} reduce_t;
+
+extern bool reduceInit(reduce_t *this, bool iszeroed);
+extern bool reduceSet(reduce_t *this, char *spec, FILE *f);
+extern bool reduceLine(reduce_t *this, struct cmd *cmd, char *line, int len,
+		       int epollfd);
+extern void reduceFlush(reduce_t *this);
+extern void reduceBarrier(reduce_t *this, bool now);
+extern void reduceReport(reduce_t *this, FILE *f);
+extern void reduceCleanup(reduce_t *this);
+extern void reduceDump(reduce_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool reduceIsOn(reduce_t *this)
+{
+  return this->on;
+}
+#endif
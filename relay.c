@@ -0,0 +1,643 @@
+#include "yar.h"
+#include <fcntl.h>
+
+// FRAMES
+// a frame is RELAY_SYNC, the type, the length of the name, the length of the
+// payload (2 bytes big endian) followed by the name and the payload.  Build a
+// frame whose name is pre/name (either can be NULL) and whose payload is the
+// concatenation of bufs (both are truncated if too long).  Returns the
+// length of the frame
+static int
+relayFrame(char *frame, char type, char *pre, char *name, char **bufs,
+	   int *lens, int nbufs)
+{
+  int n = RELAY_HDRLEN, namelen = 0, len = 0;
+
+  if (pre && name) {
+    namelen = snprintf(&frame[n], RELAY_MAXNAME+1, "%s/%s", pre, name);
+  } else if (pre || name) {
+    namelen = snprintf(&frame[n], RELAY_MAXNAME+1, "%s", (pre) ? pre : name);
+  }
+  if (namelen > RELAY_MAXNAME) namelen = RELAY_MAXNAME;
+  n += namelen;
+  for (int b=0; b<nbufs; b++) {
+    int l = lens[b];
+    if (len + l > RELAY_MAXDATA) l = RELAY_MAXDATA - len;
+    memcpy(&frame[n], bufs[b], l);
+    n   += l;
+    len += l;
+  }
+  frame[0] = RELAY_SYNC;
+  frame[1] = type;
+  frame[2] = namelen;
+  frame[3] = (len >> 8) & 0xff;
+  frame[4] = len & 0xff;
+  return n;
+}
+
+// feed a received byte to f.  Returns true when f holds a complete frame.
+// Bytes outside of frames (eg. noise from a child yar before it has taken
+// over its stdout) are skipped
+static bool
+relayFrameByte(relayframe_t *f, uint8_t c)
+{
+  if (f->hdrn < RELAY_HDRLEN) {
+    if (f->hdrn == 0 && c != RELAY_SYNC) {
+      f->skipped++;
+      return false;
+    }
+    f->hdr[f->hdrn++] = c;
+    if (f->hdrn < RELAY_HDRLEN) return false;
+    f->type    = f->hdr[1];
+    f->namelen = f->hdr[2];
+    f->len     = (f->hdr[3] << 8) | f->hdr[4];
+    f->got     = 0;
+    if (f->len > RELAY_MAXDATA) {
+      f->skipped += RELAY_HDRLEN;
+      f->hdrn     = 0;
+      return false;
+    }
+  } else if (f->got < f->namelen) {
+    f->name[f->got++] = c;
+  } else {
+    f->data[f->got++ - f->namelen] = c;
+  }
+  if (f->got < f->namelen + f->len) return false;
+  f->name[f->namelen] = '\0';
+  f->data[f->len]     = '\0';
+  f->hdrn             = 0;
+  return true;
+}
+
+// UPLINK: a child yar's side
+// send a frame to the parent.  The write blocks if the parent is not
+// keeping up: that is the backpressure on the child's nodes
+static void
+relayUp(relay_t *this, char type, char *pre, char *name, char **bufs,
+	int *lens, int nbufs)
+{
+  char frame[RELAY_FRAMEMAX];
+  int  n = relayFrame(frame, type, pre, name, bufs, lens, nbufs);
+
+  for (int w=0; w<n; ) {
+    int rc = write(this->outfd, &frame[w], n - w);
+    if (rc == -1) {
+      if (errno == EINTR) continue;
+      // the parent has gone away
+      perror("relay write");
+      EEXIT();
+    }
+    w += rc;
+  }
+  this->upframes++;
+}
+
+static void
+relayUpStr(relay_t *this, char type, char *pre, char *name, char *str)
+{
+  int len = strlen(str);
+  relayUp(this, type, pre, name, &str, &len, 1);
+}
+
+// periodic: send the stats of the nodes that have changed
+static evnthdlrrc_t
+relayTmrEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  relay_t *this = obj;
+  cmd_t   *cmd, *tmp;
+  char     str[80];
+
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    cmdrelay_t *rly = &(cmd->rly);
+    if (cmd->cmdtty.wbytes == rly->upin && cmd->cmdtty.rbytes == rly->upout &&
+	cmd->restartcnt == rly->uprestarts) continue;
+    rly->upin       = cmd->cmdtty.wbytes;
+    rly->upout      = cmd->cmdtty.rbytes;
+    rly->uprestarts = cmd->restartcnt;
+    snprintf(str, sizeof(str), "%lu %lu %d", rly->upin, rly->upout,
+	     rly->uprestarts);
+    relayUpStr(this, RELAY_STATS, NULL, cmd->name, str);
+  }
+  return EVNT_HDLR_SUCCESS;
+}
+
+// a frame from the parent: input for all the nodes or for one of them
+static void
+relayFromParent(relay_t *this, relayframe_t *f, int epollfd)
+{
+  this->downframes++;
+  if (f->type != RELAY_DATA) {
+    EPRINT(stderr, "unexpected frame type from parent: 0x%02x\n", f->type);
+    return;
+  }
+  if (f->namelen == 0) bcstInput(f->data, f->len, epollfd);
+  else relaySend(this, f->name, f->data, f->len, epollfd, stderr);
+}
+
+static evnthdlrrc_t
+relayEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  relay_t *this = obj;
+  char     buf[RELAY_FRAMEMAX];
+  int      n;
+
+  if (evnts & EPOLLIN) {
+    n = read(this->infd, buf, sizeof(buf));
+    if (n == -1 && errno == EINTR) return EVNT_HDLR_SUCCESS;
+    if (n <= 0) {
+      // the parent has closed our tty: nothing more to do
+      VLPRINT(1, "%s: parent gone exiting\n", this->path);
+      return EVNT_HDLR_EXIT_LOOP;
+    }
+    for (int i=0; i<n; i++) {
+      if (relayFrameByte(&(this->in), buf[i])) {
+	relayFromParent(this, &(this->in), epollfd);
+      }
+    }
+  } else if (evnts & (EPOLLHUP | EPOLLERR)) {
+    VLPRINT(1, "%s: parent hung up exiting\n", this->path);
+    return EVNT_HDLR_EXIT_LOOP;
+  }
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+relayInit(relay_t *this, bool iszeroed)
+{
+  char exe[PATH_MAX];
+  int  n;
+
+  if (!iszeroed) bzero(this, sizeof(relay_t));
+  this->infd    = -1;
+  this->outfd   = -1;
+  this->epollfd = -1;
+  n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  if (n == -1) {
+    perror("readlink /proc/self/exe");
+    return false;
+  }
+  exe[n]    = '\0';
+  this->exe = strdup(exe);
+  return tmrInit(&(this->tmr), relayTmrEvent, this, true);
+}
+
+// -Y: this yar is the child of another.  Its stdin and stdout (the tty of
+// the relay command in the parent) become the uplink and nothing else may
+// write to them: stdin, stdout and stderr are switched to /dev/null (or the
+// log see -L).  The parent is told that we are up
+extern bool
+relayUplinkCreate(relay_t *this)
+{
+  this->infd  = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0);
+  this->outfd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+  if (this->infd == -1 || this->outfd == -1) {
+    perror("relay dup");
+    return false;
+  }
+  if (freopen("/dev/null", "r", stdin) == NULL ||
+      freopen("/dev/null", "w", stdout) == NULL ||
+      freopen("/dev/null", "w", stderr) == NULL) {
+    return false;
+  }
+  this->ed = (evntdesc_t){ .hdlr = relayEvent, .obj = this };
+  relayUpStr(this, RELAY_HELLO, NULL, NULL, "");
+  return true;
+}
+
+// enable or disable input from the parent (broadcast input for a child
+// yar, see bcstPause)
+extern void
+relayUplinkEnable(relay_t *this, int epollfd, bool enable)
+{
+  struct epoll_event ev;
+
+  ASSERT(this->uplink && epollfd != -1);
+  ev.events   = EPOLLHUP | EPOLLERR;  // Level
+  if (enable) ev.events |= EPOLLIN;
+  ev.data.ptr = &(this->ed);
+  if (epoll_ctl(epollfd, EPOLL_CTL_MOD, this->infd, &ev) == -1) {
+    perror("epoll_ctl: EPOLL_CTL_MOD relay->infd");
+    NYI;
+  }
+}
+
+// a child yar's commands are started as soon as it runs (rather than when
+// its broadcast tty is opened) and its node stats are sent periodically
+extern void
+relayRegisterEvents(relay_t *this, int epollfd)
+{
+  struct epoll_event ev;
+  cmd_t *cmd, *tmp;
+
+  this->epollfd = epollfd;
+  if (!this->uplink) return;
+  ev.events   = EPOLLIN | EPOLLHUP | EPOLLERR;  // Level
+  ev.data.ptr = &(this->ed);
+  if (epoll_ctl(epollfd, EPOLL_CTL_ADD, this->infd, &ev) == -1) {
+    perror("epoll_ctl: relay->infd");
+    NYI;
+  }
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmdStart(cmd, true, epollfd, 0.0)) {
+      VPRINT("%s started pidfd=%d pid=%d\n", cmd->name, cmd->pidfd, cmd->pid);
+    }
+  }
+  if (!tmrArm(&(this->tmr), epollfd, RELAY_INTERVAL, RELAY_INTERVAL)) NYI;
+}
+
+// a line of output of cmd (this yar is a child)
+extern void
+relayOutput(relay_t *this, cmd_t *cmd, char **seg, int *seglen, int segs)
+{
+  relayUp(this, RELAY_OUT, NULL, cmd->name, seg, seglen, segs);
+}
+
+// cmd's readiness may have changed (this yar is a child)
+extern void
+relayReady(relay_t *this, cmd_t *cmd)
+{
+  bool ready;
+
+  if (!this->uplink) return;
+  ready = cmdIsReady(cmd);
+  if (ready == cmd->rly.upready) return;
+  cmd->rly.upready = ready;
+  relayUpStr(this, RELAY_READY, NULL, cmd->name, (ready) ? "1" : "0");
+}
+
+// RELAY COMMANDS: a parent yar's side
+// the shell command line that runs the child yar of cmd.  Its path in the
+// tree is passed down so that the defaults for its client tty links are
+// unique (eg. rack1.n3)
+extern char *
+relayCmdline(relay_t *this, cmd_t *cmd)
+{
+  char *line;
+  if (this->path) {
+    assert(asprintf(&line, "exec '%s' -Y '%s.%s' %s", this->exe, this->path,
+		    cmd->name, &(cmd->cmdline[1])) != -1);
+  } else {
+    assert(asprintf(&line, "exec '%s' -Y '%s' %s", this->exe, cmd->name,
+		    &(cmd->cmdline[1])) != -1);
+  }
+  return line;
+}
+
+// stop waiting to write to cmd's child yar: the rest of the frame has been
+// written or is dropped
+static void
+relayUnwait(relay_t *this, cmd_t *cmd)
+{
+  cmdrelay_t *rly = &(cmd->rly);
+
+  rly->restn = 0;
+  if (rly->wfd == -1) return;
+  if (epoll_ctl(this->epollfd, EPOLL_CTL_DEL, rly->wfd, NULL) == -1) {
+    perror("epoll_ctl: EPOLL_CTL_DEL relay wfd");
+    NYI;
+  }
+  close(rly->wfd);
+  rly->wfd = -1;
+  this->full--;
+  if (this->full == 0) bcstPause(BCST_PAUSE_RELAY, false, this->epollfd);
+}
+
+// cmd's child yar has made room: write more of the rest of the frame.  If
+// the child has gone the rest is dropped (a new child starts a new stream)
+static evnthdlrrc_t
+relayWriteEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  cmd_t      *cmd = obj;
+  cmdrelay_t *rly = &(cmd->rly);
+  int         w;
+
+  VLPRINT(3, "START: %s fd:%d evnts:0x%08x\n", cmd->name, rly->wfd, evnts);
+  w = ttyWriteBuf(&(cmd->cmdtty), &(rly->rest[rly->restoff]), rly->restn,
+		  &(cmd->lastwrite));
+  if (w > 0) {
+    rly->restoff += w;
+    rly->restn   -= w;
+  } else if (cmd->cmdtty.opens == 0 || (evnts & (EPOLLHUP | EPOLLERR))) {
+    VLPRINT(1, "%s: child yar gone dropping %d bytes\n", cmd->name,
+	    rly->restn);
+    rly->restn = 0;
+  }
+  if (rly->restn == 0) relayUnwait(&GBLS.relay, cmd);
+  return EVNT_HDLR_SUCCESS;
+}
+
+// a frame that has only been partly written must be finished before
+// anything else is written to the child yar (the rest of the stream would
+// be misframed).  The rest is kept and written as the child makes room
+static void
+relayFinish(relay_t *this, cmd_t *cmd, char *buf, int len)
+{
+  cmdrelay_t        *rly = &(cmd->rly);
+  struct epoll_event ev;
+
+  ASSERT(this->epollfd != -1 && rly->wfd == -1);
+  memcpy(rly->rest, buf, len);
+  rly->restoff = 0;
+  rly->restn   = len;
+  rly->wfd     = dup(cmd->cmdtty.dfd);
+  if (rly->wfd == -1) {
+    perror("dup: relay cmdtty dfd");
+    NYI;
+  }
+  assert(fcntl(rly->wfd, F_SETFD, FD_CLOEXEC)!=-1);
+  rly->ed     = (evntdesc_t){ .hdlr = relayWriteEvent, .obj = cmd };
+  ev.events   = EPOLLOUT;
+  ev.data.ptr = &(rly->ed);
+  if (epoll_ctl(this->epollfd, EPOLL_CTL_ADD, rly->wfd, &ev) == -1) {
+    perror("epoll_ctl: EPOLL_CTL_ADD relay wfd");
+    NYI;
+  }
+  this->full++;
+  bcstPause(BCST_PAUSE_RELAY, true, this->epollfd);
+  VLPRINT(2, "%s: child yar full: %d bytes of a frame queued\n", cmd->name,
+	  len);
+}
+
+// write input to a child yar for all of its nodes (node NULL) or for the
+// node with the given path.  Like ttyWriteBuf a full tty is not fatal:
+// returns the number of bytes of buf written (-1 if none).  Bytes of a
+// frame that is being finished count as written
+extern int
+relayWrite(relay_t *this, cmd_t *cmd, char *node, char *buf, int len)
+{
+  char frame[RELAY_FRAMEMAX];
+  int  sent = 0;
+
+  if (cmd->rly.restn) return -1;
+  while (sent < len) {
+    char *b = &buf[sent];
+    int   l = len - sent;
+    if (l > RELAY_MAXDATA) l = RELAY_MAXDATA;
+    int n = relayFrame(frame, RELAY_DATA, NULL, node, &b, &l, 1);
+    int w = ttyWriteBuf(&(cmd->cmdtty), frame, n, &(cmd->lastwrite));
+    if (w <= 0) return (sent) ? sent : w;
+    sent += l;
+    if (w < n) {
+      relayFinish(this, cmd, &frame[w], n - w);
+      break;
+    }
+  }
+  return sent;
+}
+
+static relaynode_t *
+relayNode(cmd_t *cmd, char *name, bool create)
+{
+  relaynode_t *node;
+
+  HASH_FIND_STR(cmd->rly.nodes, name, node);
+  if (node == NULL && create) {
+    node = calloc(1, sizeof(relaynode_t));
+    assert(node);
+    node->name = strdup(name);
+    HASH_ADD_KEYPTR(hh, cmd->rly.nodes, node->name, strlen(node->name), node);
+  }
+  return node;
+}
+
+static void
+relayNodeDel(relay_t *this, cmd_t *cmd, relaynode_t *node)
+{
+  if (this->uplink) relayUpStr(this, RELAY_GONE, cmd->name, node->name, "");
+  HASH_DEL(cmd->rly.nodes, node);
+  free(node->name);
+  free(node);
+}
+
+// a line of output from a node of a child yar: its relay command's client
+// tty gets "<node>: <line>" and the broadcast tty "<relay>/<node>: <line>"
+static void
+relayOut(cmd_t *cmd, relaynode_t *node, relayframe_t *f, int epollfd)
+{
+  char *bufs[5];
+  int   lens[5], nbufs = 0;
+
+  // the client tty is best effort (a full tty drops the line)
+  ttyWriteBuf(&(cmd->clttty), node->name, strlen(node->name), NULL);
+  ttyWriteBuf(&(cmd->clttty), ": ", 2, NULL);
+  ttyWriteBuf(&(cmd->clttty), f->data, f->len, NULL);
+  if (!GBLS.bcstflg) return;
+  if (cmd->lmt.on && !limitPass(&GBLS.limit, cmd, f->len, epollfd)) return;
+  if (GBLS.prefixbcst) {
+    bufs[nbufs] = cmd->name;  lens[nbufs++] = strlen(cmd->name);
+    bufs[nbufs] = "/";        lens[nbufs++] = 1;
+    bufs[nbufs] = node->name; lens[nbufs++] = strlen(node->name);
+    bufs[nbufs] = ": ";       lens[nbufs++] = 2;
+  }
+  bufs[nbufs] = f->data;
+  lens[nbufs++] = f->len;
+  fairqWritev(&GBLS.fairq, cmd, bufs, lens, nbufs, epollfd);
+}
+
+// a frame from the child yar of cmd.  If this yar is itself a child the
+// news about the nodes is passed up with the node names prefixed by ours
+static void
+relayFromChild(relay_t *this, cmd_t *cmd, relayframe_t *f, int epollfd)
+{
+  relaynode_t *node, *tmp;
+
+  cmd->rly.frames++;
+  switch (f->type) {
+  case RELAY_HELLO:
+    // a (re)started child: it will tell us about all of its nodes again.
+    // The rest of a frame meant for the old child is dropped
+    relayUnwait(this, cmd);
+    HASH_ITER(hh, cmd->rly.nodes, node, tmp) relayNodeDel(this, cmd, node);
+    if (!cmd->rdy.ready) readyMark(&GBLS.ready, cmd);
+    return;
+  case RELAY_GONE:
+    node = relayNode(cmd, f->name, false);
+    if (node) relayNodeDel(this, cmd, node);
+    return;
+  case RELAY_NODE:
+  case RELAY_READY:
+  case RELAY_OUT:
+  case RELAY_STATS:
+    break;
+  default:
+    f->skipped += RELAY_HDRLEN + f->namelen + f->len;
+    return;
+  }
+  if (f->namelen == 0) return;
+  node = relayNode(cmd, f->name, true);
+  switch (f->type) {
+  case RELAY_READY:
+    node->ready = (f->data[0] == '1');
+    break;
+  case RELAY_OUT:
+    node->lines++;
+    if (!this->uplink) relayOut(cmd, node, f, epollfd);
+    break;
+  case RELAY_STATS:
+    sscanf(f->data, "%lu %lu %d", &(node->in), &(node->out),
+	   &(node->restarts));
+    break;
+  }
+  if (this->uplink) {
+    char *data = f->data;
+    relayUp(this, f->type, cmd->name, f->name, &data, &(f->len), 1);
+  }
+}
+
+// a byte of output of a relay command: part of a frame from its child yar
+extern int
+relayChar(relay_t *this, cmd_t *cmd, char c, int epollfd)
+{
+  this->epollfd = epollfd;
+  if (relayFrameByte(cmd->rly.in, c)) {
+    relayFromChild(this, cmd, cmd->rly.in, epollfd);
+  }
+  return 1;
+}
+
+// write buf to the command or child yar node named by path (eg. n3 or
+// rack1/n3).  Returns false if there is no such node or it could not take
+// all of buf
+extern bool
+relaySend(relay_t *this, char *path, char *buf, int len, int epollfd,
+	  FILE *f)
+{
+  char   name[RELAY_MAXNAME+1];
+  char  *node;
+  cmd_t *cmd;
+  int    n;
+
+  this->epollfd = epollfd;
+  snprintf(name, sizeof(name), "%s", path);
+  node = strchr(name, '/');
+  if (node) *node++ = '\0';
+  HASH_FIND_STR(GBLS.cmds, name, cmd);
+  if (cmd == NULL) {
+    EPRINT(f, "%s is not a current command\n", name);
+    return false;
+  }
+  if (node && *node) {
+    if (!cmd->rly.on) {
+      EPRINT(f, "%s is not a relay (child yar)\n", name);
+      return false;
+    }
+    if (!cmdIsReady(cmd)) {
+      EPRINT(f, "%s: child yar is not running\n", name);
+      return false;
+    }
+    n = relayWrite(this, cmd, node, buf, len);
+  } else if (cmdIsReady(cmd)) {
+    n = cmdWriteBuf(cmd, buf, len);
+  } else {
+    n = readyHold(&GBLS.ready, cmd, buf, len, epollfd);
+  }
+  if (n != len) {
+    EPRINT(f, "%s: only %d of %d bytes written\n", path, n, len);
+    return false;
+  }
+  return true;
+}
+
+// must be called after cmd is added to GBLS.cmds
+extern void
+relayAddCmd(relay_t *this, cmd_t *cmd)
+{
+  cmd->rly.wfd = -1;
+  if (cmd->rly.on) {
+    cmd->rly.in = calloc(1, sizeof(relayframe_t));
+    assert(cmd->rly.in);
+    cmd->rly.rest = malloc(RELAY_FRAMEMAX);
+    assert(cmd->rly.rest);
+  }
+  if (this->uplink) relayUpStr(this, RELAY_NODE, NULL, cmd->name, "");
+}
+
+// must be called before cmd is removed from GBLS.cmds and freed
+extern void
+relayForgetCmd(relay_t *this, cmd_t *cmd)
+{
+  relaynode_t *node, *tmp;
+
+  HASH_ITER(hh, cmd->rly.nodes, node, tmp) relayNodeDel(this, cmd, node);
+  if (this->uplink) relayUpStr(this, RELAY_GONE, NULL, cmd->name, "");
+  relayUnwait(this, cmd);
+  if (cmd->rly.in) {
+    free(cmd->rly.in);
+    cmd->rly.in = NULL;
+  }
+  if (cmd->rly.rest) {
+    free(cmd->rly.rest);
+    cmd->rly.rest = NULL;
+  }
+}
+
+extern void
+relayReport(relay_t *this, FILE *f)
+{
+  cmd_t       *cmd, *tmp;
+  relaynode_t *node, *ntmp;
+
+  if (this->uplink) {
+    fprintf(f, "relay: child yar %s frames up:%lu down:%lu skipped:%lu\n",
+	    this->path, this->upframes, this->downframes, this->in.skipped);
+  } else {
+    fprintf(f, "relay:\n");
+  }
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (!cmd->rly.on) continue;
+    fprintf(f, "  %s%s nodes:%d frames:%lu skipped:%lu%s\n", cmd->name,
+	    (cmd->rdy.ready) ? "" : " STARTING", HASH_COUNT(cmd->rly.nodes),
+	    cmd->rly.frames, cmd->rly.in->skipped,
+	    (cmd->rly.restn) ? " FULL" : "");
+    HASH_ITER(hh, cmd->rly.nodes, node, ntmp) {
+      fprintf(f, "    %s/%s%s in:%lu out:%lu lines:%lu restarts:%d\n",
+	      cmd->name, node->name, (node->ready) ? "" : " NOTREADY",
+	      node->in, node->out, node->lines, node->restarts);
+    }
+  }
+}
+
+extern void
+relayCleanup(relay_t *this)
+{
+  cmd_t       *cmd, *tmp;
+  relaynode_t *node, *ntmp;
+
+  // frees the per command state (nothing is sent to the parent on exit)
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    HASH_ITER(hh, cmd->rly.nodes, node, ntmp) {
+      HASH_DEL(cmd->rly.nodes, node);
+      free(node->name);
+      free(node);
+    }
+    if (cmd->rly.wfd != -1) close(cmd->rly.wfd);
+    cmd->rly.wfd = -1;
+    if (cmd->rly.in) {
+      free(cmd->rly.in);
+      cmd->rly.in = NULL;
+    }
+    if (cmd->rly.rest) {
+      free(cmd->rly.rest);
+      cmd->rly.rest = NULL;
+    }
+  }
+  tmrCleanup(&(this->tmr));
+  if (this->infd != -1) close(this->infd);
+  if (this->outfd != -1) close(this->outfd);
+  this->infd  = -1;
+  this->outfd = -1;
+  if (this->exe) free(this->exe);
+  if (this->path) free(this->path);
+  this->exe  = NULL;
+  this->path = NULL;
+}
+
+extern void
+relayDump(relay_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%srelay: this=%p uplink=%d path=%s exe=%s infd=%d outfd=%d "
+	  "epollfd=%d upframes=%lu downframes=%lu skipped=%lu\n", prefix, this,
+	  this->uplink, this->path, this->exe, this->infd, this->outfd,
+	  this->epollfd, this->upframes, this->downframes, this->in.skipped);
+  tmrDump(&(this->tmr), f, prefix);
+}
@@ -0,0 +1,121 @@
+#ifndef __YAR_RELAY_H__
+#define __YAR_RELAY_H__
+
+struct cmd;
+
+#define RELAY_CMDCHAR  '@'   // a cmdline starting with this runs a child yar
+#define RELAY_SYNC     0x1e  // first byte of every frame (ASCII RS)
+#define RELAY_HDRLEN   5     // sync, type, name length, payload length (2)
+#define RELAY_MAXNAME  255   // longest node name (path) in a frame
+#define RELAY_MAXDATA  4096  // largest payload (a line of output)
+#define RELAY_FRAMEMAX (RELAY_HDRLEN + RELAY_MAXNAME + 1 + RELAY_MAXDATA)
+#define RELAY_INTERVAL 1.0   // seconds between node stats sent to the parent
+
+// frame types.  Down frames go from a parent yar to a child yar, up frames
+// from a child to its parent.  The name of a frame is the path of the node
+// it is about (empty for the child yar itself)
+typedef enum {
+  RELAY_DATA  = 'D',   // down: input for all nodes or for the named node
+  RELAY_HELLO = 'H',   // up: the child yar is running and taking input
+  RELAY_NODE  = 'N',   // up: a node was added
+  RELAY_GONE  = 'X',   // up: a node was deleted
+  RELAY_READY = 'R',   // up: node ready state ("1" or "0")
+  RELAY_OUT   = 'O',   // up: a line of output of the node
+  RELAY_STATS = 'T'    // up: "<in> <out> <restarts>" of the node
+} relaytype_t;
+
+// a frame being received
+typedef struct {
+  char     name[RELAY_MAXNAME+1];
+  char     data[RELAY_MAXDATA+1];  // payload (null terminated)
+  uint64_t skipped;                // bytes dropped looking for a frame
+  uint8_t  hdr[RELAY_HDRLEN];
+  int      hdrn;                   // header bytes received
+  int      namelen;
+  int      len;                    // payload length
+  int      got;                    // name and payload bytes received
+  char     type;
+} relayframe_t;
+
+// a node of a child yar (as reported by the child)
+typedef struct relaynode {
+  UT_hash_handle hh;
+  char    *name;             // path below the relay command (eg. n3 or r2/n3)
+  uint64_t in;               // bytes written to the node
+  uint64_t out;              // bytes read from the node
+  uint64_t lines;            // lines of output relayed from the node
+  int      restarts;
+  bool     ready;
+} relaynode_t;
+
+// per command relay state (embedded in each cmd_t)
+typedef struct {
+  relayframe_t *in;          // frame being received from the child yar
+  char         *rest;        // rest of a partly written frame (see relayFinish)
+  relaynode_t  *nodes;       // hashtable of the child's nodes
+  evntdesc_t    ed;          // the child yar's tty is writable again
+  uint64_t      frames;      // frames received from the child yar
+  uint64_t      upin;        // uplink: stats last sent to the parent
+  uint64_t      upout;
+  int           uprestarts;
+  int           restoff;     // rest still to be written
+  int           restn;
+  int           wfd;         // dup of the tty's dom side while waiting
+  bool          upready;     // uplink: ready state last sent to the parent
+  bool          on;          // this command is a child yar
+} cmdrelay_t;
+
+// Relay Object
+//   Lets yar instances form a tree so that no single yar writes to all the
+//   ptys of a very large fanout.  A command whose cmdline starts with '@'
+//   is a child yar (the rest of the cmdline are its arguments, run with
+//   -Y).  The parent and child talk over the command's tty using compact
+//   frames rather than raw bytes: broadcast input goes down as data frames
+//   (optionally for a single node, named by its path eg. rack1/n3), and
+//   node names, ready state, lines of output and stats come up.  A child
+//   yar has no broadcast tty: its uplink (stdin and stdout) replaces it.
+//   Output of the nodes of a child is written to the parent's broadcast
+//   tty as that of "<relay>/<node>".  Input to a child yar is held (see
+//   ready.h) until it says hello.  A frame is never split: if a child's
+//   tty takes only part of one the rest is queued and broadcast input
+//   (the uplink for a child yar) is paused until the child has taken it.
+typedef struct {
+  relayframe_t in;           // uplink: frame being received from the parent
+  evntdesc_t   ed;           // uplink: input from the parent
+  tmr_t        tmr;          // uplink: node stats timer
+  char        *exe;          // this executable (run for relay commands)
+  char        *path;         // uplink: this yar's path in the tree
+  uint64_t     upframes;     // uplink: frames sent to the parent
+  uint64_t     downframes;   // uplink: frames received from the parent
+  int          infd;         // uplink: from the parent
+  int          epollfd;      // for waiting on child yars outside of our
+                             // events
+  int          full;         // child yars with the rest of a frame queued
+  int          outfd;        // uplink: to the parent
+  bool         uplink;       // this yar is a child of another yar (-Y)
+} relay_t;
+
+extern bool relayInit(relay_t *this, bool iszeroed);
+extern bool relayUplinkCreate(relay_t *this);
+extern void relayRegisterEvents(relay_t *this, int epollfd);
+extern void relayUplinkEnable(relay_t *this, int epollfd, bool enable);
+extern char *relayCmdline(relay_t *this, struct cmd *cmd);
+extern int  relayWrite(relay_t *this, struct cmd *cmd, char *node, char *buf,
+		       int len);
+extern int  relayChar(relay_t *this, struct cmd *cmd, char c, int epollfd);
+extern bool relaySend(relay_t *this, char *path, char *buf, int len,
+		      int epollfd, FILE *f);
+extern void relayOutput(relay_t *this, struct cmd *cmd, char **seg,
+			int *seglen, int segs);
+extern void relayReady(relay_t *this, struct cmd *cmd);
+extern void relayAddCmd(relay_t *this, struct cmd *cmd);
+extern void relayForgetCmd(relay_t *this, struct cmd *cmd);
+extern void relayReport(relay_t *this, FILE *f);
+extern void relayCleanup(relay_t *this);
+extern void relayDump(relay_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool relayIsUplink(relay_t *this)
+{
+  return this->uplink;
+}
+#endif
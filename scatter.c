@@ -0,0 +1,362 @@
+#include "yar.h"
+
+// find the key of a line: the keyfield'th whitespace separated field
+// (1 based) or the whole line (minus the newline) if keyfield is 0.
+// returns the length of the key and sets *key to its start
+static int
+scatterKey(scatter_t *this, char **key)
+{
+  char *line = this->line;
+  int   n    = this->n;
+  int   i    = 0, start, field;
+
+  if (n && line[n-1] == '\n') n--;
+  if (this->keyfield == 0) {
+    *key = line;
+    return n;
+  }
+  for (field=1; ; field++) {
+    while (i<n && (line[i]==' ' || line[i]=='\t' || line[i]=='\r')) i++;
+    start = i;
+    while (i<n && line[i]!=' ' && line[i]!='\t' && line[i]!='\r') i++;
+    if (field == this->keyfield || i>=n) break;
+  }
+  // if the line has fewer fields than keyfield an empty key is used
+  // so all such lines are routed to the same command
+  *key = &line[start];
+  return (field == this->keyfield) ? i - start : 0;
+}
+
+// pick the command that the current line should go to
+static cmd_t *
+scatterTarget(scatter_t *this)
+{
+  cmd_t *cmd, *tmp, *best=NULL;
+
+  if (GBLS.cmds == NULL) return NULL;
+  if (this->mode == SCATTER_RR) {
+    // the next running command that is ready or, if none is, the next
+    // running one (the line is held for it see readyHold)
+    cmd_t *start = (this->rrnext) ? this->rrnext : GBLS.cmds;
+    cmd_t *next, *bestnext = NULL;
+    cmd = start;
+    do {
+      next = (cmd->hh.next) ? cmd->hh.next : GBLS.cmds;
+      if (cmdIsRunning(cmd)) {
+	if (cmdIsReady(cmd)) {
+	  this->rrnext = next;
+	  return cmd;
+	}
+	if (best == NULL) {
+	  best     = cmd;
+	  bestnext = next;
+	}
+      }
+      cmd = next;
+    } while (cmd != start);
+    if (best) this->rrnext = bestnext;
+    return best;
+  }
+
+  // SCATTER_HASH: rendezvous (highest random weight) hashing. Each
+  // command's score for a key is a mix of the key hash and the command's
+  // name hash, the highest score wins.  Unlike a simple hash modulo the
+  // number of commands, adding or removing a command only moves the keys
+  // that hashed to that command.  The keys of a command that is not
+  // running go to their next highest scoring command.
+  char    *key;
+  int      keylen = scatterKey(this, &key);
+  uint64_t kh     = hashBytes(key, keylen);
+  uint64_t score, bestscore = 0;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (!cmdIsRunning(cmd)) continue;
+    score = hashMix(kh ^ cmd->namehash);
+    if (best == NULL || score > bestscore) {
+      best      = cmd;
+      bestscore = score;
+    }
+  }
+  return best;
+}
+
+// write as much of buf to cmd as its pacing and tty allow.  Returns the
+// bytes written
+static int
+scatterSend(cmd_t *cmd, char *buf, int len)
+{
+  int n = bucketAvail(&(cmd->pace.bkt), len);
+  if (n == 0) return 0;
+  return cmdWriteBuf(cmd, buf, n);
+}
+
+// append to cmd's queue: bytes beyond SCATTER_QUEUELEN are dropped
+static void
+scatterEnqueue(scatter_t *this, cmd_t *cmd, char *buf, int len)
+{
+  cmdscatter_t *sq = &(cmd->sctr);
+  int           end, n;
+
+  if (len > SCATTER_QUEUELEN - sq->len) {
+    int drop = len - (SCATTER_QUEUELEN - sq->len);
+    VLPRINT(1, "%s: scatter queue full dropping %d bytes\n", cmd->name,
+	    drop);
+    sq->drops    += drop;
+    this->qdrops += drop;
+    len          -= drop;
+  }
+  if (len == 0) return;
+  if (sq->ring == NULL) {
+    sq->ring = malloc(SCATTER_QUEUELEN);
+    assert(sq->ring);
+  }
+  while (len) {
+    end = (sq->start + sq->len) % SCATTER_QUEUELEN;
+    n   = SCATTER_QUEUELEN - end;
+    if (n > len) n = len;
+    memcpy(&(sq->ring[end]), buf, n);
+    sq->len      += n;
+    sq->queued   += n;
+    this->queued += n;
+    this->depth  += n;
+    buf += n;
+    len -= n;
+  }
+  if (!tmrIsArmed(&(this->tmr)) && this->epollfd != -1) {
+    tmrArm(&(this->tmr), this->epollfd, SCATTER_TICK, SCATTER_TICK);
+  }
+}
+
+// discard what is queued for cmd
+static void
+scatterDrop(scatter_t *this, cmd_t *cmd)
+{
+  cmdscatter_t *sq = &(cmd->sctr);
+  if (sq->len == 0) return;
+  VLPRINT(1, "%s: dropping %d queued bytes\n", cmd->name, sq->len);
+  sq->drops    += sq->len;
+  this->qdrops += sq->len;
+  this->depth  -= sq->len;
+  sq->start     = 0;
+  sq->len       = 0;
+}
+
+// send what is queued for cmd as far as its pacing and tty allow
+static void
+scatterSendQueued(scatter_t *this, cmd_t *cmd)
+{
+  cmdscatter_t *sq = &(cmd->sctr);
+  int           chunk, w;
+
+  while (sq->len) {
+    chunk = SCATTER_QUEUELEN - sq->start;
+    if (chunk > sq->len) chunk = sq->len;
+    w = scatterSend(cmd, &(sq->ring[sq->start]), chunk);
+    if (w == 0) break;
+    sq->start    = (sq->start + w) % SCATTER_QUEUELEN;
+    sq->len     -= w;
+    this->depth -= w;
+  }
+  if (sq->len == 0) sq->start = 0;
+}
+
+// periodic while lines are queued: send them.  Lines queued for a command
+// that has stopped are dropped
+static evnthdlrrc_t
+scatterTmrEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  scatter_t *this = obj;
+  cmd_t *cmd, *tmp;
+
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->sctr.len == 0) continue;
+    if (!cmdIsRunning(cmd)) scatterDrop(this, cmd);
+    else if (cmdIsReady(cmd)) scatterSendQueued(this, cmd);
+  }
+  if (this->depth == 0) tmrDisarm(&(this->tmr));
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+scatterInit(scatter_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(scatter_t));
+  this->mode     = SCATTER_OFF;
+  this->target   = NULL;
+  this->rrnext   = NULL;
+  this->n        = 0;
+  this->keyfield = 0;
+  this->depth    = 0;
+  this->epollfd  = -1;
+  return tmrInit(&(this->tmr), scatterTmrEvent, this, iszeroed);
+}
+
+extern const char *
+scatterModeStr(scatter_t *this)
+{
+  switch (this->mode) {
+  case SCATTER_OFF:  return "off";
+  case SCATTER_RR:   return "rr";
+  case SCATTER_HASH: return "hash";
+  case SCATTER_QUEUE: return "queue";
+  }
+  return "unknown";
+}
+
+// spec is one of "off", "rr", "hash[:<field>]" or "queue[:<inflight>]"
+extern bool
+scatterSetMode(scatter_t *this, char *spec, FILE *f)
+{
+  scattermode_t mode;
+  int keyfield = 0;
+
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing scatter mode\n");
+    return false;
+  }
+  if (strcmp(spec, "off") == 0) {
+    mode = SCATTER_OFF;
+  } else if (strcmp(spec, "rr") == 0) {
+    mode = SCATTER_RR;
+  } else if (strncmp(spec, "hash", 4) == 0 &&
+	     (spec[4] == '\0' || spec[4] == ':')) {
+    mode = SCATTER_HASH;
+    if (spec[4] == ':') {
+      char *end;
+      errno = 0;
+      keyfield = strtol(&spec[5], &end, 10);
+      if (errno != 0 || *end != '\0' || end == &spec[5] || keyfield < 0) {
+	EPRINT(f, "bad scatter hash key field: %s\n", spec);
+	return false;
+      }
+    }
+  } else if (strncmp(spec, "queue", 5) == 0 &&
+	     (spec[5] == '\0' || spec[5] == ':')) {
+    mode = SCATTER_QUEUE;
+    if (spec[5] == ':') {
+      char *end;
+      int   inflight;
+      errno = 0;
+      inflight = strtol(&spec[6], &end, 10);
+      if (errno != 0 || *end != '\0' || end == &spec[6] || inflight < 1) {
+	EPRINT(f, "bad scatter queue in flight limit: %s\n", spec);
+	return false;
+      }
+      GBLS.workq.inflightmax = inflight;
+    }
+  } else {
+    EPRINT(f, "unknown scatter mode: %s\n", spec);
+    return false;
+  }
+  // dispatch anything that is buffered under the old mode before switching
+  scatterFlush(this, -1);
+  if (mode == SCATTER_QUEUE && this->mode != SCATTER_QUEUE) {
+    workqStart(&GBLS.workq);
+  }
+  this->mode     = mode;
+  this->keyfield = keyfield;
+  return true;
+}
+
+// send the buffered data to the target (chosen if not already).  If the
+// target is not ready the data is held for it (see readyHold).  What the
+// target's pacing or tty does not allow now is queued for it (behind
+// anything already queued)
+extern int
+scatterFlush(scatter_t *this, int epollfd)
+{
+  int    n = this->n;
+  int    written;
+  cmd_t *target;
+
+  if (n == 0) return 0;
+  if (epollfd != -1) this->epollfd = epollfd;
+  if (this->target == NULL) this->target = scatterTarget(this);
+  target = this->target;
+  if (target == NULL) {
+    VLPRINT(2, "no commands dropping %d bytes\n", n);
+    this->drops++;
+    this->n = 0;
+    return 0;
+  }
+  if (!cmdIsReady(target)) {
+    written = readyHold(&GBLS.ready, target, this->line, n, epollfd);
+  } else if (target->sctr.len == 0) {
+    written = scatterSend(target, this->line, n);
+  } else {
+    written = 0;
+  }
+  if (written < n) scatterEnqueue(this, target, &(this->line[written]),
+				  n - written);
+  VLPRINT(2, "%d bytes to %s (%d queued)\n", n, target->name, n - written);
+  this->n = 0;
+  return n;
+}
+
+// accumulate a character read from the broadcast tty.  Complete lines are
+// dispatched to a single command.  Lines longer than the line buffer are
+// sent in pieces but all pieces go to the same command.
+extern int
+scatterChar(scatter_t *this, char c, int epollfd)
+{
+  int n = 0;
+  ASSERT(this->n < sizeof(this->line));
+  this->line[this->n] = c;
+  this->n++;
+  if (this->mode == SCATTER_QUEUE) {
+    // lines are handed to the work queue rather than directly to a command
+    // (overly long lines are queued as separate items)
+    if (c == '\n' || this->n == sizeof(this->line)) {
+      workqAdd(&GBLS.workq, this->line, this->n, epollfd);
+      n = this->n;
+      this->n = 0;
+      this->lines++;
+    }
+    return n;
+  }
+  if (c == '\n') {
+    n = scatterFlush(this, epollfd);
+    this->target = NULL;        // next line gets a new target
+    this->lines++;
+  } else if (this->n == sizeof(this->line)) {
+    n = scatterFlush(this, epollfd);     // keep the target for rest of the line
+  }
+  return n;
+}
+
+// must be called before cmd is removed from GBLS.cmds and freed
+extern void
+scatterForgetCmd(scatter_t *this, cmd_t *cmd)
+{
+  if (this->rrnext == cmd) this->rrnext = cmd->hh.next;
+  if (this->target == cmd) this->target = NULL;
+  scatterDrop(this, cmd);
+  if (cmd->sctr.ring) free(cmd->sctr.ring);
+  cmd->sctr.ring = NULL;
+}
+
+// releases every command's queue
+extern void
+scatterCleanup(scatter_t *this)
+{
+  cmd_t *cmd, *tmp;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->sctr.ring) free(cmd->sctr.ring);
+    cmd->sctr.ring = NULL;
+    cmd->sctr.len  = 0;
+  }
+  this->depth = 0;
+  tmrCleanup(&(this->tmr));
+}
+
+extern void
+scatterDump(scatter_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sscatter: this=%p mode=%s keyfield=%d n=%d lines=%lu "
+	  "drops=%lu queued=%lu qdrops=%lu depth=%d epollfd=%d target=%p(%s) "
+	  "rrnext=%p(%s)\n", prefix, this,
+	  scatterModeStr(this), this->keyfield, this->n, this->lines,
+	  this->drops, this->queued, this->qdrops, this->depth, this->epollfd,
+	  this->target, (this->target) ? this->target->name : "",
+	  this->rrnext, (this->rrnext) ? this->rrnext->name : "");
+  tmrDump(&(this->tmr), f, prefix);
+}
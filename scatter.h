@@ -0,0 +1,70 @@
+#ifndef __YAR_SCATTER_H__
+#define __YAR_SCATTER_H__
+
+struct cmd;
+
+#define SCATTER_LINELEN  4096         // bytes of a line accumulated
+#define SCATTER_QUEUELEN (64 * 1024)  // bytes of lines queued per command
+#define SCATTER_TICK     0.01         // seconds between sends of queued lines
+
+// per command scatter state (embedded in each cmd_t)
+typedef struct {
+  char    *ring;         // lines queued (allocated when first needed)
+  uint64_t queued;       // bytes that had to be queued
+  uint64_t drops;        // bytes dropped as the queue was full
+  int      start;        // offset of the oldest queued byte
+  int      len;          // bytes queued
+} cmdscatter_t;
+
+typedef enum {
+  SCATTER_OFF=0,     // normal broadcast: every byte goes to every command
+  SCATTER_RR=1,      // each line goes to the next command in round robin order
+  SCATTER_HASH=2,    // each line goes to the command chosen by hashing a key
+  SCATTER_QUEUE=3    // lines are queued and handed to commands as they
+                     // complete previous lines (see workq.h)
+} scattermode_t;
+
+// Scatter Object
+//   Turns the broadcast tty into a parallel dispatcher.  Rather than sending
+//   every byte read from the broadcast tty to every command, bytes are
+//   accumulated into lines and each complete line is sent to exactly one
+//   command.  The target is either chosen round robin or by hashing a key
+//   field of the line (sticky routing: lines with the same key always go to
+//   the same command as long as the set of commands does not change).
+//   Only running commands are chosen and round robin prefers those that
+//   are ready.  A line is written as far as the target's pacing (see
+//   pace.h) and tty allow, the rest is queued for it and sent every
+//   SCATTER_TICK until its queue is empty.  Output from the commands is
+//   still gathered on the broadcast tty as usual.
+typedef struct {
+  char          line[SCATTER_LINELEN]; // line being accumulated
+  struct cmd   *target;            // command the current line is going to
+                                   // (NULL until chosen)
+  struct cmd   *rrnext;            // round robin cursor: next cmd to use
+  tmr_t         tmr;               // sends queued lines (armed while any)
+  uint64_t      lines;             // number of lines dispatched
+  uint64_t      drops;             // number of lines dropped (no commands)
+  uint64_t      queued;            // bytes that had to be queued
+  uint64_t      qdrops;            // bytes dropped as a queue was full
+  scattermode_t mode;              // current dispatch mode
+  int           depth;             // bytes queued for all commands
+  int           epollfd;
+  int           n;                 // number of bytes buffered in line
+  int           keyfield;          // SCATTER_HASH: whitespace separated
+                                   // field (1..n) used as key, 0 whole line
+} scatter_t;
+
+extern bool scatterInit(scatter_t *this, bool iszeroed);
+extern bool scatterSetMode(scatter_t *this, char *spec, FILE *f);
+extern const char *scatterModeStr(scatter_t *this);
+extern int  scatterChar(scatter_t *this, char c, int epollfd);
+extern int  scatterFlush(scatter_t *this, int epollfd);
+extern void scatterForgetCmd(scatter_t *this, struct cmd *cmd);
+extern void scatterCleanup(scatter_t *this);
+extern void scatterDump(scatter_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool scatterIsOn(scatter_t *this)
+{
+  return (this->mode != SCATTER_OFF);
+}
+#endif
@@ -0,0 +1,359 @@
+#include "yar.h"
+#include <sys/wait.h>
+
+// true if the command has a ready spec (its own or the default)
+static bool
+standbyGated(cmd_t *cmd)
+{
+  readyspec_t *spec = (cmd->rdy.spec) ? cmd->rdy.spec : &(GBLS.ready.spec);
+  return readySpecIsSet(spec);
+}
+
+static void
+standbyResetMatch(standbyinst_t *inst)
+{
+  bzero(inst->cnts, sizeof(inst->cnts));
+  inst->linen = 0;
+}
+
+// stop watching an instance's tty and process.  Done explicitly (rather
+// than relying on the close of the fds) as a command being started may
+// briefly share them
+static void
+standbyUnregister(standby_t *this, standbyinst_t *inst)
+{
+  if (this->epollfd == -1) return;
+  if (epoll_ctl(this->epollfd, EPOLL_CTL_DEL, inst->tty.dfd, NULL) == -1 ||
+      epoll_ctl(this->epollfd, EPOLL_CTL_DEL, inst->tty.ifd, NULL) == -1 ||
+      epoll_ctl(this->epollfd, EPOLL_CTL_DEL, inst->pidfd, NULL) == -1) {
+    perror("epoll_ctl: EPOLL_CTL_DEL standby fd");
+    assert(0);
+  }
+}
+
+// release the slot of an instance whose process has gone.  Its tty is
+// closed unless it was handed over to the command
+static void
+standbyFree(standbyinst_t *inst, bool closetty)
+{
+  if (closetty) ttyCleanup(&(inst->tty));
+  ttyInit(&(inst->tty), NULL, NULL, NULL, NULL, NULL, false);
+  inst->pid     = -1;
+  inst->pidfd   = -1;
+  inst->pidfded = (evntdesc_t){ NULL, NULL };
+  inst->ready   = false;
+}
+
+// a standby instance has matched the command's ready spec
+static void
+standbyReady(standbyinst_t *inst)
+{
+  struct timespec now;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  inst->ready = true;
+  inst->ttr   = tsDiff(&now, &(inst->start));
+  VPRINT("%s: standby pid:%d READY: time to ready %f\n", inst->cmd->name,
+	 inst->pid, inst->ttr);
+}
+
+// output of a standby instance: matched against the command's ready spec
+// until it is ready and otherwise discarded
+static evnthdlrrc_t
+standbyttyEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  standbyinst_t *inst = obj;
+  cmd_t         *cmd  = inst->cmd;
+  char           buf[CMD_BUFSIZE];
+  int            n;
+
+  if (evnts & EPOLLIN) {
+    n = ttyReadBuf(&(inst->tty), buf, sizeof(buf));
+    for (int i=0; i<n && !inst->ready; i++) {
+      if (readyMatch(&GBLS.ready, cmd, inst->cnts, inst->line,
+		     &(inst->linen), buf[i])) standbyReady(inst);
+    }
+    // a prompt is not newline terminated (see readyMatch)
+    if (n > 0 && !inst->ready &&
+	readyMatchLine(&GBLS.ready, cmd, inst->line, inst->linen)) {
+      standbyReady(inst);
+    }
+    VLPRINT(2, "%s: standby pid:%d discarded %d bytes\n", cmd->name,
+	    inst->pid, n);
+    evnts = evnts & ~EPOLLIN;
+  }
+  if (evnts != 0) {
+    VLPRINT(2, "%s: standby pid:%d events evnts:%x\n", cmd->name, inst->pid,
+	    evnts);
+  }
+  return EVNT_HDLR_SUCCESS;
+}
+
+static evnthdlrrc_t standbyPidEvent(void *obj, uint32_t evnts, int epollfd);
+
+// start a standby instance in a free slot on a tty of its own.  Like a
+// restart the instance waits startdelay seconds before it runs the command
+static void
+standbySpawn(standby_t *this, cmd_t *cmd, standbyinst_t *inst,
+	     double startdelay, int epollfd)
+{
+  ASSERT(inst->pid == -1 && epollfd != -1);
+  this->epollfd = epollfd;
+  if (!ttyCreate(&(inst->tty),
+		 (evntdesc_t){ .hdlr = standbyttyEvent, .obj = inst },
+		 (evntdesc_t){ NULL, NULL }, true)) {
+    EPRINT(stderr, "%s: failed to create a tty for a standby\n", cmd->name);
+    ttyInit(&(inst->tty), NULL, NULL, NULL, NULL, NULL, false);
+    return;
+  }
+  assert(ttyRegisterEvents(&(inst->tty), epollfd));
+  if (clock_gettime(CLOCK_SOURCE, &(inst->start)) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  inst->cmd     = cmd;
+  inst->ttr     = 0.0;
+  inst->ready   = !standbyGated(cmd);
+  standbyResetMatch(inst);
+  inst->pid     = cmdSpawn(cmd, &(inst->tty), true, startdelay,
+			   &(inst->pidfd));
+  inst->pidfded = (evntdesc_t){ .hdlr = standbyPidEvent, .obj = inst };
+  {
+    struct epoll_event ev;
+    ev.data.ptr = &(inst->pidfded);
+    ev.events   = EPOLLIN |  EPOLLHUP | EPOLLRDHUP | EPOLLERR | EPOLLET;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, inst->pidfd, &ev) == -1 ) {
+      perror("epoll_ctl: standby pidfd");
+      assert(0);
+    }
+  }
+  cmd->sby.spawns++;
+  this->spawns++;
+  VPRINT("%s: standby started pid:%d delay:%f\n", cmd->name, inst->pid,
+	 startdelay);
+}
+
+// a standby instance exited: it is replaced (throttled like a restart) as
+// long as the command is running
+static evnthdlrrc_t
+standbyPidEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  standby_t     *this = &GBLS.standby;
+  standbyinst_t *inst = obj;
+  cmd_t         *cmd  = inst->cmd;
+  siginfo_t      info;
+
+  if (!(evnts & EPOLLIN)) {
+    VLPRINT(2, "%s: standby unknown events evnts:%x", cmd->name, evnts);
+    return EVNT_HDLR_SUCCESS;
+  }
+  if (waitid(P_PIDFD, inst->pidfd, &info, WEXITED) < 0) {
+    perror("waitpid after detecting standby death failed");
+    assert(0);
+  }
+  VPRINT("%s: standby pid:%d exited status:%d\n", cmd->name, inst->pid,
+	 info.si_status);
+  this->deaths++;
+  standbyUnregister(this, inst);
+  close(inst->pidfd);
+  standbyFree(inst, true);
+  if (cmdIsRunning(cmd) && GBLS.restart && cmd->restart &&
+      (inst - cmd->sby.insts) < cmd->sby.want) {
+    standbySpawn(this, cmd, inst, (info.si_status == 0) ?
+		 GBLS.restartcmddelay : GBLS.errrestartcmddelay, epollfd);
+  }
+  return EVNT_HDLR_SUCCESS;
+}
+
+// terminate and reap a standby instance
+static void
+standbyKill(standby_t *this, standbyinst_t *inst)
+{
+  standbyUnregister(this, inst);
+  cmdReap(inst->cmd, inst->pid, inst->pidfd);
+  close(inst->pidfd);
+  standbyFree(inst, true);
+}
+
+extern void
+standbyInit(standby_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(standby_t));
+  this->spawns  = 0;
+  this->swaps   = 0;
+  this->misses  = 0;
+  this->deaths  = 0;
+  this->epollfd = -1;
+}
+
+// spec is the number of standby instances (0 to STANDBY_MAX)
+extern bool
+standbyParse(char *spec, int *want, FILE *f)
+{
+  char *end;
+  long  n;
+  errno = 0;
+  n = strtol(spec, &end, 10);
+  if (errno != 0 || end == spec || *end != '\0' || n < 0 ||
+      n > STANDBY_MAX) {
+    EPRINT(f, "bad standby count (0 to %d): %s\n", STANDBY_MAX, spec);
+    return false;
+  }
+  *want = n;
+  return true;
+}
+
+// set the number of standby instances of cmd.  If it is running standbys
+// are started or stopped to match
+extern bool
+standbySet(standby_t *this, cmd_t *cmd, int want, int epollfd, FILE *f)
+{
+  if (want && cmd->rly.on) {
+    EPRINT(f, "%s: a relay command can not have standbys\n", cmd->name);
+    return false;
+  }
+  cmd->sby.want = want;
+  if (cmd->sby.insts) {
+    for (int i=want; i<STANDBY_MAX; i++) {
+      if (cmd->sby.insts[i].pid != -1) standbyKill(this, &(cmd->sby.insts[i]));
+    }
+  }
+  if (cmdIsRunning(cmd) && epollfd != -1) standbyStart(this, cmd, epollfd);
+  return true;
+}
+
+// cmd has been started: start any of its standby instances not running
+extern void
+standbyStart(standby_t *this, cmd_t *cmd, int epollfd)
+{
+  if (cmd->sby.want == 0) return;
+  if (cmd->sby.insts == NULL) {
+    cmd->sby.insts = calloc(STANDBY_MAX, sizeof(standbyinst_t));
+    assert(cmd->sby.insts);
+    for (int i=0; i<STANDBY_MAX; i++) standbyFree(&(cmd->sby.insts[i]), false);
+  }
+  for (int i=0; i<cmd->sby.want; i++) {
+    if (cmd->sby.insts[i].pid == -1) {
+      standbySpawn(this, cmd, &(cmd->sby.insts[i]), 0.0, epollfd);
+    }
+  }
+}
+
+// cmd has been stopped: so are its standby instances
+extern void
+standbyStop(standby_t *this, cmd_t *cmd)
+{
+  if (cmd->sby.insts == NULL) return;
+  for (int i=0; i<STANDBY_MAX; i++) {
+    if (cmd->sby.insts[i].pid != -1) standbyKill(this, &(cmd->sby.insts[i]));
+  }
+}
+
+// cmd's process has exited: hand the longest ready standby (or the oldest
+// if none is ready yet) over to it and start a replacement standby.
+// Returns false if cmd has no standby running
+extern bool
+standbySwap(standby_t *this, cmd_t *cmd, double startdelay, int epollfd)
+{
+  standbyinst_t *inst, *best = NULL;
+
+  if (cmd->sby.want == 0) return false;
+  for (int i=0; cmd->sby.insts && i<STANDBY_MAX; i++) {
+    inst = &(cmd->sby.insts[i]);
+    if (inst->pid == -1) continue;
+    if (best == NULL || (inst->ready && !best->ready) ||
+	(inst->ready == best->ready &&
+	 tsDiff(&(best->start), &(inst->start)) > 0.0)) {
+      best = inst;
+    }
+  }
+  if (best == NULL) {
+    VPRINT("%s: no standby to take over\n", cmd->name);
+    this->misses++;
+    return false;
+  }
+  VPRINT("%s: standby pid:%d (ready:%d) takes over\n", cmd->name, best->pid,
+	 best->ready);
+  standbyUnregister(this, best);
+  cmdAdopt(cmd, &(best->tty), best->pid, best->pidfd, best->ready, epollfd);
+  standbyFree(best, false);
+  cmd->sby.swaps++;
+  this->swaps++;
+  standbySpawn(this, cmd, best, startdelay, epollfd);
+  return true;
+}
+
+// cmd's ready spec changed: the match states of its standbys no longer
+// refer to valid automaton states.  Readiness already established is kept
+extern void
+standbySpecChanged(standby_t *this, cmd_t *cmd)
+{
+  if (cmd->sby.insts == NULL) return;
+  for (int i=0; i<STANDBY_MAX; i++) {
+    standbyinst_t *inst = &(cmd->sby.insts[i]);
+    if (inst->pid == -1) continue;
+    standbyResetMatch(inst);
+    if (!standbyGated(cmd)) inst->ready = true;
+  }
+}
+
+// must be called before cmd is removed from GBLS.cmds and freed
+extern void
+standbyForgetCmd(standby_t *this, cmd_t *cmd)
+{
+  standbyStop(this, cmd);
+  if (cmd->sby.insts) {
+    free(cmd->sby.insts);
+    cmd->sby.insts = NULL;
+  }
+  cmd->sby.want = 0;
+}
+
+extern void
+standbyReport(standby_t *this, FILE *f)
+{
+  struct timespec now;
+  cmd_t *cmd, *tmp;
+
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  fprintf(f, "standby: spawns:%lu swaps:%lu misses:%lu deaths:%lu\n",
+	  this->spawns, this->swaps, this->misses, this->deaths);
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->sby.want == 0 && cmd->sby.swaps == 0) continue;
+    fprintf(f, "  %s want:%d spawns:%lu swaps:%lu\n", cmd->name,
+	    cmd->sby.want, cmd->sby.spawns, cmd->sby.swaps);
+    for (int i=0; cmd->sby.insts && i<STANDBY_MAX; i++) {
+      standbyinst_t *inst = &(cmd->sby.insts[i]);
+      if (inst->pid == -1) continue;
+      if (inst->ready) {
+	fprintf(f, "    pid:%d ready ttr:%.6f up:%.3f\n", inst->pid, inst->ttr,
+		tsDiff(&now, &(inst->start)));
+      } else {
+	fprintf(f, "    pid:%d waiting:%.6f\n", inst->pid,
+		tsDiff(&now, &(inst->start)));
+      }
+    }
+  }
+}
+
+// stops every command's standby instances and frees their state
+extern void
+standbyCleanup(standby_t *this)
+{
+  cmd_t *cmd, *tmp;
+  this->epollfd = -1;         // the loop is gone
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) standbyForgetCmd(this, cmd);
+}
+
+extern void
+standbyDump(standby_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sstandby: this=%p spawns=%lu swaps=%lu misses=%lu deaths=%lu "
+	  "epollfd=%d\n", prefix, this, this->spawns, this->swaps,
+	  this->misses, this->deaths, this->epollfd);
+}
@@ -0,0 +1,64 @@
+#ifndef __YAR_STANDBY_H__
+#define __YAR_STANDBY_H__
+
+struct cmd;
+
+#define STANDBY_MAX 8      // standby instances per command
+
+// a standby instance: the command line running on its own command tty,
+// not yet connected to the command's client tty or the broadcast tty
+typedef struct {
+  tty_t           tty;                 // command tty of the instance
+  evntdesc_t      pidfded;             // pidfd event descriptor
+  struct timespec start;               // time the instance was started
+  struct cmd     *cmd;                 // command it stands by for
+  double          ttr;                 // time to ready
+  pid_t           pid;                 // -1 if the slot is free
+  int             pidfd;
+  int             cnts[READY_MAXSTRS]; // ready spec match state
+  char            line[READY_LINELEN]; // current line (truncated)
+  int             linen;
+  bool            ready;               // matched the command's ready spec
+} standbyinst_t;
+
+// per command standby state (embedded in each cmd_t)
+typedef struct {
+  standbyinst_t *insts;      // STANDBY_MAX slots (allocated on first use)
+  uint64_t       spawns;     // standby instances started
+  uint64_t       swaps;      // times a standby took over
+  int            want;       // standby instances to keep running
+} cmdstandby_t;
+
+// Standby Object
+//   Keeps pre-warmed instances of a command line running so that when the
+//   active instance exits (eg. an ssh connection drops) a standby takes
+//   over immediately instead of the command being restarted from scratch.
+//   Each standby runs on its own command tty and its output is read (to
+//   match the command's ready spec, see ready.h) and discarded.  When the
+//   active instance exits the longest ready standby (or, if none is ready,
+//   the oldest one) is swapped onto the command: its tty and process
+//   become the command's, so the client tty and broadcast membership carry
+//   on.  A replacement standby is then started with the usual restart
+//   delay.  Standbys run only while the command does.
+typedef struct {
+  uint64_t spawns;           // standby instances started
+  uint64_t swaps;            // standbys that took over a command
+  uint64_t misses;           // exits with no standby running to take over
+  uint64_t deaths;           // standby instances that exited
+  int      epollfd;          // loop the instances are registered with
+} standby_t;
+
+extern void standbyInit(standby_t *this, bool iszeroed);
+extern bool standbyParse(char *spec, int *want, FILE *f);
+extern bool standbySet(standby_t *this, struct cmd *cmd, int want,
+		       int epollfd, FILE *f);
+extern void standbyStart(standby_t *this, struct cmd *cmd, int epollfd);
+extern void standbyStop(standby_t *this, struct cmd *cmd);
+extern bool standbySwap(standby_t *this, struct cmd *cmd, double startdelay,
+			int epollfd);
+extern void standbySpecChanged(standby_t *this, struct cmd *cmd);
+extern void standbyForgetCmd(standby_t *this, struct cmd *cmd);
+extern void standbyReport(standby_t *this, FILE *f);
+extern void standbyCleanup(standby_t *this);
+extern void standbyDump(standby_t *this, FILE *f, char *prefix);
+#endif
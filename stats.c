@@ -0,0 +1,487 @@
+#include "yar.h"
+#include <dirent.h>
+#include <stdarg.h>
+
+// per command metric families, in the order of their samples in
+// cmdstats_t.mtxt (counters get _total appended to their samples)
+static const struct {
+  const char *name;
+  const char *type;
+  const char *help;
+} statsCmdFams[STATS_CMDFAMS] = {
+  { "yar_cmd_up", "gauge", "1 if the command's process is running" },
+  { "yar_cmd_ready", "gauge", "1 if the command is ready for input" },
+  { "yar_cmd_start_time_seconds", "gauge",
+    "Start time of the command's last process since the epoch" },
+  { "yar_cmd_restarts", "counter", "Times the command was restarted" },
+  { "yar_cmd_exits", "counter", "Processes of the command that exited" },
+  { "yar_cmd_input_bytes", "counter", "Bytes written to the command" },
+  { "yar_cmd_output_bytes", "counter", "Bytes of output of the command" },
+  { "yar_cmd_output_lines", "counter", "Lines of output of the command" },
+  { "yar_cmd_client_discarded_bytes", "counter",
+    "Output not written to the client tty (not open or full)" },
+  { "yar_cmd_pace_delays", "counter",
+    "Times the client tty's input was stopped by the command's pacing" },
+  { "yar_cmd_broadcast_queued_bytes", "gauge",
+    "Output queued for the broadcast tty" },
+  { "yar_cmd_rtt_seconds", "histogram",
+    "Round trip time of the probes (see -Q)" },
+};
+
+// histogram bucket upper bounds (+Inf is added)
+static const double statsRttLes[] = { 0.0005, 0.001, 0.0025, 0.005, 0.01,
+				      0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5,
+				      5.0 };
+static const double statsTtrLes[] = { 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0,
+				      30.0, 60.0, 300.0 };
+#define STATS_NLES(les) ((int)(sizeof(les) / sizeof(les[0])))
+
+static void
+statsNow(struct timespec *now)
+{
+  if (clock_gettime(CLOCK_SOURCE, now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+}
+
+static double
+statsWallNow()
+{
+  struct timespec ts;
+  if (clock_gettime(CLOCK_REALTIME, &ts) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  return ts.tv_sec + ts.tv_nsec / (double)NSEC_IN_SECOND;
+}
+
+// file descriptors open in yar
+static int
+statsOpenFds()
+{
+  DIR           *d = opendir("/proc/self/fd");
+  struct dirent *e;
+  int            n = 0;
+  if (d == NULL) return -1;
+  while ((e = readdir(d)) != NULL) if (e->d_name[0] != '.') n++;
+  closedir(d);
+  return n - 1;                 // the directory's own
+}
+
+// ttys of cmd that are open (a command's and its standby instances')
+static int
+statsCmdPtys(cmd_t *cmd)
+{
+  int n = (cmd->cmdtty.dfd != -1) + (cmd->clttty.dfd != -1);
+  if (cmd->sby.insts) {
+    for (int i=0; i<STANDBY_MAX; i++) n += (cmd->sby.insts[i].pid != -1);
+  }
+  return n;
+}
+
+static void
+statsFam(FILE *f, const char *name, const char *type, const char *help)
+{
+  fprintf(f, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+// the labels of a sample: the command's name (if cmd) and key=val (if key)
+static void
+statsLabels(FILE *f, cmd_t *cmd, const char *key, const char *val)
+{
+  if (cmd == NULL && key == NULL) return;
+  fputc('{', f);
+  if (cmd) {
+    fputs("name=\"", f);
+    for (char *c=cmd->name; *c; c++) {
+      if (*c == '\\' || *c == '"') fputc('\\', f);
+      if (*c == '\n') fputs("\\n", f);
+      else fputc(*c, f);
+    }
+    fputc('"', f);
+  }
+  if (key) fprintf(f, "%s%s=\"%s\"", (cmd) ? "," : "", key, val);
+  fputc('}', f);
+}
+
+// a histogram sample (buckets, count and sum) with upper bounds les
+static void
+statsHistSamples(FILE *f, const char *name, cmd_t *cmd, hist_t *h,
+		 const double *les, int n)
+{
+  uint64_t counts[n];
+  char     le[32];
+  histCumulative(h, les, n, counts);
+  for (int i=0; i<=n; i++) {
+    if (i < n) snprintf(le, sizeof(le), "%g", les[i]);
+    else strcpy(le, "+Inf");
+    fprintf(f, "%s_bucket", name);
+    statsLabels(f, cmd, "le", le);
+    fprintf(f, " %lu\n", (i < n) ? counts[i] : h->count);
+  }
+  fprintf(f, "%s_count", name);
+  statsLabels(f, cmd, NULL, NULL);
+  fprintf(f, " %lu\n%s_sum", h->count, name);
+  statsLabels(f, cmd, NULL, NULL);
+  fprintf(f, " %.9g\n", h->sum);
+}
+
+static void
+statsSample(FILE *f, const char *name, const char *suffix, cmd_t *cmd,
+	    const char *key, const char *val, const char *fmt, ...)
+{
+  va_list ap;
+  fprintf(f, "%s%s", name, suffix);
+  statsLabels(f, cmd, key, val);
+  fputc(' ', f);
+  va_start(ap, fmt);
+  vfprintf(f, fmt, ap);
+  va_end(ap);
+  fputc('\n', f);
+}
+
+// the counters the metric samples of cmd are rendered from
+static void
+statsCmdVals(cmd_t *cmd, uint64_t *vals)
+{
+  int i = 0;
+  vals[i++] = cmdIsRunning(cmd);
+  vals[i++] = cmdIsReady(cmd);
+  memcpy(&vals[i++], &(cmd->st.startwall), sizeof(double));
+  vals[i++] = cmd->restartcnt;
+  vals[i++] = cmd->st.exits;
+  vals[i++] = cmd->st.errexits;
+  vals[i++] = cmd->cmdtty.wbytes;
+  vals[i++] = cmd->cmdtty.rbytes;
+  vals[i++] = cmd->st.lines;
+  vals[i++] = cmd->clttty.wdbytes;
+  vals[i++] = cmd->pace.throttles;
+  vals[i++] = cmd->fq.len;
+  vals[i++] = cmd->ping.rtts.count;
+  memcpy(&vals[i++], &(cmd->ping.rtts.sum), sizeof(double));
+  ASSERT(i == STATS_CMDVALS);
+}
+
+// render the samples of each per command family for cmd
+static void
+statsCmdRender(stats_t *this, cmd_t *cmd, uint64_t *vals)
+{
+  cmdstats_t *st = &(cmd->st);
+  FILE       *f;
+
+  if (st->mtxt) free(st->mtxt);
+  st->mtxt = NULL;
+  f = open_memstream(&(st->mtxt), &(st->mtxtn));
+  assert(f);
+  for (int fam=0; fam<STATS_CMDFAMS; fam++) {
+    const char *name = statsCmdFams[fam].name;
+    st->moffs[fam] = ftell(f);
+    switch (fam) {
+    case 0:
+      statsSample(f, name, "", cmd, NULL, NULL, "%d", cmdIsRunning(cmd));
+      break;
+    case 1:
+      statsSample(f, name, "", cmd, NULL, NULL, "%d", cmdIsReady(cmd));
+      break;
+    case 2:
+      statsSample(f, name, "", cmd, NULL, NULL, "%.3f", st->startwall);
+      break;
+    case 3:
+      statsSample(f, name, "_total", cmd, NULL, NULL, "%d", cmd->restartcnt);
+      break;
+    case 4:
+      statsSample(f, name, "_total", cmd, "status", "ok", "%lu", st->exits);
+      statsSample(f, name, "_total", cmd, "status", "error", "%lu",
+		  st->errexits);
+      break;
+    case 5:
+      statsSample(f, name, "_total", cmd, NULL, NULL, "%lu",
+		  cmd->cmdtty.wbytes);
+      break;
+    case 6:
+      statsSample(f, name, "_total", cmd, NULL, NULL, "%lu",
+		  cmd->cmdtty.rbytes);
+      break;
+    case 7:
+      statsSample(f, name, "_total", cmd, NULL, NULL, "%lu", st->lines);
+      break;
+    case 8:
+      statsSample(f, name, "_total", cmd, NULL, NULL, "%lu",
+		  cmd->clttty.wdbytes);
+      break;
+    case 9:
+      statsSample(f, name, "_total", cmd, NULL, NULL, "%lu",
+		  cmd->pace.throttles);
+      break;
+    case 10:
+      statsSample(f, name, "", cmd, NULL, NULL, "%d", cmd->fq.len);
+      break;
+    case 11:
+      statsHistSamples(f, name, cmd, &(cmd->ping.rtts), statsRttLes,
+		       STATS_NLES(statsRttLes));
+      break;
+    }
+  }
+  st->moffs[STATS_CMDFAMS] = ftell(f);
+  fclose(f);
+  memcpy(st->mvals, vals, sizeof(st->mvals));
+  this->renders++;
+}
+
+static void
+statsMetrics(stats_t *this, FILE *f, struct timespec *now)
+{
+  uint64_t vals[STATS_CMDVALS];
+  cmd_t   *cmd, *tmp;
+  int      running = 0, ptys = 0;
+  hist_t  *ttr = &(GBLS.ready.ttrhist);
+
+  // bring the samples of the commands whose counters changed up to date
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    statsCmdVals(cmd, vals);
+    if (cmd->st.mtxt == NULL || memcmp(vals, cmd->st.mvals, sizeof(vals))) {
+      statsCmdRender(this, cmd, vals);
+    }
+    running += cmdIsRunning(cmd);
+    ptys    += statsCmdPtys(cmd);
+  }
+  ptys += (GBLS.bcsttty.dfd != -1) + (GBLS.mon.tty.dfd != -1);
+
+  statsFam(f, "yar_start_time_seconds", "gauge",
+	   "Start time of yar since the epoch");
+  statsSample(f, "yar_start_time_seconds", "", NULL, NULL, NULL, "%.3f",
+	      this->startwall);
+  statsFam(f, "yar_commands", "gauge", "Commands");
+  statsSample(f, "yar_commands", "", NULL, NULL, NULL, "%u",
+	      HASH_COUNT(GBLS.cmds));
+  statsFam(f, "yar_commands_running", "gauge", "Commands running");
+  statsSample(f, "yar_commands_running", "", NULL, NULL, NULL, "%d",
+	      running);
+  statsFam(f, "yar_open_fds", "gauge", "File descriptors open in yar");
+  statsSample(f, "yar_open_fds", "", NULL, NULL, NULL, "%d",
+	      statsOpenFds());
+  statsFam(f, "yar_ptys", "gauge", "Ptys open in yar");
+  statsSample(f, "yar_ptys", "", NULL, NULL, NULL, "%d", ptys);
+  statsFam(f, "yar_epoll_batch_size", "histogram",
+	   "Events returned by each epoll_wait");
+  {
+    uint64_t cum = 0;
+    char     le[32];
+    for (int b=0; b<EVNT_BATCHES; b++) {
+      cum += GBLS.loop.batches[b];
+      snprintf(le, sizeof(le), "%d", 1 << b);
+      statsSample(f, "yar_epoll_batch_size", "_bucket", NULL, "le", le,
+		  "%lu", cum);
+    }
+    statsSample(f, "yar_epoll_batch_size", "_bucket", NULL, "le", "+Inf",
+		"%lu", GBLS.loop.waits);
+    statsSample(f, "yar_epoll_batch_size", "_count", NULL, NULL, NULL, "%lu",
+		GBLS.loop.waits);
+    statsSample(f, "yar_epoll_batch_size", "_sum", NULL, NULL, NULL, "%lu",
+		GBLS.loop.events);
+  }
+  statsFam(f, "yar_loop_dispatches", "counter", "Event handler dispatches");
+  statsSample(f, "yar_loop_dispatches", "_total", NULL, NULL, NULL, "%lu",
+	      GBLS.loop.dispatches);
+  statsFam(f, "yar_loop_deferrals", "counter",
+	   "Event handlers deferred as their budget was used up");
+  statsSample(f, "yar_loop_deferrals", "_total", NULL, NULL, NULL, "%lu",
+	      GBLS.loop.deferrals);
+  statsFam(f, "yar_broadcast_input_bytes", "counter",
+	   "Bytes read from the broadcast tty");
+  statsSample(f, "yar_broadcast_input_bytes", "_total", NULL, NULL, NULL,
+	      "%lu", GBLS.bcsttty.rbytes);
+  statsFam(f, "yar_broadcast_output_bytes", "counter",
+	   "Bytes written to the broadcast tty");
+  statsSample(f, "yar_broadcast_output_bytes", "_total", NULL, NULL, NULL,
+	      "%lu", GBLS.bcsttty.wbytes);
+  statsFam(f, "yar_broadcast_discarded_bytes", "counter",
+	   "Output not written to the broadcast tty");
+  statsSample(f, "yar_broadcast_discarded_bytes", "_total", NULL, NULL, NULL,
+	      "%lu", GBLS.bcsttty.wdbytes);
+  statsFam(f, "yar_ready_seconds", "histogram",
+	   "Time for commands to become ready (see -R)");
+  statsHistSamples(f, "yar_ready_seconds", NULL, ttr, statsTtrLes,
+		   STATS_NLES(statsTtrLes));
+  statsFam(f, "yar_metrics_renders", "counter",
+	   "Times the samples of a command were rendered");
+  statsSample(f, "yar_metrics_renders", "_total", NULL, NULL, NULL, "%lu",
+	      this->renders);
+
+  // the per command families: copies of each command's samples
+  for (int fam=0; fam<STATS_CMDFAMS; fam++) {
+    statsFam(f, statsCmdFams[fam].name, statsCmdFams[fam].type,
+	     statsCmdFams[fam].help);
+    HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+      fwrite(&(cmd->st.mtxt[cmd->st.moffs[fam]]), 1,
+	     cmd->st.moffs[fam+1] - cmd->st.moffs[fam], f);
+    }
+  }
+  fprintf(f, "# EOF\n");
+}
+
+static void
+statsText(stats_t *this, FILE *f, struct timespec *now)
+{
+  cmd_t *cmd, *tmp;
+  int    running = 0;
+
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) if (cmdIsRunning(cmd)) running++;
+  fprintf(f, "yar pid=%d uptime=%.3f cmds=%u running=%d waits=%lu "
+	  "events=%lu dispatches=%lu deferrals=%lu bcstin=%lu bcstout=%lu "
+	  "bcstdiscards=%lu bcstdelays=%lu fqdepth=%d fqblocks=%lu "
+	  "fqqueued=%lu fqdrops=%lu wqdepth=%d snapshots=%lu\n",
+	  GBLS.pid, tsDiff(now, &(this->startts)), HASH_COUNT(GBLS.cmds),
+	  running, GBLS.loop.waits, GBLS.loop.events, GBLS.loop.dispatches,
+	  GBLS.loop.deferrals, GBLS.bcsttty.rbytes, GBLS.bcsttty.wbytes,
+	  GBLS.bcsttty.wdbytes, GBLS.pace.throttles, GBLS.fairq.depth,
+	  GBLS.fairq.blocks, GBLS.fairq.queued, GBLS.fairq.drops,
+	  GBLS.workq.depth, this->snaps[STATS_TEXT].takes + 1);
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    fprintf(f, "cmd name=%s pid=%d running=%d ready=%d restarts=%d "
+	    "exits=%lu errexits=%lu stops=%lu status=%d runsecs=%.3f "
+	    "in=%lu out=%lu lines=%lu discards=%lu cltin=%lu cltout=%lu "
+	    "cltdiscards=%lu delays=%lu overflows=%d fqdepth=%d fqqueued=%lu "
+	    "fqdrops=%lu suppressed=%lu held=%d inflight=%d\n",
+	    cmd->name, cmd->pid, cmdIsRunning(cmd), cmdIsReady(cmd),
+	    cmd->restartcnt, cmd->st.exits, cmd->st.errexits, cmd->st.stops,
+	    cmd->exitstatus, statsCmdRunSecs(cmd, now), cmd->cmdtty.wbytes,
+	    cmd->cmdtty.rbytes, cmd->st.lines, cmd->cmdtty.wdbytes,
+	    cmd->clttty.rbytes, cmd->clttty.wbytes, cmd->clttty.wdbytes,
+	    cmd->pace.throttles, cmd->bufof, cmd->fq.len, cmd->fq.queued,
+	    cmd->fq.drops, cmd->lmt.suppressed, cmd->rdy.heldn,
+	    cmd->wq.inflight);
+  }
+}
+
+// retake the snapshot of fmt
+static void
+statsTake(stats_t *this, statsfmt_t fmt, struct timespec *now)
+{
+  statssnap_t *snap = &(this->snaps[fmt]);
+  FILE        *f;
+  if (snap->buf) free(snap->buf);
+  snap->buf = NULL;
+  f = open_memstream(&(snap->buf), &(snap->n));
+  assert(f);
+  if (fmt == STATS_METRICS) statsMetrics(this, f, now);
+  else statsText(this, f, now);
+  fclose(f);
+  snap->ts = *now;
+  snap->takes++;
+}
+
+extern void
+statsInit(stats_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(stats_t));
+  for (int i=0; i<STATS_FMTS; i++) {
+    this->snaps[i].buf   = NULL;
+    this->snaps[i].n     = 0;
+    this->snaps[i].takes = 0;
+  }
+  this->renders = 0;
+  statsNow(&(this->startts));
+  this->startwall = statsWallNow();
+}
+
+// cmd's process has started (or a standby has taken over)
+extern void
+statsCmdStart(stats_t *this, cmd_t *cmd)
+{
+  statsNow(&(cmd->st.startts));
+  cmd->st.startwall = statsWallNow();
+}
+
+// cmd's process has exited (cmd->exitstatus is its status)
+extern void
+statsCmdExit(stats_t *this, cmd_t *cmd)
+{
+  struct timespec now;
+  statsNow(&now);
+  cmd->st.runsecs += tsDiff(&now, &(cmd->st.startts));
+  if (cmd->exitstatus == 0) cmd->st.exits++;
+  else cmd->st.errexits++;
+}
+
+// cmd's process has been stopped by yar
+extern void
+statsCmdStop(stats_t *this, cmd_t *cmd)
+{
+  struct timespec now;
+  statsNow(&now);
+  cmd->st.runsecs += tsDiff(&now, &(cmd->st.startts));
+  cmd->st.stops++;
+}
+
+// total time cmd has been running
+extern double
+statsCmdRunSecs(cmd_t *cmd, struct timespec *now)
+{
+  double secs = cmd->st.runsecs;
+  if (cmdIsRunning(cmd)) secs += tsDiff(now, &(cmd->st.startts));
+  return secs;
+}
+
+// must be called before cmd is freed
+extern void
+statsForgetCmd(stats_t *this, cmd_t *cmd)
+{
+  if (cmd->st.mtxt) free(cmd->st.mtxt);
+  cmd->st.mtxt  = NULL;
+  cmd->st.mtxtn = 0;
+}
+
+// size of the snapshot of fmt, retaking it first if it is too old (a
+// stat())
+extern size_t
+statsSize(stats_t *this, statsfmt_t fmt)
+{
+  statssnap_t    *snap = &(this->snaps[fmt]);
+  struct timespec now;
+  statsNow(&now);
+  if (snap->buf == NULL || tsDiff(&now, &(snap->ts)) >= STATS_MAXAGE) {
+    statsTake(this, fmt, &now);
+  }
+  return snap->n;
+}
+
+// the snapshot of fmt, taken only if there is none (a read())
+extern char *
+statsBuf(stats_t *this, statsfmt_t fmt, size_t *n)
+{
+  statssnap_t *snap = &(this->snaps[fmt]);
+  if (snap->buf == NULL) {
+    struct timespec now;
+    statsNow(&now);
+    statsTake(this, fmt, &now);
+  }
+  *n = snap->n;
+  return snap->buf;
+}
+
+// releases the snapshots and every command's metric samples
+extern void
+statsCleanup(stats_t *this)
+{
+  cmd_t *cmd, *tmp;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) statsForgetCmd(this, cmd);
+  for (int i=0; i<STATS_FMTS; i++) {
+    if (this->snaps[i].buf) free(this->snaps[i].buf);
+    this->snaps[i].buf = NULL;
+    this->snaps[i].n   = 0;
+  }
+}
+
+extern void
+statsDump(stats_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sstats: this=%p renders=%lu\n", prefix, this, this->renders);
+  for (int i=0; i<STATS_FMTS; i++) {
+    statssnap_t *snap = &(this->snaps[i]);
+    fprintf(f, "%s  snaps[%d]: buf=%p n=%zu ts=%ld:%ld takes=%lu\n", prefix,
+	    i, snap->buf, snap->n, snap->ts.tv_sec, snap->ts.tv_nsec,
+	    snap->takes);
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef __YAR_STATS_H__
+#define __YAR_STATS_H__
+
+struct cmd;
+
+#define STATS_MAXAGE 1.0     // seconds a snapshot is served before retaking
+#define STATS_CMDFAMS 12     // per command metric families (see stats.c)
+#define STATS_CMDVALS 14     // counters the metric samples are rendered from
+
+// per command counters not kept elsewhere (embedded in each cmd_t)
+typedef struct {
+  struct timespec startts;   // time the running process started
+  double          startwall; // same as seconds since the epoch
+  double          runsecs;   // time run by processes that have ended
+  uint64_t        lines;     // lines of output
+  uint64_t        exits;     // processes that exited with status 0
+  uint64_t        errexits;  // processes that exited otherwise
+  uint64_t        stops;     // processes stopped by yar (eg. once idle)
+  // the command's /metrics samples: the lines of each family, rendered
+  // again only when the counters they come from (vals) have changed
+  char           *mtxt;
+  size_t          mtxtn;
+  size_t          moffs[STATS_CMDFAMS+1]; // start of each family in mtxt
+  uint64_t        mvals[STATS_CMDVALS];
+} cmdstats_t;
+
+typedef enum {
+  STATS_TEXT,                // key=value lines (/stats)
+  STATS_METRICS,             // OpenMetrics text format (/metrics)
+  STATS_FMTS
+} statsfmt_t;
+
+// a formatted snapshot of counters
+typedef struct {
+  char           *buf;       // malloced (NULL until first taken)
+  size_t          n;         // bytes in buf
+  struct timespec ts;        // time it was taken
+  uint64_t        takes;     // times it has been (re)taken
+} statssnap_t;
+
+// Stats Object
+//   Keeps snapshots of the global and per command counters for the
+//   /stats and /metrics files of yarfs (see yarfs.c).  Formatting one
+//   walks all the commands, so rather than doing so on every stat() and
+//   read() of the file a snapshot is retaken only when a stat() finds it
+//   older than STATS_MAXAGE; reads are served from the snapshot the
+//   stat() sized.  /stats is one line per object of space separated
+//   key=value pairs, the first word being the kind of object: a 'yar'
+//   line with the global counters followed by a 'cmd' line per command.
+//   /metrics is the OpenMetrics (Prometheus) text format.  As the samples
+//   of each metric family must be together, each command keeps its own
+//   samples rendered per family and only renders them again when its
+//   counters change, a snapshot of the per command families is then a
+//   matter of copying, so scraping many mostly idle commands is cheap.
+typedef struct {
+  statssnap_t     snaps[STATS_FMTS];
+  struct timespec startts;   // time yar started
+  double          startwall; // same as seconds since the epoch
+  uint64_t        renders;   // per command metric samples rendered
+} stats_t;
+
+extern void   statsInit(stats_t *this, bool iszeroed);
+extern void   statsCmdStart(stats_t *this, struct cmd *cmd);
+extern void   statsCmdExit(stats_t *this, struct cmd *cmd);
+extern void   statsCmdStop(stats_t *this, struct cmd *cmd);
+extern double statsCmdRunSecs(struct cmd *cmd, struct timespec *now);
+extern void   statsForgetCmd(stats_t *this, struct cmd *cmd);
+extern size_t statsSize(stats_t *this, statsfmt_t fmt);
+extern char  *statsBuf(stats_t *this, statsfmt_t fmt, size_t *n);
+extern void   statsCleanup(stats_t *this);
+extern void   statsDump(stats_t *this, FILE *f, char *prefix);
+#endif
@@ -0,0 +1,114 @@
+#include "yar.h"
+#include <sys/timerfd.h>
+
+static void
+secs2ts(double secs, struct timespec *ts)
+{
+  ts->tv_sec  = (time_t)secs;
+  ts->tv_nsec = (long)((secs - ts->tv_sec) * NSEC_IN_SECOND);
+}
+
+static evnthdlrrc_t
+tmrEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  tmr_t   *this = obj;
+  uint64_t exp  = 0;
+  ssize_t  n;
+
+  VLPRINT(3, "START: tmr:%p fd:%d evnts:0x%08x\n", this, this->fd, evnts);
+  if (evnts & EPOLLIN) {
+    n = read(this->fd, &exp, sizeof(exp));
+    if (n != sizeof(exp)) {
+      // timer was disarmed or rearmed after the expiration was queued
+      if (n == -1 && errno == EAGAIN) return EVNT_HDLR_SUCCESS;
+      perror("read: timerfd");
+      NYI;
+    }
+    this->expirations += exp;
+    if (!this->periodic) this->armed = false;
+    return this->hdlr(this->obj, evnts, epollfd);
+  }
+  VLPRINT(2, "unknown events evnts:%x\n", evnts);
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+tmrInit(tmr_t *this, evnthdlr_t hdlr, void *obj, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(tmr_t));
+  this->ed         = (evntdesc_t){ .obj = this, .hdlr = tmrEvent };
+  this->hdlr       = hdlr;
+  this->obj        = obj;
+  this->registered = false;
+  this->armed      = false;
+  this->periodic   = false;
+  this->fd = timerfd_create(CLOCK_SOURCE, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (this->fd == -1) {
+    perror("timerfd_create");
+    return false;
+  }
+  return true;
+}
+
+// arm the timer to expire in secs and then every interval secs
+// (interval of 0 is a one shot timer).  Rearming a running timer resets it.
+extern bool
+tmrArm(tmr_t *this, int epollfd, double secs, double interval)
+{
+  struct itimerspec its;
+  ASSERT(this->fd != -1);
+  if (!this->registered) {
+    struct epoll_event ev;
+    ASSERT(epollfd != -1);
+    ev.events   = EPOLLIN;
+    ev.data.ptr = &(this->ed);
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, this->fd, &ev) == -1) {
+      perror("epoll_ctl: tmr");
+      return false;
+    }
+    this->registered = true;
+  }
+  // an all zero it_value disarms so round tiny values up to a nanosecond
+  if (secs <= 0.0) secs = 1.0 / NSEC_IN_SECOND;
+  secs2ts(secs, &its.it_value);
+  secs2ts(interval, &its.it_interval);
+  if (timerfd_settime(this->fd, 0, &its, NULL) == -1) {
+    perror("timerfd_settime");
+    return false;
+  }
+  this->armed    = true;
+  this->periodic = (interval > 0.0);
+  return true;
+}
+
+extern bool
+tmrDisarm(tmr_t *this)
+{
+  struct itimerspec its;
+  if (this->fd == -1 || !this->armed) return true;
+  bzero(&its, sizeof(its));
+  if (timerfd_settime(this->fd, 0, &its, NULL) == -1) {
+    perror("timerfd_settime");
+    return false;
+  }
+  this->armed = false;
+  return true;
+}
+
+extern void
+tmrCleanup(tmr_t *this)
+{
+  // closing the fd removes it from the epoll set
+  if (this->fd != -1) close(this->fd);
+  this->fd         = -1;
+  this->registered = false;
+  this->armed      = false;
+}
+
+extern void
+tmrDump(tmr_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%stmr: this=%p fd=%d armed=%d periodic=%d registered=%d "
+	  "expirations=%lu obj=%p\n", prefix, this, this->fd, this->armed,
+	  this->periodic, this->registered, this->expirations, this->obj);
+}
@@ -0,0 +1,29 @@
+#ifndef __YAR_TMR_H__
+#define __YAR_TMR_H__
+
+// Timer Object
+//   Wraps a timerfd so that timeouts are delivered as events by theLoop like
+//   any other i/o.  The fd is added to the epoll set the first time the
+//   timer is armed.  When the timer expires hdlr is called with obj.
+typedef struct {
+  evntdesc_t  ed;           // event descriptor for theLoop (internal handler)
+  evnthdlr_t  hdlr;         // user handler called on expiration
+  void       *obj;          // object passed to hdlr
+  uint64_t    expirations;  // total number of expirations
+  int         fd;           // timerfd
+  bool        registered;   // fd has been added to the epoll set
+  bool        armed;        // timer is running
+  bool        periodic;     // timer rearms itself after expiring
+} tmr_t;
+
+extern bool tmrInit(tmr_t *this, evnthdlr_t hdlr, void *obj, bool iszeroed);
+extern bool tmrArm(tmr_t *this, int epollfd, double secs, double interval);
+extern bool tmrDisarm(tmr_t *this);
+extern void tmrCleanup(tmr_t *this);
+extern void tmrDump(tmr_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool tmrIsArmed(tmr_t *this)
+{
+  return this->armed;
+}
+#endif
@@ -277,6 +277,48 @@ ttyRegisterEvents(tty_t *this, int epollfd)
   return true;
 }
 
+// enable or disable input events from the tty's dom-tty.  While disabled
+// data written to the sub-tty stays buffered in the kernel tty port which
+// in turn blocks the writer (back pressure)
+extern bool
+ttyInputEnable(tty_t *this, int epollfd, bool enable)
+{
+  struct epoll_event ev;
+  ASSERT(this && this->dfd != -1 && epollfd != -1);
+  ev.events   = EPOLLHUP | EPOLLRDHUP | EPOLLERR; // Level 
+  if (enable) ev.events |= EPOLLIN;
+  ev.data.ptr = &this->dfded;
+  if (epoll_ctl(epollfd, EPOLL_CTL_MOD, this->dfd, &ev) == -1 ) {
+    perror("epoll_ctl: EPOLL_CTL_MOD tty->dfd");
+    return false;
+  }
+  return true;
+}
+
+// book keeping for n bytes of buf successfully written to the tty (by
+// ttyWriteBuf or by a batched write see uring.c): mark the time of the
+// write if needed
+extern void
+ttyWrote(tty_t *this, char *buf, int n, struct timespec *ts)
+{
+  if (ts) {
+    if (clock_gettime(CLOCK_SOURCE, ts) == -1) {
+      perror("clock_gettime");
+      NYI;
+    }
+  }
+  this->wbytes+=n;
+  if (verbose(2)) {
+    asciistr_t charstr;
+    ascii_char2str((int)buf[0], charstr);
+    VPRINT("  %p:%s(%s): fd:%d n=%d buf[0]:%02x(%s) %s", this, this->link,
+	   this->path, this->dfd, n, buf[0], charstr,
+	   (ascii_isprintable(buf[0])) ? "" : "^^^^ NOT PRINTABLE ^^^^");
+    if (ts) fprintf(stderr, "@%ld:%ld\n", ts->tv_sec, ts->tv_nsec);
+    else fprintf(stderr, "\n");
+  }
+}
+
 extern int
 ttyWriteBuf(tty_t *this, char *buf, int len,  struct timespec *ts)
 {
@@ -293,25 +335,10 @@ ttyWriteBuf(tty_t *this, char *buf, int len,  struct timespec *ts)
 	perror("ttyWriteChar write failed");
 	NYI;
       }
-    } else if (n==len) {
-      // success mark the time of the write if needed
-      if (ts) {
-	if (clock_gettime(CLOCK_SOURCE, ts) == -1) {
-	  perror("clock_gettime");
-	  NYI;
-	}
-      }
-      // book keeping
-      this->wbytes+=n;
-      if (verbose(2)) {
-	asciistr_t charstr;
-	ascii_char2str((int)buf[0], charstr);
-	VPRINT("  %p:%s(%s): fd:%d n=%d buf[0]:%02x(%s) %s", this, this->link,
-	       this->path, this->dfd, n, buf[0], charstr,
-	       (ascii_isprintable(buf[0])) ? "" : "^^^^ NOT PRINTABLE ^^^^");
-	if (ts) fprintf(stderr, "@%ld:%ld\n", ts->tv_sec, ts->tv_nsec);
-	else fprintf(stderr, "\n");
-      }
+    } else if (n>0) {
+      // success (possibly partial if the tty port is nearly full: the
+      // caller sees n<len)
+      ttyWrote(this, buf, n, ts);
     } else {
       // n==0
       EPRINT(stderr, "write returned unexpected value?? n=%d\n", n);
@@ -373,6 +400,25 @@ ttyReadChar(tty_t *this, char *c, struct timespec *ts, double delay)
   return n;
 }
 
+// read up to len bytes.  Returns the number read (0 if there are none)
+extern int
+ttyReadBuf(tty_t *this, char *buf, int len)
+{
+  int n = read(this->dfd, buf, len);
+
+  if (n>0) {
+    if (verbose(3)) {
+      VPRINT("  %p:%s(%s) fd:%d n:%d\n", this, this->link, this->path,
+	     this->dfd, n);
+      hexdump(stderr, (uint8_t *)buf, n);
+    }
+    this->rbytes += n;
+    return n;
+  }
+  VLPRINT(2, "  read failed?? %d\n", n);
+  return 0;
+}
+
 extern bool
 ttyCleanup(tty_t *this)
 {
@@ -74,10 +74,13 @@ extern bool ttyInit(tty_t *this, char *ttylink,
 //extern bool ttySetlink(tty_t *this, char *ttylink);
 extern bool ttyCreate(tty_t *this, evntdesc_t ed, evntdesc_t ned, bool raw);
 extern bool ttyRegisterEvents(tty_t *this, int epollfd);
+extern bool ttyInputEnable(tty_t *this, int epollfd, bool enable);
 extern bool ttyCleanup(tty_t *this);
 extern int  ttyWriteBuf(tty_t *this, char *buf, int len, struct timespec *ts);
+extern void ttyWrote(tty_t *this, char *buf, int n, struct timespec *ts);
 extern int  ttyReadChar(tty_t *this, char *c, struct timespec *ts,
 			double delay);
+extern int  ttyReadBuf(tty_t *this, char *buf, int len);
 extern void ttyPortSpace(tty_t *this, int *in, int *out, int *sin, int *sout);
 
 // INLINES
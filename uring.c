@@ -0,0 +1,259 @@
+#include "yar.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int
+uringSetup(unsigned entries, struct io_uring_params *p)
+{
+  return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+uringEnter(int fd, unsigned submit, unsigned complete, unsigned flags)
+{
+  return syscall(__NR_io_uring_enter, fd, submit, complete, flags, NULL, 0);
+}
+
+// does the kernel support op?  IORING_OP_WRITE is younger than io_uring
+// itself (5.6 vs 5.1) so a ring can be set up without it
+static bool
+uringProbe(int fd, unsigned op)
+{
+  struct io_uring_probe *p;
+  size_t sz = sizeof(*p) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+  bool   rc = false;
+
+  p = calloc(1, sz);
+  assert(p);
+  if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, p,
+	      IORING_OP_LAST) == -1) {
+    perror("io_uring_register: IORING_REGISTER_PROBE");
+  } else if (op <= p->last_op && op < p->ops_len) {
+    rc = (p->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+  }
+  free(p);
+  return rc;
+}
+
+// wait up to secs for complete completions: -1 with errno ETIME if they
+// have not all arrived
+static int
+uringWait(int fd, unsigned complete, double secs)
+{
+  struct __kernel_timespec      ts;
+  struct io_uring_getevents_arg arg;
+
+  ts.tv_sec  = (long long)secs;
+  ts.tv_nsec = (long long)((secs - ts.tv_sec) * NSEC_IN_SECOND);
+  memset(&arg, 0, sizeof(arg));
+  arg.ts = (uint64_t)(uintptr_t)&ts;
+  return syscall(__NR_io_uring_enter, fd, 0, complete,
+		 IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+		 sizeof(arg));
+}
+
+// queue an sqe: returns it zeroed
+static struct io_uring_sqe *
+uringSqe(uring_t *this, unsigned b)
+{
+  struct io_uring_sqe *sqes = this->sqes;
+  unsigned idx = (*this->sqtail + b) & *this->sqmask;
+
+  memset(&sqes[idx], 0, sizeof(sqes[idx]));
+  this->sqarray[idx] = idx;
+  return &sqes[idx];
+}
+
+// submit the batch sqes queued with uringSqe
+static void
+uringSubmit(uring_t *this, unsigned batch)
+{
+  int rc;
+
+  __atomic_store_n(this->sqtail, *this->sqtail + batch, __ATOMIC_RELEASE);
+  do {
+    rc = uringEnter(this->fd, batch, 0, 0);
+  } while (rc == -1 && errno == EINTR);
+  if (rc != batch) {
+    perror("io_uring_enter");
+    NYI;
+  }
+}
+
+// move the completions that have arrived into res.  Returns the number of
+// writes completed (the completions of cancels are skipped)
+static unsigned
+uringReap(uring_t *this, fanout_t *fo)
+{
+  struct io_uring_cqe *cqes = this->cqes;
+  unsigned head = *this->cqhead, got = 0;
+  unsigned ctl  = __atomic_load_n(this->cqtail, __ATOMIC_ACQUIRE);
+
+  for (; head != ctl; head++) {
+    struct io_uring_cqe *cqe = &cqes[head & *this->cqmask];
+    if (cqe->user_data & URING_CANCEL) continue;
+    fo->res[cqe->user_data] = cqe->res;
+    got++;
+  }
+  __atomic_store_n(this->cqhead, head, __ATOMIC_RELEASE);
+  return got;
+}
+
+// the io_uring fan-out backend (see GBLSFanout): write buf to fo's fds in
+// batches of at most entries.  A tty does not support non blocking
+// io_uring writes: the write to a full tty is not failed with -EAGAIN but
+// waits for room.  So the completions are waited for at most URING_WAIT
+// and the writes still waiting are cancelled (they have written nothing:
+// res is -EAGAIN as for a plain write)
+extern void
+uringFanout(void *obj, fanout_t *fo, char *buf, int len)
+{
+  uring_t *this = obj;
+  int      n = fo->n, i = 0;
+
+  while (i < n) {
+    unsigned first = i, batch = n - i, left;
+    if (batch > this->entries) batch = this->entries;
+    for (unsigned b=0; b<batch; b++, i++) {
+      struct io_uring_sqe *sqe = uringSqe(this, b);
+      sqe->opcode    = IORING_OP_WRITE;
+      sqe->fd        = fo->fds[i];
+      sqe->addr      = (uint64_t)(uintptr_t)buf;
+      sqe->len       = len;
+      sqe->off       = (uint64_t)-1;       // ttys have no offset
+      sqe->user_data = i;
+      fo->res[i]   = URING_INFLIGHT;
+    }
+    uringSubmit(this, batch);
+    this->batches++;
+    this->writes += batch;
+    left = batch;
+    if (uringWait(this->fd, left, URING_WAIT) == -1 && errno != ETIME &&
+	errno != EINTR) {
+      perror("io_uring_enter");
+      NYI;
+    }
+    left -= uringReap(this, fo);
+    if (left) {
+      // cancel the writes waiting for room (the CQ holds twice entries)
+      unsigned c = 0;
+      for (unsigned j=first; j<i; j++) {
+	if (fo->res[j] != URING_INFLIGHT) continue;
+	struct io_uring_sqe *sqe = uringSqe(this, c++);
+	sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+	sqe->fd        = -1;
+	sqe->addr      = j;
+	sqe->user_data = URING_CANCEL | j;
+      }
+      uringSubmit(this, c);
+      this->cancels += c;
+      while (left) {
+	if (uringEnter(this->fd, 0, 1, IORING_ENTER_GETEVENTS) == -1 &&
+	    errno != EINTR) {
+	  perror("io_uring_enter");
+	  NYI;
+	}
+	left -= uringReap(this, fo);
+      }
+      for (unsigned j=first; j<i; j++) {
+	if (fo->res[j] == -ECANCELED || fo->res[j] == -EINTR) {
+	  fo->res[j] = -EAGAIN;
+	}
+      }
+    }
+  }
+}
+
+extern void
+uringInit(uring_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(uring_t));
+  this->fd      = -1;
+  this->entries = URING_ENTRIES;
+  this->want    = false;
+}
+
+// set up the rings.  Returns false if io_uring is not available in which
+// case plain writes are used
+extern bool
+uringCreate(uring_t *this)
+{
+  struct io_uring_params p;
+
+  memset(&p, 0, sizeof(p));
+  this->fd = uringSetup(this->entries, &p);
+  if (this->fd == -1) {
+    perror("io_uring_setup");
+    return false;
+  }
+  if (!(p.features & IORING_FEAT_EXT_ARG)) {
+    // needed to bound the wait for writes to full ttys (see uringFanout)
+    EPRINT(stderr, "%s", "io_uring: IORING_FEAT_EXT_ARG not supported\n");
+    uringCleanup(this);
+    return false;
+  }
+  if (!uringProbe(this->fd, IORING_OP_WRITE)) {
+    EPRINT(stderr, "%s", "io_uring: IORING_OP_WRITE not supported\n");
+    uringCleanup(this);
+    return false;
+  }
+  this->entries  = p.sq_entries;
+  this->sqringsz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  this->cqringsz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (this->cqringsz > this->sqringsz) this->sqringsz = this->cqringsz;
+    this->cqringsz = this->sqringsz;
+  }
+  this->sqring = mmap(NULL, this->sqringsz, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_POPULATE, this->fd, IORING_OFF_SQ_RING);
+  if (this->sqring == MAP_FAILED) goto fail;
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    this->cqring = this->sqring;
+  } else {
+    this->cqring = mmap(NULL, this->cqringsz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, this->fd,
+			IORING_OFF_CQ_RING);
+    if (this->cqring == MAP_FAILED) goto fail;
+  }
+  this->sqessz = p.sq_entries * sizeof(struct io_uring_sqe);
+  this->sqes   = mmap(NULL, this->sqessz, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_POPULATE, this->fd, IORING_OFF_SQES);
+  if (this->sqes == MAP_FAILED) goto fail;
+  this->sqhead  = this->sqring + p.sq_off.head;
+  this->sqtail  = this->sqring + p.sq_off.tail;
+  this->sqmask  = this->sqring + p.sq_off.ring_mask;
+  this->sqarray = this->sqring + p.sq_off.array;
+  this->cqhead  = this->cqring + p.cq_off.head;
+  this->cqtail  = this->cqring + p.cq_off.tail;
+  this->cqmask  = this->cqring + p.cq_off.ring_mask;
+  this->cqes    = this->cqring + p.cq_off.cqes;
+  VLPRINT(1, "io_uring: fd=%d entries=%u\n", this->fd, this->entries);
+  return true;
+ fail:
+  perror("mmap: io_uring");
+  uringCleanup(this);
+  return false;
+}
+
+extern void
+uringCleanup(uring_t *this)
+{
+  if (this->sqes && this->sqes != MAP_FAILED) munmap(this->sqes, this->sqessz);
+  if (this->cqring && this->cqring != MAP_FAILED &&
+      this->cqring != this->sqring) munmap(this->cqring, this->cqringsz);
+  if (this->sqring && this->sqring != MAP_FAILED) {
+    munmap(this->sqring, this->sqringsz);
+  }
+  this->sqes = this->sqring = this->cqring = NULL;
+  if (this->fd != -1 && close(this->fd) != 0) perror("close uring->fd");
+  this->fd = -1;
+}
+
+extern void
+uringDump(uring_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%suring: this=%p fd=%d want=%d entries=%u batches=%lu "
+	  "writes=%lu cancels=%lu\n", prefix, this, this->fd, this->want,
+	  this->entries, this->batches, this->writes, this->cancels);
+}
@@ -0,0 +1,58 @@
+#ifndef __YAR_URING_H__
+#define __YAR_URING_H__
+
+struct fanout;
+
+#define URING_ENTRIES 256    // submission queue size (writes per batch)
+#define URING_WAIT    0.01   // seconds to wait for a batch before cancelling
+#define URING_CANCEL  (1ULL << 63)  // user_data flag of cancel requests
+#define URING_INFLIGHT INT32_MIN    // res of a write not completed yet
+
+// Uring Object
+//   Optional io_uring backend for the broadcast fan-out.  Rather than one
+//   write syscall per command, a chunk of broadcast input is submitted as a
+//   batch of writes (one per command) with a single io_uring_enter and
+//   their completions are reaped together.  The results are the same as
+//   those of the writes (bytes written or -EAGAIN when a tty is full, see
+//   uringFanout) so the book keeping is shared with the writer pool (see
+//   GBLSFanout).  Only the write fan-out is implemented: reads
+//   are out of scope and stay with epoll and the evntdesc_t handlers.
+//   They are not cheap, command output is read a byte per read() (see
+//   cmdttyProcessOutput), but batching them is a separate change.  If
+//   io_uring is not available (old kernel, seccomp, ...) yar falls back
+//   to plain writes.  The rings are mapped directly (liburing is not
+//   required).
+typedef struct {
+  unsigned *sqhead;       // submission ring
+  unsigned *sqtail;
+  unsigned *sqmask;
+  unsigned *sqarray;
+  unsigned *cqhead;       // completion ring
+  unsigned *cqtail;
+  unsigned *cqmask;
+  void     *sqes;         // struct io_uring_sqe[entries]
+  void     *cqes;         // struct io_uring_cqe[]
+  void     *sqring;
+  void     *cqring;
+  size_t    sqringsz;
+  size_t    cqringsz;
+  size_t    sqessz;
+  uint64_t  batches;      // io_uring_enter calls
+  uint64_t  writes;       // writes submitted
+  uint64_t  cancels;      // writes to full ttys cancelled
+  int       fd;           // io_uring fd (-1 if not in use)
+  unsigned  entries;
+  bool      want;         // use io_uring if available (-U)
+} uring_t;
+
+extern void uringInit(uring_t *this, bool iszeroed);
+extern bool uringCreate(uring_t *this);
+extern void uringFanout(void *obj, struct fanout *fo, char *buf, int len);
+extern void uringCleanup(uring_t *this);
+extern void uringDump(uring_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool uringIsOn(uring_t *this)
+{
+  return (this->fd != -1);
+}
+#endif
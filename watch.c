@@ -0,0 +1,340 @@
+#include "yar.h"
+
+// (re)build the automaton from the active patterns
+static void
+watchCompile(watch_t *this)
+{
+  int  maxstates = 1, n = 1;
+  int *fail, *queue, qh = 0, qt = 0;
+
+  for (int i=0; i<this->nslots; i++) {
+    if (this->pats[i]) maxstates += strlen(this->pats[i]);
+  }
+  this->delta    = realloc(this->delta, sizeof(int) * maxstates * 256);
+  this->outpat   = realloc(this->outpat, sizeof(int) * maxstates);
+  this->dictlink = realloc(this->dictlink, sizeof(int) * maxstates);
+  fail           = malloc(sizeof(int) * maxstates);
+  queue          = malloc(sizeof(int) * maxstates);
+  assert(this->delta && this->outpat && this->dictlink && fail && queue);
+  for (int i=0; i<maxstates*256; i++) this->delta[i] = -1;
+  for (int i=0; i<maxstates; i++) {
+    this->outpat[i]   = -1;
+    this->dictlink[i] = -1;
+  }
+
+  // 1) trie of the patterns
+  for (int p=0; p<this->nslots; p++) {
+    if (this->pats[p] == NULL) continue;
+    int s = 0;
+    for (uint8_t *c=(uint8_t *)this->pats[p]; *c; c++) {
+      if (this->delta[s*256 + *c] == -1) this->delta[s*256 + *c] = n++;
+      s = this->delta[s*256 + *c];
+    }
+    this->outpat[s] = p;
+  }
+
+  // 2) breadth first: compute fail links and fill in missing transitions
+  //    with those of the fail state so delta becomes a complete DFA
+  fail[0] = 0;
+  for (int c=0; c<256; c++) {
+    int t = this->delta[c];
+    if (t == -1) {
+      this->delta[c] = 0;
+    } else {
+      fail[t] = 0;
+      queue[qt++] = t;
+    }
+  }
+  while (qh < qt) {
+    int s = queue[qh++];
+    for (int c=0; c<256; c++) {
+      int t = this->delta[s*256 + c];
+      if (t == -1) {
+	this->delta[s*256 + c] = this->delta[fail[s]*256 + c];
+      } else {
+	int f = this->delta[fail[s]*256 + c];
+	fail[t] = f;
+	this->dictlink[t] = (this->outpat[f] != -1) ? f : this->dictlink[f];
+	queue[qt++] = t;
+      }
+    }
+  }
+  this->nstates = n;
+  free(fail);
+  free(queue);
+
+  // in progress matches are relative to the old automaton
+  cmd_t *cmd, *tmp;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    cmd->wtch.state    = 0;
+    cmd->wtch.npending = 0;
+  }
+}
+
+static int
+watchFind(watch_t *this, char *pat)
+{
+  for (int i=0; i<this->nslots; i++) {
+    if (this->pats[i] && strcmp(this->pats[i], pat) == 0) return i;
+  }
+  return -1;
+}
+
+// drop any counts and last line of slot from all commands
+static void
+watchResetSlot(watch_t *this, int slot)
+{
+  cmd_t *cmd, *tmp;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (slot < cmd->wtch.ncounts) {
+      cmd->wtch.counts[slot] = 0;
+      if (cmd->wtch.last[slot]) free(cmd->wtch.last[slot]);
+      cmd->wtch.last[slot] = NULL;
+    }
+  }
+}
+
+extern void
+watchInit(watch_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(watch_t));
+  this->pats      = NULL;
+  this->delta     = NULL;
+  this->outpat    = NULL;
+  this->dictlink  = NULL;
+  this->alertlink = NULL;
+  this->nslots    = 0;
+  this->npats     = 0;
+  this->alert     = false;
+  ttyInit(&(this->alerttty), NULL, NULL, NULL, NULL, NULL, iszeroed);
+  watchCompile(this);
+}
+
+extern bool
+watchAdd(watch_t *this, char *pat, FILE *f)
+{
+  int slot;
+  if (pat == NULL || *pat == '\0') {
+    EPRINT(f, "%s", "watch pattern must not be empty\n");
+    return false;
+  }
+  if (watchFind(this, pat) != -1) {
+    EPRINT(f, "already watching for: %s\n", pat);
+    return false;
+  }
+  for (slot=0; slot<this->nslots && this->pats[slot]; slot++);
+  if (slot == this->nslots) {
+    this->nslots++;
+    this->pats = realloc(this->pats, sizeof(char *) * this->nslots);
+    assert(this->pats);
+  }
+  watchResetSlot(this, slot);
+  this->pats[slot] = strdup(pat);
+  this->npats++;
+  watchCompile(this);
+  return true;
+}
+
+extern bool
+watchDel(watch_t *this, char *pat, FILE *f)
+{
+  int slot = watchFind(this, pat);
+  if (slot == -1) {
+    EPRINT(f, "not watching for: %s\n", pat);
+    return false;
+  }
+  free(this->pats[slot]);
+  this->pats[slot] = NULL;
+  this->npats--;
+  watchCompile(this);
+  return true;
+}
+
+extern void
+watchClear(watch_t *this)
+{
+  for (int i=0; i<this->nslots; i++) {
+    if (this->pats[i]) free(this->pats[i]);
+    this->pats[i] = NULL;
+  }
+  this->npats = 0;
+  watchCompile(this);
+}
+
+// cmd's line just completed: record it as the last line of the patterns it
+// matched and raise alerts
+static void
+watchLine(watch_t *this, cmd_t *cmd)
+{
+  cmdwatch_t *w = &(cmd->wtch);
+  char        hdr[64];
+
+  for (int i=0; i<w->npending; i++) {
+    int slot = w->pending[i];
+    if (w->last[slot]) free(w->last[slot]);
+    w->last[slot] = strndup(w->line, w->linen);
+    if (this->alert && this->alerttty.opens) {
+      int n = snprintf(hdr, sizeof(hdr), "%s: [", cmd->name);
+      if (n >= sizeof(hdr)) n = sizeof(hdr) - 1;
+      ttyWriteBuf(&(this->alerttty), hdr, n, NULL);
+      ttyWriteBuf(&(this->alerttty), this->pats[slot],
+		  strlen(this->pats[slot]), NULL);
+      ttyWriteBuf(&(this->alerttty), "] ", 2, NULL);
+      ttyWriteBuf(&(this->alerttty), w->line, w->linen, NULL);
+      ttyWriteBuf(&(this->alerttty), "\n", 1, NULL);
+      this->alerts++;
+    }
+  }
+  w->npending = 0;
+  w->linen    = 0;
+}
+
+// advance cmd's automaton over an output byte
+extern void
+watchChar(watch_t *this, cmd_t *cmd, char c)
+{
+  cmdwatch_t *w = &(cmd->wtch);
+  int         s, t;
+
+  if (c == '\n') {
+    if (w->npending) watchLine(this, cmd);
+    w->linen = 0;
+  } else if (c != '\r' && w->linen < WATCH_LINELEN) {
+    w->line[w->linen++] = c;
+  }
+  s = this->delta[w->state*256 + (uint8_t)c];
+  w->state = s;
+  for (t = (this->outpat[s] != -1) ? s : this->dictlink[s]; t != -1;
+       t = this->dictlink[t]) {
+    int slot = this->outpat[t];
+    if (slot >= w->ncounts) {
+      int ncounts = this->nslots;
+      w->counts = realloc(w->counts, sizeof(uint64_t) * ncounts);
+      w->last   = realloc(w->last, sizeof(char *) * ncounts);
+      assert(w->counts && w->last);
+      for (int i=w->ncounts; i<ncounts; i++) {
+	w->counts[i] = 0;
+	w->last[i]   = NULL;
+      }
+      w->ncounts = ncounts;
+    }
+    w->counts[slot]++;
+    this->matches++;
+    VLPRINT(2, "%s: matched %s\n", cmd->name, this->pats[slot]);
+    int i;
+    for (i=0; i<w->npending && w->pending[i] != slot; i++);
+    if (i == w->npending && w->npending < WATCH_MAXPENDING) {
+      w->pending[w->npending++] = slot;
+    }
+  }
+}
+
+static evnthdlrrc_t
+alertttyEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  tty_t *tty = obj;
+  char   buf[256];
+  // the alert tty is output only: discard anything written to it
+  if (evnts & EPOLLIN) {
+    while (read(tty->dfd, buf, sizeof(buf)) > 0);
+  }
+  return EVNT_HDLR_SUCCESS;
+}
+
+static evnthdlrrc_t
+alertttyNotify(void *obj, uint32_t mask, int epollfd)
+{
+  tty_t *tty = obj;
+  VPRINT("alerttty:%s(%s) mask:0x%x opens:%d\n", tty->link, tty->path, mask,
+	 tty->opens);
+  return EVNT_HDLR_SUCCESS;
+}
+
+// create the alert tty at alertlink (must be set)
+extern bool
+watchAlertttyCreate(watch_t *this)
+{
+  tty_t     *tty = &(this->alerttty);
+  evntdesc_t ed  = { .obj = tty, .hdlr = alertttyEvent };
+  evntdesc_t ned = { .obj = tty, .hdlr = alertttyNotify };
+  ASSERT(this->alertlink);
+  ttyInit(tty, this->alertlink, NULL, NULL, NULL, NULL, false);
+  if (!ttyCreate(tty, ed, ned, true)) return false;
+  this->alert = true;
+  return true;
+}
+
+extern bool
+watchRegisterEvents(watch_t *this, int epollfd)
+{
+  if (!this->alert) return true;
+  return ttyRegisterEvents(&(this->alerttty), epollfd);
+}
+
+// must be called before cmd is freed
+extern void
+watchForgetCmd(watch_t *this, cmd_t *cmd)
+{
+  cmdwatch_t *w = &(cmd->wtch);
+  for (int i=0; i<w->ncounts; i++) if (w->last[i]) free(w->last[i]);
+  if (w->counts) free(w->counts);
+  if (w->last) free(w->last);
+  w->counts  = NULL;
+  w->last    = NULL;
+  w->ncounts = 0;
+}
+
+// one line per pattern followed by a line per command that matched it:
+// count and the last matching line
+extern void
+watchReport(watch_t *this, FILE *f)
+{
+  cmd_t *cmd, *tmp;
+  fprintf(f, "watch: patterns:%d states:%d matches:%lu alerts:%lu "
+	  "alerttty:%s\n", this->npats, this->nstates, this->matches,
+	  this->alerts, (this->alert) ? this->alerttty.link : "");
+  for (int i=0; i<this->nslots; i++) {
+    if (this->pats[i] == NULL) continue;
+    fprintf(f, "pattern: %s\n", this->pats[i]);
+    HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+      cmdwatch_t *w = &(cmd->wtch);
+      if (i < w->ncounts && w->counts[i]) {
+	fprintf(f, "  %s count:%lu last:%s\n", cmd->name, w->counts[i],
+		(w->last[i]) ? w->last[i] : "");
+      }
+    }
+  }
+}
+
+extern void
+watchCleanup(watch_t *this)
+{
+  cmd_t *cmd, *tmp;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) watchForgetCmd(this, cmd);
+  for (int i=0; i<this->nslots; i++) if (this->pats[i]) free(this->pats[i]);
+  if (this->pats) free(this->pats);
+  if (this->delta) free(this->delta);
+  if (this->outpat) free(this->outpat);
+  if (this->dictlink) free(this->dictlink);
+  if (this->alertlink) free(this->alertlink);
+  if (this->alert) ttyCleanup(&(this->alerttty));
+  this->pats      = NULL;
+  this->delta     = NULL;
+  this->outpat    = NULL;
+  this->dictlink  = NULL;
+  this->alertlink = NULL;
+  this->nslots    = 0;
+  this->npats     = 0;
+  this->alert     = false;
+}
+
+extern void
+watchDump(watch_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%swatch: this=%p npats=%d nslots=%d nstates=%d matches=%lu "
+	  "alerts=%lu alertlink=%s\n", prefix, this, this->npats, this->nslots,
+	  this->nstates, this->matches, this->alerts, this->alertlink);
+  for (int i=0; i<this->nslots; i++) {
+    fprintf(f, "%s  pats[%d]=%s\n", prefix, i, this->pats[i]);
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef __YAR_WATCH_H__
+#define __YAR_WATCH_H__
+
+struct cmd;
+
+#define WATCH_LINELEN    256  // bytes of a matching line that are kept
+#define WATCH_MAXPENDING 16   // distinct patterns recorded per line
+
+// per command watch state (embedded in each cmd_t)
+typedef struct {
+  uint64_t *counts;                  // matches of each pattern (by slot)
+  char    **last;                    // last line matching each pattern
+  char      line[WATCH_LINELEN];     // current line (truncated)
+  int       pending[WATCH_MAXPENDING];// patterns matched in current line
+  int       state;                   // automaton state
+  int       linen;
+  int       npending;
+  int       ncounts;                 // size of counts and last
+} cmdwatch_t;
+
+// Watch Object
+//   Watches the output of all commands for any of a set of patterns.  The
+//   patterns are compiled into a single Aho-Corasick automaton (stored as a
+//   full transition table) so each byte of output costs one table lookup
+//   regardless of the number of patterns.  Per command, per pattern match
+//   counts and the last matching line are kept and, if an alert tty is
+//   configured, an event line is written to it for each matching line.
+typedef struct {
+  tty_t     alerttty;     // optional tty that alert lines are written to
+  char    **pats;         // patterns by slot (NULL if slot is free)
+  int      *delta;        // transitions: delta[state*256 + byte]
+  int      *outpat;       // pattern slot that ends at a state or -1
+  int      *dictlink;     // next state on the fail chain with output or -1
+  char     *alertlink;    // path of alert tty link
+  uint64_t  matches;      // total matches
+  uint64_t  alerts;       // total alert lines written
+  int       nslots;
+  int       npats;        // number of active patterns
+  int       nstates;
+  bool      alert;        // alert tty has been created
+} watch_t;
+
+extern void watchInit(watch_t *this, bool iszeroed);
+extern bool watchAdd(watch_t *this, char *pat, FILE *f);
+extern bool watchDel(watch_t *this, char *pat, FILE *f);
+extern void watchClear(watch_t *this);
+extern void watchChar(watch_t *this, struct cmd *cmd, char c);
+extern bool watchAlertttyCreate(watch_t *this);
+extern bool watchRegisterEvents(watch_t *this, int epollfd);
+extern void watchForgetCmd(watch_t *this, struct cmd *cmd);
+extern void watchReport(watch_t *this, FILE *f);
+extern void watchCleanup(watch_t *this);
+extern void watchDump(watch_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool watchIsOn(watch_t *this)
+{
+  return (this->npats != 0);
+}
+#endif
@@ -0,0 +1,391 @@
+#include "yar.h"
+
+static watchdogspec_t *
+watchdogSpecOf(watchdog_t *this, cmd_t *cmd)
+{
+  return (cmd->wdog.spec) ? cmd->wdog.spec : &(this->spec);
+}
+
+static void
+watchdogSpecCleanup(watchdogspec_t *spec)
+{
+  kmpCleanup(&(spec->pattern));
+  if (spec->probe) free(spec->probe);
+  spec->probe = NULL;
+  spec->mode  = WATCHDOG_OFF;
+}
+
+static void
+watchdogSpecDesc(watchdogspec_t *spec, FILE *f)
+{
+  switch (spec->mode) {
+  case WATCHDOG_OFF:
+    fprintf(f, "off");
+    break;
+  case WATCHDOG_IDLE:
+    fprintf(f, "idle:%.3f", spec->idle);
+    break;
+  case WATCHDOG_PROBE:
+    fprintf(f, "probe:%.3f:%.3f:\"%s\":\"%s\"", spec->every, spec->timeout,
+	    spec->probe, spec->pattern.str);
+    break;
+  }
+}
+
+// count the commands that are checked and drop the outstanding probe of
+// those whose spec changed (cmd, or all without their own if cmd is NULL)
+static void
+watchdogRecount(watchdog_t *this, cmd_t *cmd, bool changed)
+{
+  cmd_t *c, *tmp;
+  this->on = 0;
+  HASH_ITER(hh, GBLS.cmds, c, tmp) {
+    if (watchdogSpecOf(this, c)->mode != WATCHDOG_OFF) this->on++;
+    if (changed && (c == cmd || (cmd == NULL && c->wdog.spec == NULL))) {
+      c->wdog.waiting = false;
+    }
+  }
+  if (this->on && this->epollfd != -1 && !tmrIsArmed(&(this->tmr))) {
+    tmrArm(&(this->tmr), this->epollfd, WATCHDOG_TICK, WATCHDOG_TICK);
+  }
+}
+
+// start checking the process of cmd: its output is awaited, and its first
+// probe written, from after the start delay (the process only execs the
+// command line once the delay is over)
+static void
+watchdogReset(cmd_t *cmd, struct timespec *now, double startdelay)
+{
+  cmdwatchdog_t  *wd = &(cmd->wdog);
+  struct timespec ts = *now;
+  ts.tv_sec  += (time_t)startdelay;
+  ts.tv_nsec += (long)((startdelay - (time_t)startdelay) * 1e9);
+  if (ts.tv_nsec >= 1000000000L) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+  wd->pid     = cmd->pid;
+  wd->lastout = ts;
+  wd->probets = ts;
+  wd->rbytes  = cmd->cmdtty.rbytes;
+  wd->waiting = false;
+  wd->killing = false;
+}
+
+// cmd is alive but hung: have it exit (it is then restarted as usual)
+static void
+watchdogHung(watchdog_t *this, cmd_t *cmd, struct timespec *now, char *why)
+{
+  cmdwatchdog_t *wd = &(cmd->wdog);
+  EPRINT(stderr, "%s: pid:%d hung (%s) killing it\n", cmd->name, cmd->pid,
+	 why);
+  wd->hangs++;
+  this->hangs++;
+  wd->waiting = false;
+  wd->killing = true;
+  wd->killts  = *now;
+  if (kill(cmd->pid, SIGTERM) == -1) perror("kill hung command");
+}
+
+static void
+watchdogProbe(watchdog_t *this, cmd_t *cmd, watchdogspec_t *spec,
+	      struct timespec *now)
+{
+  cmdwatchdog_t *wd = &(cmd->wdog);
+  char line[CMD_BUFSIZE];
+  int  len = snprintf(line, sizeof(line), "%s\n", spec->probe);
+  if (len >= sizeof(line)) len = sizeof(line) - 1;
+  wd->probets = *now;
+  wd->cnt     = 0;
+  wd->waiting = true;
+  wd->probes++;
+  if (cmdWriteBuf(cmd, line, len) != len) {
+    VLPRINT(1, "%s: probe did not fit in the tty\n", cmd->name);
+  }
+}
+
+// check every running command
+static evnthdlrrc_t
+watchdogTmrEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  watchdog_t *this = obj;
+  struct timespec now;
+  cmd_t *cmd, *tmp;
+
+  if (this->on == 0) {
+    tmrDisarm(&(this->tmr));
+    return EVNT_HDLR_SUCCESS;
+  }
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    watchdogspec_t *spec = watchdogSpecOf(this, cmd);
+    cmdwatchdog_t  *wd   = &(cmd->wdog);
+    if (spec->mode == WATCHDOG_OFF || !cmdIsRunning(cmd)) continue;
+    if (wd->pid != cmd->pid) {
+      // a process not seen by watchdogStart (eg. a standby that took
+      // over): start checking it from now
+      watchdogReset(cmd, &now, 0.0);
+      continue;
+    }
+    if (wd->killing) {
+      if (tsDiff(&now, &(wd->killts)) >= WATCHDOG_KILLWAIT) {
+	EPRINT(stderr, "%s: pid:%d did not exit moving on to SIGKILL\n",
+	       cmd->name, cmd->pid);
+	if (kill(cmd->pid, SIGKILL) == -1) perror("kill hung command");
+	this->kills++;
+	wd->killts = now;
+      }
+      continue;
+    }
+    if (cmd->cmdtty.rbytes != wd->rbytes) {
+      wd->rbytes  = cmd->cmdtty.rbytes;
+      wd->lastout = now;
+    }
+    switch (spec->mode) {
+    case WATCHDOG_IDLE:
+      if (tsDiff(&now, &(wd->lastout)) >= spec->idle) {
+	watchdogHung(this, cmd, &now, "no output");
+      }
+      break;
+    case WATCHDOG_PROBE:
+      if (wd->waiting) {
+	if (tsDiff(&now, &(wd->probets)) >= spec->timeout) {
+	  watchdogHung(this, cmd, &now, "probe not answered");
+	}
+      } else if (cmdIsReady(cmd) &&
+		 tsDiff(&now, &(wd->probets)) >= spec->every) {
+	watchdogProbe(this, cmd, spec, &now);
+      }
+      break;
+    case WATCHDOG_OFF:
+      break;
+    }
+  }
+  return EVNT_HDLR_SUCCESS;
+}
+
+// spec is "off", "idle:<sec>" or
+// "probe:<every sec>:<timeout sec>:<string>[:<pattern>]" (the pattern
+// defaults to the string)
+static bool
+watchdogParse(char *spec, watchdogspec_t *ws, FILE *f)
+{
+  char *p, *end;
+
+  bzero(ws, sizeof(watchdogspec_t));
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing watchdog spec\n");
+    return false;
+  }
+  if (strcmp(spec, "off") == 0) {
+    ws->mode = WATCHDOG_OFF;
+    return true;
+  }
+  if (strncmp(spec, "idle:", 5) == 0) {
+    errno    = 0;
+    ws->idle = strtod(&spec[5], &end);
+    if (errno != 0 || end == &spec[5] || *end != '\0' || ws->idle <= 0.0) {
+      EPRINT(f, "bad watchdog idle timeout: %s\n", spec);
+      return false;
+    }
+    ws->mode = WATCHDOG_IDLE;
+    return true;
+  }
+  if (strncmp(spec, "probe:", 6) != 0) {
+    EPRINT(f, "unknown watchdog spec: %s\n", spec);
+    return false;
+  }
+  p = &spec[6];
+  errno     = 0;
+  ws->every = strtod(p, &end);
+  if (errno != 0 || end == p || *end != ':' || ws->every <= 0.0) {
+    EPRINT(f, "bad watchdog probe interval: %s\n", spec);
+    return false;
+  }
+  p = end + 1;
+  ws->timeout = strtod(p, &end);
+  if (errno != 0 || end == p || *end != ':' || ws->timeout <= 0.0) {
+    EPRINT(f, "bad watchdog probe timeout: %s\n", spec);
+    return false;
+  }
+  p   = end + 1;
+  end = strchr(p, ':');
+  ws->probe = (end) ? strndup(p, end - p) : strdup(p);
+  if (*ws->probe == '\0' || (end && end[1] == '\0')) {
+    EPRINT(f, "watchdog probe string and pattern must not be empty: %s\n",
+	   spec);
+    free(ws->probe);
+    ws->probe = NULL;
+    return false;
+  }
+  if (!kmpInit(&(ws->pattern), (end) ? end + 1 : ws->probe)) {
+    EPRINT(f, "%s", "failed to build watchdog pattern matcher\n");
+    free(ws->probe);
+    ws->probe = NULL;
+    return false;
+  }
+  ws->mode = WATCHDOG_PROBE;
+  return true;
+}
+
+extern bool
+watchdogInit(watchdog_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(watchdog_t));
+  this->spec.mode = WATCHDOG_OFF;
+  this->hangs     = 0;
+  this->kills     = 0;
+  this->on        = 0;
+  this->epollfd   = -1;
+  return tmrInit(&(this->tmr), watchdogTmrEvent, this, iszeroed);
+}
+
+// set the spec of cmd or, if cmd is NULL, the default used by all commands
+// that do not have their own including those added later
+extern bool
+watchdogSet(watchdog_t *this, cmd_t *cmd, char *spec, int epollfd, FILE *f)
+{
+  watchdogspec_t ws, *dst;
+
+  if (!watchdogParse(spec, &ws, f)) return false;
+  if (cmd == NULL) {
+    dst = &(this->spec);
+  } else {
+    if (cmd->wdog.spec == NULL) {
+      cmd->wdog.spec = calloc(1, sizeof(watchdogspec_t));
+      assert(cmd->wdog.spec);
+    }
+    dst = cmd->wdog.spec;
+  }
+  watchdogSpecCleanup(dst);
+  *dst = ws;
+  if (epollfd != -1) this->epollfd = epollfd;
+  watchdogRecount(this, cmd, true);
+  return true;
+}
+
+// cmd has been started with startdelay (see cmdStart)
+extern void
+watchdogStart(watchdog_t *this, cmd_t *cmd, double startdelay)
+{
+  struct timespec now;
+  if (watchdogSpecOf(this, cmd)->mode == WATCHDOG_OFF) return;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  watchdogReset(cmd, &now, startdelay);
+}
+
+// a byte of output of a command with a probe outstanding
+extern void
+watchdogChar(watchdog_t *this, cmd_t *cmd, char c)
+{
+  watchdogspec_t *spec = watchdogSpecOf(this, cmd);
+  cmdwatchdog_t  *wd   = &(cmd->wdog);
+  struct timespec now;
+
+  wd->cnt = kmpStep(&(spec->pattern), wd->cnt, c);
+  if (!kmpMatched(&(spec->pattern), wd->cnt)) return;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  wd->rtt     = tsDiff(&now, &(wd->probets));
+  wd->cnt     = 0;
+  wd->waiting = false;
+}
+
+// checking starts once the loop is running
+extern void
+watchdogRegisterEvents(watchdog_t *this, int epollfd)
+{
+  this->epollfd = epollfd;
+  watchdogRecount(this, NULL, false);
+}
+
+// must be called after cmd is added to GBLS.cmds
+extern void
+watchdogAddCmd(watchdog_t *this, cmd_t *cmd)
+{
+  cmd->wdog.pid = -1;
+  watchdogRecount(this, cmd, false);
+}
+
+// must be called after cmd is removed from GBLS.cmds and before it is freed
+extern void
+watchdogForgetCmd(watchdog_t *this, cmd_t *cmd)
+{
+  if (cmd->wdog.spec) {
+    watchdogSpecCleanup(cmd->wdog.spec);
+    free(cmd->wdog.spec);
+    cmd->wdog.spec = NULL;
+  }
+  watchdogRecount(this, NULL, false);
+}
+
+extern void
+watchdogReport(watchdog_t *this, FILE *f)
+{
+  struct timespec now;
+  cmd_t *cmd, *tmp;
+
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  fprintf(f, "watchdog: spec:");
+  watchdogSpecDesc(&(this->spec), f);
+  fprintf(f, " on:%d hangs:%lu kills:%lu\n", this->on, this->hangs,
+	  this->kills);
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    watchdogspec_t *spec = watchdogSpecOf(this, cmd);
+    cmdwatchdog_t  *wd   = &(cmd->wdog);
+    if (spec->mode == WATCHDOG_OFF && wd->hangs == 0) continue;
+    fprintf(f, "  %s hangs:%lu", cmd->name, wd->hangs);
+    if (spec->mode == WATCHDOG_PROBE) {
+      fprintf(f, " probes:%lu rtt:%.6f", wd->probes, wd->rtt);
+    }
+    if (cmdIsRunning(cmd) && wd->pid == cmd->pid) {
+      if (wd->killing) fprintf(f, " killing");
+      else if (wd->waiting) fprintf(f, " waiting:%.3f",
+				    tsDiff(&now, &(wd->probets)));
+      fprintf(f, " quiet:%.3f", tsDiff(&now, &(wd->lastout)));
+    }
+    if (cmd->wdog.spec) {
+      fprintf(f, " spec:");
+      watchdogSpecDesc(cmd->wdog.spec, f);
+    }
+    fprintf(f, "\n");
+  }
+}
+
+// releases the default spec and every command's own spec
+extern void
+watchdogCleanup(watchdog_t *this)
+{
+  cmd_t *cmd, *tmp;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (cmd->wdog.spec) {
+      watchdogSpecCleanup(cmd->wdog.spec);
+      free(cmd->wdog.spec);
+      cmd->wdog.spec = NULL;
+    }
+  }
+  tmrCleanup(&(this->tmr));
+  watchdogSpecCleanup(&(this->spec));
+  this->on = 0;
+}
+
+extern void
+watchdogDump(watchdog_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%swatchdog: this=%p spec=", prefix, this);
+  watchdogSpecDesc(&(this->spec), f);
+  fprintf(f, " on=%d hangs=%lu kills=%lu epollfd=%d\n", this->on,
+	  this->hangs, this->kills, this->epollfd);
+  tmrDump(&(this->tmr), f, prefix);
+}
@@ -0,0 +1,73 @@
+#ifndef __YAR_WATCHDOG_H__
+#define __YAR_WATCHDOG_H__
+
+struct cmd;
+
+#define WATCHDOG_TICK     0.1  // seconds between liveness checks
+#define WATCHDOG_KILLWAIT 2.0  // seconds after SIGTERM before SIGKILL
+
+typedef enum {
+  WATCHDOG_OFF,
+  WATCHDOG_IDLE,             // hung if there is no output for idle seconds
+  WATCHDOG_PROBE             // hung if a probe is not answered in time
+} watchdogmode_t;
+
+// how a command's liveness is checked
+typedef struct {
+  kmp_t          pattern;    // probe: expected in the output
+  char          *probe;      // probe: string written (with a newline)
+  double         idle;       // idle: seconds without output
+  double         every;      // probe: seconds between probes
+  double         timeout;    // probe: seconds for the pattern to appear
+  watchdogmode_t mode;
+} watchdogspec_t;
+
+// per command watchdog state (embedded in each cmd_t)
+typedef struct {
+  watchdogspec_t *spec;      // own spec, NULL to use the default
+  struct timespec lastout;   // last time output was seen
+  struct timespec probets;   // time the last probe was written
+  struct timespec killts;    // time the hung command was sent SIGTERM
+  uint64_t        rbytes;    // cmdtty bytes read when output was last seen
+  uint64_t        probes;    // probes written
+  uint64_t        hangs;     // times the command was found hung
+  double          rtt;       // time to answer the last probe
+  pid_t           pid;       // process being checked
+  int             cnt;       // probe pattern match state
+  bool            waiting;   // a probe is outstanding
+  bool            killing;   // hung and being killed
+} cmdwatchdog_t;
+
+// Watchdog Object
+//   Finds commands that are alive (so cmdPidEvent never fires) but hung,
+//   eg. an ssh stuck after a network partition, and kills them so they are
+//   restarted like any command that exits (a standby takes over if there
+//   is one, see standby.h).  A command is hung if it has produced no
+//   output for idle seconds or, in probe mode, if every so many seconds
+//   the probe string is written to it (once it is ready) and the pattern
+//   is not seen in its output within timeout seconds.  All commands are
+//   checked every WATCHDOG_TICK by a single timer.  A hung command is sent
+//   SIGTERM and, if it has still not exited WATCHDOG_KILLWAIT seconds
+//   later, SIGKILL; the loop never waits for it.
+typedef struct {
+  watchdogspec_t spec;       // default spec used by commands without one
+  tmr_t          tmr;        // liveness checks (armed while any is on)
+  uint64_t       hangs;      // hung commands found
+  uint64_t       kills;      // hung commands that needed SIGKILL
+  int            on;         // commands with a spec that is not off
+  int            epollfd;
+} watchdog_t;
+
+extern bool watchdogInit(watchdog_t *this, bool iszeroed);
+extern bool watchdogSet(watchdog_t *this, struct cmd *cmd, char *spec,
+			int epollfd, FILE *f);
+extern void watchdogStart(watchdog_t *this, struct cmd *cmd,
+			  double startdelay);
+extern void watchdogChar(watchdog_t *this, struct cmd *cmd, char c);
+extern void watchdogRegisterEvents(watchdog_t *this, int epollfd);
+extern void watchdogAddCmd(watchdog_t *this, struct cmd *cmd);
+extern void watchdogForgetCmd(watchdog_t *this, struct cmd *cmd);
+extern void watchdogReport(watchdog_t *this, FILE *f);
+extern void watchdogCleanup(watchdog_t *this);
+extern void watchdogDump(watchdog_t *this, FILE *f, char *prefix);
+#endif
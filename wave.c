@@ -0,0 +1,374 @@
+#include "yar.h"
+
+static void waveRun(wave_t *this);
+
+// announce a halted or finished rollout on the monitor
+static void
+waveAnnounce(wave_t *this, const char *what)
+{
+  if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent) {
+    monprintf("\nwave: %s rollout:%lu sent:%d waiting:%d\n", what,
+	      this->rollouts, this->sent, this->waiting);
+  }
+}
+
+// the line at the head of the queue is done with (rolled out or aborted)
+static void
+wavePop(wave_t *this)
+{
+  wvline_t *line = this->head;
+  ASSERT(line);
+  this->head = line->next;
+  if (this->head == NULL) this->tail = NULL;
+  free(line);
+  this->depth--;
+  this->sent = 0;
+  if (this->paused && this->depth < WAVE_MAXDEPTH && this->epollfd != -1) {
+    bcstPause(BCST_PAUSE_WAVE, false, this->epollfd);
+    this->paused = false;
+  }
+}
+
+// queue the n bytes of line read from the broadcast tty for rollout
+static void
+waveQueue(wave_t *this, int epollfd)
+{
+  wvline_t *line = malloc(sizeof(wvline_t) + this->n);
+  assert(line);
+  memcpy(line->data, this->line, this->n);
+  line->len  = this->n;
+  line->next = NULL;
+  if (this->tail) this->tail->next = line; else this->head = line;
+  this->tail = line;
+  this->depth++;
+  this->n = 0;
+  if (this->depth >= WAVE_MAXDEPTH && !this->paused) {
+    VLPRINT(1, "wave queue full (depth=%d) pausing broadcast input\n",
+	    this->depth);
+    bcstPause(BCST_PAUSE_WAVE, true, epollfd);
+    this->paused = true;
+  }
+}
+
+// send the head line to the next wave of commands.  Returns the number of
+// commands in the wave (0 once every running command has had the line).
+// Stopped commands are left out as they could never report success
+static int
+waveSend(wave_t *this)
+{
+  wvline_t *line = this->head;
+  cmd_t    *cmd, *tmp;
+  int       size;
+
+  if (this->sent == 0) this->rollouts++;
+  size = (this->sent == 0) ? this->canary : this->k;
+  this->inwave  = 0;
+  this->waiting = 0;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    cmd->wv.inwave = false;
+    if (this->inwave == size || cmd->wv.rollout == this->rollouts ||
+	!cmdIsRunning(cmd)) continue;
+    if (cmdIsReady(cmd)) {
+      // what a full tty does not take is queued (see inq.h)
+      inqWrite(&GBLS.inq, cmd, line->data, line->len, this->epollfd);
+    } else {
+      readyHold(&GBLS.ready, cmd, line->data, line->len, this->epollfd);
+    }
+    cmd->wv = (cmdwave_t){ .rollout = this->rollouts, .inwave = true };
+    this->inwave++;
+  }
+  this->sent   += this->inwave;
+  this->waiting = this->inwave;
+  if (this->inwave) {
+    this->waves++;
+    if (clock_gettime(CLOCK_SOURCE, &(this->wavestart)) == -1) {
+      perror("clock_gettime");
+      NYI;
+    }
+    VLPRINT(2, "rollout:%lu wave of %d sent:%d\n", this->rollouts,
+	    this->inwave, this->sent);
+  }
+  return this->inwave;
+}
+
+// roll out queued lines until we have to wait for a wave
+static void
+waveRun(wave_t *this)
+{
+  while (this->head && this->state == WAVE_IDLE) {
+    if (waveSend(this) == 0) {
+      wavePop(this);
+      continue;
+    }
+    if (kmpIsSet(&(this->marker)) || this->delay > 0.0) {
+      this->state = WAVE_WAITING;
+      if (this->delay > 0.0) tmrArm(&(this->tmr), this->epollfd, this->delay,
+				    0.0);
+      return;
+    }
+  }
+}
+
+// the current wave completed: adapt the wave size and send the next one
+static void
+waveDone(wave_t *this)
+{
+  struct timespec now;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  this->lastwave = tsDiff(&now, &(this->wavestart));
+  if (kmpIsSet(&(this->marker)) && this->delay > 0.0) {
+    if (this->lastwave < this->delay / 2.0) {
+      if (this->k <= INT_MAX / 2) this->k *= 2;
+    } else if (this->lastwave > this->delay * 0.75) {
+      if (this->k > 1) this->k /= 2;
+    }
+  }
+  tmrDisarm(&(this->tmr));
+  this->state = WAVE_IDLE;
+  waveRun(this);
+}
+
+static evnthdlrrc_t
+waveTimeout(void *obj, uint32_t evnts, int epollfd)
+{
+  wave_t *this = obj;
+  if (this->state != WAVE_WAITING) return EVNT_HDLR_SUCCESS;
+  if (kmpIsSet(&(this->marker)) && this->waiting) {
+    // some commands in the wave did not report success in time
+    this->state = WAVE_HALTED;
+    this->halts++;
+    waveAnnounce(this, "halted");
+    return EVNT_HDLR_SUCCESS;
+  }
+  waveDone(this);
+  return EVNT_HDLR_SUCCESS;
+}
+
+extern bool
+waveInit(wave_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(wave_t));
+  this->head    = NULL;
+  this->tail    = NULL;
+  this->state   = WAVE_IDLE;
+  this->on      = false;
+  this->epollfd = -1;
+  return tmrInit(&(this->tmr), waveTimeout, this, iszeroed);
+}
+
+// spec is "off" or "<canary>:<k>:<delay>[:<marker>]".  Turning waves off
+// sends the current and queued lines, and the partial line read so far, to
+// all commands that have not had them
+extern bool
+waveSet(wave_t *this, char *spec, int epollfd, FILE *f)
+{
+  long   canary, k;
+  double delay;
+  char  *end, *marker = NULL, *orig = spec;
+
+  if (spec == NULL) {
+    EPRINT(f, "%s", "missing wave spec\n");
+    return false;
+  }
+  if (epollfd != -1) this->epollfd = epollfd;
+  if (strcmp(spec, "off") == 0) {
+    kmpCleanup(&(this->marker));
+    tmrDisarm(&(this->tmr));
+    this->delay  = 0.0;
+    this->k      = INT_MAX;
+    this->canary = INT_MAX;
+    this->state  = WAVE_IDLE;
+    if (this->n) waveQueue(this, this->epollfd);
+    waveRun(this);
+    this->on     = false;
+    return true;
+  }
+  errno  = 0;
+  canary = strtol(spec, &end, 10);
+  if (errno != 0 || end == spec || *end != ':' || canary < 1 ||
+      canary > INT_MAX) goto bad;
+  spec   = end + 1;
+  k      = strtol(spec, &end, 10);
+  if (errno != 0 || end == spec || *end != ':' || k < 1 || k > INT_MAX) {
+    goto bad;
+  }
+  spec   = end + 1;
+  delay  = strtod(spec, &end);
+  if (errno != 0 || end == spec || (*end != '\0' && *end != ':') ||
+      delay < 0.0) goto bad;
+  if (*end == ':') marker = end + 1;
+  if (marker == NULL && delay == 0.0) {
+    EPRINT(f, "%s", "waves need a delay or a success marker\n");
+    return false;
+  }
+  if (marker) {
+    if (*marker == '\0' || !kmpInit(&(this->marker), marker)) {
+      EPRINT(f, "bad wave success marker: %s\n", marker);
+      return false;
+    }
+  } else {
+    kmpCleanup(&(this->marker));
+  }
+  this->canary = canary;
+  this->k      = k;
+  this->kinit  = k;
+  this->delay  = delay;
+  this->on     = true;
+  return true;
+ bad:
+  EPRINT(f, "bad wave spec (<canary>:<k>:<delay>[:<marker>]): %s\n", orig);
+  return false;
+}
+
+// accumulate a character read from the broadcast tty.  Complete lines are
+// queued for rollout
+extern int
+waveChar(wave_t *this, char c, int epollfd)
+{
+  this->epollfd = epollfd;
+  this->line[this->n++] = c;
+  if (c != '\n' && this->n < WAVE_LINELEN) return 1;
+  waveQueue(this, epollfd);
+  waveRun(this);
+  return 1;
+}
+
+// cmd emitted the success marker
+extern void
+waveArrive(wave_t *this, cmd_t *cmd, int epollfd)
+{
+  struct timespec now;
+  if (!cmd->wv.inwave || cmd->wv.done) return;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  this->epollfd   = epollfd;
+  cmd->wv.done    = true;
+  cmd->wv.latency = tsDiff(&now, &(this->wavestart));
+  this->waiting--;
+  VLPRINT(2, "%s: wave success latency=%f waiting=%d\n", cmd->name,
+	  cmd->wv.latency, this->waiting);
+  if (this->waiting == 0 && this->state == WAVE_WAITING) waveDone(this);
+}
+
+// continue a halted rollout with a halved wave size
+extern bool
+waveResume(wave_t *this, int epollfd, FILE *f)
+{
+  if (this->state != WAVE_HALTED) {
+    EPRINT(f, "%s", "rollout is not halted\n");
+    return false;
+  }
+  this->epollfd = epollfd;
+  if (this->k > 1) this->k /= 2;
+  this->state = WAVE_IDLE;
+  waveRun(this);
+  return true;
+}
+
+// abandon the line being rolled out: commands that have not had it never
+// get it.  Queued lines are rolled out starting with a canary again
+extern bool
+waveAbort(wave_t *this, int epollfd, FILE *f)
+{
+  if (this->head == NULL || this->sent == 0) {
+    EPRINT(f, "%s", "no rollout in progress\n");
+    return false;
+  }
+  this->epollfd = epollfd;
+  tmrDisarm(&(this->tmr));
+  this->aborts++;
+  this->k     = this->kinit;
+  this->state = WAVE_IDLE;
+  waveAnnounce(this, "aborted");
+  wavePop(this);
+  waveRun(this);
+  return true;
+}
+
+// must be called before cmd is removed from GBLS.cmds and freed.  A deleted
+// command can no longer report success so it is no longer waited for
+extern void
+waveForgetCmd(wave_t *this, cmd_t *cmd)
+{
+  if (!cmd->wv.inwave) return;
+  cmd->wv.inwave = false;
+  this->inwave--;
+  if (cmd->wv.done) return;
+  this->waiting--;
+  if (this->waiting == 0 && this->state == WAVE_WAITING &&
+      kmpIsSet(&(this->marker))) waveDone(this);
+}
+
+static const char *
+waveStateStr(wave_t *this)
+{
+  switch (this->state) {
+  case WAVE_IDLE:    return "idle";
+  case WAVE_WAITING: return "waiting";
+  case WAVE_HALTED:  return "halted";
+  }
+  return "unknown";
+}
+
+// human readable report: settings, the rollout in progress and the state
+// of the commands in the current wave
+extern void
+waveReport(wave_t *this, FILE *f)
+{
+  cmd_t *cmd, *tmp;
+  if (!this->on) {
+    fprintf(f, "wave: off rollouts:%lu waves:%lu halts:%lu aborts:%lu\n",
+	    this->rollouts, this->waves, this->halts, this->aborts);
+    return;
+  }
+  fprintf(f, "wave: state:%s canary:%d k:%d delay:%.3f marker:%s "
+	  "rollouts:%lu waves:%lu halts:%lu aborts:%lu lastwave:%.6f "
+	  "queued:%d\n", waveStateStr(this), this->canary, this->k,
+	  this->delay, (this->marker.str) ? this->marker.str : "",
+	  this->rollouts, this->waves, this->halts, this->aborts,
+	  this->lastwave, this->depth);
+  if (this->head == NULL || this->sent == 0) return;
+  fprintf(f, "rollout:%lu sent:%d/%d wave:%d waiting:%d line:%.*s",
+	  this->rollouts, this->sent, HASH_COUNT(GBLS.cmds), this->inwave,
+	  this->waiting, this->head->len, this->head->data);
+  if (this->head->data[this->head->len - 1] != '\n') fprintf(f, "\n");
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (!cmd->wv.inwave) continue;
+    if (cmd->wv.done) fprintf(f, "  %s done %.6f\n", cmd->name,
+			      cmd->wv.latency);
+    else fprintf(f, "  %s waiting\n", cmd->name);
+  }
+}
+
+extern void
+waveCleanup(wave_t *this)
+{
+  wvline_t *line;
+  tmrCleanup(&(this->tmr));
+  kmpCleanup(&(this->marker));
+  while ((line = this->head)) {
+    this->head = line->next;
+    free(line);
+  }
+  this->tail  = NULL;
+  this->depth = 0;
+  this->sent  = 0;
+  this->state = WAVE_IDLE;
+  this->on    = false;
+}
+
+extern void
+waveDump(wave_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%swave: this=%p on=%d state=%s canary=%d k=%d delay=%f "
+	  "head=%p depth=%d sent=%d inwave=%d waiting=%d n=%d paused=%d\n",
+	  prefix, this, this->on, waveStateStr(this), this->canary, this->k,
+	  this->delay, this->head, this->depth, this->sent, this->inwave,
+	  this->waiting, this->n, this->paused);
+  tmrDump(&(this->tmr), f, prefix);
+}
@@ -0,0 +1,89 @@
+#ifndef __YAR_WAVE_H__
+#define __YAR_WAVE_H__
+
+struct cmd;
+
+#define WAVE_MAXDEPTH 1024  // queued lines at which broadcast input pauses
+#define WAVE_LINELEN  4096  // longer lines are rolled out in pieces
+
+typedef enum {
+  WAVE_IDLE=0,      // no line is being rolled out
+  WAVE_WAITING=1,   // a wave has been sent, waiting for markers or delay
+  WAVE_HALTED=2     // a wave did not complete (see wave resume|abort)
+} wavestate_t;
+
+// a line waiting to be rolled out
+typedef struct wvline {
+  struct wvline *next;
+  int            len;
+  char           data[];
+} wvline_t;
+
+// per command wave state (embedded in each cmd_t)
+typedef struct {
+  uint64_t rollout;    // last rollout delivered to the command
+  double   latency;    // seconds from delivery to marker (last wave)
+  int      markercnt;  // marker match state (see kmpStep)
+  bool     inwave;     // part of the current wave
+  bool     done;       // emitted the marker
+} cmdwave_t;
+
+// Wave Object
+//   Staged delivery of broadcast input.  Each line read from the broadcast
+//   tty is rolled out in waves: first to a canary subset of the commands,
+//   then to successive waves of k commands.  A wave ends after delay
+//   seconds or, if a success marker is set, when every command in it has
+//   emitted the marker.  A wave with a marker that misses the delay halts
+//   the rollout until it is resumed or aborted via the monitor.  With a
+//   marker the wave size adapts to the observed completion time: it
+//   doubles when a wave completes in under half the delay and halves when
+//   it takes more than three quarters of it.  Lines are rolled out one at
+//   a time in order, later lines are queued.
+typedef struct {
+  tmr_t           tmr;         // wave delay / timeout
+  kmp_t           marker;      // success marker (optional)
+  wvline_t       *head;        // queued lines (head is being rolled out)
+  wvline_t       *tail;
+  char            line[WAVE_LINELEN]; // line being read from broadcast tty
+  struct timespec wavestart;   // time the current wave was sent
+  double          delay;       // seconds per wave (timeout if marker)
+  double          lastwave;    // duration of the last completed wave
+  uint64_t        rollouts;    // lines rolled out (or being)
+  uint64_t        waves;       // waves sent
+  uint64_t        halts;       // waves that missed the delay
+  uint64_t        aborts;      // rollouts aborted
+  wavestate_t     state;
+  int             canary;      // size of the first wave
+  int             k;           // current wave size
+  int             kinit;       // initial wave size
+  int             inwave;      // commands in the current wave
+  int             waiting;     // commands in the wave yet to emit marker
+  int             sent;        // commands the current line has gone to
+  int             depth;       // queued lines
+  int             n;           // bytes in line
+  int             epollfd;     // for completions outside of our events
+  bool            on;
+  bool            paused;      // broadcast input paused as queue is full
+} wave_t;
+
+extern bool waveInit(wave_t *this, bool iszeroed);
+extern bool waveSet(wave_t *this, char *spec, int epollfd, FILE *f);
+extern int  waveChar(wave_t *this, char c, int epollfd);
+extern void waveArrive(wave_t *this, struct cmd *cmd, int epollfd);
+extern bool waveResume(wave_t *this, int epollfd, FILE *f);
+extern bool waveAbort(wave_t *this, int epollfd, FILE *f);
+extern void waveForgetCmd(wave_t *this, struct cmd *cmd);
+extern void waveReport(wave_t *this, FILE *f);
+extern void waveCleanup(wave_t *this);
+extern void waveDump(wave_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool waveIsOn(wave_t *this)
+{
+  return this->on;
+}
+
+__attribute__((unused)) static inline bool waveIsWaiting(wave_t *this)
+{
+  return (this->state == WAVE_WAITING);
+}
+#endif
@@ -0,0 +1,352 @@
+#include "yar.h"
+
+static void
+wqPush(wqitem_t **head, wqitem_t **tail, wqitem_t *item)
+{
+  item->next = NULL;
+  if (*tail) (*tail)->next = item; else *head = item;
+  *tail = item;
+}
+
+static wqitem_t *
+wqPop(wqitem_t **head, wqitem_t **tail)
+{
+  wqitem_t *item = *head;
+  if (item) {
+    *head = item->next;
+    if (*head == NULL) *tail = NULL;
+    item->next = NULL;
+  }
+  return item;
+}
+
+static void
+wqFree(wqitem_t **head, wqitem_t **tail)
+{
+  wqitem_t *item;
+  while ((item = wqPop(head, tail))) free(item);
+}
+
+// a command's tty is full: retry once the loop has run for a while
+static void
+wqBlocked(workq_t *this, cmd_t *cmd)
+{
+  VLPRINT(2, "%s: tty full retrying in %f\n", cmd->name, WORKQ_RETRY);
+  this->blocked = true;
+  this->blocks++;
+  if (!tmrIsArmed(&(this->tmr)) && this->epollfd != -1) {
+    tmrArm(&(this->tmr), this->epollfd, WORKQ_RETRY, WORKQ_RETRY);
+  }
+}
+
+// true if the newest item handed to cmd has only been partly written
+static bool
+wqCmdPartial(cmd_t *cmd)
+{
+  return (cmd->wq.tail && cmd->wq.tail->sent < cmd->wq.tail->len);
+}
+
+// write more of the item partly written to cmd.  Returns true if it has
+// now been written completely
+static bool
+wqFinish(workq_t *this, cmd_t *cmd)
+{
+  wqitem_t *item = cmd->wq.tail;
+  item->sent += cmdWriteBuf(cmd, &(item->data[item->sent]),
+			    item->len - item->sent);
+  if (item->sent < item->len) {
+    wqBlocked(this, cmd);
+    return false;
+  }
+  return true;
+}
+
+// a command can take work if it is running, ready, has a free slot and
+// is not still being written the previous item
+static bool
+wqCmdAvailable(workq_t *this, cmd_t *cmd)
+{
+  return (cmdIsRunning(cmd) && cmdIsReady(cmd) &&
+	  cmd->wq.inflight < this->inflightmax && !wqCmdPartial(cmd));
+}
+
+// send the item at the head of the queue to cmd.  Returns false if the
+// command's tty could not take any of the data (item stays queued).  An
+// item of which only part could be written is handed to cmd anyway (the
+// rest follows see wqFinish)
+static bool
+wqSend(workq_t *this, cmd_t *cmd)
+{
+  wqitem_t *item = this->head;
+  int written;
+  ASSERT(item);
+  written = cmdWriteBuf(cmd, item->data, item->len);
+  if (written == 0) {
+    wqBlocked(this, cmd);
+    return false;
+  }
+  item->sent = written;
+  if (written < item->len) wqBlocked(this, cmd);
+  item = wqPop(&this->head, &this->tail);
+  this->depth--;
+  if (clock_gettime(CLOCK_SOURCE, &(item->ts)) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  wqPush(&cmd->wq.head, &cmd->wq.tail, item);
+  cmd->wq.inflight++;
+  this->dispatched++;
+  VLPRINT(2, "%s: dispatched item inflight=%d depth=%d\n", cmd->name,
+	  cmd->wq.inflight, this->depth);
+  return true;
+}
+
+// periodic while a tty was full: finish partly written items and dispatch
+// again.  Disarmed once nothing is held up
+static evnthdlrrc_t
+wqRetryEvent(void *obj, uint32_t evnts, int epollfd)
+{
+  workq_t *this = obj;
+  cmd_t *cmd, *tmp;
+
+  this->blocked = false;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    if (wqCmdPartial(cmd) && cmdIsRunning(cmd)) wqFinish(this, cmd);
+  }
+  workqDispatch(this, epollfd);
+  if (!this->blocked) tmrDisarm(&(this->tmr));
+  return EVNT_HDLR_SUCCESS;
+}
+
+static void
+wqResume(workq_t *this, int epollfd)
+{
+  if (this->paused && !workqIsFull(this) && epollfd != -1) {
+    bcstPause(BCST_PAUSE_WORKQ, false, epollfd);
+    this->paused = false;
+  }
+}
+
+extern bool
+workqInit(workq_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(workq_t));
+  this->head        = NULL;
+  this->tail        = NULL;
+  this->rrnext      = NULL;
+  this->depth       = 0;
+  this->maxdepth    = WORKQ_DEFAULT_MAXDEPTH;
+  this->inflightmax = WORKQ_DEFAULT_INFLIGHT;
+  this->epollfd     = -1;
+  this->paused      = false;
+  this->blocked     = false;
+  return tmrInit(&(this->tmr), wqRetryEvent, this, iszeroed);
+}
+
+extern void
+workqCleanup(workq_t *this)
+{
+  wqFree(&this->head, &this->tail);
+  kmpCleanup(&this->marker);
+  tmrCleanup(&(this->tmr));
+  this->depth     = 0;
+  this->rrnext    = NULL;
+}
+
+extern bool
+workqSetMarker(workq_t *this, char *marker, FILE *f)
+{
+  cmd_t *cmd, *tmp;
+  if (marker == NULL || *marker == '\0') {
+    EPRINT(f, "%s", "completion marker must not be empty\n");
+    return false;
+  }
+  if (!kmpInit(&this->marker, marker)) {
+    EPRINT(f, "%s", "failed to build completion marker matcher\n");
+    return false;
+  }
+  // match states are only meaningful against the marker they came from
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) cmd->wq.markercnt = 0;
+  return true;
+}
+
+// called when queue mode is enabled: resets statistics
+extern void
+workqStart(workq_t *this)
+{
+  cmd_t *cmd, *tmp;
+  if (clock_gettime(CLOCK_SOURCE, &(this->start)) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  this->queued = this->dispatched = this->completed = 0;
+  this->requeued = this->spurious = 0;
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    cmd->wq.completed = cmd->wq.requeued = 0;
+    cmd->wq.latsum = cmd->wq.latmin = cmd->wq.latmax = 0.0;
+  }
+}
+
+// queue a line.  Returns false if the queue is full (caller should stop
+// reading input); the line is queued regardless.
+extern bool
+workqAdd(workq_t *this, char *line, int len, int epollfd)
+{
+  wqitem_t *item = malloc(sizeof(wqitem_t) + len);
+  assert(item);
+  memcpy(item->data, line, len);
+  item->len  = len;
+  item->sent = 0;
+  wqPush(&this->head, &this->tail, item);
+  this->depth++;
+  this->queued++;
+  // if items were already waiting then there is no command with a free
+  // slot (we always dispatch eagerly when a slot frees) so avoid the scan
+  if (this->depth == 1) workqDispatch(this, epollfd);
+  if (workqIsFull(this)) {
+    if (!this->paused && epollfd != -1) {
+      VLPRINT(1, "work queue full (depth=%d) pausing broadcast input\n",
+	      this->depth);
+      bcstPause(BCST_PAUSE_WORKQ, true, epollfd);
+      this->paused = true;
+    }
+    return false;
+  }
+  return true;
+}
+
+// hand out queued items to any command with a free slot.  The scan starts
+// where the last one left off so that work is spread across the commands
+extern void
+workqDispatch(workq_t *this, int epollfd)
+{
+  cmd_t *cmd;
+  int    idle = 0, cnt = HASH_COUNT(GBLS.cmds);
+
+  if (epollfd != -1) this->epollfd = epollfd;
+  if (this->head == NULL || cnt == 0) goto done;
+  cmd = (this->rrnext) ? this->rrnext : GBLS.cmds;
+  // stop once we have gone all the way around without sending anything
+  while (this->head && idle < cnt) {
+    if (wqCmdAvailable(this, cmd) && wqSend(this, cmd)) idle = 0;
+    else idle++;
+    cmd = (cmd->hh.next) ? cmd->hh.next : GBLS.cmds;
+  }
+  this->rrnext = cmd;
+ done:
+  wqResume(this, epollfd);
+}
+
+// cmd emitted the completion marker: retire its oldest in flight item
+extern void
+workqComplete(workq_t *this, cmd_t *cmd, int epollfd)
+{
+  struct timespec now;
+  wqitem_t *item = wqPop(&cmd->wq.head, &cmd->wq.tail);
+  if (item == NULL) {
+    // eg. the marker was echoed or printed outside of a work item
+    VLPRINT(2, "%s: completion marker with no items in flight\n", cmd->name);
+    this->spurious++;
+    return;
+  }
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  double lat = tsDiff(&now, &(item->ts));
+  free(item);
+  cmd->wq.inflight--;
+  ASSERT(cmd->wq.inflight >= 0);
+  if (cmd->wq.completed == 0 || lat < cmd->wq.latmin) cmd->wq.latmin = lat;
+  if (lat > cmd->wq.latmax) cmd->wq.latmax = lat;
+  cmd->wq.latsum += lat;
+  cmd->wq.completed++;
+  this->completed++;
+  VLPRINT(2, "%s: completed item latency=%f inflight=%d\n", cmd->name, lat,
+	  cmd->wq.inflight);
+  // refill the slot that just freed up
+  if (epollfd != -1) this->epollfd = epollfd;
+  while (this->head && wqCmdAvailable(this, cmd) && wqSend(this, cmd));
+  wqResume(this, epollfd);
+}
+
+// move cmd's in flight items back to the front of the queue keeping their
+// original order.  They are sent again from the start
+static void
+wqRequeue(workq_t *this, cmd_t *cmd)
+{
+  int n = cmd->wq.inflight;
+  if (cmd->wq.head) {
+    for (wqitem_t *item = cmd->wq.head; item; item = item->next) {
+      item->sent = 0;
+    }
+    cmd->wq.tail->next = this->head;
+    if (this->tail == NULL) this->tail = cmd->wq.tail;
+    this->head = cmd->wq.head;
+    cmd->wq.head = cmd->wq.tail = NULL;
+    cmd->wq.requeued += n;
+    this->depth      += n;
+    this->requeued   += n;
+    VPRINT("%s: requeued %d items depth=%d\n", cmd->name, n, this->depth);
+  }
+  cmd->wq.inflight  = 0;
+  cmd->wq.markercnt = 0;
+}
+
+// cmd died or was stopped: give its in flight items to someone else
+extern void
+workqRequeueCmd(workq_t *this, cmd_t *cmd, int epollfd)
+{
+  if (cmd->wq.head == NULL) return;
+  wqRequeue(this, cmd);
+  workqDispatch(this, epollfd);
+}
+
+// must be called before cmd is removed from GBLS.cmds and freed.
+extern void
+workqForgetCmd(workq_t *this, cmd_t *cmd)
+{
+  if (this->rrnext == cmd) this->rrnext = cmd->hh.next;
+  wqRequeue(this, cmd);
+}
+
+// human readable report of the queue and per command (worker) statistics
+extern void
+workqReport(workq_t *this, FILE *f)
+{
+  struct timespec now;
+  cmd_t *cmd, *tmp;
+  double elapsed;
+  if (clock_gettime(CLOCK_SOURCE, &now) == -1) {
+    perror("clock_gettime");
+    NYI;
+  }
+  elapsed = tsDiff(&now, &(this->start));
+  fprintf(f, "workq: depth:%d maxdepth:%d inflightmax:%d marker:%s "
+	  "queued:%lu dispatched:%lu completed:%lu requeued:%lu spurious:%lu "
+	  "blocks:%lu paused:%d\n",
+	  this->depth, this->maxdepth, this->inflightmax,
+	  (this->marker.str) ? this->marker.str : "", this->queued, this->dispatched,
+	  this->completed, this->requeued, this->spurious, this->blocks,
+	  this->paused);
+  HASH_ITER(hh, GBLS.cmds, cmd, tmp) {
+    cmdwq_t *wq = &(cmd->wq);
+    fprintf(f, "  %s inflight:%d completed:%lu requeued:%lu rate:%.3f/s "
+	    "latency: avg:%.6f min:%.6f max:%.6f\n", cmd->name, wq->inflight,
+	    wq->completed, wq->requeued,
+	    (elapsed > 0.0) ? wq->completed / elapsed : 0.0,
+	    (wq->completed) ? wq->latsum / wq->completed : 0.0,
+	    wq->latmin, wq->latmax);
+  }
+}
+
+extern void
+workqDump(workq_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%sworkq: this=%p head=%p tail=%p rrnext=%p depth=%d "
+	  "maxdepth=%d inflightmax=%d marker=%s paused=%d blocked=%d "
+	  "epollfd=%d\n", prefix, this, this->head, this->tail, this->rrnext,
+	  this->depth, this->maxdepth, this->inflightmax, this->marker.str,
+	  this->paused, this->blocked, this->epollfd);
+  tmrDump(&(this->tmr), f, prefix);
+}
@@ -0,0 +1,79 @@
+#ifndef __YAR_WORKQ_H__
+#define __YAR_WORKQ_H__
+
+struct cmd;
+
+#define WORKQ_DEFAULT_INFLIGHT 1
+#define WORKQ_DEFAULT_MAXDEPTH 65536
+#define WORKQ_RETRY            0.01  // seconds between retries of full ttys
+
+// a single unit of work: one line read from the broadcast tty
+typedef struct wqitem {
+  struct wqitem  *next;
+  struct timespec ts;         // time the item was dispatched to a command
+  int             len;        // length of data
+  int             sent;       // bytes of data written to the command
+  char            data[];     // the line (including newline)
+} wqitem_t;
+
+// per command work queue state (embedded in each cmd_t)
+typedef struct {
+  wqitem_t *head;             // items sent to the command and not yet
+  wqitem_t *tail;             // completed (oldest first)
+  uint64_t  completed;        // number of items completed by the command
+  uint64_t  requeued;         // number of items requeued as the command died
+  double    latsum;           // sum of dispatch to completion latencies
+  double    latmin;           // minimum latency
+  double    latmax;           // maximum latency
+  int       inflight;         // number of items in flight
+  int       markercnt;        // marker match state (see kmpStep)
+} cmdwq_t;
+
+// Work Queue Object
+//   Used by the scatter "queue" mode.  Lines read from the broadcast tty
+//   are queued and handed to a command only when it has fewer than
+//   inflightmax items outstanding.  A command signals that it has finished
+//   an item by writing the completion marker string to its output.  Items
+//   in flight on a command that dies are put back at the front of the queue.
+//   An item is handed to a command once part of it has been written, the
+//   rest is written before anything else is sent to that command.  While
+//   a command's tty is full (an item could not be sent, or not all of it)
+//   a timer retries every WORKQ_RETRY.
+typedef struct {
+  wqitem_t        *head;        // pending items (FIFO)
+  wqitem_t        *tail;
+  struct cmd      *rrnext;      // where to start looking for a free command
+  kmp_t            marker;      // completion marker matcher
+  struct timespec  start;       // time queue mode was enabled
+  tmr_t            tmr;         // retries sends to full ttys (if blocked)
+  uint64_t         queued;      // total items queued
+  uint64_t         dispatched;  // total items sent to commands
+  uint64_t         completed;   // total items completed
+  uint64_t         requeued;    // total items requeued
+  uint64_t         spurious;    // markers seen with nothing in flight
+  uint64_t         blocks;      // sends cut short by a full tty
+  int              depth;       // current number of pending items
+  int              maxdepth;    // stop reading broadcast input at this depth
+  int              inflightmax; // max items outstanding per command (K)
+  int              epollfd;
+  bool             paused;      // broadcast input paused as we are full
+  bool             blocked;     // a send was cut short by a full tty
+} workq_t;
+
+extern bool workqInit(workq_t *this, bool iszeroed);
+extern void workqCleanup(workq_t *this);
+extern bool workqSetMarker(workq_t *this, char *marker, FILE *f);
+extern void workqStart(workq_t *this);
+extern bool workqAdd(workq_t *this, char *line, int len, int epollfd);
+extern void workqDispatch(workq_t *this, int epollfd);
+extern void workqComplete(workq_t *this, struct cmd *cmd, int epollfd);
+extern void workqRequeueCmd(workq_t *this, struct cmd *cmd, int epollfd);
+extern void workqForgetCmd(workq_t *this, struct cmd *cmd);
+extern void workqReport(workq_t *this, FILE *f);
+extern void workqDump(workq_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool workqIsFull(workq_t *this)
+{
+  return (this->depth >= this->maxdepth);
+}
+#endif
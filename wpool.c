@@ -0,0 +1,182 @@
+#include "yar.h"
+
+typedef struct {
+  wpool_t *pool;
+  int      id;
+} wpoolarg_t;
+
+// write buf to the id'th of parts contiguous ranges of fo's fds
+static void
+wpoolPart(fanout_t *fo, int id, int parts, const char *buf, int len)
+{
+  int start = ((int64_t)fo->n * id) / parts;
+  int end   = ((int64_t)fo->n * (id + 1)) / parts;
+
+  for (int i=start; i<end; i++) {
+    int rc;
+    do {
+      rc = write(fo->fds[i], buf, len);
+    } while (rc == -1 && errno == EINTR);
+    fo->res[i] = (rc == -1) ? -errno : rc;
+  }
+}
+
+static void *
+wpoolThread(void *arg)
+{
+  wpoolarg_t *a    = arg;
+  wpool_t    *this = a->pool;
+  uint64_t    seen = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&this->lock);
+    while (!this->stop && this->gen == seen) {
+      pthread_cond_wait(&this->go, &this->lock);
+    }
+    if (this->stop) {
+      pthread_mutex_unlock(&this->lock);
+      return NULL;
+    }
+    seen = this->gen;
+    fanout_t   *fo  = this->chunk.fo;
+    const char *buf = this->chunk.buf;
+    int         len = this->chunk.len;
+    pthread_mutex_unlock(&this->lock);
+
+    wpoolPart(fo, a->id, this->nthreads + 1, buf, len);
+
+    pthread_mutex_lock(&this->lock);
+    this->chunk.refs--;
+    if (this->chunk.refs == 0) pthread_cond_signal(&this->done);
+    pthread_mutex_unlock(&this->lock);
+  }
+}
+
+extern void
+wpoolInit(wpool_t *this, bool iszeroed)
+{
+  if (!iszeroed) bzero(this, sizeof(wpool_t));
+  this->threads  = NULL;
+  this->nthreads = 0;
+}
+
+// str is the number of writer threads (0 for none)
+extern bool
+wpoolSet(wpool_t *this, char *str, FILE *f)
+{
+  char *end;
+  long  n;
+
+  errno = 0;
+  n = strtol(str, &end, 10);
+  if (errno != 0 || *end != '\0' || end == str || n < 0 ||
+      n > WPOOL_MAXTHREADS) {
+    EPRINT(f, "bad number of writer threads (0-%d): %s\n", WPOOL_MAXTHREADS,
+	   str);
+    return false;
+  }
+  this->nthreads = n;
+  return true;
+}
+
+// start the writer threads.  They are started with all signals blocked so
+// that signals continue to be delivered to the event loop (see sigproc)
+extern bool
+wpoolCreate(wpool_t *this)
+{
+  sigset_t    all, old;
+  wpoolarg_t *args;
+  int         rc;
+
+  if (this->nthreads == 0) return true;
+  if (pthread_mutex_init(&this->lock, NULL) != 0 ||
+      pthread_cond_init(&this->go, NULL) != 0 ||
+      pthread_cond_init(&this->done, NULL) != 0) {
+    perror("pthread init");
+    return false;
+  }
+  this->threads = malloc(this->nthreads * sizeof(pthread_t));
+  args          = malloc(this->nthreads * sizeof(wpoolarg_t));
+  assert(this->threads && args);
+  this->args = args;
+  this->pid  = getpid();
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &old);
+  for (int i=0; i<this->nthreads; i++) {
+    args[i].pool = this;
+    args[i].id   = i;
+    rc = pthread_create(&this->threads[i], NULL, wpoolThread, &args[i]);
+    if (rc != 0) {
+      errno = rc;
+      perror("pthread_create");
+      this->nthreads = i;
+      pthread_sigmask(SIG_SETMASK, &old, NULL);
+      return false;
+    }
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  VLPRINT(1, "writer pool: %d threads\n", this->nthreads);
+  return true;
+}
+
+// the writer pool fan-out backend (see GBLSFanout): fo's fds are written
+// to in parallel
+extern void
+wpoolFanout(void *obj, fanout_t *fo, char *buf, int len)
+{
+  wpool_t *this = obj;
+
+  if (fo->n < WPOOL_MINCMDS) {
+    // not worth waking the writers
+    wpoolPart(fo, 0, 1, buf, len);
+    this->inlined++;
+    return;
+  }
+  pthread_mutex_lock(&this->lock);
+  this->chunk.fo   = fo;
+  this->chunk.buf  = buf;
+  this->chunk.len  = len;
+  this->chunk.refs = this->nthreads;
+  this->gen++;
+  pthread_cond_broadcast(&this->go);
+  pthread_mutex_unlock(&this->lock);
+  // the event loop thread writes the last part itself
+  wpoolPart(fo, this->nthreads, this->nthreads + 1, buf, len);
+  pthread_mutex_lock(&this->lock);
+  while (this->chunk.refs != 0) {
+    pthread_cond_wait(&this->done, &this->lock);
+  }
+  this->chunk.buf = NULL;
+  this->chunk.fo  = NULL;
+  pthread_mutex_unlock(&this->lock);
+  this->chunks++;
+  this->writes += fo->n;
+}
+
+extern void
+wpoolCleanup(wpool_t *this)
+{
+  // a forked child that exits before exec has no writer threads to stop
+  if (this->threads && this->pid == getpid()) {
+    pthread_mutex_lock(&this->lock);
+    this->stop = true;
+    pthread_cond_broadcast(&this->go);
+    pthread_mutex_unlock(&this->lock);
+    for (int i=0; i<this->nthreads; i++) pthread_join(this->threads[i], NULL);
+    free(this->threads);
+    free(this->args);
+    pthread_cond_destroy(&this->go);
+    pthread_cond_destroy(&this->done);
+    pthread_mutex_destroy(&this->lock);
+  }
+  this->threads = NULL;
+  this->args    = NULL;
+}
+
+extern void
+wpoolDump(wpool_t *this, FILE *f, char *prefix)
+{
+  fprintf(f, "%swpool: this=%p nthreads=%d gen=%lu chunks=%lu writes=%lu "
+	  "inlined=%lu\n", prefix, this, this->nthreads, this->gen,
+	  this->chunks, this->writes, this->inlined);
+}
@@ -0,0 +1,58 @@
+#ifndef __YAR_WPOOL_H__
+#define __YAR_WPOOL_H__
+
+#include <pthread.h>
+
+struct fanout;
+
+#define WPOOL_MAXTHREADS 64
+#define WPOOL_MINCMDS    64  // fewer ready commands are written to inline
+
+// a chunk of broadcast input handed to the writer threads.  The data is not
+// modified while the chunk is in flight and refs counts the threads that
+// have yet to finish with it (the chunk is complete when it drops to 0)
+typedef struct {
+  struct fanout *fo;        // commands to write to
+  const char    *buf;
+  int            len;
+  int            refs;
+} wpoolchunk_t;
+
+// Writer Pool Object
+//   Optional pool of writer threads for the broadcast fan-out.  The ready
+//   commands are partitioned into contiguous ranges, one per writer thread
+//   plus one for the event loop thread itself, and each range is written in
+//   parallel.  The event loop waits for the chunk to complete before it
+//   does the book keeping (see GBLSFanout) and reads more input, so
+//   the per command ordering and pacing of the single threaded fan-out are
+//   kept and a slow fan-out holds back the broadcast tty (backpressure).
+//   The threads only ever call write(2): all other yar state is touched by
+//   the event loop thread alone.
+typedef struct {
+  pthread_t      *threads;
+  pthread_mutex_t lock;
+  pthread_cond_t  go;       // a new chunk has been posted
+  pthread_cond_t  done;     // chunk.refs has dropped to 0
+  wpoolchunk_t    chunk;    // chunk being fanned out
+  uint64_t        gen;      // incremented each time a chunk is posted
+  uint64_t        chunks;   // chunks fanned out by the pool
+  uint64_t        writes;   // writes done by the pool
+  uint64_t        inlined;  // chunks written inline (too few commands)
+  void           *args;     // per thread arguments
+  int             nthreads;
+  pid_t           pid;      // process the threads belong to
+  bool            stop;
+} wpool_t;
+
+extern void wpoolInit(wpool_t *this, bool iszeroed);
+extern bool wpoolSet(wpool_t *this, char *str, FILE *f);
+extern bool wpoolCreate(wpool_t *this);
+extern void wpoolFanout(void *obj, struct fanout *fo, char *buf, int len);
+extern void wpoolCleanup(wpool_t *this);
+extern void wpoolDump(wpool_t *this, FILE *f, char *prefix);
+
+__attribute__((unused)) static inline bool wpoolIsOn(wpool_t *this)
+{
+  return (this->threads != NULL);
+}
+#endif
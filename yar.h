@@ -29,6 +29,32 @@
 // yar include files
 #include "event.h"
 #include "tty.h"
+#include "match.h"
+#include "tmr.h"
+#include "hist.h"
+#include "workq.h"
+#include "gather.h"
+#include "coalesce.h"
+#include "reduce.h"
+#include "merge.h"
+#include "watch.h"
+#include "ready.h"
+#include "inq.h"
+#include "journal.h"
+#include "wave.h"
+#include "bucket.h"
+#include "pace.h"
+#include "limit.h"
+#include "fairq.h"
+#include "uring.h"
+#include "wpool.h"
+#include "relay.h"
+#include "standby.h"
+#include "linger.h"
+#include "watchdog.h"
+#include "ping.h"
+#include "stats.h"
+#include "scatter.h"
 #include "cmd.h"
 #include "fs.h"
 
@@ -68,6 +94,21 @@ typedef struct signalprocessor {
   sigset_t    mask;
 } sigproc_t;
 
+// the ready commands a chunk of broadcast input is written to by a fan-out
+// backend (io_uring or the writer pool, see GBLSFanout).  The backend
+// writes the chunk to fds[0..n-1] and sets res[i] to the result of the
+// write to fds[i] (bytes written or -errno)
+typedef struct fanout {
+  struct cmd **cmds;
+  int         *fds;
+  int         *res;
+  int          n;
+  int          cap;               // size of cmds, fds and res
+} fanout_t;
+
+typedef void (*fanoutwrite_t)(void *backend, struct fanout *fo, char *buf,
+			      int len);
+
 #define monprintf(...) if (GBLS.mon.tty.opens != 0 && !GBLS.mon.silent)		\
     { fprintf(GBLS.mon.fileptr, __VA_ARGS__); fflush(GBLS.mon.fileptr); }
 
@@ -80,6 +121,31 @@ typedef struct {
   mon_t  mon;                 // monitor object: control interface to yar
   fs_t   fs;                  // filesystem object: control interface to yar
   sigproc_t sigproc;          // signal procesing object
+  evntloop_t loop;            // event loop budgets and deferred handlers
+  scatter_t scatter;          // scatter object: dispatches broadcast input
+                              // lines to single commands when enabled
+  workq_t   workq;            // work queue used by the scatter queue mode
+  gather_t  gather;           // barrier on a marker across commands
+  coalesce_t coalesce;        // dedups line buffered broadcast output
+  reduce_t   reduce;          // numeric reduction of broadcast output
+  merge_t    merge;           // timestamp ordered broadcast output
+  watch_t    watch;           // multi-pattern watcher of command output
+  ready_t    ready;           // when commands are ready for input
+  inq_t      inq;             // input pending for commands with full ttys
+  journal_t  journal;         // broadcast input replayed on restarts
+  wave_t     wave;            // staged (canary) delivery of broadcast input
+  pace_t     pace;            // adaptive pacing of input to commands
+  limit_t    limit;           // output rate limits on the broadcast tty
+  fairq_t    fairq;           // fair sharing of the broadcast tty
+  uring_t    uring;           // batched broadcast writes via io_uring
+  wpool_t    wpool;           // parallel broadcast writes by a thread pool
+  fanout_t   fanout;          // commands of the uring/wpool fan-out
+  relay_t    relay;           // tree of yars (relay commands and uplink)
+  standby_t  standby;         // pre-warmed instances of commands
+  linger_t   linger;          // idle commands kept running for a while
+  watchdog_t watchdog;        // hung commands are killed and restarted
+  ping_t     ping;            // round trip times of the commands
+  stats_t    stats;           // snapshot of the counters for /stats
   cmd_t *cmds;                // hashtable of cmds
   cmd_t *slowestcmd;          // pointer to the slowest cmd so that we can pace
                               // broadcast tty reads based on this command
@@ -87,11 +153,11 @@ typedef struct {
                               // our own write buffering to delay writes
                               // rather we pace reads and let the data
                               // buffer in the kernel tty port
+  cmd_t *runnerupcmd;         // slowest cmd other than slowestcmd (NULL if
+                              // none or not known): slowestcmd's delay can
+                              // fall to its delay without a rescan
+  double runnerupdelay;       // runnerupcmd's delay when last checked
   char **initialcmdspecs;     // cmd specs passed as command line args
-  char  *readystr;            // a string that a command sends to indicate it is
-                              // ready. If not null then will not send read
-                              // data from client tty's and send it to a command
-                              // until this string is received.
   char  *stopstr;             // a string to send to a command line when
                               // stopping
   char  *cwd;                 // current working directory path
@@ -102,13 +168,14 @@ typedef struct {
   char  *logpath;             // path of log used when daemonized (logdir/<pid>.log)
   FILE  *logfile;             // file pointer of log when daemonized
   double defaultcmddelay;     // default value for sending data to commands
+  int    defaultcmdburst;     // default bytes sent to commands at once
   double restartcmddelay;     // delay restarting command if exited with success
   double errrestartcmddelay;  // delay restarting command if exited with failure
   pid_t  pid;                 // pid of this yar processs
-  int    readystrlen;         // length of ready str, 0 if no ready string
-  int    cmdsreadycnt;        // count of commands that are ready
   int    verbose;             // verbosity level
   int    initialcmdspecscnt;  // number of initial cmd specs
+  int    bcstpaused;          // BCST_PAUSE_* reasons broadcast input is
+                              // paused (see bcstPause)
   int    signal;              // signal handler will set this to signal number
   bool   linebufferbcst;      // if true output from commands sent to broadcast
                               // tty will be line buffered to avoid interleaving
@@ -131,17 +198,33 @@ typedef struct {
 extern globals_t GBLS;
 
 // hack because I am too lazy to sort out head ordering
+// a command is ready once it has matched its ready spec (see ready.h) or if
+// it has no spec (neither its own nor the default).  A restarted command is
+// not ready until the journal has been replayed to it (see journal.h) so
+// newer input goes through readyHold which replays it first
 __attribute__((unused)) static inline bool cmdIsReady(cmd_t *this)
 {
-  return (GBLS.readystrlen == 0 || GBLS.readystrlen == this->readycnt);
-}
-
-__attribute__((unused)) static inline void decCmdsReadyCnt()
-{
-  if (GBLS.readystrlen) GBLS.cmdsreadycnt--;
+  readyspec_t *spec = (this->rdy.spec) ? this->rdy.spec : &(GBLS.ready.spec);
+  if (this->jrnl.pending) return false;
+  if (this->rly.on) return this->rdy.ready;  // a child yar (see relay.h)
+  return (this->rdy.ready || !readySpecIsSet(spec));
 }
 
 extern void cleanup();
+extern void GBLSDelCmd(cmd_t *cmd);
+extern void GBLSFindSlowestCmd();
+// reasons broadcast input is paused (see bcstPause)
+#define BCST_PAUSE_PACE  0x1  // the broadcast pacing bucket is empty
+#define BCST_PAUSE_WAVE  0x2  // the wave queue is full
+#define BCST_PAUSE_WORKQ 0x4  // the work queue is full
+#define BCST_PAUSE_RELAY 0x8  // a child yar has the rest of a frame queued
+#define BCST_PAUSE_INPUT 0x10 // a command has input pending (see inq.h)
+
+extern void bcstInput(char *buf, int n, int epollfd);
+extern void bcstPause(int reason, bool on, int epollfd);
+extern void loopDefer(evntdesc_t *ed);
+extern void loopUndefer(evntdesc_t *ed);
+extern bool loopBudgetUse(int bytes);
 
 // Error print
 #define EPRINT(f, fmt, ...) {						\
@@ -178,6 +261,29 @@ sigAddTermSignals(sigset_t *mask)
   sigaddset(mask, SIGIO);
 }
 
+// FNV-1a hash of a byte string
+__attribute__((unused)) static inline uint64_t
+hashBytes(const char *buf, int len)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (int i=0; i<len; i++) {
+    h ^= (uint8_t)buf[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// finalizer from splitmix64: spreads the bits of h so that hashes that
+// differ in only a few bits (eg. xored together) compare "randomly"
+__attribute__((unused)) static inline uint64_t
+hashMix(uint64_t h)
+{
+  h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27; h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
 typedef char asciistr_t[4];
 extern asciistr_t ascii_nonprintable[32];
 
@@ -210,6 +316,14 @@ ascii_char2str(int c, asciistr_t str)
   return true;
 }
 
+// difference a - b in seconds
+__attribute__((unused)) static inline double
+tsDiff(struct timespec *a, struct timespec *b)
+{
+  return (a->tv_sec - b->tv_sec) +
+    (a->tv_nsec - b->tv_nsec) / (double)NSEC_IN_SECOND;
+}
+
 extern void fdSetnonblocking(int fd);
 
 extern void delaysec(double delay);
@@ -4,6 +4,14 @@
  * /cmds  : readonly file : contents is current command names
  * /lcmds : readonly file : contents is detailed long listing of current commands
  * /bcst  : readonly file : path of broadcast tty if enabled
+ * /gather: readonly file : state of the current or last gather
+ * /reduce: readonly file : reduction settings and last round summary
+ * /watch : readonly file : watch patterns and per command matches
+ * /ready : readonly file : ready state and time to ready of each command
+ * /relay : readonly file : nodes of the child yars
+ * /ping  : readonly file : round trip times of the commands
+ * /stats : readonly file : snapshot of the global and per command counters
+ * /metrics: readonly file : same counters in the OpenMetrics text format
  ******************************************************************************/
 void
 yarfsUsage(FILE *fp)
@@ -20,7 +28,31 @@ yarfsUsage(FILE *fp)
 	  "              type='cmd'  v1=name v2=cmdline\n"
 	  "              type='bcst' v1=num of broadcast clients v2=empty\n"
 	  "              type='mon'  v1=empty v2=empty\n"
-	  " /bcst  : readonly file : path of broadcast tty if enabled\n");
+	  " /bcst  : readonly file : path of broadcast tty if enabled\n"
+	  " /gather: readonly file : state of the current or last gather\n"
+	  "          (see the gather monitor command).  The first line is\n"
+	  "          'gather: state:<state> ...' where state is one of\n"
+	  "          'idle'|'waiting'|'done'|'timeout'|'cancelled'.  It is\n"
+	  "          followed by the stragglers and the latency of each\n"
+	  "          command that arrived\n"
+	  " /reduce: readonly file : reduction settings and the summary of the\n"
+	  "          last round (see -a)\n"
+	  " /watch : readonly file : watch patterns, and per pattern the match\n"
+	  "          count and last matching line of each command (see -w)\n"
+	  " /ready : readonly file : ready spec and the ready state and time\n"
+	  "          to ready of each command, slowest first (see -R)\n"
+	  " /relay : readonly file : the nodes of each child yar (see Relays)\n"
+	  "          with their ready state and stats\n"
+	  " /ping  : readonly file : probe settings and the round trip time\n"
+	  "          (last, min, avg, p50, p99, max) of each command, slowest\n"
+	  "          first (see -Q)\n"
+	  " /stats : readonly file : global and per command counters, one\n"
+	  "          line each of space separated key=value pairs, the first\n"
+	  "          word being 'yar' or 'cmd'.  A snapshot retaken at most\n"
+	  "          once a second\n"
+	  " /metrics: readonly file : the counters in the OpenMetrics\n"
+	  "          (Prometheus) text format, each command's samples labelled\n"
+	  "          name=\"<cmd>\".  A snapshot retaken at most once a second\n");
 }
 
 /*** /pid ***/
@@ -375,6 +407,259 @@ fs_fileops_t fs_bcst_ops = {
   .readdir = NULL 
 };
 
+/*** report files: contents generated by a report function ***/
+typedef void (*yarfsreportfunc_t)(FILE *f);
+
+// returns a malloced buffer holding the output of func and its length in *n
+static char *
+reportBuf(yarfsreportfunc_t func, size_t *n)
+{
+  char *buf = NULL;
+  FILE *f   = open_memstream(&buf, n);
+  assert(f);
+  func(f);
+  fclose(f);
+  return buf;
+}
+
+static bool
+reportStat(fs_file_t *file, struct stat *stbuf, yarfsreportfunc_t func)
+{
+  size_t n;
+  free(reportBuf(func, &n));
+  VLPRINT(2, "%s %ld: ", file->name, file->ino);
+  stbuf->st_ino = file->ino;
+  stbuf->st_mode = S_IFREG | 0444;
+  stbuf->st_nlink = 1;
+  stbuf->st_size = n;
+  VLPRINT(2, "%ld\n", stbuf->st_size);
+  return true;
+}
+
+static bool
+reportRead(fuse_req_t req, size_t size, off_t off, yarfsreportfunc_t func)
+{
+  size_t n;
+  char  *buf = reportBuf(func, &n);
+
+  int rc=fsFuseReplyBufLimited(req, buf, n, off, size);
+  if (rc!=0) fprintf(stderr, "fuse_reply_buf failed: %d", rc);
+
+  free(buf);
+  return true;
+}
+
+/*** /gather ***/
+static void gatherRpt(FILE *f) { gatherReport(&GBLS.gather, f); }
+
+static bool
+fs_gather_stat(fs_t *this, fs_file_t *file, struct stat *stbuf)
+{
+  return reportStat(file, stbuf, gatherRpt);
+}
+
+static bool
+fs_gather_read(fs_t *this, fs_file_t *file, fuse_req_t req, size_t size,
+	       off_t off)
+{
+  return reportRead(req, size, off, gatherRpt);
+}
+
+fs_fileops_t fs_gather_ops = {
+  .stat    = fs_gather_stat,
+  .open    = NULL,
+  .read    = fs_gather_read,
+  .write   = NULL,
+  .readdir = NULL
+};
+
+/*** /reduce ***/
+static void reduceRpt(FILE *f) { reduceReport(&GBLS.reduce, f); }
+
+static bool
+fs_reduce_stat(fs_t *this, fs_file_t *file, struct stat *stbuf)
+{
+  return reportStat(file, stbuf, reduceRpt);
+}
+
+static bool
+fs_reduce_read(fs_t *this, fs_file_t *file, fuse_req_t req, size_t size,
+	       off_t off)
+{
+  return reportRead(req, size, off, reduceRpt);
+}
+
+fs_fileops_t fs_reduce_ops = {
+  .stat    = fs_reduce_stat,
+  .open    = NULL,
+  .read    = fs_reduce_read,
+  .write   = NULL,
+  .readdir = NULL
+};
+
+/*** /watch ***/
+static void watchRpt(FILE *f) { watchReport(&GBLS.watch, f); }
+
+static bool
+fs_watch_stat(fs_t *this, fs_file_t *file, struct stat *stbuf)
+{
+  return reportStat(file, stbuf, watchRpt);
+}
+
+static bool
+fs_watch_read(fs_t *this, fs_file_t *file, fuse_req_t req, size_t size,
+	      off_t off)
+{
+  return reportRead(req, size, off, watchRpt);
+}
+
+fs_fileops_t fs_watch_ops = {
+  .stat    = fs_watch_stat,
+  .open    = NULL,
+  .read    = fs_watch_read,
+  .write   = NULL,
+  .readdir = NULL
+};
+
+/*** /ready ***/
+static void readyRpt(FILE *f) { readyReport(&GBLS.ready, f); }
+
+static bool
+fs_ready_stat(fs_t *this, fs_file_t *file, struct stat *stbuf)
+{
+  return reportStat(file, stbuf, readyRpt);
+}
+
+static bool
+fs_ready_read(fs_t *this, fs_file_t *file, fuse_req_t req, size_t size,
+	      off_t off)
+{
+  return reportRead(req, size, off, readyRpt);
+}
+
+fs_fileops_t fs_ready_ops = {
+  .stat    = fs_ready_stat,
+  .open    = NULL,
+  .read    = fs_ready_read,
+  .write   = NULL,
+  .readdir = NULL
+};
+
+/*** /relay ***/
+static void relayRpt(FILE *f) { relayReport(&GBLS.relay, f); }
+
+static bool
+fs_relay_stat(fs_t *this, fs_file_t *file, struct stat *stbuf)
+{
+  return reportStat(file, stbuf, relayRpt);
+}
+
+static bool
+fs_relay_read(fs_t *this, fs_file_t *file, fuse_req_t req, size_t size,
+	      off_t off)
+{
+  return reportRead(req, size, off, relayRpt);
+}
+
+fs_fileops_t fs_relay_ops = {
+  .stat    = fs_relay_stat,
+  .open    = NULL,
+  .read    = fs_relay_read,
+  .write   = NULL,
+  .readdir = NULL
+};
+
+/*** /ping ***/
+static void pingRpt(FILE *f) { pingReport(&GBLS.ping, f); }
+
+static bool
+fs_ping_stat(fs_t *this, fs_file_t *file, struct stat *stbuf)
+{
+  return reportStat(file, stbuf, pingRpt);
+}
+
+static bool
+fs_ping_read(fs_t *this, fs_file_t *file, fuse_req_t req, size_t size,
+	     off_t off)
+{
+  return reportRead(req, size, off, pingRpt);
+}
+
+fs_fileops_t fs_ping_ops = {
+  .stat    = fs_ping_stat,
+  .open    = NULL,
+  .read    = fs_ping_read,
+  .write   = NULL,
+  .readdir = NULL
+};
+
+/*** /stats ***/
+static bool
+fs_stats_stat(fs_t *this, fs_file_t *file, struct stat *stbuf)
+{
+  VLPRINT(2, "%s %ld: ", file->name, file->ino);
+  stbuf->st_ino = file->ino;
+  stbuf->st_mode = S_IFREG | 0444;
+  stbuf->st_nlink = 1;
+  stbuf->st_size = statsSize(&GBLS.stats, STATS_TEXT);
+  VLPRINT(2, "%ld\n", stbuf->st_size);
+  return true;
+}
+
+// served from the snapshot sized by the last stat (see stats.h)
+static bool
+fs_stats_read(fs_t *this, fs_file_t *file, fuse_req_t req, size_t size,
+	      off_t off)
+{
+  size_t n;
+  char  *buf = statsBuf(&GBLS.stats, STATS_TEXT, &n);
+
+  int rc=fsFuseReplyBufLimited(req, buf, n, off, size);
+  if (rc!=0) fprintf(stderr, "fuse_reply_buf failed: %d", rc);
+  return true;
+}
+
+fs_fileops_t fs_stats_ops = {
+  .stat    = fs_stats_stat,
+  .open    = NULL,
+  .read    = fs_stats_read,
+  .write   = NULL,
+  .readdir = NULL
+};
+
+/*** /metrics ***/
+static bool
+fs_metrics_stat(fs_t *this, fs_file_t *file, struct stat *stbuf)
+{
+  VLPRINT(2, "%s %ld: ", file->name, file->ino);
+  stbuf->st_ino = file->ino;
+  stbuf->st_mode = S_IFREG | 0444;
+  stbuf->st_nlink = 1;
+  stbuf->st_size = statsSize(&GBLS.stats, STATS_METRICS);
+  VLPRINT(2, "%ld\n", stbuf->st_size);
+  return true;
+}
+
+// served from the snapshot sized by the last stat (see stats.h)
+static bool
+fs_metrics_read(fs_t *this, fs_file_t *file, fuse_req_t req, size_t size,
+		off_t off)
+{
+  size_t n;
+  char  *buf = statsBuf(&GBLS.stats, STATS_METRICS, &n);
+
+  int rc=fsFuseReplyBufLimited(req, buf, n, off, size);
+  if (rc!=0) fprintf(stderr, "fuse_reply_buf failed: %d", rc);
+  return true;
+}
+
+fs_fileops_t fs_metrics_ops = {
+  .stat    = fs_metrics_stat,
+  .open    = NULL,
+  .read    = fs_metrics_read,
+  .write   = NULL,
+  .readdir = NULL
+};
 
 void
 yarfsCreate(fs_t *fs, fs_ino_t rootino)
@@ -391,4 +676,20 @@ yarfsCreate(fs_t *fs, fs_ino_t rootino)
   assert(item);
   item = fsCreatefile(fs, rootino, "bcst", NULL, &fs_bcst_ops);
   assert(item);
+  item = fsCreatefile(fs, rootino, "gather", NULL, &fs_gather_ops);
+  assert(item);
+  item = fsCreatefile(fs, rootino, "reduce", NULL, &fs_reduce_ops);
+  assert(item);
+  item = fsCreatefile(fs, rootino, "watch", NULL, &fs_watch_ops);
+  assert(item);
+  item = fsCreatefile(fs, rootino, "ready", NULL, &fs_ready_ops);
+  assert(item);
+  item = fsCreatefile(fs, rootino, "relay", NULL, &fs_relay_ops);
+  assert(item);
+  item = fsCreatefile(fs, rootino, "ping", NULL, &fs_ping_ops);
+  assert(item);
+  item = fsCreatefile(fs, rootino, "stats", NULL, &fs_stats_ops);
+  assert(item);
+  item = fsCreatefile(fs, rootino, "metrics", NULL, &fs_metrics_ops);
+  assert(item);
 }